@@ -0,0 +1,29 @@
+#ifndef REOPENGL_BENCH_H
+#define REOPENGL_BENCH_H
+
+#include <stdio.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/* monotonic seconds */
+static double BenchNow(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+#endif
+}
+
+/* keeps results alive so the compiler can't drop the work being timed */
+static volatile unsigned int benchSink;
+
+#endif
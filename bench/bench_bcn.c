@@ -0,0 +1,247 @@
+/*
+    bench_bcn :
+    MP/s and PSNR of EncodeBlockCompressed for BC1/BC3/BC4/BC5/BC7 on a fixed synthetic RGBA image, on one
+    thread and on several. the blocks are decoded here to measure PSNR over the channels each format keeps, and
+    the multi-threaded output must be byte-identical to the single-threaded one (non-zero exit otherwise).
+    usage : bench_bcn [size] [threads]
+*/
+#include "../reopengl.c"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "bench.h"
+
+typedef struct
+{
+    const char *name;
+    BlockFormatS format;
+    int channels; /* compared for PSNR */
+} BenchFormatS;
+
+static const BenchFormatS benchFormats[] = {
+    {"BC1", BLOCK_BC1, 3},
+    {"BC3", BLOCK_BC3, 4},
+    {"BC4", BLOCK_BC4, 1},
+    {"BC5", BLOCK_BC5, 2},
+    {"BC7", BLOCK_BC7, 4},
+};
+
+/* gradients, a few hard edges and some noise, so blocks range from flat to busy */
+static void FillImage(unsigned char *pixels, int size)
+{
+    unsigned int seed = 1;
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            unsigned char *p = pixels + ((size_t)y * size + x) * 4;
+            seed = seed * 1103515245u + 12345u;
+            int noise = (int)((seed >> 16) & 15) - 8;
+            bool stripe = ((x / 37) + (y / 53)) & 1;
+            int r = x * 255 / size + noise;
+            int g = y * 255 / size + (stripe ? 60 : 0) + noise;
+            int b = ((x + y) * 255 / (2 * size)) ^ (stripe ? 0x40 : 0);
+            int a = (x * x + y * y) < size * size / 2 ? 255 : 128 + (x & 63);
+            p[0] = (unsigned char)ClampByte((float)r);
+            p[1] = (unsigned char)ClampByte((float)g);
+            p[2] = (unsigned char)b;
+            p[3] = (unsigned char)a;
+        }
+    }
+}
+
+static void Expand565(unsigned short c, int rgb[3])
+{
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void DecodeColorBlock(const unsigned char *in, unsigned char out[16][4])
+{
+    unsigned short c0 = (unsigned short)(in[0] | in[1] << 8), c1 = (unsigned short)(in[2] | in[3] << 8);
+    int palette[4][3];
+    Expand565(c0, palette[0]);
+    Expand565(c1, palette[1]);
+    for (int k = 0; k < 3; k++)
+    {
+        if (c0 > c1)
+        {
+            palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+            palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+        }
+        else
+        {
+            palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+            palette[3][k] = 0;
+        }
+    }
+    unsigned int indices = ReadU32LE(in + 4);
+    for (int i = 0; i < 16; i++)
+        for (int k = 0; k < 3; k++)
+            out[i][k] = (unsigned char)palette[(indices >> (2 * i)) & 3][k];
+}
+
+static void DecodeSingleChannelBlock(const unsigned char *in, unsigned char out[16][4], int channel)
+{
+    int a0 = in[0], a1 = in[1], palette[8];
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1)
+    {
+        for (int k = 1; k < 7; k++)
+            palette[k + 1] = ((7 - k) * a0 + k * a1 + 3) / 7;
+    }
+    else
+    {
+        for (int k = 1; k < 5; k++)
+            palette[k + 1] = ((5 - k) * a0 + k * a1 + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    unsigned long long bits = 0;
+    for (int i = 0; i < 6; i++)
+        bits |= (unsigned long long)in[2 + i] << (8 * i);
+    for (int i = 0; i < 16; i++)
+        out[i][channel] = (unsigned char)palette[(bits >> (3 * i)) & 7];
+}
+
+static unsigned int GetBits(const unsigned char *in, int *pos, int count)
+{
+    unsigned int value = 0;
+    for (int i = 0; i < count; i++, (*pos)++)
+        value |= (unsigned int)((in[*pos >> 3] >> (*pos & 7)) & 1) << i;
+    return value;
+}
+
+/* mode 6 only, the one the encoder writes */
+static bool DecodeBC7Block(const unsigned char *in, unsigned char out[16][4])
+{
+    int pos = 0, q[2][4];
+    if (GetBits(in, &pos, 7) != 1u << 6)
+        return false;
+    for (int k = 0; k < 4; k++)
+    {
+        q[0][k] = (int)GetBits(in, &pos, 7);
+        q[1][k] = (int)GetBits(in, &pos, 7);
+    }
+    int p0 = (int)GetBits(in, &pos, 1), p1 = (int)GetBits(in, &pos, 1);
+    for (int i = 0; i < 16; i++)
+    {
+        int w = bc7Weights4[GetBits(in, &pos, i == 0 ? 3 : 4)];
+        for (int k = 0; k < 4; k++)
+        {
+            int a = (q[0][k] << 1) | p0, b = (q[1][k] << 1) | p1;
+            out[i][k] = (unsigned char)(((64 - w) * a + w * b + 32) >> 6);
+        }
+    }
+    return true;
+}
+
+static double Psnr(const unsigned char *pixels, int size, const unsigned char *blocks, const BenchFormatS *fmt)
+{
+    int blocksX = (size + 3) / 4, blockBytes = BlockBytes(fmt->format);
+    double squared = 0.0;
+    unsigned char block[16][4], decoded[16][4];
+    for (int by = 0; by < (size + 3) / 4; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            const unsigned char *in = blocks + ((size_t)by * blocksX + bx) * blockBytes;
+            memset(decoded, 0, sizeof(decoded));
+            switch (fmt->format)
+            {
+            case BLOCK_BC1:
+                DecodeColorBlock(in, decoded);
+                break;
+            case BLOCK_BC3:
+                DecodeSingleChannelBlock(in, decoded, 3);
+                DecodeColorBlock(in + 8, decoded);
+                break;
+            case BLOCK_BC4:
+                DecodeSingleChannelBlock(in, decoded, 0);
+                break;
+            case BLOCK_BC5:
+                DecodeSingleChannelBlock(in, decoded, 0);
+                DecodeSingleChannelBlock(in + 8, decoded, 1);
+                break;
+            case BLOCK_BC7:
+                if (!DecodeBC7Block(in, decoded))
+                    return 0.0;
+                break;
+            }
+            GatherBlock(pixels, size, size, 4, bx, by, block);
+            for (int i = 0; i < 16; i++)
+            {
+                for (int k = 0; k < fmt->channels; k++)
+                {
+                    double d = (double)block[i][k] - decoded[i][k];
+                    squared += d * d;
+                }
+            }
+        }
+    }
+    double mse = squared / ((double)size * size * fmt->channels);
+    return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+/* best of a few runs, in ms */
+static double TimeEncode(const unsigned char *pixels, int size, BlockFormatS format, int threads, unsigned char *out)
+{
+    double best = 1e30;
+    for (int run = 0; run < 3; run++)
+    {
+        double t = BenchNow();
+        EncodeBlockCompressed(pixels, size, size, 4, format, threads, out);
+        t = BenchNow() - t;
+        best = t < best ? t : best;
+        benchSink += out[0];
+    }
+    return best * 1e3;
+}
+
+int main(int argc, char **argv)
+{
+    int size = argc > 1 ? atoi(argv[1]) : 1024;
+    int threads = argc > 2 ? atoi(argv[2]) : (CpuCount() > 4 ? CpuCount() : 4);
+    int mismatches = 0;
+    if (size < 1 || threads < 1)
+    {
+        fprintf(stderr, "usage : %s [size] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    unsigned char *pixels = (unsigned char *)malloc((size_t)size * size * 4);
+    unsigned char *single = (unsigned char *)malloc(BlockCompressedSize(size, size, BLOCK_BC7));
+    unsigned char *multi = (unsigned char *)malloc(BlockCompressedSize(size, size, BLOCK_BC7));
+    if (!pixels || !single || !multi)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    FillImage(pixels, size);
+
+    double mp = (double)size * size * 1e-6;
+    const char *search = "C";
+#ifdef BLOCK_SIMD
+    search = BlockIndexSearch() == PickIndicesAvx2 ? "AVX2" : BlockIndexSearch() == PickIndicesSse41 ? "SSE4.1" : "C";
+#endif
+    printf("%dx%d RGBA, %s index search\n", size, size, search);
+    for (size_t f = 0; f < sizeof(benchFormats) / sizeof(benchFormats[0]); f++)
+    {
+        const BenchFormatS *fmt = &benchFormats[f];
+        size_t bytes = BlockCompressedSize(size, size, fmt->format);
+        double ms1 = TimeEncode(pixels, size, fmt->format, 1, single);
+        double msN = TimeEncode(pixels, size, fmt->format, threads, multi);
+        bool same = memcmp(single, multi, bytes) == 0;
+        mismatches += !same;
+        printf("%s : %7.2f MP/s 1 thread, %7.2f MP/s %2d threads, %5.2f dB%s\n", fmt->name, mp / ms1 * 1e3,
+               mp / msN * 1e3, threads, Psnr(pixels, size, single, fmt), same ? "" : ", MULTI-THREADED OUTPUT DIFFERS");
+    }
+
+    free(pixels);
+    free(single);
+    free(multi);
+    return mismatches ? 1 : 0;
+}
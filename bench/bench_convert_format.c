@@ -0,0 +1,69 @@
+/*
+    bench_convert_format :
+    MP/s of stbi__convert_format for every 8-bit (img_n, req_comp) pair on a 2048x1024 image. the pairs that
+    only copy or fill channels run the SSSE3 shuffle kernel when the CPU has it; the kernel alone is timed as
+    well. build with STBI_NO_SIMD defined to get the scalar numbers for comparison.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "bench.h"
+
+#define WIDTH 2048
+#define HEIGHT 1024
+
+static stbi_uc source[4 * WIDTH * HEIGHT];
+
+int main(void)
+{
+    int img_n, req_comp, i, n = 10;
+    unsigned int seed = 7;
+    for (i = 0; i < (int)sizeof(source); ++i)
+    {
+        seed = seed * 1103515245u + 12345u;
+        source[i] = (stbi_uc)(seed >> 8);
+    }
+
+    for (img_n = 1; img_n <= 4; ++img_n)
+    {
+        for (req_comp = 1; req_comp <= 4; ++req_comp)
+        {
+            double total = 0.0;
+            if (img_n == req_comp)
+                continue;
+            for (i = 0; i < n; ++i)
+            {
+                /* stbi__convert_format frees its input */
+                stbi_uc *data = (stbi_uc *)STBI_MALLOC((size_t)img_n * WIDTH * HEIGHT);
+                memcpy(data, source, (size_t)img_n * WIDTH * HEIGHT);
+                double t = BenchNow();
+                stbi_uc *out = stbi__convert_format(data, img_n, req_comp, WIDTH, HEIGHT);
+                total += BenchNow() - t;
+                benchSink += out[i];
+                STBI_FREE(out);
+            }
+            printf("%d -> %d : %8.1f MP/s", img_n, req_comp, (double)n * WIDTH * HEIGHT / total * 1e-6);
+#ifdef STBI__AVX2
+            {
+                stbi_uc shuf[16], fill[16];
+                int q = stbi__ssse3_available() ? stbi__convert_shuffle_setup(img_n, req_comp, 1, shuf, fill) : 0;
+                if (q)
+                {
+                    stbi_uc *out = (stbi_uc *)STBI_MALLOC((size_t)req_comp * WIDTH * HEIGHT);
+                    double t = BenchNow();
+                    for (i = 0; i < n; ++i)
+                    {
+                        int j;
+                        for (j = 0; j < HEIGHT; ++j)
+                            stbi__convert_shuffle_ssse3(out + (size_t)j * WIDTH * req_comp, source + (size_t)j * WIDTH * img_n, WIDTH, img_n, req_comp, q, shuf, fill);
+                        benchSink += out[i];
+                    }
+                    printf(", ssse3 kernel alone %8.1f MP/s", (double)n * WIDTH * HEIGHT / (BenchNow() - t) * 1e-6);
+                    STBI_FREE(out);
+                }
+            }
+#endif
+            printf("\n");
+        }
+    }
+    return 0;
+}
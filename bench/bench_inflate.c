@@ -0,0 +1,114 @@
+/*
+    bench_inflate :
+    inflate throughput over a corpus of PNG files : each file's IDAT chunks are joined into one zlib stream and
+    decoded with stbi_zlib_decode_malloc_guesssize, so only inflate is timed (no unfiltering or conversion).
+    prints MB/s of decompressed output per file and for the whole corpus.
+    usage : bench_inflate file.png [file.png ...]
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "bench.h"
+
+static unsigned int ReadU32BE(const unsigned char *p)
+{
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+/* the concatenated IDAT payloads, or NULL if the file isn't a PNG */
+static unsigned char *ReadIdat(const char *path, int *length, int *rawLength)
+{
+    unsigned char *file, *idat;
+    long size, pos = 8;
+    int total = 0;
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    file = (unsigned char *)malloc((size_t)size);
+    idat = (unsigned char *)malloc((size_t)size);
+    if (!file || !idat || fread(file, 1, (size_t)size, f) != (size_t)size || size < 8 || memcmp(file, "\x89PNG\r\n\x1a\n", 8) != 0)
+    {
+        fclose(f);
+        free(file);
+        free(idat);
+        return NULL;
+    }
+    fclose(f);
+
+    *rawLength = 0;
+    while (pos + 12 <= size)
+    {
+        unsigned int chunk = ReadU32BE(file + pos);
+        if (chunk > (unsigned int)(size - pos - 12))
+            break;
+        if (memcmp(file + pos + 4, "IHDR", 4) == 0 && chunk >= 13)
+        {
+            /* an upper bound on the decompressed size, as stb_img.h guesses it */
+            static const int channels[7] = {1, 0, 3, 1, 2, 0, 4};
+            const unsigned char *h = file + pos + 8;
+            int bits = h[8] * (h[9] <= 6 ? channels[h[9]] : 4);
+            *rawLength = (int)((((long)ReadU32BE(h) * bits + 7) / 8 + 1) * ReadU32BE(h + 4));
+        }
+        if (memcmp(file + pos + 4, "IDAT", 4) == 0)
+        {
+            memcpy(idat + total, file + pos + 8, chunk);
+            total += (int)chunk;
+        }
+        pos += 12 + (long)chunk;
+    }
+    free(file);
+    *length = total;
+    return idat;
+}
+
+int main(int argc, char **argv)
+{
+    double totalTime = 0.0, totalBytes = 0.0;
+    int f, i, runs = 10;
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage : %s file.png [file.png ...]\n", argv[0]);
+        return 1;
+    }
+
+    for (f = 1; f < argc; ++f)
+    {
+        int length = 0, rawLength = 0, outLength = 0;
+        double best = 1e30;
+        unsigned char *idat = ReadIdat(argv[f], &length, &rawLength);
+        if (!idat || !length)
+        {
+            fprintf(stderr, "%s : not a PNG with image data, skipped\n", argv[f]);
+            free(idat);
+            continue;
+        }
+        for (i = 0; i < runs; ++i)
+        {
+            double t = BenchNow();
+            char *out = stbi_zlib_decode_malloc_guesssize((const char *)idat, length, rawLength > 0 ? rawLength : 16384, &outLength);
+            t = BenchNow() - t;
+            if (!out)
+            {
+                fprintf(stderr, "%s : inflate failed : %s\n", argv[f], stbi_failure_reason());
+                break;
+            }
+            benchSink += (unsigned char)out[outLength / 2];
+            free(out);
+            best = t < best ? t : best;
+        }
+        if (i < runs)
+        {
+            free(idat);
+            continue;
+        }
+        printf("%-40s %9d -> %10d bytes %8.1f MB/s\n", argv[f], length, outLength, outLength / best * 1e-6);
+        totalTime += best;
+        totalBytes += outLength;
+        free(idat);
+    }
+    if (totalTime > 0.0)
+        printf("corpus : %.1f MB/s\n", totalBytes / totalTime * 1e-6);
+    return 0;
+}
@@ -0,0 +1,112 @@
+/*
+    bench_jpeg_kernels :
+    ns per 8x8 block for the IDCT and ns per output pixel for the 2x2 upsampler and YCbCr-to-RGB, for the generic
+    C, SSE2 and AVX2 kernels the CPU can run.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "bench.h"
+
+#define ROW_WIDTH 2048
+
+typedef void (*IdctFn)(stbi_uc *out, int out_stride, short data[64]);
+typedef stbi_uc *(*UpsampleFn)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+typedef void (*ColorFn)(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step);
+
+static stbi_uc nearRow[ROW_WIDTH + 64], farRow[ROW_WIDTH + 64], lumaRow[ROW_WIDTH + 64];
+static stbi_uc output[4 * ROW_WIDTH + 64];
+
+static void BenchIdct(const char *name, IdctFn idct)
+{
+    STBI_SIMD_ALIGN(short, block[64]);
+    STBI_SIMD_ALIGN(short, data[64]);
+    stbi_uc out[64];
+    int i, k, n = 2000000;
+    unsigned int seed = 1;
+    /* a typical block : a few low-frequency coefficients, the rest zero */
+    for (k = 0; k < 64; ++k)
+    {
+        seed = seed * 1103515245u + 12345u;
+        block[k] = k < 12 ? (short)((int)((seed >> 8) % 512) - 256) : 0;
+    }
+    double t = BenchNow();
+    for (i = 0; i < n; ++i)
+    {
+        memcpy(data, block, sizeof(data));
+        idct(out, 8, data);
+        benchSink += out[i & 63];
+    }
+    printf("%-20s %7.1f ns/block\n", name, (BenchNow() - t) / n * 1e9);
+}
+
+static void BenchUpsample(const char *name, UpsampleFn upsample)
+{
+    int i, n = 20000;
+    double t = BenchNow();
+    for (i = 0; i < n; ++i)
+    {
+        upsample(output, nearRow, farRow, ROW_WIDTH, 2);
+        benchSink += output[i & 1023];
+    }
+    printf("%-20s %7.2f ns/px\n", name, (BenchNow() - t) / n / (2 * ROW_WIDTH) * 1e9);
+}
+
+static void BenchColor(const char *name, ColorFn color, int step)
+{
+    int i, n = 20000;
+    double t = BenchNow();
+    for (i = 0; i < n; ++i)
+    {
+        color(output, lumaRow, nearRow, farRow, ROW_WIDTH, step);
+        benchSink += output[i & 1023];
+    }
+    printf("%-20s %7.2f ns/px\n", name, (BenchNow() - t) / n / ROW_WIDTH * 1e9);
+}
+
+int main(void)
+{
+    int i;
+    unsigned int seed = 7;
+    for (i = 0; i < ROW_WIDTH + 64; ++i)
+    {
+        seed = seed * 1103515245u + 12345u;
+        nearRow[i] = (stbi_uc)(seed >> 8);
+        farRow[i] = (stbi_uc)(seed >> 16);
+        lumaRow[i] = (stbi_uc)(seed >> 24);
+    }
+
+    BenchIdct("idct C", stbi__idct_block);
+#ifdef STBI_SSE2
+    if (stbi__sse2_available())
+        BenchIdct("idct sse2", stbi__idct_simd);
+#endif
+#ifdef STBI__AVX2
+    if (stbi__avx2_available())
+        BenchIdct("idct avx2", stbi__idct_avx2);
+#endif
+
+    BenchUpsample("hv_2 C", stbi__resample_row_hv_2);
+#ifdef STBI_SSE2
+    if (stbi__sse2_available())
+        BenchUpsample("hv_2 sse2", stbi__resample_row_hv_2_simd);
+#endif
+#ifdef STBI__AVX2
+    if (stbi__avx2_available())
+        BenchUpsample("hv_2 avx2", stbi__resample_row_hv_2_avx2);
+#endif
+
+    BenchColor("ycbcr C, rgba", stbi__YCbCr_to_RGB_row, 4);
+#ifdef STBI_SSE2
+    if (stbi__sse2_available())
+        BenchColor("ycbcr sse2, rgba", stbi__YCbCr_to_RGB_simd, 4);
+#endif
+#ifdef STBI__AVX2
+    if (stbi__avx2_available())
+    {
+        BenchColor("ycbcr avx2, rgba", stbi__YCbCr_to_RGB_avx2, 4);
+        BenchColor("ycbcr avx2, rgb", stbi__YCbCr_to_RGB_avx2, 3);
+    }
+#endif
+    BenchColor("ycbcr C, rgb", stbi__YCbCr_to_RGB_row, 3);
+    return 0;
+}
@@ -0,0 +1,66 @@
+/*
+    bench_jpeg_threads :
+    decode time of one JPEG for 1, 2, 4, ... threads. only baseline JPEGs with restart markers split their scan
+    across threads; every JPEG large enough splits its color conversion.
+    usage : bench_jpeg_threads image.jpg [max threads] [decodes]
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_JPEG_THREADS
+#include "../stb_img.h"
+#include "bench.h"
+
+int main(int argc, char **argv)
+{
+    int maxThreads = argc > 2 ? atoi(argv[2]) : 8;
+    int decodes = argc > 3 ? atoi(argv[3]) : 10;
+    int threads, i, w, h, c;
+    double single = 0.0;
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage : %s image.jpg [max threads] [decodes]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (!file)
+    {
+        fprintf(stderr, "can't open %s\n", argv[1]);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char *data = (unsigned char *)malloc((size_t)size);
+    if (!data || fread(data, 1, (size_t)size, file) != (size_t)size)
+    {
+        fprintf(stderr, "can't read %s\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+    fclose(file);
+
+    for (threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        stbi_set_jpeg_thread_count(threads);
+        /* one untimed decode starts the pool threads and warms the caches */
+        stbi_image_free(stbi_load_from_memory(data, (int)size, &w, &h, &c, 0));
+        double t = BenchNow();
+        for (i = 0; i < decodes; ++i)
+        {
+            unsigned char *pixels = stbi_load_from_memory(data, (int)size, &w, &h, &c, 0);
+            if (!pixels)
+            {
+                fprintf(stderr, "decode failed : %s\n", stbi_failure_reason());
+                return 1;
+            }
+            benchSink += pixels[0];
+            stbi_image_free(pixels);
+        }
+        double ms = (BenchNow() - t) / decodes * 1e3;
+        if (threads == 1)
+            single = ms;
+        printf("%dx%d, %2d thread(s) : %8.2f ms/decode, %.2fx\n", w, h, threads, ms, single / ms);
+    }
+    free(data);
+    return 0;
+}
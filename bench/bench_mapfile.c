@@ -0,0 +1,104 @@
+/*
+    bench_mapfile :
+    decode throughput of stbi_load(path), which reads through FILE* and stb's small refill buffer, against MapFile +
+    stbi_load_from_memory + UnmapFile, the path the texture loaders take. both decode to the file's own channel count.
+    prints the median MB/s of file bytes per file and for the whole corpus (warm page cache).
+    usage : bench_mapfile file [file ...]
+*/
+#include "../reopengl.c"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "bench.h"
+
+#define RUNS 21
+
+static int CompareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double Median(double *times)
+{
+    qsort(times, RUNS, sizeof(double), CompareDouble);
+    return times[RUNS / 2];
+}
+
+/* seconds for one decode either way, or a negative time if it failed */
+static double TimeStbiLoad(const char *path)
+{
+    int w, h, c;
+    double t = BenchNow();
+    unsigned char *pixels = stbi_load(path, &w, &h, &c, 0);
+    t = BenchNow() - t;
+    if (!pixels)
+        return -1.0;
+    benchSink += pixels[0];
+    stbi_image_free(pixels);
+    return t;
+}
+
+static double TimeMapped(const char *path)
+{
+    int w, h, c;
+    unsigned char *pixels = NULL;
+    MappedFileS file;
+    double t = BenchNow();
+    if (MapFile(path, &file) && file.size <= INT_MAX)
+        pixels = stbi_load_from_memory(file.data, (int)file.size, &w, &h, &c, 0);
+    UnmapFile(&file);
+    t = BenchNow() - t;
+    if (!pixels)
+        return -1.0;
+    benchSink += pixels[0];
+    stbi_image_free(pixels);
+    return t;
+}
+
+int main(int argc, char **argv)
+{
+    double totalLoad = 0.0, totalMapped = 0.0, totalBytes = 0.0;
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage : %s file [file ...]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-40s %10s %12s %12s %7s\n", "file", "bytes", "stbi_load", "MapFile", "diff");
+    for (int f = 1; f < argc; ++f)
+    {
+        double load[RUNS], mapped[RUNS];
+        bool ok = true;
+        MappedFileS file;
+        if (!MapFile(argv[f], &file))
+        {
+            fprintf(stderr, "%s : can't read\n", argv[f]);
+            continue;
+        }
+        double bytes = (double)file.size;
+        UnmapFile(&file);
+        /* alternate the two so drift in clock speed or cache state hits both alike */
+        for (int i = 0; i < RUNS && ok; ++i)
+        {
+            load[i] = TimeStbiLoad(argv[f]);
+            mapped[i] = TimeMapped(argv[f]);
+            ok = load[i] >= 0.0 && mapped[i] >= 0.0;
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "%s : %s\n", argv[f], stbi_failure_reason());
+            continue;
+        }
+
+        double loadTime = Median(load), mappedTime = Median(mapped);
+        printf("%-40s %10.0f %7.1f MB/s %7.1f MB/s %+6.1f%%\n", argv[f], bytes, bytes / loadTime * 1e-6,
+               bytes / mappedTime * 1e-6, (loadTime / mappedTime - 1.0) * 100.0);
+        totalLoad += loadTime;
+        totalMapped += mappedTime;
+        totalBytes += bytes;
+    }
+    if (totalBytes > 0.0)
+        printf("corpus : %.1f MB/s stbi_load, %.1f MB/s MapFile\n", totalBytes / totalLoad * 1e-6, totalBytes / totalMapped * 1e-6);
+    return 0;
+}
@@ -0,0 +1,55 @@
+/*
+    bench_png_unfilter :
+    MB/s of output for each PNG filter type with 3- and 4-byte pixels, for the scalar stbi__unfilter_row and the
+    SSE4.1 and AVX2 kernels the CPU can run. unfiltering only; no inflate, no format conversion.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "bench.h"
+
+#define ROW_PIXELS 4096
+#define ROW_BYTES (4 * ROW_PIXELS)
+
+static stbi_uc rawRow[ROW_BYTES], rows[2][ROW_BYTES];
+
+static const char *filterNames[] = {"none", "sub", "up", "avg", "paeth", "avg_first"};
+
+/* each row unfilters against the previous one, as in a real image */
+static void BenchUnfilter(const char *name, stbi__unfilter_row_func unfilter, int bpp)
+{
+    int filter, i, n = 4000, nk = ROW_PIXELS * bpp;
+    for (filter = STBI__F_sub; filter <= STBI__F_paeth; ++filter)
+    {
+        double t = BenchNow();
+        for (i = 0; i < n; ++i)
+        {
+            unfilter(rows[i & 1], rows[(i + 1) & 1], rawRow, nk, bpp, filter);
+            benchSink += rows[i & 1][i & 1023];
+        }
+        printf("%-10s %d bytes/px %-6s %8.1f MB/s\n", name, bpp, filterNames[filter], (double)n * nk / (BenchNow() - t) * 1e-6);
+    }
+}
+
+int main(void)
+{
+    int i, bpp;
+    unsigned int seed = 7;
+    for (i = 0; i < ROW_BYTES; ++i)
+    {
+        seed = seed * 1103515245u + 12345u;
+        rawRow[i] = (stbi_uc)(seed >> 8);
+        rows[1][i] = (stbi_uc)(seed >> 16);
+    }
+
+    for (bpp = 3; bpp <= 4; ++bpp)
+    {
+        BenchUnfilter("C", stbi__unfilter_row, bpp);
+#ifdef STBI__AVX2
+        if (stbi__sse41_available())
+            BenchUnfilter("sse4.1", stbi__unfilter_row_sse41, bpp);
+        if (stbi__avx2_available())
+            BenchUnfilter("avx2", stbi__unfilter_row_avx2, bpp);
+#endif
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+/*
+    bench_rgbe_half :
+    MP/s of RGBE to half conversion for the scalar stbi__rgbe_to_half_scalar and, when the CPU has F16C, the
+    kernel plus its scalar tail. random mantissas with exponents in the normal half range.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "bench.h"
+
+#define PIXELS (1 << 20)
+
+static stbi_uc rgbe[PIXELS * 4];
+static stbi_us half[PIXELS * 3];
+
+static void BenchConvert(const char *name, void (*convert)(stbi_us *, stbi_uc const *, int))
+{
+    int i, n = 50;
+    double t = BenchNow();
+    for (i = 0; i < n; ++i)
+    {
+        convert(half, rgbe, PIXELS);
+        benchSink += half[i];
+    }
+    printf("%-6s %8.1f MP/s\n", name, (double)n * PIXELS / (BenchNow() - t) * 1e-6);
+}
+
+#ifdef STBI__AVX2
+static void ConvertF16c(stbi_us *output, stbi_uc const *input, int pixel_count)
+{
+    int done = stbi__rgbe_to_half_f16c(output, input, pixel_count);
+    stbi__rgbe_to_half_scalar(output + done * 3, input + done * 4, pixel_count - done);
+}
+#endif
+
+int main(void)
+{
+    int i;
+    unsigned int seed = 7;
+    for (i = 0; i < PIXELS * 4; ++i)
+    {
+        seed = seed * 1103515245u + 12345u;
+        rgbe[i] = (i & 3) == 3 ? (stbi_uc)(120 + (seed >> 16) % 24) : (stbi_uc)(seed >> 16);
+    }
+
+    BenchConvert("C", stbi__rgbe_to_half_scalar);
+#ifdef STBI__AVX2
+    if (stbi__f16c_available())
+        BenchConvert("f16c", ConvertF16c);
+#endif
+    return 0;
+}
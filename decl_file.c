@@ -1,4 +1,15 @@
+#include <stddef.h>
+
+/* stb allocates through the image arena in reopengl.c */
+void *ImageArenaAlloc(size_t size);
+void *ImageArenaRealloc(void *p, size_t oldSize, size_t newSize);
+void ImageArenaFree(void *p);
+
 #define STB_IMAGE_IMPLEMENTATION
+#define STBI_JPEG_THREADS
+#define STBI_MALLOC(sz) ImageArenaAlloc(sz)
+#define STBI_REALLOC_SIZED(p, oldsz, newsz) ImageArenaRealloc(p, oldsz, newsz)
+#define STBI_FREE(p) ImageArenaFree(p)
 #include "stb_img.h"
 
 #define STB_EASY_FONT_IMPLEMENTATION
@@ -1,3 +1,16 @@
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE /* realpath, madvise */
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <limits.h>
 #include "reopengl.h"
 
 /* function impelementation*/
@@ -43,48 +56,335 @@ void DestroyWindow(GLFWwindow *window)
 
     glfwTerminate();
 }
-GLuint CreateShaderStr(const char *vertexShSouce, const char *fragmentShSource)
+static unsigned int HashString(const char *str, unsigned int seed)
+{
+    /* FNV-1a */
+    unsigned int hash = 2166136261u ^ seed;
+    for (const unsigned char *c = (const unsigned char *)str; *c; c++)
+    {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+#ifdef _WIN32
+#define CANONICAL_PATH_MAX _MAX_PATH
+#else
+#define CANONICAL_PATH_MAX PATH_MAX
+#endif
+
+/* canonical form of path into out (CANONICAL_PATH_MAX bytes), false when it doesn't fit */
+static bool CanonicalPath(const char *path, char *out)
+{
+#ifdef _WIN32
+    if (_fullpath(out, path, CANONICAL_PATH_MAX))
+        return true;
+#else
+    if (realpath(path, out))
+        return true;
+#endif
+
+    /* file may not exist, the loader reports that; key on the path as given */
+    size_t length = strlen(path);
+    if (length >= CANONICAL_PATH_MAX)
+        return false;
+    memcpy(out, path, length + 1);
+    return true;
+}
+
+static char *CopyString(const char *text)
+{
+    size_t length = strlen(text) + 1;
+    char *copy = (char *)malloc(length);
+    if (copy)
+        memcpy(copy, text, length);
+    return copy;
+}
+
+/*
+    program binary cache :
+    with a directory set by SetProgramCacheDir (and GL 4.1 or ARB_get_program_binary), CreateShaderStr keeps
+    each linked program's glGetProgramBinary blob in <dir>/<key>.glprog and loads it with glProgramBinary on
+    the next run instead of compiling. the key hashes both sources with GL_VENDOR, GL_RENDERER and GL_VERSION,
+    so another GPU or driver update misses; a binary the driver still rejects is compiled as usual and the
+    file rewritten.
+*/
+typedef struct
+{
+    char magic[8];
+    unsigned int key[2];
+    unsigned int sourceLength[2];
+    unsigned int format;
+    unsigned int length;
+} ProgramBinaryHeaderS;
+
+static const char PROGRAM_BINARY_MAGIC[8] = "RGLPROG";
+static char *programCacheDir;
+static ProgramCacheStatsS programCacheStats;
+
+bool SetProgramCacheDir(const char *dir)
+{
+    free(programCacheDir);
+    programCacheDir = NULL;
+    if (!dir || !*dir)
+        return true;
+
+#ifdef _WIN32
+    _mkdir(dir);
+#else
+    mkdir(dir, 0755);
+#endif
+    programCacheDir = (char *)malloc(strlen(dir) + 1);
+    if (!programCacheDir)
+        return false;
+    strcpy(programCacheDir, dir);
+    return true;
+}
+
+ProgramCacheStatsS GetProgramCacheStats()
+{
+    return programCacheStats;
+}
+
+static bool ProgramBinaryKey(const char *vertexSource, const char *fragmentSource, ProgramBinaryHeaderS *header, char *path, size_t pathSize)
 {
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShSouce, NULL);
-    glCompileShader(vertexShader);
+    if (!programCacheDir || !(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary))
+        return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0)
+        return false;
 
-    if (!IsShaderCompiled(vertexShader, "vertex shader"))
+    const char *driver[3] = {(const char *)glGetString(GL_VENDOR), (const char *)glGetString(GL_RENDERER),
+                             (const char *)glGetString(GL_VERSION)};
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, PROGRAM_BINARY_MAGIC, sizeof(header->magic));
+    /* two FNV-1a chains with different seeds make a 64-bit key */
+    for (int k = 0; k < 2; k++)
     {
-        glDeleteShader(vertexShader);
+        unsigned int hash = HashString(vertexSource, k ? 0x9e3779b9u : 0u);
+        hash = HashString(fragmentSource, hash * 31u + 1u);
+        for (int i = 0; i < 3; i++)
+            hash = HashString(driver[i] ? driver[i] : "", hash * 31u + 1u);
+        header->key[k] = hash;
+    }
+    header->sourceLength[0] = (unsigned int)strlen(vertexSource);
+    header->sourceLength[1] = (unsigned int)strlen(fragmentSource);
+
+    int written = snprintf(path, pathSize, "%s/%08x%08x.glprog", programCacheDir, header->key[0], header->key[1]);
+    return written > 0 && (size_t)written < pathSize;
+}
 
+static GLuint LoadProgramBinary(const char *path, const ProgramBinaryHeaderS *expected)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        programCacheStats.misses++;
         return 0;
     }
 
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShSource, NULL);
-    glCompileShader(fragmentShader);
-
-    if (!IsShaderCompiled(fragmentShader, "fragment shader"))
+    ProgramBinaryHeaderS header;
+    void *binary = NULL;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, expected->magic, sizeof(header.magic)) == 0 &&
+              memcmp(header.key, expected->key, sizeof(header.key)) == 0 &&
+              memcmp(header.sourceLength, expected->sourceLength, sizeof(header.sourceLength)) == 0 && header.length > 0 &&
+              (binary = malloc(header.length)) != NULL && fread(binary, 1, header.length, file) == header.length;
+    fclose(file);
+    if (!ok)
     {
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
+        free(binary);
+        programCacheStats.rejected++;
+        return 0;
+    }
 
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary, (GLsizei)header.length);
+    free(binary);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        /* the driver changed under an unchanged version string, or the file is damaged */
+        glDeleteProgram(program);
+        programCacheStats.rejected++;
         return 0;
     }
+    programCacheStats.hits++;
+    return program;
+}
 
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
+static void SaveProgramBinary(GLuint program, const char *path, ProgramBinaryHeaderS *header)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    void *binary = length > 0 ? malloc((size_t)length) : NULL;
+    if (!binary)
+        return;
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary);
+    header->format = format;
+    header->length = (unsigned int)written;
 
-    if (!IsProgramLinked(shaderProgram))
+    /* write next to it and rename, so a crash never leaves a torn file under the real name */
+    size_t pathLength = strlen(path);
+    char *tmpPath = (char *)malloc(pathLength + 5);
+    FILE *file = NULL;
+    if (written > 0 && tmpPath)
     {
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
-        glDeleteProgram(shaderProgram);
-        return 0;
+        memcpy(tmpPath, path, pathLength);
+        memcpy(tmpPath + pathLength, ".tmp", 5);
+        file = fopen(tmpPath, "wb");
+    }
+    if (file)
+    {
+        bool ok = fwrite(header, sizeof(*header), 1, file) == 1 && fwrite(binary, 1, (size_t)written, file) == (size_t)written;
+        ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+        remove(path);
+#endif
+        if (ok && rename(tmpPath, path) == 0)
+            programCacheStats.written++;
+        else
+            remove(tmpPath);
     }
+    free(tmpPath);
+    free(binary);
+}
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+/*
+    shader batches :
+    SubmitShaderBatch compiles every shader of the batch and links every program without asking for any
+    status in between, so the driver can run them all at once (on its compiler threads, with
+    KHR/ARB_parallel_shader_compile); the status checks, the logs of failures, the binary cache and the
+    uniform tables are left to PollShaderBatch. with parallel compile it only finishes the programs whose
+    GL_COMPLETION_STATUS_KHR is set, so calling it once per frame never waits on the compiler; without the
+    extension, or with wait, it finishes all of them. CreateShaderStr is a batch of one.
+*/
+static bool HasParallelShaderCompile()
+{
+    return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+}
 
-    return shaderProgram;
+void SubmitShaderBatch(ShaderBuildS *builds, int count)
+{
+    static bool threadsRequested = false;
+    if (!threadsRequested && HasParallelShaderCompile())
+    {
+        /* as many compiler threads as the driver will give */
+        if (GLEW_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        else
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+        threadsRequested = true;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        ShaderBuildS *build = &builds[i];
+        build->program = 0;
+        build->vertexShader = 0;
+        build->fragmentShader = 0;
+        build->state = SHADER_BUILD_PENDING;
+
+        ProgramBinaryHeaderS binaryHeader;
+        char binaryPath[4096];
+        if (ProgramBinaryKey(build->vertexSource, build->fragmentSource, &binaryHeader, binaryPath, sizeof(binaryPath)))
+        {
+            build->program = LoadProgramBinary(binaryPath, &binaryHeader);
+            if (build->program)
+            {
+                CacheProgramUniforms(build->program);
+                build->state = SHADER_BUILD_READY;
+                continue;
+            }
+        }
+
+        build->vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(build->vertexShader, 1, &build->vertexSource, NULL);
+        glCompileShader(build->vertexShader);
+        build->fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(build->fragmentShader, 1, &build->fragmentSource, NULL);
+        glCompileShader(build->fragmentShader);
+    }
+
+    /* links go in after all the compiles; a program whose shaders failed just fails to link */
+    bool retrievable = programCacheDir && (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary);
+    for (int i = 0; i < count; i++)
+    {
+        ShaderBuildS *build = &builds[i];
+        if (build->state != SHADER_BUILD_PENDING)
+            continue;
+        build->program = glCreateProgram();
+        glAttachShader(build->program, build->vertexShader);
+        glAttachShader(build->program, build->fragmentShader);
+        if (retrievable)
+            glProgramParameteri(build->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(build->program);
+    }
+}
+
+static void FinishShaderBuild(ShaderBuildS *build)
+{
+    /* the compile logs say more than the link log when a shader is at fault */
+    bool compiled = IsShaderCompiled(build->vertexShader, "vertex shader");
+    compiled = IsShaderCompiled(build->fragmentShader, "fragment shader") && compiled;
+    bool linked = compiled && IsProgramLinked(build->program);
+
+    glDeleteShader(build->vertexShader);
+    glDeleteShader(build->fragmentShader);
+    build->vertexShader = 0;
+    build->fragmentShader = 0;
+    if (!linked)
+    {
+        glDeleteProgram(build->program);
+        build->program = 0;
+        build->state = SHADER_BUILD_FAILED;
+        return;
+    }
+
+    ProgramBinaryHeaderS binaryHeader;
+    char binaryPath[4096];
+    if (ProgramBinaryKey(build->vertexSource, build->fragmentSource, &binaryHeader, binaryPath, sizeof(binaryPath)))
+        SaveProgramBinary(build->program, binaryPath, &binaryHeader);
+    CacheProgramUniforms(build->program);
+    build->state = SHADER_BUILD_READY;
+}
+
+int PollShaderBatch(ShaderBuildS *builds, int count, bool wait)
+{
+    bool query = !wait && HasParallelShaderCompile();
+    int pending = 0;
+    for (int i = 0; i < count; i++)
+    {
+        ShaderBuildS *build = &builds[i];
+        if (build->state != SHADER_BUILD_PENDING)
+            continue;
+        if (query)
+        {
+            GLint done = GL_FALSE;
+            glGetProgramiv(build->program, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done)
+            {
+                pending++;
+                continue;
+            }
+        }
+        FinishShaderBuild(build);
+    }
+    return pending;
+}
+
+GLuint CreateShaderStr(const char *vertexShSouce, const char *fragmentShSource)
+{
+    ShaderBuildS build = {0};
+    build.vertexSource = vertexShSouce;
+    build.fragmentSource = fragmentShSource;
+    SubmitShaderBatch(&build, 1);
+    PollShaderBatch(&build, 1, true);
+    return build.program;
 }
 
 GLuint CreateShaderFiles(const char *vertexShPath, const char *fragmentShPath)
@@ -162,203 +462,4309 @@ char *ReadGlslfile(const char *filepath)
     buffer[len] = '\0';
     fclose(file);
 
-    return buffer;
+    return buffer;
+}
+
+/*
+    GLSL preprocessing :
+    PreprocessGlslFile expands #include "file" (or <file>) lines, paths relative to the including file and
+    every file at most once, and adds the defines right after #version. #line directives keep compiler
+    messages pointing at the right place : source string 0 is the top file, the others number the included
+    files in the order they were first met.
+    CreateShaderVariant caches programs per permutation key : the canonical paths of both files and the
+    sorted, deduplicated define set, so the same variant asked for with its defines in another order (or
+    spelled NAME=VALUE instead of NAME VALUE) is compiled only once per process (and, being the same source,
+    shares its on-disk binary too). one name given two different values is refused.
+*/
+typedef struct
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} GlslBufferS;
+
+typedef struct
+{
+    char **paths; /* canonical paths already expanded */
+    int count;
+    int capacity;
+} GlslIncludesS;
+
+#define GLSL_MAX_INCLUDE_DEPTH 32
+
+static void AppendGlsl(GlslBufferS *buf, const char *text, size_t length)
+{
+    if (buf->failed)
+        return;
+    if (buf->length + length + 1 > buf->capacity)
+    {
+        size_t capacity = buf->capacity ? buf->capacity : 4096;
+        while (buf->length + length + 1 > capacity)
+            capacity *= 2;
+        char *data = (char *)realloc(buf->data, capacity);
+        if (!data)
+        {
+            buf->failed = true;
+            return;
+        }
+        buf->data = data;
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->length, text, length);
+    buf->length += length;
+    buf->data[buf->length] = '\0';
+}
+
+static void AppendGlslLine(GlslBufferS *buf, int line, int sourceString)
+{
+    char directive[48];
+    int length = snprintf(directive, sizeof(directive), "#line %d %d\n", line, sourceString);
+    AppendGlsl(buf, directive, (size_t)length);
+}
+
+/* the path of an #include line, or false when the line is something else */
+static bool ParseGlslInclude(const char *line, const char *end, const char **pathStart, size_t *pathLength)
+{
+    while (line < end && (*line == ' ' || *line == '\t'))
+        line++;
+    if (line == end || *line++ != '#')
+        return false;
+    while (line < end && (*line == ' ' || *line == '\t'))
+        line++;
+    if ((size_t)(end - line) < 7 || strncmp(line, "include", 7) != 0)
+        return false;
+    line += 7;
+    while (line < end && (*line == ' ' || *line == '\t'))
+        line++;
+    if (line == end || (*line != '"' && *line != '<'))
+        return false;
+    char close = *line == '"' ? '"' : '>';
+    const char *start = ++line;
+    while (line < end && *line != close)
+        line++;
+    if (line == end || line == start)
+        return false;
+    *pathStart = start;
+    *pathLength = (size_t)(line - start);
+    return true;
+}
+
+static bool IsGlslVersionLine(const char *line, const char *end)
+{
+    while (line < end && (*line == ' ' || *line == '\t'))
+        line++;
+    if (line == end || *line++ != '#')
+        return false;
+    while (line < end && (*line == ' ' || *line == '\t'))
+        line++;
+    return (size_t)(end - line) >= 7 && strncmp(line, "version", 7) == 0;
+}
+
+static void AppendGlslDefines(GlslBufferS *buf, const char *const *defines, int defineCount, int nextLine)
+{
+    for (int i = 0; i < defineCount; i++)
+    {
+        /* "NAME=VALUE" as on a compiler command line is "NAME VALUE"; an '=' after the name belongs to the value */
+        const char *define = defines[i];
+        size_t nameLength = strcspn(define, "= \t");
+        AppendGlsl(buf, "#define ", 8);
+        AppendGlsl(buf, define, nameLength);
+        if (define[nameLength] == '=')
+        {
+            AppendGlsl(buf, " ", 1);
+            AppendGlsl(buf, define + nameLength + 1, strlen(define + nameLength + 1));
+        }
+        else
+        {
+            AppendGlsl(buf, define + nameLength, strlen(define + nameLength));
+        }
+        AppendGlsl(buf, "\n", 1);
+    }
+    if (defineCount > 0)
+        AppendGlslLine(buf, nextLine, 0);
+}
+
+static bool ExpandGlslFile(GlslBufferS *buf, GlslIncludesS *included, const char *path, int depth, const char *const *defines,
+                           int defineCount)
+{
+    if (depth > GLSL_MAX_INCLUDE_DEPTH)
+    {
+        fprintf(stderr, "GLSL includes nested too deep at: %s\n", path);
+        return false;
+    }
+
+    char canonicalPath[CANONICAL_PATH_MAX];
+    if (!CanonicalPath(path, canonicalPath))
+        return false;
+    for (int i = 0; i < included->count; i++)
+    {
+        if (strcmp(included->paths[i], canonicalPath) == 0)
+        {
+            /* already in, also breaks include cycles */
+            return true;
+        }
+    }
+    if (included->count == included->capacity)
+    {
+        int capacity = included->capacity ? included->capacity * 2 : 8;
+        char **paths = (char **)realloc(included->paths, (size_t)capacity * sizeof(char *));
+        if (!paths)
+            return false;
+        included->paths = paths;
+        included->capacity = capacity;
+    }
+    char *pathCopy = CopyString(canonicalPath);
+    if (!pathCopy)
+        return false;
+    int sourceString = included->count;
+    included->paths[included->count++] = pathCopy;
+
+    char *source = ReadGlslfile(path);
+    if (!source)
+        return false;
+
+    /* includes resolve against this file's directory */
+    const char *slash = strrchr(path, '/');
+#ifdef _WIN32
+    const char *backslash = strrchr(path, '\\');
+    if (backslash && (!slash || backslash > slash))
+        slash = backslash;
+#endif
+    size_t dirLength = slash ? (size_t)(slash - path) + 1 : 0;
+
+    if (depth > 0)
+        AppendGlslLine(buf, 1, sourceString);
+
+    bool ok = true;
+    bool definesDone = depth > 0 || defineCount == 0;
+    int lineNumber = 1;
+    if (!definesDone)
+    {
+        /* without #version the defines go first */
+        bool hasVersion = false;
+        for (const char *line = source; *line;)
+        {
+            const char *end = strchr(line, '\n');
+            end = end ? end : line + strlen(line);
+            if (IsGlslVersionLine(line, end))
+            {
+                hasVersion = true;
+                break;
+            }
+            line = *end ? end + 1 : end;
+        }
+        if (!hasVersion)
+        {
+            AppendGlslDefines(buf, defines, defineCount, 1);
+            definesDone = true;
+        }
+    }
+
+    for (const char *line = source; ok && *line; lineNumber++)
+    {
+        const char *end = strchr(line, '\n');
+        end = end ? end : line + strlen(line);
+        const char *next = *end ? end + 1 : end;
+
+        const char *includePath;
+        size_t includeLength;
+        if (ParseGlslInclude(line, end, &includePath, &includeLength))
+        {
+            char *childPath = (char *)malloc(dirLength + includeLength + 1);
+            if (!childPath)
+            {
+                ok = false;
+                break;
+            }
+            bool absolute = includePath[0] == '/';
+#ifdef _WIN32
+            absolute = absolute || includePath[0] == '\\' || (includeLength > 1 && includePath[1] == ':');
+#endif
+            size_t prefix = absolute ? 0 : dirLength;
+            memcpy(childPath, path, prefix);
+            memcpy(childPath + prefix, includePath, includeLength);
+            childPath[prefix + includeLength] = '\0';
+
+            int before = included->count;
+            ok = ExpandGlslFile(buf, included, childPath, depth + 1, NULL, 0);
+            if (!ok)
+                fprintf(stderr, "  included from %s:%d\n", path, lineNumber);
+            else if (included->count != before)
+                AppendGlslLine(buf, lineNumber + 1, sourceString);
+            else
+                AppendGlsl(buf, "\n", 1);
+            free(childPath);
+        }
+        else if (depth > 0 && IsGlslVersionLine(line, end))
+        {
+            /* include files may carry a #version for editors and validators; only the top one counts */
+            AppendGlsl(buf, "\n", 1);
+        }
+        else
+        {
+            AppendGlsl(buf, line, (size_t)(next - line));
+            if (next == end && end != line)
+                AppendGlsl(buf, "\n", 1);
+            if (!definesDone && IsGlslVersionLine(line, end))
+            {
+                AppendGlslDefines(buf, defines, defineCount, lineNumber + 1);
+                definesDone = true;
+            }
+        }
+        line = next;
+    }
+
+    free(source);
+    return ok && !buf->failed;
+}
+
+char *PreprocessGlslFile(const char *path, const char *const *defines, int defineCount)
+{
+    GlslBufferS buf = {0};
+    GlslIncludesS included = {0};
+    bool ok = ExpandGlslFile(&buf, &included, path, 0, defines, defineCount);
+    for (int i = 0; i < included.count; i++)
+        free(included.paths[i]);
+    free(included.paths);
+    if (!ok)
+    {
+        free(buf.data);
+        return NULL;
+    }
+    return buf.data;
+}
+
+/*
+    permutation key : canonical vertex path, canonical fragment path, then the defines one per line, each
+    written as "NAME VALUE" (or "NAME"), sorted and without duplicates. sortedDefines receives the define order
+    the variant is built with, pointing into defineText (room for every define plus its terminator).
+    the same name with two different values is an error rather than a separate variant.
+*/
+static bool IsDefineSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+/* "NAME=VALUE", "NAME VALUE" or "NAME" into out as "NAME VALUE" / "NAME", returns the end of the copy or NULL without a name */
+static char *NormalizeDefine(const char *define, char *out)
+{
+    while (IsDefineSpace(*define))
+        define++;
+    size_t nameLength = strcspn(define, "= \t");
+    if (nameLength == 0)
+        return NULL;
+    memcpy(out, define, nameLength);
+    out += nameLength;
+
+    const char *value = define + nameLength;
+    while (IsDefineSpace(*value))
+        value++;
+    if (*value == '=')
+        value++;
+    while (IsDefineSpace(*value))
+        value++;
+    size_t valueLength = strlen(value);
+    while (valueLength > 0 && IsDefineSpace(value[valueLength - 1]))
+        valueLength--;
+    if (valueLength > 0)
+    {
+        *out++ = ' ';
+        memcpy(out, value, valueLength);
+        out += valueLength;
+    }
+    *out++ = '\0';
+    return out;
+}
+
+/* a name never holds a space, so plain string order puts every define with the same name next to each other */
+static int CompareDefines(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static char *ShaderVariantKey(const char *vertexPath, const char *fragmentPath, const char *const *defines, int defineCount,
+                              char *defineText, const char **sortedDefines, int *sortedCount)
+{
+    char paths[2][CANONICAL_PATH_MAX];
+    bool pathsOk = CanonicalPath(vertexPath, paths[0]) && CanonicalPath(fragmentPath, paths[1]);
+    size_t length = 0;
+    for (int i = 0; pathsOk && i < 2; i++)
+        length += strlen(paths[i]) + 1;
+
+    for (int i = 0; i < defineCount; i++)
+    {
+        sortedDefines[i] = defineText;
+        defineText = NormalizeDefine(defines[i], defineText);
+        if (!defineText)
+        {
+            fprintf(stderr, "Shader define without a name: \"%s\"\n", defines[i]);
+            return NULL;
+        }
+    }
+    if (defineCount > 0)
+        qsort(sortedDefines, (size_t)defineCount, sizeof(char *), CompareDefines);
+    *sortedCount = 0;
+    for (int i = 0; i < defineCount; i++)
+    {
+        if (*sortedCount > 0)
+        {
+            const char *previous = sortedDefines[*sortedCount - 1];
+            size_t nameLength = strcspn(previous, " ");
+            if (strncmp(previous, sortedDefines[i], nameLength) == 0 && strcspn(sortedDefines[i], " ") == nameLength)
+            {
+                if (strcmp(previous, sortedDefines[i]) == 0)
+                    continue;
+                fprintf(stderr, "Shader define %.*s given different values: \"%s\" and \"%s\"\n", (int)nameLength, previous, previous,
+                        sortedDefines[i]);
+                return NULL;
+            }
+        }
+        sortedDefines[(*sortedCount)++] = sortedDefines[i];
+        length += strlen(sortedDefines[i]) + 1;
+    }
+
+    char *key = pathsOk ? (char *)malloc(length + 1) : NULL;
+    if (key)
+    {
+        char *out = key;
+        for (int i = 0; i < 2; i++)
+            out += sprintf(out, "%s\n", paths[i]);
+        for (int i = 0; i < *sortedCount; i++)
+            out += sprintf(out, "%s\n", sortedDefines[i]);
+    }
+    return key;
+}
+
+typedef struct
+{
+    char *key; /* NULL for an empty slot */
+    unsigned int hash;
+    GLuint program; /* 0 when the variant failed to build; it isn't retried */
+} ShaderVariantS;
+
+static ShaderVariantS *shaderVariants;
+static size_t shaderVariantCapacity; /* power of two */
+static size_t shaderVariantCount;
+static ShaderVariantStatsS shaderVariantStats;
+
+static bool InsertShaderVariant(char *key, unsigned int hash, GLuint program)
+{
+    if ((shaderVariantCount + 1) * 4 > shaderVariantCapacity * 3)
+    {
+        size_t newCapacity = shaderVariantCapacity ? shaderVariantCapacity * 2 : 64;
+        ShaderVariantS *newVariants = (ShaderVariantS *)calloc(newCapacity, sizeof(ShaderVariantS));
+        if (!newVariants)
+            return false;
+        for (size_t i = 0; i < shaderVariantCapacity; i++)
+        {
+            if (!shaderVariants[i].key)
+                continue;
+            size_t j = shaderVariants[i].hash & (newCapacity - 1);
+            while (newVariants[j].key)
+                j = (j + 1) & (newCapacity - 1);
+            newVariants[j] = shaderVariants[i];
+        }
+        free(shaderVariants);
+        shaderVariants = newVariants;
+        shaderVariantCapacity = newCapacity;
+    }
+
+    size_t i = hash & (shaderVariantCapacity - 1);
+    while (shaderVariants[i].key)
+        i = (i + 1) & (shaderVariantCapacity - 1);
+    shaderVariants[i].key = key;
+    shaderVariants[i].hash = hash;
+    shaderVariants[i].program = program;
+    shaderVariantCount++;
+    shaderVariantStats.variants = shaderVariantCount;
+    return true;
+}
+
+GLuint CreateShaderVariant(const char *vertexPath, const char *fragmentPath, const char *const *defines, int defineCount)
+{
+    size_t textLength = 1;
+    for (int i = 0; i < defineCount; i++)
+        textLength += strlen(defines[i]) + 1;
+    const char **sortedDefines = (const char **)malloc(((size_t)defineCount + 1) * sizeof(char *));
+    char *defineText = (char *)malloc(textLength);
+    int sortedCount = 0;
+    char *key = sortedDefines && defineText
+                    ? ShaderVariantKey(vertexPath, fragmentPath, defines, defineCount, defineText, sortedDefines, &sortedCount)
+                    : NULL;
+    if (!key)
+    {
+        free(sortedDefines);
+        free(defineText);
+        fprintf(stderr, "Failed to build shader variant: %s, %s\n", vertexPath, fragmentPath);
+        return 0;
+    }
+
+    unsigned int hash = HashString(key, 0);
+    for (size_t i = hash & (shaderVariantCapacity - 1); shaderVariants && shaderVariants[i].key; i = (i + 1) & (shaderVariantCapacity - 1))
+    {
+        if (shaderVariants[i].hash == hash && strcmp(shaderVariants[i].key, key) == 0)
+        {
+            shaderVariantStats.hits++;
+            free(key);
+            free(sortedDefines);
+            free(defineText);
+            return shaderVariants[i].program;
+        }
+    }
+
+    GLuint program = 0;
+    char *vertexSource = PreprocessGlslFile(vertexPath, sortedDefines, sortedCount);
+    char *fragmentSource = vertexSource ? PreprocessGlslFile(fragmentPath, sortedDefines, sortedCount) : NULL;
+    if (fragmentSource)
+        program = CreateShaderStr(vertexSource, fragmentSource);
+    if (!program)
+        fprintf(stderr, "Shader variant failed: %s, %s\n", vertexPath, fragmentPath);
+    free(vertexSource);
+    free(fragmentSource);
+    free(sortedDefines);
+    free(defineText);
+
+    shaderVariantStats.compiles++;
+    if (!InsertShaderVariant(key, hash, program))
+        free(key);
+    return program;
+}
+
+void FreeShaderVariants()
+{
+    for (size_t i = 0; i < shaderVariantCapacity; i++)
+    {
+        if (!shaderVariants[i].key)
+            continue;
+        DeleteShaderProgram(shaderVariants[i].program);
+        free(shaderVariants[i].key);
+    }
+    free(shaderVariants);
+    shaderVariants = NULL;
+    shaderVariantCapacity = 0;
+    shaderVariantCount = 0;
+    shaderVariantStats.variants = 0;
+}
+
+ShaderVariantStatsS GetShaderVariantStats()
+{
+    return shaderVariantStats;
+}
+
+bool IsShaderCompiled(GLuint shader, const char *shaderName)
+{
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        GLint logLength = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+        if (logLength > 0)
+        {
+            char *infoLog = (char *)malloc(logLength);
+            glGetShaderInfoLog(shader, logLength, NULL, infoLog);
+            fprintf(stderr, "ERROR: Shader compilation failed (%s):\n%s\n", shaderName, infoLog);
+            free(infoLog);
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Shader compilation failed (%s): Unknown error (no log).\n", shaderName);
+        }
+        return false;
+    }
+    return true;
+}
+
+bool IsProgramLinked(GLuint program)
+{
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        GLint logLength = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+        if (logLength > 0)
+        {
+            char *infoLog = (char *)malloc(logLength);
+            glGetProgramInfoLog(program, logLength, NULL, infoLog);
+            fprintf(stderr, "ERROR: Program linking failed:\n%s\n", infoLog);
+            free(infoLog);
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Program linking failed: Unknown error (no log).\n");
+        }
+        return false;
+    }
+    return true;
+}
+
+GLuint CreateVertexArrayObject()
+{
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    return vao;
+}
+
+GLuint CreateVertexBufferObject(const void *data, size_t size)
+{
+    GLuint vbo;
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+    return vbo;
+}
+/*
+    index : attribute location : i.e layout(location=0).
+    size : number of components : i.e (3 for vec3).
+    type : Data type ( most common case : GL_FLOAT)
+    stride : size of each vertex in bytex ( sizeof(data) -> return nb bytes)
+    pointer: offset within the vertex struct ( raw data)
+*/
+void SetupVertexAttrib(GLuint index, GLint size, GLenum type, GLsizei stride, const void *pointer)
+{
+    glVertexAttribPointer(index, size, type, GL_FALSE, stride, pointer);
+    glEnableVertexAttribArray(index);
+}
+
+/*
+    uniform location cache :
+    each linked program gets a table of its active uniforms (array elements by index as well as the bare
+    array name), read once through glGetActiveUniform/glGetUniformLocation. the setters, BindMeshS and the
+    texture binders look names up there by FNV-1a hash, so a frame makes no glGetUniformLocation calls; a
+    name the program doesn't have is answered -1 from the table too. CreateShaderStr fills it at link time,
+    programs linked elsewhere on first use (or with CacheProgramUniforms, which also refreshes a relinked one).
+*/
+typedef struct
+{
+    char *name; /* NULL for an empty slot */
+    unsigned int hash;
+    GLint location;
+} UniformSlotS;
+
+typedef struct
+{
+    GLuint program; /* 0 for an empty slot */
+    UniformSlotS *slots;
+    size_t capacity; /* power of two */
+    char *names;     /* one block for all slot names */
+} ProgramUniformsS;
+
+static ProgramUniformsS *programCache;
+static size_t programCacheCapacity; /* power of two */
+static size_t programCacheCount;
+static UniformCacheStatsS uniformCacheStats;
+
+static size_t ProgramSlot(GLuint program, size_t capacity)
+{
+    return (size_t)(program * 2654435761u) & (capacity - 1);
+}
+
+static ProgramUniformsS *FindProgramUniforms(GLuint program)
+{
+    if (!programCache)
+        return NULL;
+    for (size_t i = ProgramSlot(program, programCacheCapacity);; i = (i + 1) & (programCacheCapacity - 1))
+    {
+        if (programCache[i].program == program)
+            return &programCache[i];
+        if (programCache[i].program == 0)
+            return NULL;
+    }
+}
+
+static void FreeProgramUniforms(ProgramUniformsS *entry)
+{
+    size_t mask = programCacheCapacity - 1;
+    size_t hole = (size_t)(entry - programCache);
+    free(entry->slots);
+    free(entry->names);
+    memset(entry, 0, sizeof(*entry));
+    programCacheCount--;
+    uniformCacheStats.programs = programCacheCount;
+
+    /* backward-shift as RemoveCachedTexture does */
+    for (size_t i = (hole + 1) & mask; programCache[i].program; i = (i + 1) & mask)
+    {
+        size_t home = ProgramSlot(programCache[i].program, programCacheCapacity);
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            programCache[hole] = programCache[i];
+            memset(&programCache[i], 0, sizeof(programCache[i]));
+            hole = i;
+        }
+    }
+}
+
+static ProgramUniformsS *InsertProgramUniforms(GLuint program)
+{
+    if ((programCacheCount + 1) * 4 > programCacheCapacity * 3)
+    {
+        size_t newCapacity = programCacheCapacity ? programCacheCapacity * 2 : 32;
+        ProgramUniformsS *newCache = (ProgramUniformsS *)calloc(newCapacity, sizeof(ProgramUniformsS));
+        if (!newCache)
+            return NULL;
+        for (size_t i = 0; i < programCacheCapacity; i++)
+        {
+            if (!programCache[i].program)
+                continue;
+            size_t j = ProgramSlot(programCache[i].program, newCapacity);
+            while (newCache[j].program)
+                j = (j + 1) & (newCapacity - 1);
+            newCache[j] = programCache[i];
+        }
+        free(programCache);
+        programCache = newCache;
+        programCacheCapacity = newCapacity;
+    }
+
+    size_t i = ProgramSlot(program, programCacheCapacity);
+    while (programCache[i].program)
+        i = (i + 1) & (programCacheCapacity - 1);
+    programCache[i].program = program;
+    programCacheCount++;
+    uniformCacheStats.programs = programCacheCount;
+    return &programCache[i];
+}
+
+static void AddUniformSlot(ProgramUniformsS *entry, char *name, GLint location)
+{
+    unsigned int hash = HashString(name, 0);
+    size_t i = hash & (entry->capacity - 1);
+    while (entry->slots[i].name)
+        i = (i + 1) & (entry->capacity - 1);
+    entry->slots[i].name = name;
+    entry->slots[i].hash = hash;
+    entry->slots[i].location = location;
+}
+
+bool CacheProgramUniforms(GLuint program)
+{
+    ProgramUniformsS *entry = FindProgramUniforms(program);
+    if (entry)
+        FreeProgramUniforms(entry);
+
+    GLint linked = GL_FALSE;
+    if (program != 0)
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+        return false;
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    char *name = (char *)malloc((size_t)maxLength + 16);
+    if (!name)
+        return false;
+
+    /* first pass sizes the name block : "a[0]" also goes in as "a", and as "a[k]" for every element */
+    size_t slotCount = 0, nameBytes = 0;
+    for (GLint u = 0; u < count; u++)
+    {
+        GLsizei length = 0;
+        GLenum type;
+        GLint size = 0;
+        glGetActiveUniform(program, (GLuint)u, maxLength, &length, &size, &type, name);
+        slotCount += 1 + (size_t)size;
+        nameBytes += ((size_t)length + 1) * (1 + (size_t)size) + (size_t)size * 12;
+    }
+
+    entry = InsertProgramUniforms(program);
+    size_t capacity = 16;
+    while (capacity < slotCount * 2)
+        capacity *= 2;
+    if (entry)
+    {
+        entry->capacity = capacity;
+        entry->slots = (UniformSlotS *)calloc(capacity, sizeof(UniformSlotS));
+        entry->names = (char *)malloc(nameBytes + 1);
+    }
+    if (!entry || !entry->slots || !entry->names)
+    {
+        if (entry)
+            FreeProgramUniforms(entry);
+        free(name);
+        return false;
+    }
+
+    char *out = entry->names;
+    for (GLint u = 0; u < count; u++)
+    {
+        GLsizei length = 0;
+        GLenum type;
+        GLint size = 0;
+        glGetActiveUniform(program, (GLuint)u, maxLength, &length, &size, &type, name);
+        /* uniforms of blocks have no location */
+        GLint location = glGetUniformLocation(program, name);
+        uniformCacheStats.driverQueries++;
+        if (location == -1)
+            continue;
+
+        bool suffixed = length >= 3 && strcmp(name + length - 3, "[0]") == 0;
+        if (!suffixed && size <= 1)
+        {
+            memcpy(out, name, (size_t)length + 1);
+            AddUniformSlot(entry, out, location);
+            out += length + 1;
+            continue;
+        }
+
+        /* arrays : the bare name and each element; plain arrays have consecutive locations, but that
+           isn't guaranteed, so every element is asked for */
+        size_t base = suffixed ? (size_t)length - 3 : (size_t)length;
+        memcpy(out, name, base);
+        out[base] = '\0';
+        AddUniformSlot(entry, out, location);
+        out += base + 1;
+        for (GLint k = 0; k < size; k++)
+        {
+            int written = sprintf(out, "%.*s[%d]", (int)base, name, k);
+            GLint elementLocation = location;
+            if (k > 0)
+            {
+                elementLocation = glGetUniformLocation(program, out);
+                uniformCacheStats.driverQueries++;
+            }
+            AddUniformSlot(entry, out, elementLocation);
+            out += written + 1;
+        }
+    }
+
+    free(name);
+    return true;
+}
+
+GLint GetUniformLocationCached(GLuint program, const char *name)
+{
+    ProgramUniformsS *entry = FindProgramUniforms(program);
+    if (!entry)
+    {
+        if (!CacheProgramUniforms(program))
+        {
+            /* not linked (or out of memory) : let the driver answer */
+            uniformCacheStats.driverQueries++;
+            return glGetUniformLocation(program, name);
+        }
+        entry = FindProgramUniforms(program);
+    }
+
+    uniformCacheStats.callsAvoided++;
+    unsigned int hash = HashString(name, 0);
+    for (size_t i = hash & (entry->capacity - 1);; i = (i + 1) & (entry->capacity - 1))
+    {
+        UniformSlotS *slot = &entry->slots[i];
+        if (!slot->name)
+            return -1;
+        if (slot->hash == hash && strcmp(slot->name, name) == 0)
+            return slot->location;
+    }
+}
+
+/*
+    program binding :
+    the last program bound through UseProgram is tracked, so binding it again costs nothing. this only
+    holds while every bind goes through UseProgram; after a glUseProgram elsewhere (another library, a
+    debugger) call ForgetBoundProgram so the next UseProgram binds for real. debug builds check the
+    tracked program against GL_CURRENT_PROGRAM before skipping a bind.
+    the library's bind and draw helpers always call glUseProgram, so they never draw with a stale program.
+*/
+static GLuint boundProgram;
+static bool boundProgramKnown;
+
+static void BindProgram(GLuint program)
+{
+    glUseProgram(program);
+    boundProgram = program;
+    boundProgramKnown = true;
+}
+
+void UseProgram(GLuint program)
+{
+    if (boundProgramKnown && boundProgram == program)
+    {
+#ifndef NDEBUG
+        GLint current = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+        if ((GLuint)current != program)
+        {
+            fprintf(stderr, "Program %u was unbound outside UseProgram (current: %d), call ForgetBoundProgram after glUseProgram\n", program, current);
+            BindProgram(program);
+            return;
+        }
+#endif
+        uniformCacheStats.bindsAvoided++;
+        return;
+    }
+    BindProgram(program);
+}
+
+void ForgetBoundProgram()
+{
+    boundProgramKnown = false;
+}
+
+void DeleteShaderProgram(GLuint program)
+{
+    if (program == 0)
+        return;
+    ProgramUniformsS *entry = FindProgramUniforms(program);
+    if (entry)
+        FreeProgramUniforms(entry);
+    /* the name is free for reuse as soon as it's deleted, even while the program stays current */
+    if (boundProgram == program)
+        boundProgramKnown = false;
+    glDeleteProgram(program);
+}
+
+UniformCacheStatsS GetUniformCacheStats()
+{
+    return uniformCacheStats;
+}
+
+void ResetUniformCacheStats()
+{
+    /* programs is a gauge, not a per-frame counter */
+    size_t programs = uniformCacheStats.programs;
+    memset(&uniformCacheStats, 0, sizeof(uniformCacheStats));
+    uniformCacheStats.programs = programs;
+}
+
+/*
+    with GL 4.1 or ARB_separate_shader_objects the setters write through glProgramUniform* and leave the
+    bound program alone; otherwise they bind the program with UseProgram (a no-op when it's current
+    already) and it stays bound.
+*/
+#define HAS_PROGRAM_UNIFORM (GLEW_VERSION_4_1 || GLEW_ARB_separate_shader_objects)
+
+void SetUniform1i(GLuint program, const char *name, int value)
+{
+    GLint location = GetUniformLocationCached(program, name);
+    if (location == -1)
+    {
+        fprintf(stderr, "Uniform '%s' not found in program %u\n", name, program);
+        return;
+    }
+    if (HAS_PROGRAM_UNIFORM)
+    {
+        glProgramUniform1i(program, location, value);
+        return;
+    }
+    UseProgram(program);
+    glUniform1i(location, value);
+}
+
+void SetUniform1f(GLuint program, const char *name, float value)
+{
+    GLint location = GetUniformLocationCached(program, name);
+    if (location == -1)
+    {
+        fprintf(stderr, "Uniform '%s' not found in program %u\n", name, program);
+        return;
+    }
+    if (HAS_PROGRAM_UNIFORM)
+    {
+        glProgramUniform1f(program, location, value);
+        return;
+    }
+    UseProgram(program);
+    glUniform1f(location, value);
+}
+
+void SetUniform3f(GLuint program, const char *name, float x, float y, float z)
+{
+    GLint location = GetUniformLocationCached(program, name);
+    if (location == -1)
+    {
+        fprintf(stderr, "Uniform '%s' not found in program %u\n", name, program);
+        return;
+    }
+    if (HAS_PROGRAM_UNIFORM)
+    {
+        glProgramUniform3f(program, location, x, y, z);
+        return;
+    }
+    UseProgram(program);
+    glUniform3f(location, x, y, z);
+}
+
+void SetUniform4f(GLuint program, const char *name, float x, float y, float z, float w)
+{
+    GLint location = GetUniformLocationCached(program, name);
+    if (location == -1)
+    {
+        fprintf(stderr, "Uniform '%s' not found in program %u\n", name, program);
+        return;
+    }
+    if (HAS_PROGRAM_UNIFORM)
+    {
+        glProgramUniform4f(program, location, x, y, z, w);
+        return;
+    }
+    UseProgram(program);
+    glUniform4f(location, x, y, z, w);
+}
+
+void SetUniformMat4(GLuint program, const char *name, const float *matrix)
+{
+    GLint location = GetUniformLocationCached(program, name);
+    if (location == -1)
+    {
+        fprintf(stderr, "Uniform '%s' not found in program %u\n", name, program);
+        return;
+    }
+    if (HAS_PROGRAM_UNIFORM)
+    {
+        glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, matrix);
+        return;
+    }
+    UseProgram(program);
+    glUniformMatrix4fv(location, 1, GL_FALSE, matrix);
+}
+
+static GLenum TextureFormatFromChannels(int channels)
+{
+    if (channels == 1)
+        return GL_RED;
+    else if (channels == 3)
+        return GL_RGB;
+    else if (channels == 4)
+        return GL_RGBA;
+    return 0;
+}
+
+/* (re)specifies level 0 of an existing texture object and builds its mip chain */
+static void UploadTexturePixels(GLuint textureID, const unsigned char *data, int width, int height, GLenum format, TextureSettingS setting)
+{
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    // Wrapping
+    GLenum wrapMode = (setting == TEXTURE_REPEAT) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+
+    // Filtering
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Upload data
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+/*
+    texture cache :
+    textures are shared by canonical path + wrap setting + origin + max dimension. every LoadTexture()/LoadTextureAsync() of the
+    same file hands back the same texture id and takes a reference; FreeTextureS() drops one and only
+    deletes the GL texture with the last one.
+*/
+typedef struct
+{
+    char *path; /* canonical path, NULL for an empty slot */
+    unsigned int hash;
+    int maxDimension; /* the TextureLoadOptionsS limit it was loaded with */
+    TextureS tex;
+    int refs;
+} TextureCacheEntryS;
+
+static TextureCacheEntryS *textureCache;
+static size_t textureCacheCapacity; /* power of two */
+static size_t textureCacheCount;
+static TextureCacheStatsS textureCacheStats;
+
+/* GL id -> textureCache slot, so freeing, polling and uploading find their entry without a scan. it has
+   textureCacheCapacity slots too, is rebuilt when the cache grows and follows entries as removals shift them */
+typedef struct
+{
+    GLuint id; /* 0 for an empty slot */
+    size_t slot;
+} TextureIdSlotS;
+
+static TextureIdSlotS *textureIdIndex;
+
+static size_t TextureIdHome(GLuint id, size_t capacity)
+{
+    return (size_t)(id * 2654435761u) & (capacity - 1);
+}
+
+static TextureIdSlotS *FindTextureIdSlot(GLuint id)
+{
+    if (!textureIdIndex || id == 0)
+        return NULL;
+    for (size_t i = TextureIdHome(id, textureCacheCapacity);; i = (i + 1) & (textureCacheCapacity - 1))
+    {
+        if (textureIdIndex[i].id == id)
+            return &textureIdIndex[i];
+        if (textureIdIndex[i].id == 0)
+            return NULL;
+    }
+}
+
+static void InsertTextureIdSlot(TextureIdSlotS *index, size_t capacity, GLuint id, size_t slot)
+{
+    size_t i = TextureIdHome(id, capacity);
+    while (index[i].id)
+        i = (i + 1) & (capacity - 1);
+    index[i].id = id;
+    index[i].slot = slot;
+}
+
+static void RemoveTextureIdSlot(TextureIdSlotS *entry)
+{
+    size_t mask = textureCacheCapacity - 1;
+    size_t hole = (size_t)(entry - textureIdIndex);
+    entry->id = 0;
+
+    /* backward-shift as RemoveCachedTexture does */
+    for (size_t i = (hole + 1) & mask; textureIdIndex[i].id; i = (i + 1) & mask)
+    {
+        size_t home = TextureIdHome(textureIdIndex[i].id, textureCacheCapacity);
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            textureIdIndex[hole] = textureIdIndex[i];
+            textureIdIndex[i].id = 0;
+            hole = i;
+        }
+    }
+}
+
+/* approximate GPU size of an 8-bit texture with a full mip chain */
+static size_t TextureSizeBytes(const TextureS *tex)
+{
+    size_t base = (size_t)tex->width * tex->height * tex->channels;
+    return base + base / 3;
+}
+
+static TextureCacheEntryS *FindCachedTexture(const char *canonicalPath, TextureSettingS setting, TextureOriginS origin, int maxDimension, unsigned int hash)
+{
+    if (!textureCache)
+        return NULL;
+
+    for (size_t i = hash & (textureCacheCapacity - 1);; i = (i + 1) & (textureCacheCapacity - 1))
+    {
+        TextureCacheEntryS *entry = &textureCache[i];
+        if (!entry->path)
+            return NULL;
+        if (entry->hash == hash && entry->tex.setting == setting && entry->tex.origin == origin && entry->maxDimension == maxDimension &&
+            strcmp(entry->path, canonicalPath) == 0)
+            return entry;
+    }
+}
+
+static TextureCacheEntryS *FindCachedTextureById(GLuint id)
+{
+    TextureIdSlotS *entry = FindTextureIdSlot(id);
+    return entry ? &textureCache[entry->slot] : NULL;
+}
+
+static bool InsertCachedTexture(const char *canonicalPath, unsigned int hash, int maxDimension, const TextureS *tex)
+{
+    char *key = CopyString(canonicalPath);
+    if (!key)
+        return false;
+
+    /* keep the load factor under 3/4 */
+    if ((textureCacheCount + 1) * 4 > textureCacheCapacity * 3)
+    {
+        size_t newCapacity = textureCacheCapacity ? textureCacheCapacity * 2 : 64;
+        TextureCacheEntryS *newCache = (TextureCacheEntryS *)calloc(newCapacity, sizeof(TextureCacheEntryS));
+        TextureIdSlotS *newIndex = (TextureIdSlotS *)calloc(newCapacity, sizeof(TextureIdSlotS));
+        if (!newCache || !newIndex)
+        {
+            free(newCache);
+            free(newIndex);
+            free(key);
+            return false;
+        }
+        for (size_t i = 0; i < textureCacheCapacity; i++)
+        {
+            if (!textureCache[i].path)
+                continue;
+            size_t j = textureCache[i].hash & (newCapacity - 1);
+            while (newCache[j].path)
+                j = (j + 1) & (newCapacity - 1);
+            newCache[j] = textureCache[i];
+            InsertTextureIdSlot(newIndex, newCapacity, newCache[j].tex.id, j);
+        }
+        free(textureCache);
+        free(textureIdIndex);
+        textureCache = newCache;
+        textureIdIndex = newIndex;
+        textureCacheCapacity = newCapacity;
+    }
+
+    size_t i = hash & (textureCacheCapacity - 1);
+    while (textureCache[i].path)
+        i = (i + 1) & (textureCacheCapacity - 1);
+    textureCache[i].path = key;
+    textureCache[i].hash = hash;
+    textureCache[i].maxDimension = maxDimension;
+    textureCache[i].tex = *tex;
+    textureCache[i].refs = 1;
+    InsertTextureIdSlot(textureIdIndex, textureCacheCapacity, tex->id, i);
+    textureCacheCount++;
+    return true;
+}
+
+static void RemoveCachedTexture(TextureCacheEntryS *entry)
+{
+    size_t mask = textureCacheCapacity - 1;
+    size_t hole = (size_t)(entry - textureCache);
+    RemoveTextureIdSlot(FindTextureIdSlot(entry->tex.id));
+    free(entry->path);
+    entry->path = NULL;
+    textureCacheCount--;
+
+    /* backward-shift the rest of the probe run so lookups never stop at the hole */
+    for (size_t i = (hole + 1) & mask; textureCache[i].path; i = (i + 1) & mask)
+    {
+        size_t home = textureCache[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            textureCache[hole] = textureCache[i];
+            textureCache[i].path = NULL;
+            FindTextureIdSlot(textureCache[hole].tex.id)->slot = hole;
+            hole = i;
+        }
+    }
+}
+
+/*
+    looks the texture up, taking a reference on a hit. canonicalPath (CANONICAL_PATH_MAX bytes, on the caller's
+    stack) receives the key, empty when the path can't be keyed; it's only copied to the heap when inserted.
+*/
+static bool AcquireCachedTexture(const char *path, TextureSettingS setting, TextureOriginS origin, int maxDimension, TextureS *outTex,
+                                 char *canonicalPath, unsigned int *outHash)
+{
+    if (!CanonicalPath(path, canonicalPath))
+    {
+        canonicalPath[0] = '\0';
+        return false;
+    }
+    unsigned int hash = HashString(canonicalPath, (unsigned int)setting | (unsigned int)origin << 8 | (unsigned int)maxDimension << 16);
+
+    TextureCacheEntryS *entry = FindCachedTexture(canonicalPath, setting, origin, maxDimension, hash);
+    if (entry)
+    {
+        entry->refs++;
+        textureCacheStats.hits++;
+        textureCacheStats.bytesSaved += TextureSizeBytes(&entry->tex);
+        *outTex = entry->tex;
+        return true;
+    }
+
+    textureCacheStats.misses++;
+    *outHash = hash;
+    return false;
+}
+
+static void RegisterCachedTexture(const char *canonicalPath, unsigned int hash, int maxDimension, const TextureS *tex)
+{
+    if (canonicalPath[0] && tex->id != 0)
+        InsertCachedTexture(canonicalPath, hash, maxDimension, tex);
+}
+
+TextureCacheStatsS GetTextureCacheStats()
+{
+    return textureCacheStats;
+}
+
+void ResetTextureCacheStats()
+{
+    memset(&textureCacheStats, 0, sizeof(textureCacheStats));
+}
+
+/*
+    image files are mapped into memory and handed to stbi_load_from_memory, instead of going through
+    FILE* and stb's small refill buffer. when mapping fails the file is read with pread() into one buffer.
+*/
+typedef struct
+{
+    unsigned char *data;
+    size_t size;
+    bool mapped;
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+} MappedFileS;
+
+static bool MapFile(const char *path, MappedFileS *file)
+{
+    memset(file, 0, sizeof(*file));
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+    file->mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (!file->mapping)
+        return false;
+    file->data = (unsigned char *)MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!file->data)
+    {
+        CloseHandle(file->mapping);
+        file->mapping = NULL;
+        return false;
+    }
+    file->size = (size_t)size.QuadPart;
+    file->mapped = true;
+    return true;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+    file->size = (size_t)st.st_size;
+
+    void *view = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view != MAP_FAILED)
+    {
+        madvise(view, file->size, MADV_SEQUENTIAL);
+        madvise(view, file->size, MADV_WILLNEED);
+        file->data = (unsigned char *)view;
+        file->mapped = true;
+        close(fd);
+        return true;
+    }
+
+    file->data = (unsigned char *)malloc(file->size);
+    size_t done = 0;
+    while (file->data && done < file->size)
+    {
+        ssize_t n = pread(fd, file->data + done, file->size - done, (off_t)done);
+        if (n <= 0)
+        {
+            free(file->data);
+            file->data = NULL;
+            break;
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+    return file->data != NULL;
+#endif
+}
+
+static void UnmapFile(MappedFileS *file)
+{
+    if (!file->data)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle(file->mapping);
+#else
+    if (file->mapped)
+        munmap(file->data, file->size);
+    else
+        free(file->data);
+#endif
+    memset(file, 0, sizeof(*file));
+}
+
+/* the calling thread's jpeg scale (see "Scaled JPEG decoding" in stb_img.h) for an image of width x height :
+   the smallest of 1/1, 1/2, 1/4 and 1/8 that fits in maxDimension, or 1/8. reset to 1 after the load */
+static void SetJpegScaleLimit(int width, int height, int maxDimension)
+{
+    int denom = 1;
+    while (denom < 8 && ((width + denom - 1) / denom > maxDimension || (height + denom - 1) / denom > maxDimension))
+        denom *= 2;
+    stbi_set_jpeg_scale_denom_thread(denom);
+}
+
+/* stbi_load() through a mapped file; maxDimension > 0 scales large jpegs down (see TextureLoadOptionsS) */
+static unsigned char *LoadImageMapped(const char *path, int *width, int *height, int *channels, int reqComp, int maxDimension)
+{
+    unsigned char *data;
+    int w, h, c;
+    MappedFileS file;
+    if (!MapFile(path, &file) || file.size > INT_MAX)
+    {
+        UnmapFile(&file);
+        if (maxDimension > 0 && stbi_info(path, &w, &h, &c))
+            SetJpegScaleLimit(w, h, maxDimension);
+        data = stbi_load(path, width, height, channels, reqComp);
+    }
+    else
+    {
+        if (maxDimension > 0 && stbi_info_from_memory(file.data, (int)file.size, &w, &h, &c))
+            SetJpegScaleLimit(w, h, maxDimension);
+        data = stbi_load_from_memory(file.data, (int)file.size, width, height, channels, reqComp);
+        UnmapFile(&file);
+    }
+    stbi_set_jpeg_scale_denom_thread(1);
+    return data;
+}
+
+/*
+    image arena :
+    stb's allocations (decoded pixels, zlib output, jpeg component buffers, ...) go through ImageArenaAlloc,
+    ImageArenaRealloc and ImageArenaFree, see decl_file.c. between BeginImageArena and EndImageArena they are
+    bump-allocated from a per-thread block that is reset at the end, so a steady stream of loads doesn't
+    touch the heap. outside a scope they are plain malloc/realloc/free.
+    a load that doesn't fit takes extra chunks from the heap; EndImageArena then replaces the chunks with
+    one block of the high-water size, so the block settles at the largest image seen.
+    anything allocated inside a scope is gone after EndImageArena.
+*/
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+#define THREAD_LOCAL _Thread_local
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#define IMAGE_ARENA_ALIGN 16
+#define IMAGE_ARENA_MIN_BLOCK (1 << 20)
+
+typedef struct ImageArenaChunkS
+{
+    struct ImageArenaChunkS *next;
+    size_t size;
+    size_t used;
+} ImageArenaChunkS;
+
+typedef struct
+{
+    ImageArenaChunkS *chunks; /* newest first */
+    size_t highWater;
+    int depth;
+    size_t heapAllocations;
+} ImageArenaS;
+
+static THREAD_LOCAL ImageArenaS imageArena;
+
+/* chunk data starts after the header, rounded up to the alignment */
+#define IMAGE_ARENA_HEADER ((sizeof(ImageArenaChunkS) + IMAGE_ARENA_ALIGN - 1) & ~(size_t)(IMAGE_ARENA_ALIGN - 1))
+
+static unsigned char *ChunkData(ImageArenaChunkS *chunk)
+{
+    return (unsigned char *)chunk + IMAGE_ARENA_HEADER;
+}
+
+static ImageArenaChunkS *NewArenaChunk(size_t size)
+{
+    ImageArenaChunkS *chunk = (ImageArenaChunkS *)malloc(IMAGE_ARENA_HEADER + size);
+    imageArena.heapAllocations++;
+    if (!chunk)
+        return NULL;
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+static void FreeArenaChunks()
+{
+    while (imageArena.chunks)
+    {
+        ImageArenaChunkS *next = imageArena.chunks->next;
+        free(imageArena.chunks);
+        imageArena.chunks = next;
+    }
+}
+
+static size_t ArenaUsed()
+{
+    size_t used = 0;
+    for (ImageArenaChunkS *chunk = imageArena.chunks; chunk; chunk = chunk->next)
+        used += chunk->used;
+    return used;
+}
+
+static bool InArena(const void *p)
+{
+    for (ImageArenaChunkS *chunk = imageArena.chunks; chunk; chunk = chunk->next)
+    {
+        const unsigned char *data = ChunkData(chunk);
+        if ((const unsigned char *)p >= data && (const unsigned char *)p < data + chunk->size)
+            return true;
+    }
+    return false;
+}
+
+void BeginImageArena(size_t reserveBytes)
+{
+    if (imageArena.depth++ > 0)
+        return;
+    if (reserveBytes < IMAGE_ARENA_MIN_BLOCK)
+        reserveBytes = IMAGE_ARENA_MIN_BLOCK;
+    if (imageArena.chunks && imageArena.chunks->size >= reserveBytes)
+        return;
+    FreeArenaChunks();
+    imageArena.chunks = NewArenaChunk(reserveBytes);
+}
+
+void EndImageArena()
+{
+    if (imageArena.depth == 0 || --imageArena.depth > 0)
+        return;
+    size_t used = ArenaUsed();
+    if (used > imageArena.highWater)
+        imageArena.highWater = used;
+    if (imageArena.chunks && imageArena.chunks->next)
+    {
+        /* overflowed : one block big enough for everything this load needed */
+        FreeArenaChunks();
+        imageArena.chunks = NewArenaChunk(imageArena.highWater + imageArena.highWater / 8);
+        return;
+    }
+    if (imageArena.chunks)
+        imageArena.chunks->used = 0;
+}
+
+void ReleaseImageArena()
+{
+    if (imageArena.depth > 0)
+        return;
+    FreeArenaChunks();
+    imageArena.highWater = 0;
+}
+
+size_t GetImageHeapAllocations()
+{
+    return imageArena.heapAllocations;
+}
+
+void *ImageArenaAlloc(size_t size)
+{
+    if (imageArena.depth == 0)
+    {
+        imageArena.heapAllocations++;
+        return malloc(size);
+    }
+    size = (size + IMAGE_ARENA_ALIGN - 1) & ~(size_t)(IMAGE_ARENA_ALIGN - 1);
+    ImageArenaChunkS *chunk = imageArena.chunks;
+    if (!chunk || chunk->size - chunk->used < size)
+    {
+        size_t chunkSize = chunk ? chunk->size * 2 : IMAGE_ARENA_MIN_BLOCK;
+        if (chunkSize < size)
+            chunkSize = size;
+        ImageArenaChunkS *grown = NewArenaChunk(chunkSize);
+        if (!grown)
+            return NULL;
+        grown->next = chunk;
+        imageArena.chunks = chunk = grown;
+    }
+    void *p = ChunkData(chunk) + chunk->used;
+    chunk->used += size;
+    return p;
+}
+
+void *ImageArenaRealloc(void *p, size_t oldSize, size_t newSize)
+{
+    if (!p)
+        return ImageArenaAlloc(newSize);
+    if (!InArena(p))
+    {
+        imageArena.heapAllocations++;
+        return realloc(p, newSize);
+    }
+
+    /* the newest allocation grows in place (zlib output does this a lot) */
+    ImageArenaChunkS *chunk = imageArena.chunks;
+    unsigned char *data = ChunkData(chunk);
+    size_t offset = (size_t)((unsigned char *)p - data);
+    size_t oldEnd = offset + ((oldSize + IMAGE_ARENA_ALIGN - 1) & ~(size_t)(IMAGE_ARENA_ALIGN - 1));
+    size_t newEnd = offset + ((newSize + IMAGE_ARENA_ALIGN - 1) & ~(size_t)(IMAGE_ARENA_ALIGN - 1));
+    if (imageArena.depth > 0 && (unsigned char *)p >= data && oldEnd == chunk->used && newEnd <= chunk->size)
+    {
+        chunk->used = newEnd;
+        return p;
+    }
+
+    void *q = ImageArenaAlloc(newSize);
+    if (q)
+        memcpy(q, p, oldSize < newSize ? oldSize : newSize);
+    return q;
+}
+
+void ImageArenaFree(void *p)
+{
+    /* arena memory comes back all at once in EndImageArena */
+    if (p && !InArena(p))
+        free(p);
+}
+
+size_t QueryImageSize(const char *path, int *width, int *height, int *channels, int reqComp)
+{
+    MappedFileS file;
+    int w, h, c;
+    int ok;
+    BeginImageArena(0);
+    if (MapFile(path, &file) && file.size <= INT_MAX)
+        ok = stbi_info_from_memory(file.data, (int)file.size, &w, &h, &c);
+    else
+        ok = stbi_info(path, &w, &h, &c);
+    UnmapFile(&file);
+    EndImageArena();
+    if (!ok)
+        return 0;
+
+    if (width)
+        *width = w;
+    if (height)
+        *height = h;
+    if (channels)
+        *channels = c;
+    return (size_t)w * h * (reqComp ? reqComp : c);
+}
+
+bool LoadImageInto(const char *path, unsigned char *dst, size_t dstSize, int *width, int *height, int *channels, int reqComp)
+{
+    int w, h, c;
+    BeginImageArena(0);
+    unsigned char *data = LoadImageMapped(path, &w, &h, &c, reqComp, 0);
+    size_t size = data ? (size_t)w * h * (reqComp ? reqComp : c) : 0;
+    bool ok = data && size <= dstSize;
+    if (ok)
+        memcpy(dst, data, size);
+    EndImageArena();
+
+    if (!data)
+        fprintf(stderr, "Failed to load image: %s\n", path);
+    else if (!ok)
+        fprintf(stderr, "Buffer too small for image %s (%zu bytes, need %zu)\n", path, dstSize, size);
+    else
+    {
+        if (width)
+            *width = w;
+        if (height)
+            *height = h;
+        if (channels)
+            *channels = c;
+    }
+    return ok;
+}
+
+static int CpuCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+static TextureS LoadTextureUncached(const char *path, TextureLoadOptionsS options)
+{
+    TextureS tex = {0};
+    TextureSettingS setting = options.setting;
+
+    /* per thread, so loads with different origins can run side by side */
+    stbi_set_flip_vertically_on_load_thread(options.origin == TEXTURE_ORIGIN_BOTTOM_LEFT);
+    /* large baseline jpegs with restart markers decode across all cores (per thread, never racing the workers) */
+    stbi_set_jpeg_thread_count_thread(CpuCount());
+    int width, height, channels;
+    BeginImageArena(0);
+    unsigned char *data = LoadImageMapped(path, &width, &height, &channels, 0, options.maxDimension);
+    if (!data)
+    {
+        EndImageArena();
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        return tex;
+    }
+
+    GLenum format = TextureFormatFromChannels(channels);
+    if (format == 0)
+    {
+        fprintf(stderr, "Unsupported number of channels (%d) in texture: %s\n", channels, path);
+        stbi_image_free(data);
+        EndImageArena();
+        return tex;
+    }
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    UploadTexturePixels(textureID, data, width, height, format, setting);
+
+    stbi_image_free(data);
+    EndImageArena();
+
+    tex.id = textureID;
+    tex.width = width;
+    tex.height = height;
+    tex.channels = channels;
+    tex.setting = setting;
+    tex.origin = options.origin;
+
+    return tex;
+}
+
+TextureS LoadTextureEx(const char *path, TextureLoadOptionsS options)
+{
+    TextureS tex = {0};
+    char canonicalPath[CANONICAL_PATH_MAX];
+    unsigned int hash = 0;
+    if (AcquireCachedTexture(path, options.setting, options.origin, options.maxDimension, &tex, canonicalPath, &hash))
+        return tex;
+
+    tex = LoadTextureUncached(path, options);
+    RegisterCachedTexture(canonicalPath, hash, options.maxDimension, &tex);
+    return tex;
+}
+
+TextureS LoadTexture(const char *path, TextureSettingS setting)
+{
+    TextureLoadOptionsS options = {setting, TEXTURE_ORIGIN_BOTTOM_LEFT, 0};
+    return LoadTextureEx(path, options);
+}
+
+/*
+    immutable textures :
+    storage is allocated once with glTexStorage2D, using sized formats and the full level count, so the
+    driver never has to re-validate or re-allocate it. 3-channel (and grey+alpha) images are expanded to
+    RGBA by stb while decoding, so every row is 4-byte aligned and uploads need no repacking.
+    without GL 4.2 / ARB_texture_storage each level is specified with glTexImage2D instead.
+*/
+static int MipLevelCount(int width, int height)
+{
+    int levels = 1;
+    int size = width > height ? width : height;
+    while (size > 1)
+    {
+        size >>= 1;
+        levels++;
+    }
+    return levels;
+}
+
+static void AllocateTextureStorage(GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+    if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage)
+    {
+        glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+        return;
+    }
+
+    for (GLsizei level = 0; level < levels; level++)
+    {
+        glTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, format, type, NULL);
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
+TextureS LoadTextureImmutable(const char *path, TextureSettingS setting, bool srgb)
+{
+    TextureS tex = {0};
+
+    MappedFileS file;
+    if (!MapFile(path, &file) || file.size > INT_MAX)
+    {
+        UnmapFile(&file);
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        return tex;
+    }
+
+    /* single-channel images stay R8, everything else is decoded straight to RGBA */
+    int width, height, channels;
+    int reqComp = 4;
+    BeginImageArena(0);
+    if (stbi_info_from_memory(file.data, (int)file.size, &width, &height, &channels) && channels == 1)
+        reqComp = 1;
+
+    stbi_set_flip_vertically_on_load_thread(1);
+    unsigned char *data = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &channels, reqComp);
+    UnmapFile(&file);
+    if (!data)
+    {
+        EndImageArena();
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        return tex;
+    }
+
+    GLenum internalFormat = reqComp == 1 ? GL_R8 : (srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8);
+    GLenum format = reqComp == 1 ? GL_RED : GL_RGBA;
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    GLenum wrapMode = (setting == TEXTURE_REPEAT) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    AllocateTextureStorage(MipLevelCount(width, height), internalFormat, width, height, format, GL_UNSIGNED_BYTE);
+
+    /* R8 rows are only 4-byte aligned when the width is */
+    if (reqComp == 1)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data);
+    if (reqComp == 1)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    stbi_image_free(data);
+    EndImageArena();
+
+    tex.id = textureID;
+    tex.width = width;
+    tex.height = height;
+    tex.channels = reqComp;
+    tex.setting = setting;
+
+    return tex;
+}
+
+/*
+    HDR textures :
+    Radiance .hdr files are read as raw RGBE (see "HDR image support" in stb_img.h) and converted straight
+    to half floats for a GL_RGB16F texture, half the memory and upload of the float32 path. both buffers
+    come from the image arena.
+*/
+TextureS LoadTextureHDR(const char *path, TextureSettingS setting)
+{
+    TextureS tex = {0};
+
+    MappedFileS file;
+    if (!MapFile(path, &file) || file.size > INT_MAX)
+    {
+        UnmapFile(&file);
+        fprintf(stderr, "Failed to load HDR texture: %s\n", path);
+        return tex;
+    }
+
+    int width, height;
+    BeginImageArena(0);
+    stbi_set_flip_vertically_on_load_thread(1);
+    unsigned char *rgbe = stbi_load_rgbe_from_memory(file.data, (int)file.size, &width, &height);
+    UnmapFile(&file);
+    unsigned short *half = rgbe ? (unsigned short *)ImageArenaAlloc((size_t)width * height * 3 * sizeof(unsigned short)) : NULL;
+    if (!half)
+    {
+        stbi_image_free(rgbe);
+        EndImageArena();
+        fprintf(stderr, "Failed to load HDR texture: %s\n", path);
+        return tex;
+    }
+    stbi_rgbe_to_half(half, rgbe, width * height);
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    GLenum wrapMode = (setting == TEXTURE_REPEAT) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    AllocateTextureStorage(MipLevelCount(width, height), GL_RGB16F, width, height, GL_RGB, GL_HALF_FLOAT);
+
+    /* rows are 6 bytes per pixel, only 4-byte aligned for even widths */
+    if (width & 1)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB, GL_HALF_FLOAT, half);
+    if (width & 1)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    ImageArenaFree(half);
+    stbi_image_free(rgbe);
+    EndImageArena();
+
+    tex.id = textureID;
+    tex.width = width;
+    tex.height = height;
+    tex.channels = 3;
+    tex.setting = setting;
+
+    return tex;
+}
+
+/*
+    16-bit textures :
+    16-bit files (PNG, PSD, PNM) are decoded with stbi_load_16 and uploaded as GL_R16 / GL_RG16 / GL_RGBA16
+    without going through 8 bits; RGB is expanded to RGBA by stb while decoding, like LoadTextureImmutable.
+    grey + alpha stays GL_RG16 but is swizzled to sample as (grey, grey, grey, alpha), the RGBA the 8-bit
+    path expands it to.
+    files with 8 bits per channel gain nothing from it and go to LoadTextureImmutable instead.
+    extraBytes (may be NULL) receives the VRAM this costs over the 8-bit texture, mip chain included.
+*/
+TextureS LoadTexture16(const char *path, TextureSettingS setting, size_t *extraBytes)
+{
+    TextureS tex = {0};
+    if (extraBytes)
+        *extraBytes = 0;
+
+    MappedFileS file;
+    if (!MapFile(path, &file) || file.size > INT_MAX)
+    {
+        UnmapFile(&file);
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        return tex;
+    }
+
+    int width, height, channels;
+    if (!stbi_is_16_bit_from_memory(file.data, (int)file.size))
+    {
+        UnmapFile(&file);
+        return LoadTextureImmutable(path, setting, false);
+    }
+
+    int reqComp = 4;
+    BeginImageArena(0);
+    if (stbi_info_from_memory(file.data, (int)file.size, &width, &height, &channels) && channels <= 2)
+        reqComp = channels;
+
+    stbi_set_flip_vertically_on_load_thread(1);
+    unsigned short *data = stbi_load_16_from_memory(file.data, (int)file.size, &width, &height, &channels, reqComp);
+    UnmapFile(&file);
+    if (!data)
+    {
+        EndImageArena();
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        return tex;
+    }
+
+    static const GLenum internalFormats[5] = {0, GL_R16, GL_RG16, 0, GL_RGBA16};
+    GLenum format = reqComp == 1 ? GL_RED : (reqComp == 2 ? GL_RG : GL_RGBA);
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    GLenum wrapMode = (setting == TEXTURE_REPEAT) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    AllocateTextureStorage(MipLevelCount(width, height), internalFormats[reqComp], width, height, format, GL_UNSIGNED_SHORT);
+    if (reqComp == 2)
+    {
+        static const GLint greyAlpha[4] = {GL_RED, GL_RED, GL_RED, GL_GREEN};
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, greyAlpha);
+    }
+
+    /* R16 rows are only 4-byte aligned when the width is even */
+    if (reqComp == 1 && (width & 1))
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_SHORT, data);
+    if (reqComp == 1 && (width & 1))
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    stbi_image_free(data);
+    EndImageArena();
+
+    tex.id = textureID;
+    tex.width = width;
+    tex.height = height;
+    tex.channels = reqComp;
+    tex.setting = setting;
+
+    /* against the R8 or RGBA8 (grey + alpha included) of the 8-bit path; TextureSizeBytes counts bytes per texel */
+    if (extraBytes)
+    {
+        TextureS sixteenBit = tex, eightBit = tex;
+        sixteenBit.channels = 2 * tex.channels;
+        eightBit.channels = reqComp == 1 ? 1 : 4;
+        *extraBytes = TextureSizeBytes(&sixteenBit) - TextureSizeBytes(&eightBit);
+    }
+
+    return tex;
+}
+
+/*
+    YCbCr textures :
+    a JPEG's Y, Cb and Cr planes (see "JPEG planes" in stb_img.h) go up as three GL_R8 textures at their own
+    resolution, straight from the decoder's buffers (GL_UNPACK_ROW_LENGTH skips their padding), and the
+    fragment shader does the rest : bilinear filtering of the chroma textures is the same upsampling as stb's
+    for JFIF's centered chroma, then the YCbCr to RGB matrix. a 4:2:0 file uploads 1.5 bytes per pixel instead
+    of 3 (4 as RGBA), and stb's resampling and color conversion passes are skipped altogether.
+    each plane has its own mip chain; the conversion is affine, so converting filtered planes gives the
+    filtered RGB image (up to the final clamp).
+    the planes are top row first : for TEXTURE_ORIGIN_BOTTOM_LEFT the sampler flips v itself, so SampleYCbCr(uv)
+    reads like texture() on a LoadTextureEx texture with the same options.
+    greyscale files get 1x1 neutral chroma textures.
+*/
+const char YCBCR_SAMPLER_GLSL[] =
+    "uniform sampler2D u_PlaneY;\n"
+    "uniform sampler2D u_PlaneCb;\n"
+    "uniform sampler2D u_PlaneCr;\n"
+    "uniform vec2 u_ChromaScale;\n"
+    "uniform bool u_YCbCrFlipV;\n"
+    "vec3 SampleYCbCr(vec2 uv)\n"
+    "{\n"
+    "    if (u_YCbCrFlipV)\n"
+    "        uv.y = 1.0 - uv.y;\n"
+    "    float y = texture(u_PlaneY, uv).r;\n"
+    "    float cb = texture(u_PlaneCb, uv * u_ChromaScale).r - 128.0 / 255.0;\n"
+    "    float cr = texture(u_PlaneCr, uv * u_ChromaScale).r - 128.0 / 255.0;\n"
+    "    return clamp(vec3(y + 1.402 * cr, y - 0.344136 * cb - 0.714136 * cr, y + 1.772 * cb), 0.0, 1.0);\n"
+    "}\n";
+
+YCbCrTextureS LoadTextureYCbCr(const char *path, TextureLoadOptionsS options)
+{
+    YCbCrTextureS tex = {0};
+
+    MappedFileS file;
+    if (!MapFile(path, &file) || file.size > INT_MAX)
+    {
+        UnmapFile(&file);
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        return tex;
+    }
+
+    int width, height, channels, planeCount;
+    stbi_plane planes[3];
+    BeginImageArena(0);
+    if (options.maxDimension > 0 && stbi_info_from_memory(file.data, (int)file.size, &width, &height, &channels))
+        SetJpegScaleLimit(width, height, options.maxDimension);
+    bool ok = stbi_load_jpeg_planes_from_memory(file.data, (int)file.size, &width, &height, &planeCount, planes);
+    stbi_set_jpeg_scale_denom_thread(1);
+    UnmapFile(&file);
+    if (!ok)
+    {
+        EndImageArena();
+        fprintf(stderr, "Failed to load texture: %s (%s)\n", path, stbi_failure_reason());
+        return tex;
+    }
+    /* one chroma scale serves both planes */
+    if (planeCount == 3 && (planes[1].w != planes[2].w || planes[1].h != planes[2].h))
+    {
+        stbi_jpeg_planes_free(planes, planeCount);
+        EndImageArena();
+        fprintf(stderr, "Unsupported chroma subsampling in texture: %s\n", path);
+        return tex;
+    }
+
+    static const unsigned char neutralChroma = 128;
+    glGenTextures(3, tex.planes);
+    GLenum wrapMode = (options.setting == TEXTURE_REPEAT) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int i = 0; i < 3; i++)
+    {
+        const unsigned char *data = i < planeCount ? planes[i].data : &neutralChroma;
+        int w = i < planeCount ? planes[i].w : 1;
+        int h = i < planeCount ? planes[i].h : 1;
+
+        glBindTexture(GL_TEXTURE_2D, tex.planes[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        AllocateTextureStorage(MipLevelCount(w, h), GL_R8, w, h, GL_RED, GL_UNSIGNED_BYTE);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, i < planeCount ? planes[i].stride : 0);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RED, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    /* a chroma plane covers hs * w image pixels, a bit more than the image when its width is odd */
+    tex.chromaScale[0] = planeCount == 3 ? (float)width / (planes[1].hs * planes[1].w) : 1.0f;
+    tex.chromaScale[1] = planeCount == 3 ? (float)height / (planes[1].vs * planes[1].h) : 1.0f;
+    stbi_jpeg_planes_free(planes, planeCount);
+    EndImageArena();
+
+    tex.width = width;
+    tex.height = height;
+    tex.setting = options.setting;
+    tex.origin = options.origin;
+
+    return tex;
+}
+
+void BindYCbCrTexture(const YCbCrTextureS *tex, GLuint shaderProgram)
+{
+    if (!tex || tex->planes[0] == 0)
+    {
+        fprintf(stderr, "Attempted to bind an invalid or uninitialized YCbCr texture.\n");
+        return;
+    }
+    static const char *const samplers[3] = {"u_PlaneY", "u_PlaneCb", "u_PlaneCr"};
+    BindProgram(shaderProgram);
+    for (int i = 0; i < 3; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, tex->planes[i]);
+        GLint location = GetUniformLocationCached(shaderProgram, samplers[i]);
+        if (location != -1)
+        {
+            glUniform1i(location, i);
+        }
+    }
+    glActiveTexture(GL_TEXTURE0);
+    GLint scaleLocation = GetUniformLocationCached(shaderProgram, "u_ChromaScale");
+    if (scaleLocation != -1)
+    {
+        glUniform2f(scaleLocation, tex->chromaScale[0], tex->chromaScale[1]);
+    }
+    GLint flipLocation = GetUniformLocationCached(shaderProgram, "u_YCbCrFlipV");
+    if (flipLocation != -1)
+    {
+        glUniform1i(flipLocation, tex->origin == TEXTURE_ORIGIN_BOTTOM_LEFT);
+    }
+}
+
+void FreeYCbCrTexture(YCbCrTextureS *tex)
+{
+    if (!tex || tex->planes[0] == 0)
+        return;
+    glDeleteTextures(3, tex->planes);
+    memset(tex, 0, sizeof(*tex));
+}
+
+/*
+    streamed textures :
+    the image is decoded a band of rows at a time (see "Row-streaming decode" in stb_img.h) and each band
+    goes to glTexSubImage2D as soon as it's ready, so decode and upload overlap and the full decoded image
+    never has to sit in memory. no image arena here : the arena never frees within a scope, which would
+    bring back the whole image's worth of memory.
+    stb hands rows out top row first; for TEXTURE_ORIGIN_BOTTOM_LEFT each band is flipped in place and
+    uploaded mirrored, so the result matches LoadTexture.
+*/
+#define STREAM_BAND_BYTES (1 << 20)
+
+typedef struct
+{
+    GLenum format;
+    int height;
+    size_t rowBytes;
+    TextureOriginS origin;
+    unsigned char *swap; /* one row, for flipping */
+} StreamUploadS;
+
+static int UploadStreamedRows(void *user, unsigned char *rows, int firstRow, int rowCount)
+{
+    StreamUploadS *upload = (StreamUploadS *)user;
+    int y = firstRow;
+    if (upload->origin == TEXTURE_ORIGIN_BOTTOM_LEFT)
+    {
+        for (int i = 0; i < rowCount / 2; i++)
+        {
+            unsigned char *a = rows + (size_t)i * upload->rowBytes;
+            unsigned char *b = rows + (size_t)(rowCount - 1 - i) * upload->rowBytes;
+            memcpy(upload->swap, a, upload->rowBytes);
+            memcpy(a, b, upload->rowBytes);
+            memcpy(b, upload->swap, upload->rowBytes);
+        }
+        y = upload->height - firstRow - rowCount;
+    }
+    int width = (int)(upload->rowBytes / (upload->format == GL_RED ? 1 : 4));
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, rowCount, upload->format, GL_UNSIGNED_BYTE, rows);
+    return 1;
+}
+
+TextureS LoadTextureStreamed(const char *path, TextureLoadOptionsS options)
+{
+    TextureS tex = {0};
+
+    MappedFileS file;
+    if (!MapFile(path, &file) || file.size > INT_MAX)
+    {
+        UnmapFile(&file);
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        return tex;
+    }
+
+    /* as LoadTextureImmutable : R8 for grey, RGBA8 for everything else */
+    int width, height, channels;
+    bool ok = stbi_info_from_memory(file.data, (int)file.size, &width, &height, &channels);
+    if (ok && options.maxDimension > 0)
+    {
+        /* the rows come in at the scaled size, which stbi_info now reports */
+        SetJpegScaleLimit(width, height, options.maxDimension);
+        ok = stbi_info_from_memory(file.data, (int)file.size, &width, &height, &channels);
+    }
+    if (!ok)
+    {
+        stbi_set_jpeg_scale_denom_thread(1);
+        UnmapFile(&file);
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        return tex;
+    }
+    int reqComp = channels == 1 ? 1 : 4;
+
+    StreamUploadS upload;
+    upload.format = reqComp == 1 ? GL_RED : GL_RGBA;
+    upload.height = height;
+    upload.rowBytes = (size_t)width * reqComp;
+    upload.origin = options.origin;
+    upload.swap = (unsigned char *)malloc(upload.rowBytes);
+    if (!upload.swap)
+    {
+        stbi_set_jpeg_scale_denom_thread(1);
+        UnmapFile(&file);
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        return tex;
+    }
+    int bandRows = (int)(STREAM_BAND_BYTES / upload.rowBytes);
+    if (bandRows < 16)
+        bandRows = 16;
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    GLenum wrapMode = (options.setting == TEXTURE_REPEAT) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    AllocateTextureStorage(MipLevelCount(width, height), reqComp == 1 ? GL_R8 : GL_RGBA8, width, height, upload.format, GL_UNSIGNED_BYTE);
+
+    if (reqComp == 1)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    ok = stbi_load_rows_from_memory(file.data, (int)file.size, &width, &height, &channels, reqComp, bandRows, UploadStreamedRows, &upload);
+    stbi_set_jpeg_scale_denom_thread(1);
+    if (reqComp == 1)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    UnmapFile(&file);
+    free(upload.swap);
+
+    if (!ok)
+    {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDeleteTextures(1, &textureID);
+        fprintf(stderr, "Failed to load texture: %s (%s)\n", path, stbi_failure_reason());
+        return tex;
+    }
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    tex.id = textureID;
+    tex.width = width;
+    tex.height = height;
+    tex.channels = reqComp;
+    tex.setting = options.setting;
+    tex.origin = options.origin;
+
+    return tex;
+}
+
+/*
+    tiled textures :
+    images larger than GL_MAX_TEXTURE_SIZE (map and satellite imagery) are cut into a grid of tiles, each its
+    own texture, while they stream in : each band of rows goes to the tiles it crosses with
+    GL_UNPACK_ROW_LENGTH set to the image width, a row of tiles is created when the first band reaches it and
+    gets its mipmaps when the last one has gone through. so neither the image nor a tile row is ever whole
+    in memory, and stb's whole-image size limits don't apply (see "Row-streaming decode" in stb_img.h).
+    tiles keep file order, drawn with u_FlipV as for TEXTURE_ORIGIN_TOP_LEFT, and clamp to their edges :
+    filtering doesn't cross tile borders, and mip levels are per tile.
+*/
+#define TILE_DEFAULT_SIZE 4096
+
+typedef struct
+{
+    TiledTextureS *tex;
+    GLenum format;
+    GLenum internalFormat;
+    size_t rowBytes;
+} TileUploadS;
+
+static int UploadTileRows(void *user, unsigned char *rows, int firstRow, int rowCount)
+{
+    TileUploadS *upload = (TileUploadS *)user;
+    TiledTextureS *tex = upload->tex;
+    while (rowCount > 0)
+    {
+        int tileRow = firstRow / tex->tileSize;
+        TextureTileS *tiles = tex->tiles + (size_t)tileRow * tex->columns;
+        int y0 = tiles[0].y;
+        int count = y0 + tiles[0].height - firstRow;
+        if (count > rowCount)
+            count = rowCount;
+
+        for (int i = 0; i < tex->columns; i++)
+        {
+            TextureTileS *tile = &tiles[i];
+            if (firstRow == y0)
+            {
+                glGenTextures(1, &tile->id);
+                glBindTexture(GL_TEXTURE_2D, tile->id);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                AllocateTextureStorage(MipLevelCount(tile->width, tile->height), upload->internalFormat, tile->width, tile->height,
+                                       upload->format, GL_UNSIGNED_BYTE);
+            }
+            else
+            {
+                glBindTexture(GL_TEXTURE_2D, tile->id);
+            }
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow - y0, tile->width, count, upload->format, GL_UNSIGNED_BYTE,
+                            rows + (size_t)tile->x * tex->channels);
+            if (firstRow + count == y0 + tile->height)
+                glGenerateMipmap(GL_TEXTURE_2D);
+        }
+
+        rows += (size_t)count * upload->rowBytes;
+        firstRow += count;
+        rowCount -= count;
+    }
+    return 1;
+}
+
+TiledTextureS LoadTiledTexture(const char *path, int tileSize)
+{
+    TiledTextureS tex = {0};
+
+    MappedFileS file;
+    int width, height, channels;
+    if (!MapFile(path, &file) || file.size > INT_MAX || !stbi_info_from_memory(file.data, (int)file.size, &width, &height, &channels))
+    {
+        UnmapFile(&file);
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        return tex;
+    }
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (tileSize <= 0)
+        tileSize = TILE_DEFAULT_SIZE;
+    if (maxSize > 0 && tileSize > maxSize)
+        tileSize = maxSize;
+
+    /* as LoadTextureStreamed : R8 for grey, RGBA8 for everything else */
+    tex.channels = channels == 1 ? 1 : 4;
+    tex.width = width;
+    tex.height = height;
+    tex.tileSize = tileSize;
+    tex.columns = (width + tileSize - 1) / tileSize;
+    tex.rows = (height + tileSize - 1) / tileSize;
+    tex.tileCount = tex.columns * tex.rows;
+    tex.tiles = (TextureTileS *)calloc((size_t)tex.tileCount, sizeof(TextureTileS));
+    if (!tex.tiles)
+    {
+        UnmapFile(&file);
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        memset(&tex, 0, sizeof(tex));
+        return tex;
+    }
+    for (int i = 0; i < tex.tileCount; i++)
+    {
+        TextureTileS *tile = &tex.tiles[i];
+        tile->x = i % tex.columns * tileSize;
+        tile->y = i / tex.columns * tileSize;
+        tile->width = width - tile->x < tileSize ? width - tile->x : tileSize;
+        tile->height = height - tile->y < tileSize ? height - tile->y : tileSize;
+    }
+
+    TileUploadS upload;
+    upload.tex = &tex;
+    upload.format = tex.channels == 1 ? GL_RED : GL_RGBA;
+    upload.internalFormat = tex.channels == 1 ? GL_R8 : GL_RGBA8;
+    upload.rowBytes = (size_t)width * tex.channels;
+    int bandRows = (int)(STREAM_BAND_BYTES / upload.rowBytes);
+    if (bandRows < 16)
+        bandRows = 16;
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    if (tex.channels == 1)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    int ok = stbi_load_rows_from_memory(file.data, (int)file.size, &width, &height, &channels, (int)tex.channels, bandRows, UploadTileRows, &upload);
+    if (tex.channels == 1)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    UnmapFile(&file);
+
+    if (!ok)
+    {
+        fprintf(stderr, "Failed to load texture: %s (%s)\n", path, stbi_failure_reason());
+        FreeTiledTexture(&tex);
+    }
+    return tex;
+}
+
+/* false when the rectangle (z = 0) lies entirely outside one of the clip planes */
+static bool RectInClipVolume(mat4 mvp, float x0, float y0, float x1, float y1)
+{
+    int outside = 0x3f;
+    for (int i = 0; i < 4; i++)
+    {
+        vec4 corner = {i & 1 ? x1 : x0, i & 2 ? y1 : y0, 0.0f, 1.0f};
+        vec4 clip;
+        glm_mat4_mulv(mvp, corner, clip);
+        int code = (clip[0] < -clip[3]) | (clip[0] > clip[3]) << 1 | (clip[1] < -clip[3]) << 2 | (clip[1] > clip[3]) << 3 |
+                   (clip[2] < -clip[3]) << 4 | (clip[2] > clip[3]) << 5;
+        outside &= code;
+    }
+    return outside == 0;
+}
+
+int DrawTiledTexture(const TiledTextureS *tex, GLuint shaderProgram, GLuint quadVAO, mat4 mvp)
+{
+    if (!tex || !tex->tiles)
+    {
+        fprintf(stderr, "Attempted to draw an invalid or uninitialized tiled texture.\n");
+        return 0;
+    }
+    BindProgram(shaderProgram);
+    GLint mvpLoc = GetUniformLocationCached(shaderProgram, "u_MVP");
+    GLint flipLocation = GetUniformLocationCached(shaderProgram, "u_FlipV");
+    if (flipLocation != -1)
+    {
+        glUniform1i(flipLocation, 1);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(quadVAO);
+
+    int drawn = 0;
+    for (int i = 0; i < tex->tileCount; i++)
+    {
+        const TextureTileS *tile = &tex->tiles[i];
+        /* tile rows count from the top, image space has y up */
+        float x0 = (float)tile->x;
+        float y0 = (float)(tex->height - tile->y - tile->height);
+        if (tile->id == 0 || !RectInClipVolume(mvp, x0, y0, x0 + tile->width, y0 + tile->height))
+            continue;
+
+        mat4 model;
+        glm_mat4_identity(model);
+        glm_translate(model, (vec3){x0, y0, 0.0f});
+        glm_scale(model, (vec3){(float)tile->width, (float)tile->height, 1.0f});
+        mat4 tileMvp;
+        glm_mat4_mul(mvp, model, tileMvp);
+        glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, (const GLfloat *)tileMvp);
+        glBindTexture(GL_TEXTURE_2D, tile->id);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        drawn++;
+    }
+
+    glBindVertexArray(0);
+    UnbindTextureS();
+    BindProgram(0);
+    return drawn;
+}
+
+void FreeTiledTexture(TiledTextureS *tex)
+{
+    if (!tex)
+        return;
+    for (int i = 0; tex->tiles && i < tex->tileCount; i++)
+    {
+        if (tex->tiles[i].id)
+            glDeleteTextures(1, &tex->tiles[i].id);
+    }
+    free(tex->tiles);
+    memset(tex, 0, sizeof(*tex));
+}
+
+/*
+    KTX2 textures :
+    the container stores every mip level ready for upload, so loading is one mapped read and one
+    glTexImage2D/glCompressedTexImage2D per level, with no decode and no glGenerateMipmap
+    (unless the file has levelCount 0, which asks the loader to generate them).
+    only plain 2D textures without supercompression are supported. rows are uploaded in file order,
+    so bake files bottom-up (KTXorientation "ru") to match LoadTexture, as BakeTextureKTX2() does.
+*/
+typedef struct
+{
+    unsigned int vkFormat;
+    GLenum internalFormat;
+    GLenum format; /* 0 for block-compressed formats */
+    GLenum type;
+    int bytes;     /* per pixel, or per 4x4 block when compressed */
+    int channels;
+} Ktx2FormatS;
+
+static const Ktx2FormatS ktx2Formats[] = {
+    {9, GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, 1},                                 /* VK_FORMAT_R8_UNORM */
+    {16, GL_RG8, GL_RG, GL_UNSIGNED_BYTE, 2, 2},                                /* VK_FORMAT_R8G8_UNORM */
+    {23, GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE, 3, 3},                              /* VK_FORMAT_R8G8B8_UNORM */
+    {29, GL_SRGB8, GL_RGB, GL_UNSIGNED_BYTE, 3, 3},                             /* VK_FORMAT_R8G8B8_SRGB */
+    {37, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, 4},                            /* VK_FORMAT_R8G8B8A8_UNORM */
+    {43, GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, 4},                     /* VK_FORMAT_R8G8B8A8_SRGB */
+    {44, GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE, 4, 4},                            /* VK_FORMAT_B8G8R8A8_UNORM */
+    {50, GL_SRGB8_ALPHA8, GL_BGRA, GL_UNSIGNED_BYTE, 4, 4},                     /* VK_FORMAT_B8G8R8A8_SRGB */
+    {97, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8, 4},                             /* VK_FORMAT_R16G16B16A16_SFLOAT */
+    {131, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 0, 0, 8, 3},                         /* VK_FORMAT_BC1_RGB_UNORM_BLOCK */
+    {132, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 0, 0, 8, 3},                        /* VK_FORMAT_BC1_RGB_SRGB_BLOCK */
+    {133, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0, 8, 4},                        /* VK_FORMAT_BC1_RGBA_UNORM_BLOCK */
+    {134, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 0, 0, 8, 4},                  /* VK_FORMAT_BC1_RGBA_SRGB_BLOCK */
+    {135, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0, 16, 4},                       /* VK_FORMAT_BC2_UNORM_BLOCK */
+    {136, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 0, 0, 16, 4},                 /* VK_FORMAT_BC2_SRGB_BLOCK */
+    {137, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0, 16, 4},                       /* VK_FORMAT_BC3_UNORM_BLOCK */
+    {138, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 0, 0, 16, 4},                 /* VK_FORMAT_BC3_SRGB_BLOCK */
+    {139, GL_COMPRESSED_RED_RGTC1, 0, 0, 8, 1},                                 /* VK_FORMAT_BC4_UNORM_BLOCK */
+    {140, GL_COMPRESSED_SIGNED_RED_RGTC1, 0, 0, 8, 1},                          /* VK_FORMAT_BC4_SNORM_BLOCK */
+    {141, GL_COMPRESSED_RG_RGTC2, 0, 0, 16, 2},                                 /* VK_FORMAT_BC5_UNORM_BLOCK */
+    {142, GL_COMPRESSED_SIGNED_RG_RGTC2, 0, 0, 16, 2},                          /* VK_FORMAT_BC5_SNORM_BLOCK */
+    {143, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 0, 0, 16, 3},                  /* VK_FORMAT_BC6H_UFLOAT_BLOCK */
+    {144, GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, 0, 0, 16, 3},                    /* VK_FORMAT_BC6H_SFLOAT_BLOCK */
+    {145, GL_COMPRESSED_RGBA_BPTC_UNORM, 0, 0, 16, 4},                          /* VK_FORMAT_BC7_UNORM_BLOCK */
+    {146, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 0, 0, 16, 4},                    /* VK_FORMAT_BC7_SRGB_BLOCK */
+};
+
+static unsigned int ReadU32LE(const unsigned char *p)
+{
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned long long ReadU64LE(const unsigned char *p)
+{
+    return (unsigned long long)ReadU32LE(p) | ((unsigned long long)ReadU32LE(p + 4) << 32);
+}
+
+TextureS LoadTextureKTX2(const char *path, TextureSettingS setting)
+{
+    static const unsigned char identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+    TextureS tex = {0};
+
+    MappedFileS file;
+    if (!MapFile(path, &file))
+    {
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        return tex;
+    }
+    if (file.size < 80 || memcmp(file.data, identifier, sizeof(identifier)) != 0)
+    {
+        fprintf(stderr, "Not a KTX2 file: %s\n", path);
+        UnmapFile(&file);
+        return tex;
+    }
+
+    const unsigned char *header = file.data;
+    unsigned int vkFormat = ReadU32LE(header + 12);
+    int width = (int)ReadU32LE(header + 20);
+    int height = (int)ReadU32LE(header + 24);
+    unsigned int depth = ReadU32LE(header + 28);
+    unsigned int layerCount = ReadU32LE(header + 32);
+    unsigned int faceCount = ReadU32LE(header + 36);
+    unsigned int levelCount = ReadU32LE(header + 40);
+    unsigned int supercompression = ReadU32LE(header + 44);
+    bool generateMips = levelCount == 0;
+    if (generateMips)
+        levelCount = 1;
+
+    if (width <= 0 || height <= 0 || depth != 0 || layerCount != 0 || faceCount != 1 || supercompression != 0 || levelCount > 32)
+    {
+        fprintf(stderr, "Unsupported KTX2 layout (only 2D textures without supercompression): %s\n", path);
+        UnmapFile(&file);
+        return tex;
+    }
+    if (80 + (size_t)levelCount * 24 > file.size)
+    {
+        fprintf(stderr, "Truncated KTX2 level index: %s\n", path);
+        UnmapFile(&file);
+        return tex;
+    }
+
+    const Ktx2FormatS *fmt = NULL;
+    for (size_t i = 0; i < sizeof(ktx2Formats) / sizeof(ktx2Formats[0]); i++)
+    {
+        if (ktx2Formats[i].vkFormat == vkFormat)
+        {
+            fmt = &ktx2Formats[i];
+            break;
+        }
+    }
+    if (!fmt || (generateMips && fmt->format == 0))
+    {
+        fprintf(stderr, "Unsupported KTX2 format (vkFormat %u): %s\n", vkFormat, path);
+        UnmapFile(&file);
+        return tex;
+    }
+
+    /* validate every level before creating the texture */
+    for (unsigned int level = 0; level < levelCount; level++)
+    {
+        const unsigned char *entry = header + 80 + level * 24;
+        unsigned long long offset = ReadU64LE(entry);
+        unsigned long long length = ReadU64LE(entry + 8);
+        unsigned long long w = (width >> level) > 0 ? (unsigned long long)(width >> level) : 1;
+        unsigned long long h = (height >> level) > 0 ? (unsigned long long)(height >> level) : 1;
+        unsigned long long units = fmt->format ? w * h : ((w + 3) / 4) * ((h + 3) / 4);
+        unsigned long long expected = units * fmt->bytes;
+        /* glCompressedTexImage2D rejects any size but the exact one, and GL sizes are ints */
+        if (units > INT_MAX || expected > INT_MAX || length != expected || offset > file.size || length > file.size - offset)
+        {
+            fprintf(stderr, "Corrupt KTX2 level %u: %s\n", level, path);
+            UnmapFile(&file);
+            return tex;
+        }
+    }
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    GLenum wrapMode = (setting == TEXTURE_REPEAT) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+    bool mipmapped = generateMips || levelCount > 1;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    /* chains may stop before 1x1 */
+    if (!generateMips)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levelCount - 1);
+
+    /* KTX2 rows are tightly packed */
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned int level = 0; level < levelCount; level++)
+    {
+        const unsigned char *entry = header + 80 + level * 24;
+        const unsigned char *data = file.data + ReadU64LE(entry);
+        GLsizei length = (GLsizei)ReadU64LE(entry + 8);
+        GLsizei w = (width >> level) > 0 ? (width >> level) : 1;
+        GLsizei h = (height >> level) > 0 ? (height >> level) : 1;
+
+        if (fmt->format)
+            glTexImage2D(GL_TEXTURE_2D, level, fmt->internalFormat, w, h, 0, fmt->format, fmt->type, data);
+        else
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, fmt->internalFormat, w, h, 0, length, data);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (generateMips)
+        glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    UnmapFile(&file);
+
+    tex.id = textureID;
+    tex.width = width;
+    tex.height = height;
+    tex.channels = fmt->channels;
+    tex.setting = setting;
+
+    return tex;
+}
+
+/*
+    block compression (BCn) :
+    EncodeBlockCompressed() turns decoded 8-bit pixels into BC1/BC3/BC4/BC5/BC7 blocks on the CPU,
+    splitting the block rows over threads. it makes no GL calls, so baking also works on machines
+    without a GPU. BC7 blocks are always written in mode 6 (one subset, 4-bit indices).
+    BC4 reads the first channel of the image, BC5 the first two (grey + alpha for 2-channel images).
+    on x86 the BC1/BC3/BC7 index searches have SSE4.1 and AVX2 versions, compiled with a per-function
+    target and picked at run time the same way as the stb kernels. define REOPENGL_NO_SIMD to leave them out.
+*/
+#if !defined(REOPENGL_NO_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#if defined(_MSC_VER) && _MSC_VER >= 1700 && !defined(__clang__)
+#define BLOCK_SIMD
+#define BLOCK_SSE41_TARGET
+#define BLOCK_AVX2_TARGET
+#include <intrin.h>
+#include <immintrin.h>
+static bool BlockSse41Available(void)
+{
+    int info[4];
+    __cpuid(info, 1);
+    return ((info[2] >> 19) & 1) != 0;
+}
+static bool BlockAvx2Available(void)
+{
+    int info[4];
+    __cpuid(info, 1);
+    /* OSXSAVE and AVX, with the OS saving the ymm registers */
+    if ((info[2] & (3 << 27)) != (3 << 27) || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return ((info[1] >> 5) & 1) != 0;
+}
+#elif defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define BLOCK_SIMD
+#define BLOCK_SSE41_TARGET __attribute__((target("sse4.1")))
+#define BLOCK_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+static bool BlockSse41Available(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.1");
+}
+static bool BlockAvx2Available(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
+static int BlockBytes(BlockFormatS format)
+{
+    return (format == BLOCK_BC1 || format == BLOCK_BC4) ? 8 : 16;
+}
+
+size_t BlockCompressedSize(int width, int height, BlockFormatS format)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+}
+
+/* 4x4 block as RGBA, edge pixels repeated for partial blocks */
+static void GatherBlock(const unsigned char *pixels, int width, int height, int channels, int bx, int by, unsigned char block[16][4])
+{
+    for (int y = 0; y < 4; y++)
+    {
+        int sy = (by * 4 + y < height) ? by * 4 + y : height - 1;
+        for (int x = 0; x < 4; x++)
+        {
+            int sx = (bx * 4 + x < width) ? bx * 4 + x : width - 1;
+            const unsigned char *p = pixels + ((size_t)sy * width + sx) * channels;
+            unsigned char *q = block[y * 4 + x];
+            switch (channels)
+            {
+            case 1:
+                q[0] = q[1] = q[2] = p[0];
+                q[3] = 255;
+                break;
+            case 2:
+                q[0] = q[1] = q[2] = p[0];
+                q[3] = p[1];
+                break;
+            case 3:
+                q[0] = p[0];
+                q[1] = p[1];
+                q[2] = p[2];
+                q[3] = 255;
+                break;
+            default:
+                q[0] = p[0];
+                q[1] = p[1];
+                q[2] = p[2];
+                q[3] = p[3];
+                break;
+            }
+        }
+    }
+}
+
+static int ClampByte(float v)
+{
+    int i = (int)(v + 0.5f);
+    return i < 0 ? 0 : (i > 255 ? 255 : i);
+}
+
+/* mean and dominant direction of the first dims channels, by power iteration on the covariance */
+static void PrincipalAxis(const unsigned char block[16][4], int dims, float mean[4], float axis[4])
+{
+    float cov[4][4] = {{0}};
+    for (int c = 0; c < dims; c++)
+    {
+        mean[c] = 0.0f;
+        for (int i = 0; i < 16; i++)
+            mean[c] += block[i][c];
+        mean[c] /= 16.0f;
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        float d[4];
+        for (int c = 0; c < dims; c++)
+            d[c] = block[i][c] - mean[c];
+        for (int r = 0; r < dims; r++)
+            for (int c = 0; c < dims; c++)
+                cov[r][c] += d[r] * d[c];
+    }
+
+    for (int c = 0; c < dims; c++)
+        axis[c] = 1.0f;
+    for (int iter = 0; iter < 8; iter++)
+    {
+        float next[4] = {0};
+        float len = 0.0f;
+        for (int r = 0; r < dims; r++)
+        {
+            for (int c = 0; c < dims; c++)
+                next[r] += cov[r][c] * axis[c];
+            len += next[r] * next[r];
+        }
+        if (len < 1e-12f)
+            break;
+        len = 1.0f / sqrtf(len);
+        for (int c = 0; c < dims; c++)
+            axis[c] = next[c] * len;
+    }
+}
+
+/* block pixels with the smallest and largest projection on the axis */
+static void AxisExtremes(const unsigned char block[16][4], int dims, const float mean[4], const float axis[4], float lo[4], float hi[4])
+{
+    float minDot = 1e30f, maxDot = -1e30f;
+    for (int i = 0; i < 16; i++)
+    {
+        float dot = 0.0f;
+        for (int c = 0; c < dims; c++)
+            dot += (block[i][c] - mean[c]) * axis[c];
+        minDot = dot < minDot ? dot : minDot;
+        maxDot = dot > maxDot ? dot : maxDot;
+    }
+    for (int c = 0; c < dims; c++)
+    {
+        lo[c] = mean[c] + axis[c] * minDot;
+        hi[c] = mean[c] + axis[c] * maxDot;
+    }
+}
+
+/*
+    least-squares endpoints for fixed indices : weights[i] is how much of endpoint 1 pixel i takes.
+    returns false when every pixel uses the same weight.
+*/
+static bool FitEndpoints(const unsigned char block[16][4], int dims, const float weights[16], float e0[4], float e1[4])
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {0}, bx[4] = {0};
+    for (int i = 0; i < 16; i++)
+    {
+        float b = weights[i], a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < dims; c++)
+        {
+            ax[c] += a * block[i][c];
+            bx[c] += b * block[i][c];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (fabsf(det) < 1e-6f)
+        return false;
+    det = 1.0f / det;
+    for (int c = 0; c < dims; c++)
+    {
+        e0[c] = (ax[c] * bb - bx[c] * ab) * det;
+        e1[c] = (bx[c] * aa - ax[c] * ab) * det;
+    }
+    return true;
+}
+
+static unsigned short PackColor565(const float c[3])
+{
+    int r = ClampByte(c[0]) * 31 + 127;
+    int g = ClampByte(c[1]) * 63 + 127;
+    int b = ClampByte(c[2]) * 31 + 127;
+    return (unsigned short)(((r / 255) << 11) | ((g / 255) << 5) | (b / 255));
+}
+
+static void UnpackColor565(unsigned short v, int out[3])
+{
+    int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+/*
+    index of the closest palette entry for each pixel (first one on ties), returns the summed squared error.
+    alpha is left out of the distance when false, palette holds at most 16 entries.
+*/
+typedef int (*PickIndicesFn)(const unsigned char block[16][4], const int palette[][4], int entries, bool alpha, unsigned char indices[16]);
+
+static int PickIndices(const unsigned char block[16][4], const int palette[][4], int entries, bool alpha, unsigned char indices[16])
+{
+    int channels = alpha ? 4 : 3;
+    int error = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, bestDist = 1 << 30;
+        for (int k = 0; k < entries; k++)
+        {
+            int dist = 0;
+            for (int c = 0; c < channels; c++)
+            {
+                int d = palette[k][c] - block[i][c];
+                dist += d * d;
+            }
+            if (dist < bestDist)
+            {
+                bestDist = dist;
+                best = k;
+            }
+        }
+        indices[i] = (unsigned char)best;
+        error += bestDist;
+    }
+    return error;
+}
+
+#ifdef BLOCK_SIMD
+/*
+    the same search with one pixel per 32-bit lane : r/g and b/a are widened to 16-bit pairs so that madd
+    sums two squared differences at once, and the distance is shifted up over the entry index, so a plain
+    min keeps the closest entry and the lowest index on ties, exactly like the scalar loop.
+*/
+BLOCK_SSE41_TARGET static int PickIndicesSse41(const unsigned char block[16][4], const int palette[][4], int entries, bool alpha, unsigned char indices[16])
+{
+    int bits = entries > 4 ? 4 : 2;
+    const __m128i rgMask = _mm_setr_epi8(0, -1, 1, -1, 4, -1, 5, -1, 8, -1, 9, -1, 12, -1, 13, -1);
+    const __m128i baMask = alpha ? _mm_setr_epi8(2, -1, 3, -1, 6, -1, 7, -1, 10, -1, 11, -1, 14, -1, 15, -1)
+                                 : _mm_setr_epi8(2, -1, -1, -1, 6, -1, -1, -1, 10, -1, -1, -1, 14, -1, -1, -1);
+    int error = 0;
+    for (int g = 0; g < 16; g += 4)
+    {
+        __m128i px = _mm_loadu_si128((const __m128i *)block[g]);
+        __m128i rg = _mm_shuffle_epi8(px, rgMask);
+        __m128i ba = _mm_shuffle_epi8(px, baMask);
+        __m128i best = _mm_set1_epi32(INT_MAX);
+        for (int k = 0; k < entries; k++)
+        {
+            __m128i d0 = _mm_sub_epi16(rg, _mm_set1_epi32(palette[k][0] | (palette[k][1] << 16)));
+            __m128i d1 = _mm_sub_epi16(ba, _mm_set1_epi32(palette[k][2] | (alpha ? palette[k][3] << 16 : 0)));
+            __m128i dist = _mm_add_epi32(_mm_madd_epi16(d0, d0), _mm_madd_epi16(d1, d1));
+            best = _mm_min_epi32(best, _mm_or_si128(_mm_slli_epi32(dist, bits), _mm_set1_epi32(k)));
+        }
+        int keys[4];
+        _mm_storeu_si128((__m128i *)keys, best);
+        for (int j = 0; j < 4; j++)
+        {
+            indices[g + j] = (unsigned char)(keys[j] & ((1 << bits) - 1));
+            error += keys[j] >> bits;
+        }
+    }
+    return error;
+}
+
+BLOCK_AVX2_TARGET static int PickIndicesAvx2(const unsigned char block[16][4], const int palette[][4], int entries, bool alpha, unsigned char indices[16])
+{
+    int bits = entries > 4 ? 4 : 2;
+    const __m256i rgMask = _mm256_broadcastsi128_si256(_mm_setr_epi8(0, -1, 1, -1, 4, -1, 5, -1, 8, -1, 9, -1, 12, -1, 13, -1));
+    const __m256i baMask = _mm256_broadcastsi128_si256(alpha ? _mm_setr_epi8(2, -1, 3, -1, 6, -1, 7, -1, 10, -1, 11, -1, 14, -1, 15, -1)
+                                                             : _mm_setr_epi8(2, -1, -1, -1, 6, -1, -1, -1, 10, -1, -1, -1, 14, -1, -1, -1));
+    int error = 0;
+    for (int g = 0; g < 16; g += 8)
+    {
+        __m256i px = _mm256_loadu_si256((const __m256i *)block[g]);
+        __m256i rg = _mm256_shuffle_epi8(px, rgMask);
+        __m256i ba = _mm256_shuffle_epi8(px, baMask);
+        __m256i best = _mm256_set1_epi32(INT_MAX);
+        for (int k = 0; k < entries; k++)
+        {
+            __m256i d0 = _mm256_sub_epi16(rg, _mm256_set1_epi32(palette[k][0] | (palette[k][1] << 16)));
+            __m256i d1 = _mm256_sub_epi16(ba, _mm256_set1_epi32(palette[k][2] | (alpha ? palette[k][3] << 16 : 0)));
+            __m256i dist = _mm256_add_epi32(_mm256_madd_epi16(d0, d0), _mm256_madd_epi16(d1, d1));
+            best = _mm256_min_epi32(best, _mm256_or_si256(_mm256_slli_epi32(dist, bits), _mm256_set1_epi32(k)));
+        }
+        int keys[8];
+        _mm256_storeu_si256((__m256i *)keys, best);
+        for (int j = 0; j < 8; j++)
+        {
+            indices[g + j] = (unsigned char)(keys[j] & ((1 << bits) - 1));
+            error += keys[j] >> bits;
+        }
+    }
+    return error;
+}
+#endif
+
+/* the widest index search this CPU runs */
+static PickIndicesFn BlockIndexSearch(void)
+{
+#ifdef BLOCK_SIMD
+    if (BlockAvx2Available())
+        return PickIndicesAvx2;
+    if (BlockSse41Available())
+        return PickIndicesSse41;
+#endif
+    return PickIndices;
+}
+
+/* 2-bit indices of the 4-colour BC1 palette, returns the squared error */
+static int PickColorIndices(const unsigned char block[16][4], unsigned short c0, unsigned short c1, PickIndicesFn pick, unsigned int *indices)
+{
+    int palette[4][4] = {{0}};
+    UnpackColor565(c0, palette[0]);
+    UnpackColor565(c1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    unsigned char best[16];
+    int error = pick(block, palette, 4, false, best);
+    *indices = 0;
+    for (int i = 0; i < 16; i++)
+        *indices |= (unsigned int)best[i] << (2 * i);
+    return error;
+}
+
+static void EncodeColorBlock(const unsigned char block[16][4], PickIndicesFn pick, unsigned char out[8])
+{
+    static const float weightOfIndex[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+    float mean[4], axis[4], lo[4], hi[4];
+    PrincipalAxis(block, 3, mean, axis);
+    AxisExtremes(block, 3, mean, axis, lo, hi);
+
+    unsigned short c0 = PackColor565(hi), c1 = PackColor565(lo);
+    unsigned int indices;
+    int error = PickColorIndices(block, c0, c1, pick, &indices);
+
+    /* one refinement pass with the endpoints that best fit the chosen indices */
+    float weights[16], e0[4], e1[4];
+    for (int i = 0; i < 16; i++)
+        weights[i] = weightOfIndex[(indices >> (2 * i)) & 3];
+    if (FitEndpoints(block, 3, weights, e0, e1))
+    {
+        unsigned short r0 = PackColor565(e0), r1 = PackColor565(e1);
+        unsigned int refined;
+        int refinedError = PickColorIndices(block, r0, r1, pick, &refined);
+        if (refinedError < error)
+        {
+            c0 = r0;
+            c1 = r1;
+            indices = refined;
+        }
+    }
+
+    /* c0 > c1 selects the opaque 4-colour mode, swapping endpoints maps index k to k ^ 1 */
+    if (c0 < c1)
+    {
+        unsigned short t = c0;
+        c0 = c1;
+        c1 = t;
+        indices ^= 0x55555555u;
+    }
+    else if (c0 == c1)
+    {
+        indices = 0;
+    }
+
+    out[0] = (unsigned char)(c0 & 0xFF);
+    out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)(c1 & 0xFF);
+    out[3] = (unsigned char)(c1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+/* BC4 block (also the alpha half of BC3) in the 8-value mode */
+static void EncodeSingleChannelBlock(const unsigned char block[16][4], int channel, unsigned char out[8])
+{
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int v = block[i][channel];
+        lo = v < lo ? v : lo;
+        hi = v > hi ? v : hi;
+    }
+
+    out[0] = (unsigned char)hi;
+    out[1] = (unsigned char)lo;
+    unsigned long long bits = 0;
+    if (hi != lo)
+    {
+        int palette[8];
+        palette[0] = hi;
+        palette[1] = lo;
+        for (int k = 1; k < 7; k++)
+            palette[k + 1] = ((7 - k) * hi + k * lo + 3) / 7;
+
+        for (int i = 0; i < 16; i++)
+        {
+            int v = block[i][channel];
+            int best = 0, bestDist = 1 << 30;
+            for (int k = 0; k < 8; k++)
+            {
+                int dist = abs(palette[k] - v);
+                if (dist < bestDist)
+                {
+                    bestDist = dist;
+                    best = k;
+                }
+            }
+            bits |= (unsigned long long)best << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+static const int bc7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+/* 7-bit endpoint + shared p-bit closest to the float colour */
+static void QuantizeBC7Endpoint(const float c[4], int q[4], int *pbit)
+{
+    int bestError = 1 << 30;
+    for (int p = 0; p < 2; p++)
+    {
+        int error = 0, cand[4];
+        for (int k = 0; k < 4; k++)
+        {
+            int v = (ClampByte(c[k]) - p + 1) >> 1;
+            v = v < 0 ? 0 : (v > 127 ? 127 : v);
+            cand[k] = v;
+            int d = ((v << 1) | p) - ClampByte(c[k]);
+            error += d * d;
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            *pbit = p;
+            memcpy(q, cand, sizeof(cand));
+        }
+    }
+}
+
+static int PickBC7Indices(const unsigned char block[16][4], const int q0[4], int p0, const int q1[4], int p1, PickIndicesFn pick, unsigned char indices[16])
+{
+    int palette[16][4];
+    for (int k = 0; k < 4; k++)
+    {
+        int a = (q0[k] << 1) | p0, b = (q1[k] << 1) | p1;
+        for (int w = 0; w < 16; w++)
+            palette[w][k] = ((64 - bc7Weights4[w]) * a + bc7Weights4[w] * b + 32) >> 6;
+    }
+    return pick(block, palette, 16, true, indices);
+}
+
+static void PutBits(unsigned char *out, int *pos, unsigned int value, int count)
+{
+    for (int i = 0; i < count; i++, (*pos)++)
+    {
+        if (value & (1u << i))
+            out[*pos >> 3] |= (unsigned char)(1u << (*pos & 7));
+    }
+}
+
+static void EncodeBC7Block(const unsigned char block[16][4], PickIndicesFn pick, unsigned char out[16])
+{
+    float mean[4], axis[4], lo[4], hi[4];
+    PrincipalAxis(block, 4, mean, axis);
+    AxisExtremes(block, 4, mean, axis, lo, hi);
+
+    int q0[4], q1[4], p0, p1;
+    unsigned char indices[16];
+    QuantizeBC7Endpoint(lo, q0, &p0);
+    QuantizeBC7Endpoint(hi, q1, &p1);
+    int error = PickBC7Indices(block, q0, p0, q1, p1, pick, indices);
+
+    float weights[16], e0[4], e1[4];
+    for (int i = 0; i < 16; i++)
+        weights[i] = bc7Weights4[indices[i]] / 64.0f;
+    if (FitEndpoints(block, 4, weights, e0, e1))
+    {
+        int r0[4], r1[4], rp0, rp1;
+        unsigned char refined[16];
+        QuantizeBC7Endpoint(e0, r0, &rp0);
+        QuantizeBC7Endpoint(e1, r1, &rp1);
+        int refinedError = PickBC7Indices(block, r0, rp0, r1, rp1, pick, refined);
+        if (refinedError < error)
+        {
+            memcpy(q0, r0, sizeof(q0));
+            memcpy(q1, r1, sizeof(q1));
+            p0 = rp0;
+            p1 = rp1;
+            memcpy(indices, refined, sizeof(indices));
+        }
+    }
+
+    /* the anchor index is stored with 3 bits, so its top bit must be clear */
+    if (indices[0] & 8)
+    {
+        int t[4];
+        memcpy(t, q0, sizeof(t));
+        memcpy(q0, q1, sizeof(t));
+        memcpy(q1, t, sizeof(t));
+        int tp = p0;
+        p0 = p1;
+        p1 = tp;
+        for (int i = 0; i < 16; i++)
+            indices[i] = (unsigned char)(15 - indices[i]);
+    }
+
+    memset(out, 0, 16);
+    int pos = 0;
+    PutBits(out, &pos, 1u << 6, 7); /* mode 6 */
+    for (int k = 0; k < 4; k++)
+    {
+        PutBits(out, &pos, (unsigned int)q0[k], 7);
+        PutBits(out, &pos, (unsigned int)q1[k], 7);
+    }
+    PutBits(out, &pos, (unsigned int)p0, 1);
+    PutBits(out, &pos, (unsigned int)p1, 1);
+    PutBits(out, &pos, indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        PutBits(out, &pos, indices[i], 4);
+}
+
+typedef struct
+{
+    const unsigned char *pixels;
+    int width;
+    int height;
+    int channels;
+    BlockFormatS format;
+    unsigned char *out;
+    int firstRow; /* block rows [firstRow, lastRow) */
+    int lastRow;
+    PickIndicesFn pick;
+} BlockEncodeJobS;
+
+static void *EncodeBlockRows(void *arg)
+{
+    BlockEncodeJobS *job = (BlockEncodeJobS *)arg;
+    int blocksX = (job->width + 3) / 4;
+    int blockBytes = BlockBytes(job->format);
+    /* BC5 takes grey + alpha from 2-channel images */
+    int secondChannel = job->channels == 2 ? 3 : 1;
+    unsigned char block[16][4];
+
+    for (int by = job->firstRow; by < job->lastRow; by++)
+    {
+        unsigned char *out = job->out + (size_t)by * blocksX * blockBytes;
+        for (int bx = 0; bx < blocksX; bx++, out += blockBytes)
+        {
+            GatherBlock(job->pixels, job->width, job->height, job->channels, bx, by, block);
+            switch (job->format)
+            {
+            case BLOCK_BC1:
+                EncodeColorBlock(block, job->pick, out);
+                break;
+            case BLOCK_BC3:
+                EncodeSingleChannelBlock(block, 3, out);
+                EncodeColorBlock(block, job->pick, out + 8);
+                break;
+            case BLOCK_BC4:
+                EncodeSingleChannelBlock(block, 0, out);
+                break;
+            case BLOCK_BC5:
+                EncodeSingleChannelBlock(block, 0, out);
+                EncodeSingleChannelBlock(block, secondChannel, out + 8);
+                break;
+            case BLOCK_BC7:
+                EncodeBC7Block(block, job->pick, out);
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* out must hold BlockCompressedSize(width, height, format) bytes */
+bool EncodeBlockCompressed(const unsigned char *pixels, int width, int height, int channels, BlockFormatS format, int threadCount, unsigned char *out)
+{
+    if (!pixels || !out || width <= 0 || height <= 0 || channels < 1 || channels > 4)
+        return false;
+
+    int rows = (height + 3) / 4;
+    if (threadCount < 1)
+        threadCount = 1;
+    if (threadCount > rows)
+        threadCount = rows;
+
+    if (threadCount > 64)
+        threadCount = 64;
+    BlockEncodeJobS jobs[64];
+    pthread_t threads[64];
+
+    PickIndicesFn pick = BlockIndexSearch();
+    for (int i = 0; i < threadCount; i++)
+    {
+        BlockEncodeJobS job = {pixels, width, height, channels, format, out, rows * i / threadCount, rows * (i + 1) / threadCount, pick};
+        jobs[i] = job;
+    }
+
+    /* the calling thread takes the first share */
+    bool started[64] = {false};
+    for (int i = 1; i < threadCount; i++)
+        started[i] = pthread_create(&threads[i], NULL, EncodeBlockRows, &jobs[i]) == 0;
+    EncodeBlockRows(&jobs[0]);
+    for (int i = 1; i < threadCount; i++)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            EncodeBlockRows(&jobs[i]);
+    }
+    return true;
+}
+
+/* 2x2 box filter, odd edges repeat the last row/column */
+static unsigned char *DownsampleHalf(const unsigned char *src, int width, int height, int channels, int *outWidth, int *outHeight)
+{
+    int w = width > 1 ? width / 2 : 1;
+    int h = height > 1 ? height / 2 : 1;
+    unsigned char *dst = (unsigned char *)malloc((size_t)w * h * channels);
+    if (!dst)
+        return NULL;
+
+    for (int y = 0; y < h; y++)
+    {
+        int y0 = 2 * y < height ? 2 * y : height - 1;
+        int y1 = 2 * y + 1 < height ? 2 * y + 1 : height - 1;
+        for (int x = 0; x < w; x++)
+        {
+            int x0 = 2 * x < width ? 2 * x : width - 1;
+            int x1 = 2 * x + 1 < width ? 2 * x + 1 : width - 1;
+            for (int c = 0; c < channels; c++)
+            {
+                int sum = src[((size_t)y0 * width + x0) * channels + c] + src[((size_t)y0 * width + x1) * channels + c] +
+                          src[((size_t)y1 * width + x0) * channels + c] + src[((size_t)y1 * width + x1) * channels + c];
+                dst[((size_t)y * w + x) * channels + c] = (unsigned char)((sum + 2) >> 2);
+            }
+        }
+    }
+    *outWidth = w;
+    *outHeight = h;
+    return dst;
+}
+
+/*
+    decodes an image and encodes its whole mip chain. levels[i]/levelSizes[i] receive malloc'd blocks,
+    returns the number of levels (0 on failure).
+*/
+static int EncodeMipChain(const char *path, BlockFormatS format, int threadCount, unsigned char *levels[32], size_t levelSizes[32], int *width, int *height, int *channels)
+{
+    stbi_set_flip_vertically_on_load_thread(1);
+    unsigned char *pixels = LoadImageMapped(path, width, height, channels, 0, 0);
+    if (!pixels)
+    {
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        return 0;
+    }
+
+    int levelCount = 0;
+    int w = *width, h = *height;
+    unsigned char *level = pixels;
+    bool failed = false;
+    for (;;)
+    {
+        levelSizes[levelCount] = BlockCompressedSize(w, h, format);
+        levels[levelCount] = (unsigned char *)malloc(levelSizes[levelCount]);
+        if (!levels[levelCount] || !EncodeBlockCompressed(level, w, h, *channels, format, threadCount, levels[levelCount]))
+        {
+            fprintf(stderr, "Memory allocation failed while compressing texture: %s\n", path);
+            free(levels[levelCount]);
+            failed = true;
+            break;
+        }
+        levelCount++;
+        if (w == 1 && h == 1)
+            break;
+
+        int nw = 0, nh = 0;
+        unsigned char *next = DownsampleHalf(level, w, h, *channels, &nw, &nh);
+        if (level != pixels)
+            free(level);
+        level = next;
+        if (!level)
+        {
+            fprintf(stderr, "Memory allocation failed while downsampling texture: %s\n", path);
+            failed = true;
+            break;
+        }
+        w = nw;
+        h = nh;
+    }
+    if (level && level != pixels)
+        free(level);
+    stbi_image_free(pixels);
+
+    /* a truncated chain would bake or upload as incomplete, so any failed level drops them all */
+    if (failed)
+    {
+        for (int i = 0; i < levelCount; i++)
+            free(levels[i]);
+        return 0;
+    }
+    return levelCount;
+}
+
+static GLenum BlockInternalFormat(BlockFormatS format)
+{
+    switch (format)
+    {
+    case BLOCK_BC1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BLOCK_BC3:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BLOCK_BC4:
+        return GL_COMPRESSED_RED_RGTC1;
+    case BLOCK_BC5:
+        return GL_COMPRESSED_RG_RGTC2;
+    default:
+        return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+}
+
+static int BlockChannels(BlockFormatS format)
+{
+    static const int channels[] = {3, 4, 1, 2, 4};
+    return channels[format];
+}
+
+/* decodes, block-compresses on the CPU and uploads with glCompressedTexImage2D, mips included */
+TextureS LoadTextureCompressed(const char *path, TextureSettingS setting, BlockFormatS format)
+{
+    TextureS tex = {0};
+    unsigned char *levels[32];
+    size_t levelSizes[32];
+    int width, height, channels;
+    int levelCount = EncodeMipChain(path, format, CpuCount(), levels, levelSizes, &width, &height, &channels);
+    if (levelCount == 0)
+        return tex;
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    GLenum wrapMode = (setting == TEXTURE_REPEAT) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+    GLenum internalFormat = BlockInternalFormat(format);
+    for (int level = 0; level < levelCount; level++)
+    {
+        GLsizei w = (width >> level) > 0 ? (width >> level) : 1;
+        GLsizei h = (height >> level) > 0 ? (height >> level) : 1;
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, w, h, 0, (GLsizei)levelSizes[level], levels[level]);
+        free(levels[level]);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    tex.id = textureID;
+    tex.width = width;
+    tex.height = height;
+    tex.channels = BlockChannels(format);
+    tex.setting = setting;
+
+    return tex;
+}
+
+static void WriteU32LE(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static void WriteU64LE(unsigned char *p, unsigned long long v)
+{
+    WriteU32LE(p, (unsigned int)v);
+    WriteU32LE(p + 4, (unsigned int)(v >> 32));
+}
+
+/*
+    offline baking : compresses an image with its mip chain into a KTX2 file for LoadTextureKTX2().
+    rows are stored bottom-up like LoadTexture uploads them (KTXorientation "ru").
+*/
+bool BakeTextureKTX2(const char *imagePath, const char *ktx2Path, BlockFormatS format, int threadCount)
+{
+    /* vkFormat, KHR_DF_MODEL_BC*, and the DFD samples : {bitOffset, channelId} */
+    static const struct
+    {
+        unsigned int vkFormat;
+        unsigned int colorModel;
+        int sampleCount;
+        unsigned int samples[2][2];
+    } layouts[] = {
+        {131, 128, 1, {{0, 0}}},           /* BC1 : colour */
+        {137, 130, 2, {{0, 15}, {64, 0}}}, /* BC3 : alpha, colour */
+        {139, 131, 1, {{0, 0}}},           /* BC4 : red */
+        {141, 132, 2, {{0, 0}, {64, 1}}},  /* BC5 : red, green */
+        {145, 134, 1, {{0, 0}}},           /* BC7 : colour */
+    };
+    static const unsigned char identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+    static const char orientation[] = "KTXorientation\0ru";
+
+    if (threadCount < 1)
+        threadCount = CpuCount();
+    unsigned char *levels[32];
+    size_t levelSizes[32];
+    int width, height, channels;
+    int levelCount = EncodeMipChain(imagePath, format, threadCount, levels, levelSizes, &width, &height, &channels);
+    if (levelCount == 0)
+        return false;
+
+    int blockBytes = BlockBytes(format);
+    size_t dfdOffset = 80 + (size_t)levelCount * 24;
+    size_t dfdSize = 4 + 24 + 16 * layouts[format].sampleCount;
+    size_t kvdOffset = dfdOffset + dfdSize;
+    /* one key/value entry, padded to 4 bytes as the KTX2 spec requires (the padding is zero, header is calloc'd) */
+    size_t kvdSize = (4 + sizeof(orientation) + 3) & ~(size_t)3;
+    size_t dataOffset = (kvdOffset + kvdSize + 15) & ~(size_t)15;
+
+    size_t headerSize = dataOffset;
+    unsigned char *header = (unsigned char *)calloc(1, headerSize);
+    if (!header)
+    {
+        for (int i = 0; i < levelCount; i++)
+            free(levels[i]);
+        return false;
+    }
+
+    memcpy(header, identifier, sizeof(identifier));
+    WriteU32LE(header + 12, layouts[format].vkFormat);
+    WriteU32LE(header + 16, 1); /* typeSize */
+    WriteU32LE(header + 20, (unsigned int)width);
+    WriteU32LE(header + 24, (unsigned int)height);
+    WriteU32LE(header + 36, 1); /* faceCount */
+    WriteU32LE(header + 40, (unsigned int)levelCount);
+    WriteU32LE(header + 48, (unsigned int)dfdOffset);
+    WriteU32LE(header + 52, (unsigned int)dfdSize);
+    WriteU32LE(header + 56, (unsigned int)kvdOffset);
+    WriteU32LE(header + 60, (unsigned int)kvdSize);
+
+    /* smallest level first in the file, every level aligned to the block size */
+    size_t offset = dataOffset;
+    for (int level = levelCount - 1; level >= 0; level--)
+    {
+        unsigned char *entry = header + 80 + level * 24;
+        WriteU64LE(entry, offset);
+        WriteU64LE(entry + 8, levelSizes[level]);
+        WriteU64LE(entry + 16, levelSizes[level]);
+        offset += (levelSizes[level] + blockBytes - 1) / blockBytes * blockBytes;
+    }
+
+    unsigned char *dfd = header + dfdOffset;
+    WriteU32LE(dfd, (unsigned int)dfdSize);
+    WriteU32LE(dfd + 8, 2 | (unsigned int)(24 + 16 * layouts[format].sampleCount) << 16);
+    WriteU32LE(dfd + 12, layouts[format].colorModel | 1u << 8 | 1u << 16); /* BT.709 primaries, linear */
+    WriteU32LE(dfd + 16, 3 | 3u << 8);                                    /* 4x4 texel blocks */
+    WriteU32LE(dfd + 20, (unsigned int)blockBytes);
+    for (int i = 0; i < layouts[format].sampleCount; i++)
+    {
+        unsigned char *sample = dfd + 28 + 16 * i;
+        WriteU32LE(sample, layouts[format].samples[i][0] | (unsigned int)(blockBytes * 8 / layouts[format].sampleCount - 1) << 16 | layouts[format].samples[i][1] << 24);
+        WriteU32LE(sample + 12, 0xFFFFFFFFu);
+    }
+
+    unsigned char *kvd = header + kvdOffset;
+    WriteU32LE(kvd, sizeof(orientation));
+    memcpy(kvd + 4, orientation, sizeof(orientation));
+
+    bool ok = false;
+    FILE *file = fopen(ktx2Path, "wb");
+    if (file)
+    {
+        static const unsigned char padding[16] = {0};
+        ok = fwrite(header, 1, headerSize, file) == headerSize;
+        for (int level = levelCount - 1; level >= 0 && ok; level--)
+        {
+            size_t pad = (blockBytes - levelSizes[level] % blockBytes) % blockBytes;
+            ok = fwrite(levels[level], 1, levelSizes[level], file) == levelSizes[level] && fwrite(padding, 1, pad, file) == pad;
+        }
+        ok = (fclose(file) == 0) && ok;
+    }
+    if (!ok)
+        fprintf(stderr, "Failed to write KTX2 file: %s\n", ktx2Path);
+
+    free(header);
+    for (int i = 0; i < levelCount; i++)
+        free(levels[i]);
+    return ok;
+}
+
+/*
+    async texture loading :
+    LoadTextureAsync() hands back a texture right away, holding a 1x1 white placeholder.
+    worker threads decode the image with stb, and PumpTextureUploads() (called once per frame
+    on the GL thread) uploads finished images into the same texture id, so the handle stays valid.
+    uploads stop for the frame once uploadBudgetBytes have been sent (0 means no budget).
+*/
+typedef enum
+{
+    TEXTURE_JOB_PENDING,
+    TEXTURE_JOB_DECODING,
+    TEXTURE_JOB_DECODED
+} TextureJobStateS;
+
+typedef struct TextureJobS
+{
+    char *path;
+    TextureSettingS setting;
+    int priority;
+    GLuint id;
+    unsigned char *data;
+    int width;
+    int height;
+    int channels;
+    TextureJobStateS state;
+    bool cancelled;                 /* its texture was freed while a worker had it */
+    struct TextureJobS *next;       /* link in the pending or decoded queue */
+    struct TextureJobS *nextJob;    /* link in the list of every job not yet uploaded */
+} TextureJobS;
+
+typedef struct
+{
+    pthread_t *workers;
+    int workerCount;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool running;
+    TextureJobS *pending;   /* waiting for a worker, highest priority first */
+    TextureJobS *decoded;   /* waiting for the GL thread, in completion order */
+    TextureJobS *decodedTail;
+    TextureJobS *jobs;      /* every job until PumpTextureUploads() is done with it */
+    size_t uploadBudget;
+} TextureLoaderS;
+
+static TextureLoaderS textureLoader;
+
+static void FreeTextureJob(TextureJobS *job)
+{
+    if (job->data)
+        stbi_image_free(job->data);
+    free(job->path);
+    free(job);
+}
+
+/* lock held */
+static void UnlinkTextureJob(TextureJobS *job)
+{
+    for (TextureJobS **slot = &textureLoader.jobs; *slot; slot = &(*slot)->nextJob)
+    {
+        if (*slot == job)
+        {
+            *slot = job->nextJob;
+            return;
+        }
+    }
+}
+
+/* the texture of an unfinished job is being deleted. glGenTextures hands the id straight back out, so the
+   job must never upload into it : queued jobs go away now, one a worker is decoding is dropped by the pump */
+static void CancelTextureJob(GLuint id)
+{
+    if (!textureLoader.workers)
+        return;
+
+    TextureJobS *job = NULL;
+    pthread_mutex_lock(&textureLoader.lock);
+    for (TextureJobS *candidate = textureLoader.jobs; candidate; candidate = candidate->nextJob)
+    {
+        if (candidate->id == id && !candidate->cancelled)
+        {
+            job = candidate;
+            break;
+        }
+    }
+    if (job && job->state == TEXTURE_JOB_DECODING)
+    {
+        job->cancelled = true;
+        job = NULL;
+    }
+    else if (job)
+    {
+        TextureJobS **queue = job->state == TEXTURE_JOB_PENDING ? &textureLoader.pending : &textureLoader.decoded;
+        TextureJobS *previous = NULL;
+        for (TextureJobS **slot = queue; *slot; previous = *slot, slot = &(*slot)->next)
+        {
+            if (*slot == job)
+            {
+                *slot = job->next;
+                if (textureLoader.decodedTail == job)
+                    textureLoader.decodedTail = previous;
+                break;
+            }
+        }
+        UnlinkTextureJob(job);
+    }
+    pthread_mutex_unlock(&textureLoader.lock);
+
+    if (job)
+        FreeTextureJob(job);
+}
+
+static void *TextureLoaderWorker(void *arg)
+{
+    (void)arg;
+    stbi_set_flip_vertically_on_load_thread(1);
+    /* the workers already decode side by side, each jpeg gets one thread */
+    stbi_set_jpeg_thread_count_thread(1);
+
+    pthread_mutex_lock(&textureLoader.lock);
+    for (;;)
+    {
+        while (textureLoader.running && !textureLoader.pending)
+            pthread_cond_wait(&textureLoader.wake, &textureLoader.lock);
+        if (!textureLoader.running)
+            break;
+
+        TextureJobS *job = textureLoader.pending;
+        textureLoader.pending = job->next;
+        job->next = NULL;
+        job->state = TEXTURE_JOB_DECODING;
+        pthread_mutex_unlock(&textureLoader.lock);
+
+        job->data = LoadImageMapped(job->path, &job->width, &job->height, &job->channels, 0, 0);
+
+        pthread_mutex_lock(&textureLoader.lock);
+        job->state = TEXTURE_JOB_DECODED;
+        if (textureLoader.decodedTail)
+            textureLoader.decodedTail->next = job;
+        else
+            textureLoader.decoded = job;
+        textureLoader.decodedTail = job;
+    }
+    pthread_mutex_unlock(&textureLoader.lock);
+
+    return NULL;
+}
+
+bool InitTextureLoader(int workerCount, size_t uploadBudgetBytes)
+{
+    if (textureLoader.running)
+    {
+        textureLoader.uploadBudget = uploadBudgetBytes;
+        return true;
+    }
+    if (workerCount < 1)
+        workerCount = 1;
+
+    textureLoader.workers = (pthread_t *)calloc(workerCount, sizeof(pthread_t));
+    if (!textureLoader.workers)
+    {
+        fprintf(stderr, "Memory allocation failed while starting the texture loader\n");
+        return false;
+    }
+    pthread_mutex_init(&textureLoader.lock, NULL);
+    pthread_cond_init(&textureLoader.wake, NULL);
+    textureLoader.running = true;
+    textureLoader.uploadBudget = uploadBudgetBytes;
+
+    textureLoader.workerCount = 0;
+    for (int i = 0; i < workerCount; i++)
+    {
+        if (pthread_create(&textureLoader.workers[i], NULL, TextureLoaderWorker, NULL) != 0)
+        {
+            fprintf(stderr, "Failed to start texture loader thread %d\n", i);
+            break;
+        }
+        textureLoader.workerCount++;
+    }
+    if (textureLoader.workerCount == 0)
+    {
+        ShutdownTextureLoader();
+        return false;
+    }
+    return true;
+}
+
+void ShutdownTextureLoader()
+{
+    if (!textureLoader.workers)
+        return;
+
+    pthread_mutex_lock(&textureLoader.lock);
+    textureLoader.running = false;
+    pthread_cond_broadcast(&textureLoader.wake);
+    pthread_mutex_unlock(&textureLoader.lock);
+
+    for (int i = 0; i < textureLoader.workerCount; i++)
+        pthread_join(textureLoader.workers[i], NULL);
+
+    /* textures of unfinished jobs keep their placeholder */
+    while (textureLoader.jobs)
+    {
+        TextureJobS *next = textureLoader.jobs->nextJob;
+        FreeTextureJob(textureLoader.jobs);
+        textureLoader.jobs = next;
+    }
+
+    pthread_mutex_destroy(&textureLoader.lock);
+    pthread_cond_destroy(&textureLoader.wake);
+    free(textureLoader.workers);
+    memset(&textureLoader, 0, sizeof(textureLoader));
+}
+
+TextureS LoadTextureAsync(const char *path, TextureSettingS setting, int priority)
+{
+    if (!textureLoader.running && !InitTextureLoader(2, 0))
+    {
+        return LoadTexture(path, setting);
+    }
+
+    TextureS tex = {0};
+    char canonicalPath[CANONICAL_PATH_MAX];
+    unsigned int hash = 0;
+    if (AcquireCachedTexture(path, setting, TEXTURE_ORIGIN_BOTTOM_LEFT, 0, &tex, canonicalPath, &hash))
+        return tex;
+
+    TextureJobS *job = (TextureJobS *)calloc(1, sizeof(TextureJobS));
+    char *pathCopy = (char *)malloc(strlen(path) + 1);
+    if (!job || !pathCopy)
+    {
+        fprintf(stderr, "Memory allocation failed while queueing texture: %s\n", path);
+        free(job);
+        free(pathCopy);
+        return tex;
+    }
+    strcpy(pathCopy, path);
+
+    static const unsigned char placeholder[4] = {255, 255, 255, 255};
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    job->path = pathCopy;
+    job->setting = setting;
+    job->priority = priority;
+    job->id = textureID;
+    job->state = TEXTURE_JOB_PENDING;
+
+    pthread_mutex_lock(&textureLoader.lock);
+    job->nextJob = textureLoader.jobs;
+    textureLoader.jobs = job;
+    TextureJobS **slot = &textureLoader.pending;
+    while (*slot && (*slot)->priority >= priority)
+        slot = &(*slot)->next;
+    job->next = *slot;
+    *slot = job;
+    pthread_cond_signal(&textureLoader.wake);
+    pthread_mutex_unlock(&textureLoader.lock);
+
+    tex.id = textureID;
+    tex.width = 1;
+    tex.height = 1;
+    tex.channels = 4;
+    tex.setting = setting;
+    RegisterCachedTexture(canonicalPath, hash, 0, &tex);
+
+    return tex;
 }
 
-bool IsShaderCompiled(GLuint shader, const char *shaderName)
+int PumpTextureUploads()
 {
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    if (!textureLoader.workers)
+        return 0;
+
+    int uploaded = 0;
+    size_t uploadedBytes = 0;
+    for (;;)
     {
-        GLint logLength = 0;
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-        if (logLength > 0)
+        if (uploaded > 0 && textureLoader.uploadBudget != 0 && uploadedBytes >= textureLoader.uploadBudget)
+            break;
+
+        pthread_mutex_lock(&textureLoader.lock);
+        TextureJobS *job = textureLoader.decoded;
+        if (job)
         {
-            char *infoLog = (char *)malloc(logLength);
-            glGetShaderInfoLog(shader, logLength, NULL, infoLog);
-            fprintf(stderr, "ERROR: Shader compilation failed (%s):\n%s\n", shaderName, infoLog);
-            free(infoLog);
+            textureLoader.decoded = job->next;
+            if (!textureLoader.decoded)
+                textureLoader.decodedTail = NULL;
+        }
+        if (job && job->cancelled)
+            UnlinkTextureJob(job);
+        pthread_mutex_unlock(&textureLoader.lock);
+        if (!job)
+            break;
+        if (job->cancelled)
+        {
+            FreeTextureJob(job);
+            continue;
+        }
+
+        GLenum format = job->data ? TextureFormatFromChannels(job->channels) : 0;
+        if (!job->data)
+        {
+            fprintf(stderr, "Failed to load texture: %s\n", job->path);
+        }
+        else if (format == 0)
+        {
+            fprintf(stderr, "Unsupported number of channels (%d) in texture: %s\n", job->channels, job->path);
         }
         else
         {
-            fprintf(stderr, "ERROR: Shader compilation failed (%s): Unknown error (no log).\n", shaderName);
+            UploadTexturePixels(job->id, job->data, job->width, job->height, format, job->setting);
+            uploadedBytes += (size_t)job->width * job->height * job->channels;
+            uploaded++;
         }
-        return false;
+        if (!job->data || format == 0)
+        {
+            /* failed loads keep the placeholder */
+            job->width = 1;
+            job->height = 1;
+            job->channels = 4;
+        }
+        if (job->data)
+        {
+            stbi_image_free(job->data);
+            job->data = NULL;
+        }
+
+        /* later hits on the cache see the real size */
+        TextureCacheEntryS *entry = FindCachedTextureById(job->id);
+        if (entry)
+        {
+            entry->tex.width = job->width;
+            entry->tex.height = job->height;
+            entry->tex.channels = job->channels;
+        }
+
+        pthread_mutex_lock(&textureLoader.lock);
+        UnlinkTextureJob(job);
+        pthread_mutex_unlock(&textureLoader.lock);
+        FreeTextureJob(job);
     }
-    return true;
+    if (uploaded > 0)
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+    return uploaded;
 }
 
-bool IsProgramLinked(GLuint program)
+/* true once the texture holds its real image; also updates the size stored in tex */
+bool IsTextureReady(TextureS *tex)
 {
-    GLint success;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success)
+    if (!tex || tex->id == 0)
+        return false;
+    if (!textureLoader.workers)
+        return true;
+
+    bool ready = true;
+    pthread_mutex_lock(&textureLoader.lock);
+    for (TextureJobS *job = textureLoader.jobs; job; job = job->nextJob)
     {
-        GLint logLength = 0;
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-        if (logLength > 0)
+        if (job->id == tex->id && !job->cancelled)
         {
-            char *infoLog = (char *)malloc(logLength);
-            glGetProgramInfoLog(program, logLength, NULL, infoLog);
-            fprintf(stderr, "ERROR: Program linking failed:\n%s\n", infoLog);
-            free(infoLog);
+            ready = false;
+            break;
         }
-        else
+    }
+    pthread_mutex_unlock(&textureLoader.lock);
+
+    if (ready)
+    {
+        /* the pump left the real size in the cache entry */
+        TextureCacheEntryS *entry = FindCachedTextureById(tex->id);
+        if (entry)
         {
-            fprintf(stderr, "ERROR: Program linking failed: Unknown error (no log).\n");
+            tex->width = entry->tex.width;
+            tex->height = entry->tex.height;
+            tex->channels = entry->tex.channels;
         }
-        return false;
     }
-    return true;
+    return ready;
 }
 
-GLuint CreateVertexArrayObject()
+/*
+    animated textures :
+    GIF frames go into the layers of a GL_TEXTURE_2D_ARRAY used as a ring. a small pool of decoder threads,
+    shared by every animation, composes frames with stb's GIF stream into a matching ring of CPU slots, one
+    frame at a time per stream; UpdateAnimatedTexture() (GL thread, once per frame) uploads finished slots to
+    their layer and steps the current layer along the frame delays, handing each slot back to the decoders
+    once its frame has been shown. so only ringLayers frames are ever resident, however long the animation.
+    when the whole animation fits in the ring its decoding stops after the first pass and playback just
+    cycles the layers. the pool starts with the first animation and stops when the last one is freed.
+    sample in GLSL with :  uniform sampler2DArray u_Texture; uniform int u_Layer;
+                           texture(u_Texture, vec3(uv, u_Layer))
+*/
+#define ANIMATION_DEFAULT_LAYERS 8
+#define ANIMATION_DECODER_THREADS 2
+
+typedef enum
 {
-    GLuint vao;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    return vao;
-}
+    ANIMATION_SLOT_FREE,     /* a decoder may fill it */
+    ANIMATION_SLOT_DECODED,  /* waiting for the GL thread */
+    ANIMATION_SLOT_UPLOADED  /* its layer holds a frame that hasn't been shown yet, or is showing */
+} AnimationSlotStateS;
 
-GLuint CreateVertexBufferObject(const void *data, size_t size)
+typedef struct
 {
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
-    return vbo;
-}
-/*
-    index : attribute location : i.e layout(location=0).
-    size : number of components : i.e (3 for vec3).
-    type : Data type ( most common case : GL_FLOAT)
-    stride : size of each vertex in bytex ( sizeof(data) -> return nb bytes)
-    pointer: offset within the vertex struct ( raw data)
-*/
-void SetupVertexAttrib(GLuint index, GLint size, GLenum type, GLsizei stride, const void *pointer)
+    unsigned char *pixels;
+    int delay; /* milliseconds */
+    AnimationSlotStateS state;
+} AnimationSlotS;
+
+struct AnimationStreamS
 {
-    glVertexAttribPointer(index, size, type, GL_FALSE, stride, pointer);
-    glEnableVertexAttribArray(index);
+    MappedFileS file;
+    stbi_gif_stream *gif;
+    AnimationSlotS *slots;
+    int slotCount;
+    int width;
+    int height;
+    int writeSlot;     /* next slot the decoders fill */
+    int readSlot;      /* slot whose layer is showing */
+    int framesDecoded; /* on the first pass */
+    int frameCount;    /* 0 until the first pass is done */
+    bool firstPass;
+    bool resident;     /* every frame is in the ring */
+    bool done;         /* nothing left to decode (resident, failed or being freed) */
+    bool busy;         /* a decoder thread has it */
+    bool registered;   /* in animationDecoder.streams */
+    float elapsed;     /* milliseconds into the current frame */
+    struct AnimationStreamS *next;
+};
+
+typedef struct
+{
+    pthread_t workers[ANIMATION_DECODER_THREADS];
+    int workerCount;
+    pthread_mutex_t lock; /* guards the pool and the state of every registered stream */
+    pthread_cond_t wake;  /* a stream may have work */
+    pthread_cond_t idle;  /* a decoder put a stream down */
+    bool running;
+    struct AnimationStreamS *streams;
+    int streamCount;
+} AnimationDecoderS;
+
+static AnimationDecoderS animationDecoder;
+
+/* browsers show GIF delays under 20ms as 100ms, and files rely on it */
+static int AnimationFrameDelay(int delay)
+{
+    return delay < 20 ? 100 : delay;
 }
 
-/*
-    ill consider removing : glUseProgram() inside the functions of SetUniform.
-    but i still think it's safe and not cause any error for the momment.
-*/
-void SetUniform1i(GLuint program, const char *name, int value)
+/* copies a top-row-first frame into a slot bottom row first, to match LoadTexture */
+static void FillAnimationSlot(AnimationSlotS *slot, const unsigned char *frame, int width, int height, int delay)
 {
-    GLint location = glGetUniformLocation(program, name);
-    if (location == -1)
-    {
-        fprintf(stderr, "Uniform '%s' not found in program %u\n", name, program);
-        return;
-    }
-    glUseProgram(program);
-    glUniform1i(location, value);
+    size_t rowBytes = (size_t)width * 4;
+    for (int y = 0; y < height; y++)
+        memcpy(slot->pixels + (size_t)(height - 1 - y) * rowBytes, frame + (size_t)y * rowBytes, rowBytes);
+    slot->delay = AnimationFrameDelay(delay);
 }
 
-void SetUniform1f(GLuint program, const char *name, float value)
+/* a stream no decoder has, still decoding and with its next slot free. lock held */
+static struct AnimationStreamS *NextAnimationWork(void)
 {
-    GLint location = glGetUniformLocation(program, name);
-    if (location == -1)
+    for (struct AnimationStreamS *stream = animationDecoder.streams; stream; stream = stream->next)
     {
-        fprintf(stderr, "Uniform '%s' not found in program %u\n", name, program);
-        return;
+        if (!stream->busy && !stream->done && stream->slots[stream->writeSlot].state == ANIMATION_SLOT_FREE)
+            return stream;
     }
-    glUseProgram(program);
-    glUniform1f(location, value);
+    return NULL;
 }
 
-void SetUniform3f(GLuint program, const char *name, float x, float y, float z)
+static void *AnimationDecoderWorker(void *arg)
 {
-    GLint location = glGetUniformLocation(program, name);
-    if (location == -1)
+    (void)arg;
+    pthread_mutex_lock(&animationDecoder.lock);
+    for (;;)
     {
-        fprintf(stderr, "Uniform '%s' not found in program %u\n", name, program);
-        return;
+        struct AnimationStreamS *stream = NULL;
+        while (animationDecoder.running && !(stream = NextAnimationWork()))
+            pthread_cond_wait(&animationDecoder.wake, &animationDecoder.lock);
+        if (!animationDecoder.running)
+            break;
+        stream->busy = true;
+        AnimationSlotS *slot = &stream->slots[stream->writeSlot];
+        pthread_mutex_unlock(&animationDecoder.lock);
+
+        /* the gif stream, firstPass and framesDecoded only change while busy, so they're read unlocked */
+        unsigned char *frame;
+        int delay;
+        int passFrames = -1;
+        int r = stbi_gif_stream_next(stream->gif, &frame, &delay);
+        if (r == 0 && stream->firstPass)
+        {
+            passFrames = stream->framesDecoded;
+            stream->firstPass = false;
+        }
+        /* past the last frame : loop, unless the first pass just found that it all fits in the ring */
+        if (r == 0 && !(passFrames >= 0 && passFrames <= stream->slotCount))
+        {
+            stbi_gif_stream_rewind(stream->gif);
+            r = stbi_gif_stream_next(stream->gif, &frame, &delay);
+        }
+        if (r == 1)
+            FillAnimationSlot(slot, frame, stream->width, stream->height, delay);
+        else if (r < 0)
+            fprintf(stderr, "Failed to decode animation frame: %s\n", stbi_failure_reason());
+
+        pthread_mutex_lock(&animationDecoder.lock);
+        if (passFrames >= 0)
+        {
+            stream->frameCount = passFrames;
+            stream->resident = passFrames <= stream->slotCount;
+        }
+        if (r == 1)
+        {
+            slot->state = ANIMATION_SLOT_DECODED;
+            stream->writeSlot = (stream->writeSlot + 1) % stream->slotCount;
+            if (stream->firstPass)
+                stream->framesDecoded++;
+        }
+        else
+        {
+            stream->done = true;
+        }
+        stream->busy = false;
+        pthread_cond_broadcast(&animationDecoder.idle);
     }
-    glUseProgram(program);
-    glUniform3f(location, x, y, z);
+    pthread_mutex_unlock(&animationDecoder.lock);
+
+    return NULL;
 }
 
-void SetUniform4f(GLuint program, const char *name, float x, float y, float z, float w)
+static bool StartAnimationDecoder(void)
 {
-    GLint location = glGetUniformLocation(program, name);
-    if (location == -1)
+    pthread_mutex_init(&animationDecoder.lock, NULL);
+    pthread_cond_init(&animationDecoder.wake, NULL);
+    pthread_cond_init(&animationDecoder.idle, NULL);
+    animationDecoder.running = true;
+
+    animationDecoder.workerCount = 0;
+    for (int i = 0; i < ANIMATION_DECODER_THREADS; i++)
     {
-        fprintf(stderr, "Uniform '%s' not found in program %u\n", name, program);
-        return;
+        if (pthread_create(&animationDecoder.workers[i], NULL, AnimationDecoderWorker, NULL) != 0)
+        {
+            fprintf(stderr, "Failed to start animation decoder thread %d\n", i);
+            break;
+        }
+        animationDecoder.workerCount++;
     }
-    glUseProgram(program);
-    glUniform4f(location, x, y, z, w);
+    if (animationDecoder.workerCount == 0)
+    {
+        pthread_mutex_destroy(&animationDecoder.lock);
+        pthread_cond_destroy(&animationDecoder.wake);
+        pthread_cond_destroy(&animationDecoder.idle);
+        memset(&animationDecoder, 0, sizeof(animationDecoder));
+        return false;
+    }
+    return true;
 }
 
-void SetUniformMat4(GLuint program, const char *name, const float *matrix)
+static void StopAnimationDecoder(void)
 {
-    GLint location = glGetUniformLocation(program, name);
-    if (location == -1)
-    {
-        fprintf(stderr, "Uniform '%s' not found in program %u\n", name, program);
-        return;
-    }
-    glUseProgram(program);
-    glUniformMatrix4fv(location, 1, GL_FALSE, matrix);
+    pthread_mutex_lock(&animationDecoder.lock);
+    animationDecoder.running = false;
+    pthread_cond_broadcast(&animationDecoder.wake);
+    pthread_mutex_unlock(&animationDecoder.lock);
+
+    for (int i = 0; i < animationDecoder.workerCount; i++)
+        pthread_join(animationDecoder.workers[i], NULL);
+
+    pthread_mutex_destroy(&animationDecoder.lock);
+    pthread_cond_destroy(&animationDecoder.wake);
+    pthread_cond_destroy(&animationDecoder.idle);
+    memset(&animationDecoder, 0, sizeof(animationDecoder));
 }
 
-TextureS LoadTexture(const char *path, TextureSettingS setting)
+AnimatedTextureS LoadAnimatedTexture(const char *path, TextureSettingS setting, int ringLayers)
 {
-    TextureS tex = {0};
+    AnimatedTextureS tex = {0};
+    if (ringLayers < 1)
+        ringLayers = ANIMATION_DEFAULT_LAYERS;
+    /* the showing layer is only handed back once the next one is ready, so one layer would never advance */
+    if (ringLayers < 2)
+        ringLayers = 2;
 
-    stbi_set_flip_vertically_on_load(1);
-    int width, height, channels;
-    unsigned char *data = stbi_load(path, &width, &height, &channels, 0);
-    if (!data)
+    struct AnimationStreamS *stream = (struct AnimationStreamS *)calloc(1, sizeof(struct AnimationStreamS));
+    if (!stream)
     {
-        fprintf(stderr, "Failed to load texture: %s\n", path);
+        fprintf(stderr, "Memory allocation failed while loading animation: %s\n", path);
+        return tex;
+    }
+    if (!MapFile(path, &stream->file) || stream->file.size > INT_MAX)
+    {
+        UnmapFile(&stream->file);
+        free(stream);
+        fprintf(stderr, "Failed to load animation: %s\n", path);
+        return tex;
+    }
+    int width = 0, height = 0;
+    stream->gif = stbi_gif_stream_open_from_memory(stream->file.data, (int)stream->file.size, &width, &height);
+    if (!stream->gif)
+    {
+        fprintf(stderr, "Failed to load animation: %s (%s)\n", path, stbi_failure_reason());
+        UnmapFile(&stream->file);
+        free(stream);
         return tex;
     }
+    stream->slots = (AnimationSlotS *)calloc(ringLayers, sizeof(AnimationSlotS));
+    bool ok = stream->slots != NULL;
+    for (int i = 0; ok && i < ringLayers; i++)
+    {
+        stream->slots[i].pixels = (unsigned char *)malloc((size_t)width * height * 4);
+        ok = stream->slots[i].pixels != NULL;
+    }
+    stream->slotCount = ringLayers;
+    stream->width = width;
+    stream->height = height;
+    tex.stream = stream;
+    tex.width = width;
+    tex.height = height;
+    tex.layerCount = ringLayers;
+    tex.setting = setting;
 
-    GLenum format;
-    if (channels == 1)
-        format = GL_RED;
-    else if (channels == 3)
-        format = GL_RGB;
-    else if (channels == 4)
-        format = GL_RGBA;
+    /* the first frame is decoded here, so the texture is complete as soon as it's returned */
+    unsigned char *frame;
+    int delay;
+    if (!ok || stbi_gif_stream_next(stream->gif, &frame, &delay) != 1)
+    {
+        fprintf(stderr, "Failed to load animation: %s (%s)\n", path, stbi_failure_reason());
+        FreeAnimatedTexture(&tex);
+        return tex;
+    }
+    FillAnimationSlot(&stream->slots[0], frame, width, height, delay);
+    stream->slots[0].state = ANIMATION_SLOT_UPLOADED;
+    stream->writeSlot = 1;
+    stream->framesDecoded = 1;
+    stream->firstPass = true;
+
+    glGenTextures(1, &tex.id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, tex.id);
+    GLenum wrapMode = (setting == TEXTURE_REPEAT) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage)
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, width, height, ringLayers);
     else
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, ringLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, stream->slots[0].pixels);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    /* the pool only exists while animations do, so it's started and stopped from the GL thread */
+    if (animationDecoder.streamCount == 0 && !StartAnimationDecoder())
     {
-        fprintf(stderr, "Unsupported number of channels (%d) in texture: %s\n", channels, path);
-        stbi_image_free(data);
+        fprintf(stderr, "Failed to start the decoder threads for animation: %s\n", path);
         return tex;
     }
+    pthread_mutex_lock(&animationDecoder.lock);
+    stream->next = animationDecoder.streams;
+    animationDecoder.streams = stream;
+    animationDecoder.streamCount++;
+    stream->registered = true;
+    pthread_cond_signal(&animationDecoder.wake);
+    pthread_mutex_unlock(&animationDecoder.lock);
+    return tex;
+}
 
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+/* GL thread, once per frame. true when tex->layer moved on */
+bool UpdateAnimatedTexture(AnimatedTextureS *tex, float deltaTime)
+{
+    if (!tex || !tex->stream || !tex->stream->registered)
+        return false;
+    struct AnimationStreamS *stream = tex->stream;
 
-    // Wrapping
-    GLenum wrapMode = (setting == TEXTURE_REPEAT) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+    pthread_mutex_lock(&animationDecoder.lock);
+    bool resident = stream->resident;
+    tex->frameCount = stream->frameCount;
+    pthread_mutex_unlock(&animationDecoder.lock);
 
-    // Filtering
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    bool bound = false;
+    for (int i = 0; i < stream->slotCount; i++)
+    {
+        pthread_mutex_lock(&animationDecoder.lock);
+        bool decoded = stream->slots[i].state == ANIMATION_SLOT_DECODED;
+        pthread_mutex_unlock(&animationDecoder.lock);
+        if (!decoded)
+            continue;
+        if (!bound)
+        {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, tex->id);
+            bound = true;
+        }
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, tex->width, tex->height, 1, GL_RGBA, GL_UNSIGNED_BYTE, stream->slots[i].pixels);
+        pthread_mutex_lock(&animationDecoder.lock);
+        stream->slots[i].state = ANIMATION_SLOT_UPLOADED;
+        pthread_mutex_unlock(&animationDecoder.lock);
+    }
+    if (bound)
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
-    // Upload data
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    if (resident && stream->frameCount == 1)
+        return false;
 
-    stbi_image_free(data);
+    bool changed = false;
+    stream->elapsed += deltaTime * 1000.0f;
+    for (;;)
+    {
+        int current = stream->readSlot;
+        float delay = (float)stream->slots[current].delay;
+        if (stream->elapsed < delay)
+            break;
 
-    tex.id = textureID;
-    tex.width = width;
-    tex.height = height;
-    tex.channels = channels;
-    tex.setting = setting;
+        int next = (current + 1) % (resident ? stream->frameCount : stream->slotCount);
+        if (!resident)
+        {
+            pthread_mutex_lock(&animationDecoder.lock);
+            bool ready = stream->slots[next].state == ANIMATION_SLOT_UPLOADED;
+            if (ready)
+            {
+                /* shown : the decoders can have the slot back */
+                stream->slots[current].state = ANIMATION_SLOT_FREE;
+                pthread_cond_signal(&animationDecoder.wake);
+            }
+            pthread_mutex_unlock(&animationDecoder.lock);
+            if (!ready)
+            {
+                /* the decoder is behind : hold this frame rather than skip ahead later */
+                stream->elapsed = delay;
+                break;
+            }
+        }
+        stream->elapsed -= delay;
+        stream->readSlot = next;
+        changed = true;
+    }
+    tex->layer = stream->readSlot;
+    return changed;
+}
 
-    return tex;
+/* binds the array to unit 0 and sets u_Layer, if the shader has it */
+void BindAnimatedTexture(AnimatedTextureS *tex, GLuint shaderProgram)
+{
+    if (!tex || tex->id == 0)
+    {
+        fprintf(stderr, "Attempted to bind an invalid or uninitialized animated texture.\n");
+        return;
+    }
+    BindProgram(shaderProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, tex->id);
+    GLint layerLocation = GetUniformLocationCached(shaderProgram, "u_Layer");
+    if (layerLocation != -1)
+    {
+        glUniform1i(layerLocation, tex->layer);
+    }
+}
+
+void FreeAnimatedTexture(AnimatedTextureS *tex)
+{
+    if (!tex)
+        return;
+    struct AnimationStreamS *stream = tex->stream;
+    if (stream)
+    {
+        if (stream->registered)
+        {
+            pthread_mutex_lock(&animationDecoder.lock);
+            stream->done = true;
+            while (stream->busy)
+                pthread_cond_wait(&animationDecoder.idle, &animationDecoder.lock);
+            for (struct AnimationStreamS **slot = &animationDecoder.streams; *slot; slot = &(*slot)->next)
+            {
+                if (*slot == stream)
+                {
+                    *slot = stream->next;
+                    break;
+                }
+            }
+            bool last = --animationDecoder.streamCount == 0;
+            pthread_mutex_unlock(&animationDecoder.lock);
+            if (last)
+                StopAnimationDecoder();
+        }
+
+        for (int i = 0; stream->slots && i < stream->slotCount; i++)
+            free(stream->slots[i].pixels);
+        free(stream->slots);
+        stbi_gif_stream_close(stream->gif);
+        UnmapFile(&stream->file);
+        free(stream);
+    }
+    if (tex->id != 0)
+        glDeleteTextures(1, &tex->id);
+    memset(tex, 0, sizeof(*tex));
 }
 
 /* make sure to call this :  glfwSetFramebufferSizeCallback(window, FramebufferSizeCallback);  */
@@ -381,10 +4787,21 @@ void SizeCallbackViewCam(GLFWwindow *window, int width, int height)
     }
 }
 
+/* cached textures are only deleted when their last reference is freed */
 void FreeTextureS(TextureS *tex)
 {
     if (tex && tex->id != 0)
     {
+        TextureCacheEntryS *entry = FindCachedTextureById(tex->id);
+        if (entry && --entry->refs > 0)
+        {
+            tex->id = 0;
+            return;
+        }
+        if (entry)
+            RemoveCachedTexture(entry);
+
+        CancelTextureJob(tex->id);
         glDeleteTextures(1, &tex->id);
         tex->id = 0;
     }
@@ -433,11 +4850,11 @@ void BindMeshS(MeshS *mesh, GLuint shaderProgram)
     {
         return;
     }
-    glUseProgram(shaderProgram);
+    BindProgram(shaderProgram);
     glBindVertexArray(mesh->vao);
     glActiveTexture(GL_TEXTURE0);
     BindTextureS(&mesh->texture);
-    GLint mvpLocation = glGetUniformLocation(shaderProgram, "u_MVP");
+    GLint mvpLocation = GetUniformLocationCached(shaderProgram, "u_MVP");
     if (mvpLocation != -1)
     {
         glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, (const GLfloat *)mesh->mvp);
@@ -446,6 +4863,12 @@ void BindMeshS(MeshS *mesh, GLuint shaderProgram)
     {
         fprintf(stderr, "Warning: uniform 'u_MVP' not found in shader program %u\n", shaderProgram);
     }
+    /* optional : textures kept in file order are sampled with uv.y = 1.0 - uv.y */
+    GLint flipLocation = GetUniformLocationCached(shaderProgram, "u_FlipV");
+    if (flipLocation != -1)
+    {
+        glUniform1i(flipLocation, mesh->texture.origin == TEXTURE_ORIGIN_TOP_LEFT);
+    }
 }
 
 void DrawMeshS(MeshS *mesh)
@@ -649,6 +5072,29 @@ TextureS LoadEmptyTexture(int width, int height)
     return tex;
 }
 
+/* same as LoadEmptyTexture, with immutable GL_RGBA8 storage */
+TextureS LoadEmptyTextureImmutable(int width, int height)
+{
+    TextureS tex = {0};
+    tex.width = width;
+    tex.height = height;
+    tex.channels = 4;
+
+    glGenTextures(1, &tex.id);
+    glBindTexture(GL_TEXTURE_2D, tex.id);
+
+    AllocateTextureStorage(1, GL_RGBA8, width, height, GL_RGBA, GL_UNSIGNED_BYTE);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return tex;
+}
+
 bool CreateFrameBuffer(FrameBufferS *fb, int width, int height)
 {
     fb->width = width;
@@ -697,7 +5143,7 @@ void FreeFrameBuffer(FrameBufferS *fb)
 }
 void DrawFrameBufferTexture(FrameBufferS *fb, GLuint shaderProgram, GLuint quadVAO)
 {
-    glUseProgram(shaderProgram);
+    BindProgram(shaderProgram);
     mat4 ortho;
     glm_ortho(0.0f, (float)fb->width, 0.0f, (float)fb->height, -1.0f, 1.0f, ortho);
     mat4 model;
@@ -705,7 +5151,7 @@ void DrawFrameBufferTexture(FrameBufferS *fb, GLuint shaderProgram, GLuint quadV
     glm_scale(model, (vec3){(float)fb->width, (float)fb->height, 1.0f});
     mat4 mvp;
     glm_mat4_mul(ortho, model, mvp);
-    GLint mvpLoc = glGetUniformLocation(shaderProgram, "u_MVP");
+    GLint mvpLoc = GetUniformLocationCached(shaderProgram, "u_MVP");
     glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, (const GLfloat *)mvp);
     BindTextureS(&fb->texture);
     glBindVertexArray(quadVAO);
@@ -714,7 +5160,7 @@ void DrawFrameBufferTexture(FrameBufferS *fb, GLuint shaderProgram, GLuint quadV
 
     UnbindTextureS();
 
-    glUseProgram(0);
+    BindProgram(0);
 }
 void UpdateCameraProjection(CCameraS *cam, float fovDeg, float aspect, float nearZ, float farZ)
 {
@@ -7,6 +7,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
 #include "stb_img.h"
 #include "cglm/cglm.h"
 #include <math.h>
@@ -18,12 +20,39 @@ typedef enum
     TEXTURE_REPEAT
 } TextureSettingS;
 
+/* where the first row of an image file ends up. stb's vertical flip gives GL's bottom-left convention but
+   costs a full pass over the pixels; TOP_LEFT keeps file order and the texture is sampled with v flipped
+   (BindMeshS sets u_FlipV for shaders that declare it) */
+typedef enum
+{
+    TEXTURE_ORIGIN_BOTTOM_LEFT,
+    TEXTURE_ORIGIN_TOP_LEFT
+} TextureOriginS;
+
+typedef struct
+{
+    TextureSettingS setting;
+    TextureOriginS origin;
+    /* JPEGs wider or taller than this are decoded at 1/2, 1/4 or 1/8 size (the first that fits, 1/8 at most)
+       by stb's scaled IDCT, saving decode time and VRAM; 0 = no limit. other formats load at full size */
+    int maxDimension;
+} TextureLoadOptionsS;
+
 typedef enum
 {
     FILTER_LINEAR,
     FILTER_NEAREST
 } TextureFilterS;
 
+typedef enum
+{
+    BLOCK_BC1, /* RGB, 4 bpp */
+    BLOCK_BC3, /* RGBA, 8 bpp */
+    BLOCK_BC4, /* R, 4 bpp */
+    BLOCK_BC5, /* RG, 8 bpp */
+    BLOCK_BC7  /* RGBA, 8 bpp */
+} BlockFormatS;
+
 typedef struct
 {
     GLuint id;
@@ -31,8 +60,109 @@ typedef struct
     int height;
     size_t channels;
     TextureSettingS setting;
+    TextureOriginS origin;
 
 } TextureS;
+
+/* a GIF playing from a ring of GL_TEXTURE_2D_ARRAY layers; draw layer 'layer' (see LoadAnimatedTexture) */
+typedef struct
+{
+    GLuint id;
+    int width;
+    int height;
+    int layerCount; /* layers in the ring */
+    int layer;      /* layer holding the frame to show */
+    int frameCount; /* frames in the file, 0 until the decoder has been through it once */
+    TextureSettingS setting;
+    struct AnimationStreamS *stream;
+} AnimatedTextureS;
+
+/* one GL_TEXTURE_2D of a TiledTextureS; x, y is its top-left pixel in the image (rows counted from the top) */
+typedef struct
+{
+    GLuint id;
+    int x;
+    int y;
+    int width;
+    int height;
+} TextureTileS;
+
+/* an image split into tiles of at most tileSize x tileSize, for images past GL_MAX_TEXTURE_SIZE (see LoadTiledTexture) */
+typedef struct
+{
+    TextureTileS *tiles; /* row-major, from the top-left */
+    int tileCount;
+    int columns;
+    int rows;
+    int tileSize;
+    int width;
+    int height;
+    size_t channels;
+} TiledTextureS;
+
+/* a JPEG as its Y, Cb and Cr planes, one GL_R8 texture each at the plane's own resolution (see LoadTextureYCbCr) */
+typedef struct
+{
+    GLuint planes[3]; /* Y, Cb, Cr */
+    int width;
+    int height;
+    float chromaScale[2]; /* Cb/Cr texcoord = image texcoord * chromaScale */
+    TextureSettingS setting;
+    TextureOriginS origin;
+} YCbCrTextureS;
+
+typedef enum
+{
+    SHADER_BUILD_PENDING,
+    SHADER_BUILD_READY,
+    SHADER_BUILD_FAILED
+} ShaderBuildStateS;
+
+/* one program of a SubmitShaderBatch batch. the sources must stay valid while it's pending; program is
+   usable once state is SHADER_BUILD_READY */
+typedef struct
+{
+    const char *vertexSource;
+    const char *fragmentSource;
+    GLuint program;
+    ShaderBuildStateS state;
+    GLuint vertexShader; /* in flight */
+    GLuint fragmentShader;
+} ShaderBuildS;
+
+/* counters of the per-process shader variant cache behind CreateShaderVariant */
+typedef struct
+{
+    size_t hits;     /* variants handed back without compiling */
+    size_t compiles; /* variants built (failed ones included) */
+    size_t variants; /* variants in the cache */
+} ShaderVariantStatsS;
+
+/* counters of the on-disk program binary cache behind CreateShaderStr */
+typedef struct
+{
+    size_t hits;     /* programs loaded from a binary */
+    size_t misses;   /* no binary on disk yet */
+    size_t rejected; /* binaries that didn't match or that the driver refused; compiled instead */
+    size_t written;  /* binaries saved */
+} ProgramCacheStatsS;
+
+/* counters of the per-program uniform location cache behind SetUniform* and BindMeshS, and of UseProgram */
+typedef struct
+{
+    size_t callsAvoided;  /* lookups answered from the cache instead of glGetUniformLocation */
+    size_t driverQueries; /* glGetUniformLocation calls made filling it (or for unlinked programs) */
+    size_t programs;      /* programs with a table */
+    size_t bindsAvoided;  /* UseProgram calls skipped because the program was bound already */
+} UniformCacheStatsS;
+
+/* counters of the path-keyed texture cache behind LoadTexture */
+typedef struct
+{
+    size_t hits;
+    size_t misses;
+    size_t bytesSaved; /* texture memory not allocated thanks to hits */
+} TextureCacheStatsS;
 typedef struct
 {
     mat4 view;
@@ -121,11 +251,82 @@ void InitGLFW();
 void DestroyWindow(GLFWwindow *window);
 GLuint CreateShaderStr(const char *vertexShSouce, const char *fragmentShSource);
 GLuint CreateShaderFiles(const char *vertexShPath, const char *fragmentShPath);
+/* CreateShaderStr/CreateShaderFiles keep linked program binaries in dir (created if missing) and reuse them
+   on later runs with the same sources and driver; NULL turns it off */
+bool SetProgramCacheDir(const char *dir);
+/* compiles and links a whole batch before checking any of it; PollShaderBatch finishes the programs the
+   driver is done with and returns how many are still pending (never waits with KHR_parallel_shader_compile
+   unless wait is set, always finishes everything without it) */
+void SubmitShaderBatch(ShaderBuildS *builds, int count);
+int PollShaderBatch(ShaderBuildS *builds, int count, bool wait);
+ProgramCacheStatsS GetProgramCacheStats();
 GLuint CreateVertexArrayObject();
 GLuint CreateVertexBufferObject(const void *data, size_t size);
 bool IsShaderCompiled(GLuint shader, const char *shaderName);
 bool IsProgramLinked(GLuint program);
 TextureS LoadTexture(const char *path, TextureSettingS setting);
+TextureS LoadTextureEx(const char *path, TextureLoadOptionsS options);
+TextureS LoadTextureImmutable(const char *path, TextureSettingS setting, bool srgb);
+/* Radiance .hdr as a GL_RGB16F texture, converted from RGBE to half floats on the CPU */
+TextureS LoadTextureHDR(const char *path, TextureSettingS setting);
+/* 16-bit files as GL_R16/GL_RG16/GL_RGBA16 (8-bit files fall back to LoadTextureImmutable), grey + alpha
+   sampling as RGBA like the 8-bit path; extraBytes receives the VRAM cost over the 8-bit texture */
+TextureS LoadTexture16(const char *path, TextureSettingS setting, size_t *extraBytes);
+/* JPEGs without CPU upsampling or color conversion : put YCBCR_SAMPLER_GLSL after #version in the fragment
+   shader, call BindYCbCrTexture and sample with SampleYCbCr(uv). greyscale files work, RGB/CMYK JPEGs fail */
+YCbCrTextureS LoadTextureYCbCr(const char *path, TextureLoadOptionsS options);
+void BindYCbCrTexture(const YCbCrTextureS *tex, GLuint shaderProgram);
+void FreeYCbCrTexture(YCbCrTextureS *tex);
+extern const char YCBCR_SAMPLER_GLSL[];
+/* decodes and uploads a band of rows at a time; for large images, the whole decoded image is never in memory */
+TextureS LoadTextureStreamed(const char *path, TextureLoadOptionsS options);
+/* streamed like LoadTextureStreamed into tiles of tileSize (0 = 4096, never above GL_MAX_TEXTURE_SIZE).
+   DrawTiledTexture draws the tiles intersecting the view : mvp maps image pixels (origin bottom-left, y up)
+   to clip space, quadVAO is a unit quad as for DrawFrameBufferTexture; returns the number of tiles drawn */
+TiledTextureS LoadTiledTexture(const char *path, int tileSize);
+int DrawTiledTexture(const TiledTextureS *tex, GLuint shaderProgram, GLuint quadVAO, mat4 mvp);
+void FreeTiledTexture(TiledTextureS *tex);
+TextureS LoadTextureKTX2(const char *path, TextureSettingS setting);
+/* decoding without heap traffic : QueryImageSize returns the bytes LoadImageInto needs (0 if unreadable),
+   stb's scratch memory between BeginImageArena/EndImageArena comes from a per-thread block reset at the end */
+size_t QueryImageSize(const char *path, int *width, int *height, int *channels, int reqComp);
+bool LoadImageInto(const char *path, unsigned char *dst, size_t dstSize, int *width, int *height, int *channels, int reqComp);
+void BeginImageArena(size_t reserveBytes);
+void EndImageArena();
+void ReleaseImageArena();
+size_t GetImageHeapAllocations();
+/* CPU block compression : no GL calls besides LoadTextureCompressed */
+size_t BlockCompressedSize(int width, int height, BlockFormatS format);
+bool EncodeBlockCompressed(const unsigned char *pixels, int width, int height, int channels, BlockFormatS format, int threadCount, unsigned char *out);
+bool BakeTextureKTX2(const char *imagePath, const char *ktx2Path, BlockFormatS format, int threadCount);
+TextureS LoadTextureCompressed(const char *path, TextureSettingS setting, BlockFormatS format);
+/* async texture loading : call PumpTextureUploads() once per frame on the GL thread */
+bool InitTextureLoader(int workerCount, size_t uploadBudgetBytes);
+void ShutdownTextureLoader();
+TextureS LoadTextureAsync(const char *path, TextureSettingS setting, int priority);
+int PumpTextureUploads();
+bool IsTextureReady(TextureS *tex);
+/* animated GIFs : a decoder pool shared by all animations keeps each ring of ringLayers layers (0 = 8, at least 2) filled; call
+   UpdateAnimatedTexture() once per frame on the GL thread to upload new frames and advance playback */
+AnimatedTextureS LoadAnimatedTexture(const char *path, TextureSettingS setting, int ringLayers);
+bool UpdateAnimatedTexture(AnimatedTextureS *tex, float deltaTime);
+void BindAnimatedTexture(AnimatedTextureS *tex, GLuint shaderProgram);
+void FreeAnimatedTexture(AnimatedTextureS *tex);
+TextureCacheStatsS GetTextureCacheStats();
+void ResetTextureCacheStats();
+/* uniform locations come from a table filled when CreateShaderStr links; call CacheProgramUniforms after
+   linking (or relinking) a program yourself, and delete programs with DeleteShaderProgram so a recycled id
+   never sees a stale table. reset the stats once per frame for per-frame counts */
+bool CacheProgramUniforms(GLuint program);
+GLint GetUniformLocationCached(GLuint program, const char *name);
+void DeleteShaderProgram(GLuint program);
+/* glUseProgram that skips rebinding the current program (BindMeshS and the draw helpers always bind); the
+   SetUniform* functions don't bind at all where glProgramUniform* exists (GL 4.1 / ARB_separate_shader_objects),
+   so bind before drawing. ForgetBoundProgram after binding with glUseProgram directly */
+void UseProgram(GLuint program);
+void ForgetBoundProgram();
+UniformCacheStatsS GetUniformCacheStats();
+void ResetUniformCacheStats();
 void SetUniform1i(GLuint program, const char *name, int value);
 void SetUniform1f(GLuint program, const char *name, float value);
 void SetUniform3f(GLuint program, const char *name, float x, float y, float z);
@@ -134,6 +335,15 @@ void SetUniformMat4(GLuint program, const char *name, const float *matrix);
 void SetupVertexAttrib(GLuint index, GLint size, GLenum type, GLsizei stride, const void *pointer);
 void SetViewport(int x, int y, int w, int h);
 char *ReadGlslfile(const char *filepath);
+/* ReadGlslfile with #include "file" expanded (relative to the including file, each file once) and defines
+   ("NAME", "NAME VALUE" or "NAME=VALUE") added after #version; free() the result */
+char *PreprocessGlslFile(const char *path, const char *const *defines, int defineCount);
+/* one program per file pair and define set, whatever the define order or spelling, built once per process
+   (failures too); 0 when one name has two different values. the cache owns them : don't delete them,
+   FreeShaderVariants deletes all */
+GLuint CreateShaderVariant(const char *vertexPath, const char *fragmentPath, const char *const *defines, int defineCount);
+void FreeShaderVariants();
+ShaderVariantStatsS GetShaderVariantStats();
 void EnableDepthTest();
 void DisableDepthTest();
 static inline bool IsKeyPressed(GLFWwindow *window, int key);
@@ -154,6 +364,7 @@ void ProcessKeyboardInput(GLFWwindow *window, CCameraS *cam, float deltaTime);
 float CalculateFPS();
 bool CreateFrameBuffer(FrameBufferS *fb, int width, int height);
 TextureS LoadEmptyTexture(int width, int height);
+TextureS LoadEmptyTextureImmutable(int width, int height);
 void FreeFrameBuffer(FrameBufferS *fb);
 void BindFrameBuffer(FrameBufferS *fb);
 void UnbindFrameBuffer(int windowWidth, int windowHeight);
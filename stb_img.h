@@ -32,8 +32,8 @@
       PIC (Softimage PIC)
       PNM (PPM and PGM binary only)
 
-      Animated GIF still needs a proper API, but here's one way to do it:
-          http://gist.github.com/urraka/685d9a6340b26b830d49
+      Animated GIF: stbi_load_gif_from_memory for all frames at once, or the
+      stbi_gif_stream_* functions for one frame at a time
 
       - decode from memory or through FILE (define STBI_NO_STDIO to remove code)
       - decode from arbitrary I/O callbacks
@@ -270,12 +270,122 @@ RECENT REVISION HISTORY:
 // (at least this is true for iOS and Android). Therefore, the NEON support is
 // toggled by a build flag: define STBI_NEON to get NEON loops.
 //
+// On x86 with GCC, Clang or VC++ 2012+, AVX2 versions of the IDCT, the 2x2
+// chroma upsampler and YCbCr-to-RGB conversion are compiled in as well and
+// picked over the SSE2 ones when CPUID (and the OS) report AVX2 support, so
+// the same binary still runs on SSE2-only machines. The same goes for the
+// PNG unfilter kernels for 3- and 4-byte pixels (SSE4.1, plus AVX2 for the
+// Up filter) and the 16-bit PNG byte swap (AVX2), for the RGBE-to-half
+// conversion (AVX2 + F16C) and for the channel-count conversions that only
+// copy or fill channels (SSSE3). Their output is bit-identical to the
+// generic C versions.
+// Define STBI_NO_AVX2 to leave them all out.
+//
 // If for some reason you do not want to use any of SIMD code, or if
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
 //
 // ===========================================================================
 //
+// Multi-threaded JPEG decoding   (enable by defining STBI_JPEG_THREADS)
+//
+// When the implementation is compiled with STBI_JPEG_THREADS (pthreads, or
+// Win32 threads on Windows), stbi_set_jpeg_thread_count(n) lets the JPEG
+// decoder use up to n threads (stbi_set_jpeg_thread_count_thread(n) sets it
+// for the calling thread only):
+//
+//   - baseline scans with restart markers (DRI) are split at the markers and
+//     the restart intervals are entropy-decoded and IDCT'd in parallel; this
+//     only applies to images decoded from memory, since the whole scan must
+//     be addressable
+//   - upsampling and color conversion run over bands of output rows
+//
+// The output is byte-identical to the single-threaded decoder. The helper
+// threads come from a pool that is started on first use, grows to the
+// largest count asked for and then stays, idle, for the life of the process;
+// decodes running at the same time on different threads share it. Without
+// STBI_JPEG_THREADS the thread count is accepted and ignored.
+//
+// ===========================================================================
+//
+// Scaled JPEG decoding
+//
+// stbi_set_jpeg_scale_denom(denom) makes the JPEG decoder produce images of
+// ceil(w/denom) x ceil(h/denom) pixels for denom 2, 4 or 8 (other values round
+// down to one of those; 1 turns it off). Each 8x8 block goes through a
+// reduced 4x4, 2x2 or 1x1 IDCT that averages the block's low frequencies over
+// 2x2, 4x4 or 8x8 pixels (subsampled chroma keeps one size larger per level
+// of subsampling, so 4:2:0 chroma still comes out at the output resolution),
+// so the IDCT, upsampling and color conversion work and the output size all
+// shrink with the scale; entropy decoding still reads every coefficient, and
+// is what's left of the decode time at 1/8. stbi_info reports the scaled size
+// as well, and the other formats are not affected.
+//
+// ===========================================================================
+//
+// JPEG planes
+//
+// stbi_load_jpeg_planes_from_memory / _from_callbacks stop a JPEG decode
+// after the IDCT and hand over the component planes themselves, without
+// chroma upsampling, color conversion or a copy: one plane (Y) for
+// greyscale files, three (Y, Cb, Cr) for YCbCr ones, each at its own
+// resolution (w x h samples, every sample covering hs x vs image pixels) and
+// stride. Files stored as RGB, CMYK or YCCK fail with "not YCbCr". The planes
+// are always top row first, whatever the flip setting; the JPEG scale
+// setting applies. Free them with stbi_jpeg_planes_free.
+//
+// The caller does the rest, typically on the GPU: with JFIF's centered
+// chroma, plane sample (i,j) sits at image pixel ((i+0.5)*hs, (j+0.5)*vs),
+// so bilinear filtering reproduces the decoder's own upsampling, and
+//
+//     R = Y + 1.402 (Cr-128)
+//     G = Y - 0.344136 (Cb-128) - 0.714136 (Cr-128)
+//     B = Y + 1.772 (Cb-128)
+//
+// ===========================================================================
+//
+// Row-streaming decode
+//
+// stbi_load_rows_from_memory / _from_callbacks decode an image and hand it to
+// a callback in bands of band_rows rows (the last band may be shorter), top
+// row first, so the whole decoded image never has to be in memory at once:
+//
+//   - non-interlaced PNG inflates into a window of 32K plus one band of raw
+//     rows, and each band is unfiltered and converted as soon as it's complete;
+//     from memory the IDAT data is read in place instead of being gathered
+//   - baseline JPEG (one interleaved scan) keeps three MCU rows per component
+//     instead of whole planes and converts each MCU row once the next one is in
+//   - progressive JPEG, baseline JPEG with one scan per component, interlaced
+//     PNG and all other formats decode the whole image first and then hand it
+//     out band by band
+//
+// Since the decoded image is never allocated whole, PNG's 1GB and JPEG's 2GB
+// limits on it don't apply to the streamed cases above; only a row band (or,
+// for progressive JPEG, each component plane) has to stay under 2GB.
+//
+// The rows are 8 bits per channel with desired_channels components (or the
+// file's, if 0) and are never flipped. They're only valid during the call,
+// and the callback may modify them in place. Returning 0 from the callback
+// stops the load. The functions return 1 on success and 0 on failure, and
+// fill in x, y and channels_in_file like stbi_load.
+//
+// ===========================================================================
+//
+// Animated GIF streaming
+//
+// stbi_gif_stream_open_from_memory starts decoding a GIF one frame at a time;
+// the buffer has to stay valid until stbi_gif_stream_close. Each call to
+// stbi_gif_stream_next composes the next frame and returns 1 with *frame
+// pointing at x*y RGBA pixels (top row first, never flipped) and *delay_ms
+// set to the frame's delay. The pixels belong to the stream and are only
+// valid until the next call. It returns 0 after the last frame (or when the
+// data ends after a frame, since the trailer is often missing) and -1 on
+// error. stbi_gif_stream_rewind goes back to the first frame, for looping.
+// Only the current frame and the one before it are kept, so memory doesn't
+// grow with the number of frames.
+//
+// ===========================================================================
+//
 // HDR image support   (disable by defining STBI_NO_HDR)
 //
 // stb_image supports loading HDR images in general, and currently the Radiance
@@ -309,6 +419,12 @@ RECENT REVISION HISTORY:
 //
 //     stbi_is_hdr(char *filename);
 //
+// For textures, stbi_load_rgbe_from_memory / _from_callbacks return the
+// Radiance pixels undecoded, 4 bytes (R, G, B, shared exponent) per pixel,
+// and stbi_rgbe_to_half turns them into 3 IEEE half floats per pixel (round
+// to nearest even, with the same values as stbi_loadf) for uploading as
+// RGB16F, at half the size of the float version.
+//
 // ===========================================================================
 //
 // iPhone PNG support:
@@ -430,8 +546,22 @@ extern "C"
 // for stbi_load_from_file, file pointer is left pointing immediately after image
 #endif
 
+    // row-streaming decode; see "Row-streaming decode" above
+    typedef int (*stbi_rows_callback)(void *user, stbi_uc *rows, int first_row, int row_count);
+    STBIDEF int stbi_load_rows_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels,
+                                           int band_rows, stbi_rows_callback callback, void *callback_user);
+    STBIDEF int stbi_load_rows_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *channels_in_file, int desired_channels,
+                                              int band_rows, stbi_rows_callback callback, void *callback_user);
+
 #ifndef STBI_NO_GIF
     STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp);
+
+    // frame-at-a-time GIF decode; see "Animated GIF streaming" above
+    typedef struct stbi_gif_stream stbi_gif_stream;
+    STBIDEF stbi_gif_stream *stbi_gif_stream_open_from_memory(stbi_uc const *buffer, int len, int *x, int *y);
+    STBIDEF int stbi_gif_stream_next(stbi_gif_stream *g, stbi_uc **frame, int *delay_ms);
+    STBIDEF void stbi_gif_stream_rewind(stbi_gif_stream *g);
+    STBIDEF void stbi_gif_stream_close(stbi_gif_stream *g);
 #endif
 
 #ifdef STBI_WINDOWS_UTF8
@@ -468,6 +598,11 @@ extern "C"
 #ifndef STBI_NO_HDR
     STBIDEF void stbi_hdr_to_ldr_gamma(float gamma);
     STBIDEF void stbi_hdr_to_ldr_scale(float scale);
+
+    // raw Radiance pixels and half-float conversion; see "HDR image support" above
+    STBIDEF stbi_uc *stbi_load_rgbe_from_memory(stbi_uc const *buffer, int len, int *x, int *y);
+    STBIDEF stbi_uc *stbi_load_rgbe_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y);
+    STBIDEF void stbi_rgbe_to_half(stbi_us *output, stbi_uc const *rgbe, int pixel_count);
 #endif // STBI_NO_HDR
 
 #ifndef STBI_NO_LINEAR
@@ -522,6 +657,32 @@ extern "C"
     STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
     STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+    // number of threads the JPEG decoder may use (see "Multi-threaded JPEG decoding");
+    // the _thread version only applies to the calling thread, like the flip above
+    STBIDEF void stbi_set_jpeg_thread_count(int thread_count);
+    STBIDEF void stbi_set_jpeg_thread_count_thread(int thread_count);
+
+    // decode JPEGs at 1/2, 1/4 or 1/8 size (see "Scaled JPEG decoding"); the
+    // _thread version only applies to the calling thread, like the flip above
+    STBIDEF void stbi_set_jpeg_scale_denom(int denom);
+    STBIDEF void stbi_set_jpeg_scale_denom_thread(int denom);
+
+#ifndef STBI_NO_JPEG
+    // a JPEG component plane as the decoder left it; see "JPEG planes" above
+    typedef struct
+    {
+        stbi_uc *data; // first sample of the top row
+        int w, h;      // plane size in samples
+        int stride;    // bytes from one row to the next, >= w
+        int hs, vs;    // image pixels per sample in x and y
+        void *raw;     // the allocation, for stbi_jpeg_planes_free
+    } stbi_plane;
+
+    STBIDEF int stbi_load_jpeg_planes_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *plane_count, stbi_plane planes[3]);
+    STBIDEF int stbi_load_jpeg_planes_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *plane_count, stbi_plane planes[3]);
+    STBIDEF void stbi_jpeg_planes_free(stbi_plane *planes, int plane_count);
+#endif // STBI_NO_JPEG
+
     // ZLIB client - used by PNG, available for other purposes
 
     STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -583,6 +744,17 @@ extern "C"
 #include <string.h>
 #include <limits.h>
 
+#ifdef STBI_JPEG_THREADS
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
 #if !defined(STBI_NO_LINEAR) || !defined(STBI_NO_HDR)
 #include <math.h> // ldexp, pow
 #endif
@@ -635,12 +807,18 @@ typedef unsigned short stbi__uint16;
 typedef signed short stbi__int16;
 typedef unsigned int stbi__uint32;
 typedef signed int stbi__int32;
+#ifdef _MSC_VER
+typedef unsigned __int64 stbi__uint64;
+#else
+typedef unsigned long long stbi__uint64;
+#endif
 #else
 #include <stdint.h>
 typedef uint16_t stbi__uint16;
 typedef int16_t stbi__int16;
 typedef uint32_t stbi__uint32;
 typedef int32_t stbi__int32;
+typedef uint64_t stbi__uint64;
 #endif
 
 // should produce compiler error if size is wrong
@@ -763,6 +941,90 @@ static int stbi__sse2_available(void)
 }
 #endif
 
+#endif
+
+// AVX2 (and SSE4.1, SSSE3) kernels are compiled with a per-function target
+// attribute and only called after a run-time check, so no -mavx2 is needed
+#if !defined(STBI_NO_AVX2)
+#if defined(_MSC_VER) && _MSC_VER >= 1700
+#define STBI__AVX2
+#define STBI__AVX2_TARGET
+#define STBI__SSE41_TARGET
+#define STBI__SSSE3_TARGET
+#define STBI__F16C_TARGET
+#include <immintrin.h>
+#if !defined(STBI_NO_PNG) || !defined(STBI_NO_BMP) || !defined(STBI_NO_PSD) || !defined(STBI_NO_TGA) || !defined(STBI_NO_GIF) || !defined(STBI_NO_PIC) || !defined(STBI_NO_PNM)
+stbi_inline static int stbi__ssse3_available(void)
+{
+    int info[4];
+    __cpuid(info, 1);
+    return ((info[2] >> 9) & 1) != 0;
+}
+#endif
+#ifndef STBI_NO_PNG
+stbi_inline static int stbi__sse41_available(void)
+{
+    int info[4];
+    __cpuid(info, 1);
+    return ((info[2] >> 19) & 1) != 0;
+}
+#endif
+#if !defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG) || !defined(STBI_NO_HDR)
+stbi_inline static int stbi__avx2_available(void)
+{
+    int info[4];
+    __cpuid(info, 1);
+    // OSXSAVE and AVX, with the OS saving the ymm registers
+    if ((info[2] & (3 << 27)) != (3 << 27) || (_xgetbv(0) & 6) != 6)
+        return 0;
+    __cpuidex(info, 7, 0);
+    return ((info[1] >> 5) & 1) != 0;
+}
+#endif
+#ifndef STBI_NO_HDR
+stbi_inline static int stbi__f16c_available(void)
+{
+    int info[4];
+    __cpuid(info, 1);
+    return ((info[2] >> 29) & 1) != 0 && stbi__avx2_available();
+}
+#endif
+#elif !defined(_MSC_VER) && (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define STBI__AVX2
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+#define STBI__SSE41_TARGET __attribute__((target("sse4.1")))
+#define STBI__SSSE3_TARGET __attribute__((target("ssse3")))
+#define STBI__F16C_TARGET __attribute__((target("avx2,f16c")))
+#include <immintrin.h>
+#if !defined(STBI_NO_PNG) || !defined(STBI_NO_BMP) || !defined(STBI_NO_PSD) || !defined(STBI_NO_TGA) || !defined(STBI_NO_GIF) || !defined(STBI_NO_PIC) || !defined(STBI_NO_PNM)
+stbi_inline static int stbi__ssse3_available(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+#endif
+#ifndef STBI_NO_PNG
+stbi_inline static int stbi__sse41_available(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.1");
+}
+#endif
+#if !defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG) || !defined(STBI_NO_HDR)
+stbi_inline static int stbi__avx2_available(void)
+{
+    // also checks that the OS saves the ymm registers
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+#ifndef STBI_NO_HDR
+stbi_inline static int stbi__f16c_available(void)
+{
+    return stbi__avx2_available() && __builtin_cpu_supports("f16c");
+}
+#endif
+#endif
 #endif
 #endif
 
@@ -1137,6 +1399,256 @@ STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_fli
                                            : stbi__vertically_flip_on_load_global)
 #endif // STBI_THREAD_LOCAL
 
+#define STBI__MAX_THREADS 64
+
+static int stbi__jpeg_thread_count_global = 1;
+
+static int stbi__clamp_thread_count(int thread_count)
+{
+    if (thread_count < 1)
+        return 1;
+    return thread_count > STBI__MAX_THREADS ? STBI__MAX_THREADS : thread_count;
+}
+
+STBIDEF void stbi_set_jpeg_thread_count(int thread_count)
+{
+    stbi__jpeg_thread_count_global = stbi__clamp_thread_count(thread_count);
+}
+
+#ifndef STBI_THREAD_LOCAL
+#define stbi__jpeg_thread_count stbi__jpeg_thread_count_global
+#else
+static STBI_THREAD_LOCAL int stbi__jpeg_thread_count_local, stbi__jpeg_thread_count_set;
+
+STBIDEF void stbi_set_jpeg_thread_count_thread(int thread_count)
+{
+    stbi__jpeg_thread_count_local = stbi__clamp_thread_count(thread_count);
+    stbi__jpeg_thread_count_set = 1;
+}
+
+#define stbi__jpeg_thread_count (stbi__jpeg_thread_count_set ? stbi__jpeg_thread_count_local : stbi__jpeg_thread_count_global)
+#endif // STBI_THREAD_LOCAL
+
+// log2 of the JPEG scale denominator
+static int stbi__jpeg_scale_global = 0;
+
+static int stbi__jpeg_scale_shift(int denom)
+{
+    return denom >= 8 ? 3 : denom >= 4 ? 2 : denom >= 2 ? 1 : 0;
+}
+
+STBIDEF void stbi_set_jpeg_scale_denom(int denom)
+{
+    stbi__jpeg_scale_global = stbi__jpeg_scale_shift(denom);
+}
+
+#ifndef STBI_THREAD_LOCAL
+#define stbi__jpeg_scale stbi__jpeg_scale_global
+#else
+static STBI_THREAD_LOCAL int stbi__jpeg_scale_local, stbi__jpeg_scale_set;
+
+STBIDEF void stbi_set_jpeg_scale_denom_thread(int denom)
+{
+    stbi__jpeg_scale_local = stbi__jpeg_scale_shift(denom);
+    stbi__jpeg_scale_set = 1;
+}
+
+#define stbi__jpeg_scale (stbi__jpeg_scale_set ? stbi__jpeg_scale_local : stbi__jpeg_scale_global)
+#endif // STBI_THREAD_LOCAL
+
+// output side of the row-streaming decoders: rows are gathered into bands of
+// band_rows and handed to the callback. row_bytes is set by the decoder once
+// it knows the output layout.
+typedef struct
+{
+    stbi_rows_callback callback;
+    void *user;
+    int band_rows;
+    int row_bytes;
+    int rows_done; // rows already handed out
+    int fill;      // rows waiting in band
+    stbi_uc *band;
+} stbi__row_sink;
+
+static int stbi__sink_flush(stbi__row_sink *sink)
+{
+    if (sink->fill)
+    {
+        if (!sink->callback(sink->user, sink->band, sink->rows_done, sink->fill))
+            return stbi__err("stopped", "Row callback stopped the load");
+        sink->rows_done += sink->fill;
+        sink->fill = 0;
+    }
+    return 1;
+}
+
+// 'last' says these are the image's final rows, so a short band can go out
+// without being copied
+static int stbi__sink_write(stbi__row_sink *sink, stbi_uc *rows, int count, int last)
+{
+    while (count > 0)
+    {
+        int n = sink->band_rows - sink->fill;
+        if (n > count)
+            n = count;
+        if (sink->fill == 0 && (n == sink->band_rows || last))
+        {
+            // a whole band straight from the decoder's buffer
+            if (!sink->callback(sink->user, rows, sink->rows_done, n))
+                return stbi__err("stopped", "Row callback stopped the load");
+            sink->rows_done += n;
+        }
+        else
+        {
+            if (!sink->band)
+            {
+                sink->band = (stbi_uc *)stbi__malloc_mad3(sink->band_rows, sink->row_bytes, 1, 0);
+                if (!sink->band)
+                    return stbi__err("outofmem", "Out of memory");
+            }
+            memcpy(sink->band + (size_t)sink->fill * sink->row_bytes, rows, (size_t)n * sink->row_bytes);
+            sink->fill += n;
+            if (sink->fill == sink->band_rows && !stbi__sink_flush(sink))
+                return 0;
+        }
+        rows += (size_t)n * sink->row_bytes;
+        count -= n;
+    }
+    return 1;
+}
+
+#ifdef STBI_JPEG_THREADS
+typedef void (*stbi__parallel_func)(void *arg, int index);
+
+// one stbi__run_parallel call: indices are handed out in order to whichever
+// thread asks next, the caller included
+typedef struct stbi__parallel_job
+{
+    stbi__parallel_func func;
+    void *arg;
+    int count;
+    int next; // next index to hand out
+    int done; // indices finished
+    struct stbi__parallel_job *next_job;
+} stbi__parallel_job;
+
+// the helper threads, started on demand and never stopped; everything below
+// is guarded by the lock
+static struct
+{
+    stbi__parallel_job *jobs;
+    int threads;
+} stbi__pool;
+
+#ifdef _WIN32
+static SRWLOCK stbi__pool_mutex = SRWLOCK_INIT;
+static CONDITION_VARIABLE stbi__pool_work = CONDITION_VARIABLE_INIT;
+static CONDITION_VARIABLE stbi__pool_finished = CONDITION_VARIABLE_INIT;
+#define stbi__pool_lock() AcquireSRWLockExclusive(&stbi__pool_mutex)
+#define stbi__pool_unlock() ReleaseSRWLockExclusive(&stbi__pool_mutex)
+#define stbi__pool_wait(cond) SleepConditionVariableSRW(cond, &stbi__pool_mutex, INFINITE, 0)
+#define stbi__pool_wake_all(cond) WakeAllConditionVariable(cond)
+#else
+static pthread_mutex_t stbi__pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stbi__pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t stbi__pool_finished = PTHREAD_COND_INITIALIZER;
+#define stbi__pool_lock() pthread_mutex_lock(&stbi__pool_mutex)
+#define stbi__pool_unlock() pthread_mutex_unlock(&stbi__pool_mutex)
+#define stbi__pool_wait(cond) pthread_cond_wait(cond, &stbi__pool_mutex)
+#define stbi__pool_wake_all(cond) pthread_cond_broadcast(cond)
+#endif
+
+// with the lock held: runs the job's indices until none are left to hand out
+static void stbi__parallel_drain(stbi__parallel_job *job)
+{
+    while (job->next < job->count)
+    {
+        int index = job->next++;
+        stbi__pool_unlock();
+        job->func(job->arg, index);
+        stbi__pool_lock();
+        if (++job->done == job->count)
+            stbi__pool_wake_all(&stbi__pool_finished);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI stbi__parallel_worker(LPVOID param)
+#else
+static void *stbi__parallel_worker(void *param)
+#endif
+{
+    STBI_NOTUSED(param);
+    stbi__pool_lock();
+    // pool threads are never stopped, this only ends with the process
+    while (stbi__pool.threads > 0)
+    {
+        stbi__parallel_job *job = stbi__pool.jobs;
+        while (job && job->next >= job->count)
+            job = job->next_job;
+        if (job)
+            stbi__parallel_drain(job);
+        else
+            stbi__pool_wait(&stbi__pool_work);
+    }
+    stbi__pool_unlock();
+    return 0;
+}
+
+// with the lock held: grows the pool to 'want' threads, or as many as start
+static void stbi__pool_grow(int want)
+{
+    while (stbi__pool.threads < want)
+    {
+#ifdef _WIN32
+        HANDLE thread = CreateThread(NULL, 0, stbi__parallel_worker, NULL, 0, NULL);
+        if (!thread)
+            return;
+        CloseHandle(thread);
+#else
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, stbi__parallel_worker, NULL) != 0)
+            return;
+        pthread_detach(thread);
+#endif
+        stbi__pool.threads++;
+    }
+}
+
+// runs func(arg, i) for i in [0, count) on the pool; index 0 runs on the
+// calling thread, which also takes any indices no pool thread has picked up
+// (all of them if no thread could be started)
+static void stbi__run_parallel(stbi__parallel_func func, void *arg, int count)
+{
+    stbi__parallel_job job;
+    stbi__parallel_job **link;
+    if (count < 2)
+    {
+        func(arg, 0);
+        return;
+    }
+
+    job.func = func;
+    job.arg = arg;
+    job.count = count;
+    job.next = 0;
+    job.done = 0;
+
+    stbi__pool_lock();
+    stbi__pool_grow(count - 1);
+    job.next_job = stbi__pool.jobs;
+    stbi__pool.jobs = &job;
+    stbi__pool_wake_all(&stbi__pool_work);
+    stbi__parallel_drain(&job);
+    while (job.done < job.count)
+        stbi__pool_wait(&stbi__pool_finished);
+    for (link = &stbi__pool.jobs; *link != &job; link = &(*link)->next_job)
+        ;
+    *link = job.next_job;
+    stbi__pool_unlock();
+}
+#endif // STBI_JPEG_THREADS
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
     memset(ri, 0, sizeof(*ri));         // make sure it's initialized if we add new fields
@@ -1793,10 +2305,73 @@ static stbi_uc stbi__compute_y(int r, int g, int b)
 #if defined(STBI_NO_PNG) && defined(STBI_NO_BMP) && defined(STBI_NO_PSD) && defined(STBI_NO_TGA) && defined(STBI_NO_GIF) && defined(STBI_NO_PIC) && defined(STBI_NO_PNM)
 // nothing
 #else
+#ifdef STBI__AVX2
+// the conversions that only copy or fill channels, by [img_n][req_comp]:
+// source channel for each output channel, -1 for opaque alpha; 9 marks the
+// ones that need arithmetic (luma) or nothing at all
+static const signed char stbi__convert_shuffle_maps[5][5][4] = {
+    {{9}, {9}, {9}, {9}, {9}},
+    {{9}, {9}, {0, -1}, {0, 0, 0}, {0, 0, 0, -1}},
+    {{9}, {0}, {9}, {0, 0, 0}, {0, 0, 0, 1}},
+    {{9}, {9}, {9}, {9}, {0, 1, 2, -1}},
+    {{9}, {9}, {9}, {0, 1, 2}, {9}},
+};
+
+// builds the pshufb control and alpha fill for one 16-byte step of a
+// conversion with bytes per channel; returns the pixels per step, or 0 if
+// the conversion isn't a pure shuffle
+static int stbi__convert_shuffle_setup(int img_n, int req_comp, int bytes, stbi_uc shuf[16], stbi_uc fill[16])
+{
+    const signed char *map = stbi__convert_shuffle_maps[img_n][req_comp];
+    int q, b;
+    if (map[0] != 0)
+        return 0;
+    q = 16 / (bytes * (img_n > req_comp ? img_n : req_comp));
+    for (b = 0; b < 16; ++b)
+    {
+        int p = b / (bytes * req_comp);
+        int c = (b / bytes) % req_comp;
+        if (p >= q || map[c] < 0)
+        {
+            shuf[b] = 0x80;
+            fill[b] = p < q ? 0xff : 0;
+        }
+        else
+        {
+            shuf[b] = (stbi_uc)((p * img_n + map[c]) * bytes + b % bytes);
+            fill[b] = 0;
+        }
+    }
+    return q;
+}
+
+// q pixels per step with in/out bytes per pixel; each 16-byte load and store
+// may run past the pixels it converts (the next store overwrites the extra),
+// so the loop stays that far from the end of the row. returns pixels done
+STBI__SSSE3_TARGET static int stbi__convert_shuffle_ssse3(stbi_uc *dest, stbi_uc const *src, int x, int in, int out, int q, stbi_uc const *shuf, stbi_uc const *fill)
+{
+    __m128i s = _mm_loadu_si128((__m128i const *)shuf);
+    __m128i f = _mm_loadu_si128((__m128i const *)fill);
+    int small = in < out ? in : out;
+    int span = (16 + small - 1) / small;
+    int i;
+    for (i = 0; i + span <= x; i += q)
+    {
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)(src + i * in)), s);
+        _mm_storeu_si128((__m128i *)(dest + i * out), _mm_or_si128(v, f));
+    }
+    return i;
+}
+#endif
+
 static unsigned char *stbi__convert_format(unsigned char *data, int img_n, int req_comp, unsigned int x, unsigned int y)
 {
-    int i, j;
+    int i, j, done = 0;
     unsigned char *good;
+#ifdef STBI__AVX2
+    stbi_uc shuf[16], fill[16];
+    int q = 0;
+#endif
 
     if (req_comp == img_n)
         return data;
@@ -1809,15 +2384,30 @@ static unsigned char *stbi__convert_format(unsigned char *data, int img_n, int r
         return stbi__errpuc("outofmem", "Out of memory");
     }
 
+#ifdef STBI__AVX2
+    if (stbi__ssse3_available())
+        q = stbi__convert_shuffle_setup(img_n, req_comp, 1, shuf, fill);
+#endif
+
     for (j = 0; j < (int)y; ++j)
     {
         unsigned char *src = data + j * x * img_n;
         unsigned char *dest = good + j * x * req_comp;
 
+#ifdef STBI__AVX2
+        // the SIMD kernel does most of the row, the switch below the rest
+        if (q)
+        {
+            done = stbi__convert_shuffle_ssse3(dest, src, x, img_n, req_comp, q, shuf, fill);
+            src += done * img_n;
+            dest += done * req_comp;
+        }
+#endif
+
 #define STBI__COMBO(a, b) ((a) * 8 + (b))
 #define STBI__CASE(a, b)    \
     case STBI__COMBO(a, b): \
-        for (i = x - 1; i >= 0; --i, src += a, dest += b)
+        for (i = x - 1 - done; i >= 0; --i, src += a, dest += b)
         // convert source image with img_n components to one with req_comp components;
         // avoid switch per pixel, so use switch per scanline and massive macros
         switch (STBI__COMBO(img_n, req_comp))
@@ -1905,8 +2495,12 @@ static stbi__uint16 stbi__compute_y_16(int r, int g, int b)
 #else
 static stbi__uint16 *stbi__convert_format16(stbi__uint16 *data, int img_n, int req_comp, unsigned int x, unsigned int y)
 {
-    int i, j;
+    int i, j, done = 0;
     stbi__uint16 *good;
+#ifdef STBI__AVX2
+    stbi_uc shuf[16], fill[16];
+    int q = 0;
+#endif
 
     if (req_comp == img_n)
         return data;
@@ -1919,15 +2513,29 @@ static stbi__uint16 *stbi__convert_format16(stbi__uint16 *data, int img_n, int r
         return (stbi__uint16 *)stbi__errpuc("outofmem", "Out of memory");
     }
 
+#ifdef STBI__AVX2
+    if (stbi__ssse3_available())
+        q = stbi__convert_shuffle_setup(img_n, req_comp, 2, shuf, fill);
+#endif
+
     for (j = 0; j < (int)y; ++j)
     {
         stbi__uint16 *src = data + j * x * img_n;
         stbi__uint16 *dest = good + j * x * req_comp;
 
+#ifdef STBI__AVX2
+        if (q)
+        {
+            done = stbi__convert_shuffle_ssse3((stbi_uc *)dest, (stbi_uc const *)src, x, img_n * 2, req_comp * 2, q, shuf, fill);
+            src += done * img_n;
+            dest += done * req_comp;
+        }
+#endif
+
 #define STBI__COMBO(a, b) ((a) * 8 + (b))
 #define STBI__CASE(a, b)    \
     case STBI__COMBO(a, b): \
-        for (i = x - 1; i >= 0; --i, src += a, dest += b)
+        for (i = x - 1 - done; i >= 0; --i, src += a, dest += b)
         // convert source image with img_n components to one with req_comp components;
         // avoid switch per pixel, so use switch per scanline and massive macros
         switch (STBI__COMBO(img_n, req_comp))
@@ -2131,7 +2739,9 @@ typedef struct
     // sizes for components, interleaved MCUs
     int img_h_max, img_v_max;
     int img_mcu_x, img_mcu_y;
-    int img_mcu_w, img_mcu_h;
+    int img_mcu_w, img_mcu_h; // in output pixels
+
+    int scale; // log2 of the scale denominator (see "Scaled JPEG decoding")
 
     // definition of jpeg image component
     struct
@@ -2142,12 +2752,15 @@ typedef struct
         int hd, ha;
         int dc_pred;
 
-        int x, y, w2, h2;
+        int x, y, w2, h2; // x, y at full size; w2, h2 at the output scale
         stbi_uc *data;
         void *raw_data, *raw_coeff;
         stbi_uc *linebuf;
         short *coeff;         // progressive only
         int coeff_w, coeff_h; // number of 8x8 coefficient blocks
+        int ring;             // rows of data kept when streaming; 0 = the whole plane
+        int block_size;       // pixels per decoded block edge: 8, or less when scaled
+        void (*idct)(stbi_uc *out, int out_stride, short data[64]);
     } img_comp[4];
 
     stbi__uint32 code_buffer; // jpeg entropy-coded buffer
@@ -2172,8 +2785,18 @@ typedef struct
     void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
     void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
     stbi_uc *(*resample_row_hv_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+
+    struct stbi__jpeg_stream *stream; // set by stbi_load_rows_*
 } stbi__jpeg;
 
+// start of row 'row' of a component plane, which is a ring when streaming
+stbi_inline static stbi_uc *stbi__jpeg_comp_row(stbi__jpeg *z, int n, int row)
+{
+    if (z->img_comp[n].ring)
+        row %= z->img_comp[n].ring;
+    return z->img_comp[n].data + z->img_comp[n].w2 * row;
+}
+
 static int stbi__build_huffman(stbi__huffman *h, int *count)
 {
     int i, j, k = 0;
@@ -2791,6 +3414,62 @@ static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
     }
 }
 
+// reduced IDCTs for scaled decoding. output pixel (x,y) is the average of the
+// full IDCT over the 8/n x 8/n pixels it covers, keeping only the n x n
+// lowest frequencies: out = B * F * B^T + 128, where B[x][u] is C(u)/2 times
+// the mean of cos((2x'+1)u pi/16) over those pixels. B is symmetric about
+// the middle (odd columns flip sign), so both passes split into even and odd
+// halves like the full IDCT. fixed point as in stbi__idct_block: constants
+// are 12 bits, the first pass keeps 2 fractional bits
+static void stbi__idct_block_4x4(stbi_uc *out, int out_stride, short data[64])
+{
+    int i, tmp[16];
+    for (i = 0; i < 4; ++i)
+    {
+        // column i: coefficients 0..3 down the block
+        const short *d = data + i;
+        int e0 = d[0] * stbi__f2f(0.35355339f), e1 = d[16] * stbi__f2f(0.32664074f);
+        int o0 = d[8] * stbi__f2f(0.45306372f) + d[24] * stbi__f2f(0.15909482f);
+        int o1 = d[8] * stbi__f2f(0.18766514f) - d[24] * stbi__f2f(0.38408888f);
+        tmp[i] = (e0 + e1 + o0 + 512) >> 10;
+        tmp[4 + i] = (e0 - e1 + o1 + 512) >> 10;
+        tmp[8 + i] = (e0 - e1 - o1 + 512) >> 10;
+        tmp[12 + i] = (e0 + e1 - o0 + 512) >> 10;
+    }
+    for (i = 0; i < 4; ++i, out += out_stride)
+    {
+        // 0.5 rounding and the +128 level shift, at 2^14
+        const int *t = tmp + i * 4;
+        int e0 = t[0] * stbi__f2f(0.35355339f) + (1 << 13) + (128 << 14), e1 = t[2] * stbi__f2f(0.32664074f);
+        int o0 = t[1] * stbi__f2f(0.45306372f) + t[3] * stbi__f2f(0.15909482f);
+        int o1 = t[1] * stbi__f2f(0.18766514f) - t[3] * stbi__f2f(0.38408888f);
+        out[0] = stbi__clamp((e0 + e1 + o0) >> 14);
+        out[1] = stbi__clamp((e0 - e1 + o1) >> 14);
+        out[2] = stbi__clamp((e0 - e1 - o1) >> 14);
+        out[3] = stbi__clamp((e0 + e1 - o0) >> 14);
+    }
+}
+
+static void stbi__idct_block_2x2(stbi_uc *out, int out_stride, short data[64])
+{
+    int k = stbi__f2f(0.35355339f), a = stbi__f2f(0.32036443f);
+    int r0 = (data[0] * k + data[1] * a + 512) >> 10, r1 = (data[0] * k - data[1] * a + 512) >> 10;
+    int s0 = (data[8] * k + data[9] * a + 512) >> 10, s1 = (data[8] * k - data[9] * a + 512) >> 10;
+    int bias = (1 << 13) + (128 << 14);
+    out[0] = stbi__clamp((r0 * k + s0 * a + bias) >> 14);
+    out[1] = stbi__clamp((r1 * k + s1 * a + bias) >> 14);
+    out += out_stride;
+    out[0] = stbi__clamp((r0 * k - s0 * a + bias) >> 14);
+    out[1] = stbi__clamp((r1 * k - s1 * a + bias) >> 14);
+}
+
+// the block's mean is just DC/8
+static void stbi__idct_block_1x1(stbi_uc *out, int out_stride, short data[64])
+{
+    STBI_NOTUSED(out_stride);
+    out[0] = stbi__clamp(((data[0] + 4) >> 3) + 128);
+}
+
 #ifdef STBI_SSE2
 // sse2 integer IDCT. not the fastest possible implementation but it
 // produces bit-identical results to the generic C version so it's
@@ -2977,30 +3656,217 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 #undef dct_pass
 }
 
-#endif // STBI_SSE2
-
-#ifdef STBI_NEON
-
-// NEON integer IDCT. should produce bit-identical
-// results to the generic C version.
-static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
+#ifdef STBI__AVX2
+// avx2 version of the sse2 IDCT above, bit-identical to it for any input.
+// like it, it matches the generic C version except on dense blocks of large
+// coefficients (around +-700 and up), where the 16-bit intermediates of both
+// overflow; see tests/test_jpeg_kernels.c. the 32-bit intermediates of each
+// row (the _l/_h pairs there) live in one 256-bit register, so every
+// rotation is two pmaddwd instead of four and the wide adds/subs are halved;
+// transposes stay 128-bit.
+STBI__AVX2_TARGET static void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
 {
-    int16x8_t row0, row1, row2, row3, row4, row5, row6, row7;
+    __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+    __m128i tmp;
 
-    int16x4_t rot0_0 = vdup_n_s16(stbi__f2f(0.5411961f));
-    int16x4_t rot0_1 = vdup_n_s16(stbi__f2f(-1.847759065f));
-    int16x4_t rot0_2 = vdup_n_s16(stbi__f2f(0.765366865f));
-    int16x4_t rot1_0 = vdup_n_s16(stbi__f2f(1.175875602f));
-    int16x4_t rot1_1 = vdup_n_s16(stbi__f2f(-0.899976223f));
-    int16x4_t rot1_2 = vdup_n_s16(stbi__f2f(-2.562915447f));
-    int16x4_t rot2_0 = vdup_n_s16(stbi__f2f(-1.961570560f));
-    int16x4_t rot2_1 = vdup_n_s16(stbi__f2f(-0.390180644f));
-    int16x4_t rot3_0 = vdup_n_s16(stbi__f2f(0.298631336f));
-    int16x4_t rot3_1 = vdup_n_s16(stbi__f2f(2.053119869f));
-    int16x4_t rot3_2 = vdup_n_s16(stbi__f2f(3.072711026f));
-    int16x4_t rot3_3 = vdup_n_s16(stbi__f2f(1.501321110f));
+// dot product constant: even elems=x, odd elems=y
+#define dct_const(x, y) _mm256_setr_epi16((x), (y), (x), (y), (x), (y), (x), (y), (x), (y), (x), (y), (x), (y), (x), (y))
 
-#define dct_long_mul(out, inq, coeff)                        \
+// interleave x/y with elements 0..3 in the low lane and 4..7 in the high lane, then
+// out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+// out(1) = c1[even]*x + c1[odd]*y
+#define dct_rot(out0, out1, x, y, c0, c1)                                                 \
+    __m256i c0##xy = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16((x), (y))), \
+                                             _mm_unpackhi_epi16((x), (y)), 1);            \
+    __m256i out0 = _mm256_madd_epi16(c0##xy, c0);                                          \
+    __m256i out1 = _mm256_madd_epi16(c0##xy, c1)
+
+// out = in << 12  (in 16-bit, out 32-bit)
+#define dct_widen(out, in) \
+    __m256i out = _mm256_slli_epi32(_mm256_cvtepi16_epi32(in), 12)
+
+// wide add
+#define dct_wadd(out, a, b) \
+    __m256i out = _mm256_add_epi32(a, b)
+
+// wide sub
+#define dct_wsub(out, a, b) \
+    __m256i out = _mm256_sub_epi32(a, b)
+
+// butterfly a/b, add bias, then shift by "s" and pack; the pack works per
+// lane, so put the 64-bit quarters back in order before splitting
+#define dct_bfly32o(out0, out1, a, b, bias, s)                                         \
+    {                                                                                  \
+        __m256i abiased = _mm256_add_epi32(a, bias);                                   \
+        __m256i sum = _mm256_srai_epi32(_mm256_add_epi32(abiased, b), s);              \
+        __m256i dif = _mm256_srai_epi32(_mm256_sub_epi32(abiased, b), s);              \
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum, dif), 0xd8); \
+        out0 = _mm256_castsi256_si128(packed);                                         \
+        out1 = _mm256_extracti128_si256(packed, 1);                                    \
+    }
+
+// 8-bit interleave step (for transposes)
+#define dct_interleave8(a, b)    \
+    tmp = a;                     \
+    a = _mm_unpacklo_epi8(a, b); \
+    b = _mm_unpackhi_epi8(tmp, b)
+
+// 16-bit interleave step (for transposes)
+#define dct_interleave16(a, b)    \
+    tmp = a;                      \
+    a = _mm_unpacklo_epi16(a, b); \
+    b = _mm_unpackhi_epi16(tmp, b)
+
+#define dct_pass(bias, shift)                            \
+    {                                                    \
+        /* even part */                                  \
+        dct_rot(t2e, t3e, row2, row6, rot0_0, rot0_1);   \
+        __m128i sum04 = _mm_add_epi16(row0, row4);       \
+        __m128i dif04 = _mm_sub_epi16(row0, row4);       \
+        dct_widen(t0e, sum04);                           \
+        dct_widen(t1e, dif04);                           \
+        dct_wadd(x0, t0e, t3e);                          \
+        dct_wsub(x3, t0e, t3e);                          \
+        dct_wadd(x1, t1e, t2e);                          \
+        dct_wsub(x2, t1e, t2e);                          \
+        /* odd part */                                   \
+        dct_rot(y0o, y2o, row7, row3, rot2_0, rot2_1);   \
+        dct_rot(y1o, y3o, row5, row1, rot3_0, rot3_1);   \
+        __m128i sum17 = _mm_add_epi16(row1, row7);       \
+        __m128i sum35 = _mm_add_epi16(row3, row5);       \
+        dct_rot(y4o, y5o, sum17, sum35, rot1_0, rot1_1); \
+        dct_wadd(x4, y0o, y4o);                          \
+        dct_wadd(x5, y1o, y5o);                          \
+        dct_wadd(x6, y2o, y5o);                          \
+        dct_wadd(x7, y3o, y4o);                          \
+        dct_bfly32o(row0, row7, x0, x7, bias, shift);    \
+        dct_bfly32o(row1, row6, x1, x6, bias, shift);    \
+        dct_bfly32o(row2, row5, x2, x5, bias, shift);    \
+        dct_bfly32o(row3, row4, x3, x4, bias, shift);    \
+    }
+
+    __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+    __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f(0.765366865f), stbi__f2f(0.5411961f));
+    __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+    __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+    __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f(0.298631336f), stbi__f2f(-1.961570560f));
+    __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f(3.072711026f));
+    __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f(2.053119869f), stbi__f2f(-0.390180644f));
+    __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f(1.501321110f));
+
+    // rounding biases in column/row passes, see stbi__idct_block for explanation.
+    __m256i bias_0 = _mm256_set1_epi32(512);
+    __m256i bias_1 = _mm256_set1_epi32(65536 + (128 << 17));
+
+    // load
+    row0 = _mm_load_si128((const __m128i *)(data + 0 * 8));
+    row1 = _mm_load_si128((const __m128i *)(data + 1 * 8));
+    row2 = _mm_load_si128((const __m128i *)(data + 2 * 8));
+    row3 = _mm_load_si128((const __m128i *)(data + 3 * 8));
+    row4 = _mm_load_si128((const __m128i *)(data + 4 * 8));
+    row5 = _mm_load_si128((const __m128i *)(data + 5 * 8));
+    row6 = _mm_load_si128((const __m128i *)(data + 6 * 8));
+    row7 = _mm_load_si128((const __m128i *)(data + 7 * 8));
+
+    // column pass
+    dct_pass(bias_0, 10);
+
+    {
+        // 16bit 8x8 transpose pass 1
+        dct_interleave16(row0, row4);
+        dct_interleave16(row1, row5);
+        dct_interleave16(row2, row6);
+        dct_interleave16(row3, row7);
+
+        // transpose pass 2
+        dct_interleave16(row0, row2);
+        dct_interleave16(row1, row3);
+        dct_interleave16(row4, row6);
+        dct_interleave16(row5, row7);
+
+        // transpose pass 3
+        dct_interleave16(row0, row1);
+        dct_interleave16(row2, row3);
+        dct_interleave16(row4, row5);
+        dct_interleave16(row6, row7);
+    }
+
+    // row pass
+    dct_pass(bias_1, 17);
+
+    {
+        // pack
+        __m128i p0 = _mm_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7
+        __m128i p1 = _mm_packus_epi16(row2, row3);
+        __m128i p2 = _mm_packus_epi16(row4, row5);
+        __m128i p3 = _mm_packus_epi16(row6, row7);
+
+        // 8bit 8x8 transpose pass 1
+        dct_interleave8(p0, p2); // a0e0a1e1...
+        dct_interleave8(p1, p3); // c0g0c1g1...
+
+        // transpose pass 2
+        dct_interleave8(p0, p1); // a0c0e0g0...
+        dct_interleave8(p2, p3); // b0d0f0h0...
+
+        // transpose pass 3
+        dct_interleave8(p0, p2); // a0b0c0d0...
+        dct_interleave8(p1, p3); // a4b4c4d4...
+
+        // store
+        _mm_storel_epi64((__m128i *)out, p0);
+        out += out_stride;
+        _mm_storel_epi64((__m128i *)out, _mm_shuffle_epi32(p0, 0x4e));
+        out += out_stride;
+        _mm_storel_epi64((__m128i *)out, p2);
+        out += out_stride;
+        _mm_storel_epi64((__m128i *)out, _mm_shuffle_epi32(p2, 0x4e));
+        out += out_stride;
+        _mm_storel_epi64((__m128i *)out, p1);
+        out += out_stride;
+        _mm_storel_epi64((__m128i *)out, _mm_shuffle_epi32(p1, 0x4e));
+        out += out_stride;
+        _mm_storel_epi64((__m128i *)out, p3);
+        out += out_stride;
+        _mm_storel_epi64((__m128i *)out, _mm_shuffle_epi32(p3, 0x4e));
+    }
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_wadd
+#undef dct_wsub
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+#endif // STBI__AVX2
+
+#endif // STBI_SSE2
+
+#ifdef STBI_NEON
+
+// NEON integer IDCT. should produce bit-identical
+// results to the generic C version.
+static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
+{
+    int16x8_t row0, row1, row2, row3, row4, row5, row6, row7;
+
+    int16x4_t rot0_0 = vdup_n_s16(stbi__f2f(0.5411961f));
+    int16x4_t rot0_1 = vdup_n_s16(stbi__f2f(-1.847759065f));
+    int16x4_t rot0_2 = vdup_n_s16(stbi__f2f(0.765366865f));
+    int16x4_t rot1_0 = vdup_n_s16(stbi__f2f(1.175875602f));
+    int16x4_t rot1_1 = vdup_n_s16(stbi__f2f(-0.899976223f));
+    int16x4_t rot1_2 = vdup_n_s16(stbi__f2f(-2.562915447f));
+    int16x4_t rot2_0 = vdup_n_s16(stbi__f2f(-1.961570560f));
+    int16x4_t rot2_1 = vdup_n_s16(stbi__f2f(-0.390180644f));
+    int16x4_t rot3_0 = vdup_n_s16(stbi__f2f(0.298631336f));
+    int16x4_t rot3_1 = vdup_n_s16(stbi__f2f(2.053119869f));
+    int16x4_t rot3_2 = vdup_n_s16(stbi__f2f(3.072711026f));
+    int16x4_t rot3_3 = vdup_n_s16(stbi__f2f(1.501321110f));
+
+#define dct_long_mul(out, inq, coeff)                        \
     int32x4_t out##_l = vmull_s16(vget_low_s16(inq), coeff); \
     int32x4_t out##_h = vmull_s16(vget_high_s16(inq), coeff)
 
@@ -3265,11 +4131,198 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
     // since we don't even allow 1<<30 pixels
 }
 
+#ifdef STBI_JPEG_THREADS
+// decode one MCU of a baseline scan, given its index in scan order
+static int stbi__jpeg_decode_mcu(stbi__jpeg *z, int mcu)
+{
+    STBI_SIMD_ALIGN(short, data[64]);
+    if (z->scan_n == 1)
+    {
+        int n = z->order[0];
+        int w = (z->img_comp[n].x + 7) >> 3;
+        int i = mcu % w, j = mcu / w;
+        int ha = z->img_comp[n].ha;
+        if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq]))
+            return 0;
+        z->img_comp[n].idct(z->img_comp[n].data + z->img_comp[n].w2 * j * z->img_comp[n].block_size + i * z->img_comp[n].block_size, z->img_comp[n].w2, data);
+    }
+    else
+    {
+        int i = mcu % z->img_mcu_x, j = mcu / z->img_mcu_x;
+        int k, x, y;
+        for (k = 0; k < z->scan_n; ++k)
+        {
+            int n = z->order[k];
+            for (y = 0; y < z->img_comp[n].v; ++y)
+            {
+                for (x = 0; x < z->img_comp[n].h; ++x)
+                {
+                    int x2 = (i * z->img_comp[n].h + x) * z->img_comp[n].block_size;
+                    int y2 = (j * z->img_comp[n].v + y) * z->img_comp[n].block_size;
+                    int ha = z->img_comp[n].ha;
+                    if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq]))
+                        return 0;
+                    z->img_comp[n].idct(z->img_comp[n].data + z->img_comp[n].w2 * y2 + x2, z->img_comp[n].w2, data);
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+typedef struct
+{
+    stbi__jpeg *z;
+    stbi__jpeg *copies; // one decoder per thread, allocated by the caller so workers never allocate
+    stbi_uc **starts; // first entropy-coded byte of every restart interval
+    stbi_uc *scan_end;
+    int segments;
+    int mcus;
+    int threads;
+    int failed[STBI__MAX_THREADS];
+} stbi__jpeg_parallel_scan;
+
+static void stbi__jpeg_decode_intervals(void *arg, int index)
+{
+    stbi__jpeg_parallel_scan *p = (stbi__jpeg_parallel_scan *)arg;
+    int share = p->segments / p->threads, extra = p->segments % p->threads;
+    int first = share * index + (index < extra ? index : extra);
+    int last = first + share + (index < extra);
+    int seg, mcu, end;
+    stbi__context s;
+    // each thread decodes with its own copy of the bit reader and dc predictors;
+    // the tables are read-only and the blocks it writes don't overlap other threads'
+    stbi__jpeg *z = p->copies + index;
+    memcpy(z, p->z, sizeof(stbi__jpeg));
+    z->s = &s;
+    for (seg = first; seg < last; ++seg)
+    {
+        stbi__start_mem(&s, p->starts[seg], (int)(p->scan_end - p->starts[seg]));
+        stbi__jpeg_reset(z);
+        end = (seg + 1) * z->restart_interval;
+        if (end > p->mcus)
+            end = p->mcus;
+        for (mcu = seg * z->restart_interval; mcu < end; ++mcu)
+        {
+            if (!stbi__jpeg_decode_mcu(z, mcu))
+            {
+                p->failed[index] = 1;
+                return;
+            }
+        }
+    }
+}
+
+// decode a baseline scan by splitting it at its restart markers. returns 0 if
+// the scan can't be split (the serial decoder should run), 1 on success, -1 on
+// a decode error.
+static int stbi__jpeg_parse_parallel(stbi__jpeg *z)
+{
+    stbi__context *s = z->s;
+    stbi__jpeg_parallel_scan p;
+    stbi_uc *c, *end;
+    int i, threads = stbi__jpeg_thread_count, result = 1;
+
+    if (threads < 2 || z->progressive || z->restart_interval <= 0 || s->read_from_callbacks || z->stream)
+        return 0;
+    if (z->scan_n == 1)
+    {
+        int n = z->order[0];
+        p.mcus = ((z->img_comp[n].x + 7) >> 3) * ((z->img_comp[n].y + 7) >> 3);
+    }
+    else
+        p.mcus = z->img_mcu_x * z->img_mcu_y;
+    p.segments = (p.mcus + z->restart_interval - 1) / z->restart_interval;
+    if (p.segments < 2)
+        return 0;
+
+    p.starts = (stbi_uc **)stbi__malloc_mad2(p.segments, sizeof(stbi_uc *), 0);
+    if (!p.starts)
+        return 0;
+
+    // find every RSTn; the first other marker ends the scan
+    c = s->img_buffer;
+    end = s->img_buffer_end;
+    p.starts[0] = c;
+    p.scan_end = end;
+    i = 1;
+    while (c < end)
+    {
+        stbi_uc *ff = (stbi_uc *)memchr(c, 0xff, (size_t)(end - c));
+        stbi_uc *m;
+        if (!ff)
+            break;
+        m = ff + 1;
+        while (m < end && *m == 0xff)
+            ++m; // fill bytes
+        if (m == end)
+            break;
+        if (*m == 0)
+        { // stuffed zero
+            c = m + 1;
+            continue;
+        }
+        if (!STBI__RESTART(*m))
+        {
+            p.scan_end = ff;
+            break;
+        }
+        if (i == p.segments)
+        { // more markers than intervals
+            i = -1;
+            break;
+        }
+        p.starts[i++] = m + 1;
+        c = m + 1;
+    }
+    if (i != p.segments)
+    {
+        STBI_FREE(p.starts);
+        return 0;
+    }
+
+    if (threads > p.segments)
+        threads = p.segments;
+    p.copies = (stbi__jpeg *)stbi__malloc_mad2(threads, sizeof(stbi__jpeg), 0);
+    if (!p.copies)
+    {
+        STBI_FREE(p.starts);
+        return 0;
+    }
+    p.z = z;
+    p.threads = threads;
+    memset(p.failed, 0, sizeof(p.failed));
+    stbi__run_parallel(stbi__jpeg_decode_intervals, &p, threads);
+    for (i = 0; i < threads; ++i)
+        if (p.failed[i])
+            result = -1;
+    STBI_FREE(p.copies);
+    STBI_FREE(p.starts);
+
+    // resume at the marker that ends the scan, like the serial decoder
+    s->img_buffer = p.scan_end;
+    stbi__jpeg_reset(z);
+    return result;
+}
+#endif // STBI_JPEG_THREADS
+
+static int stbi__jpeg_stream_rows(stbi__jpeg *z, int mcu_rows);
+static int stbi__jpeg_stream_fallback(stbi__jpeg *z);
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
     stbi__jpeg_reset(z);
+    // the ring only works if every mcu row is complete once it's decoded
+    if (z->stream && !z->progressive && z->scan_n != z->s->img_n)
+        if (!stbi__jpeg_stream_fallback(z))
+            return 0;
     if (!z->progressive)
     {
+#ifdef STBI_JPEG_THREADS
+        int parallel = stbi__jpeg_parse_parallel(z);
+        if (parallel != 0)
+            return parallel > 0 ? 1 : stbi__err("bad huffman code", "Corrupt JPEG");
+#endif
         if (z->scan_n == 1)
         {
             int i, j;
@@ -3288,7 +4341,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                     int ha = z->img_comp[n].ha;
                     if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq]))
                         return 0;
-                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * j * 8 + i * 8, z->img_comp[n].w2, data);
+                    z->img_comp[n].idct(stbi__jpeg_comp_row(z, n, j * z->img_comp[n].block_size) + i * z->img_comp[n].block_size, z->img_comp[n].w2, data);
                     // every data block is an MCU, so countdown the restart interval
                     if (--z->todo <= 0)
                     {
@@ -3301,6 +4354,9 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         stbi__jpeg_reset(z);
                     }
                 }
+                // an mcu row is v block rows tall here; the last one may be cut short
+                if (z->stream && !stbi__jpeg_stream_rows(z, j + 1 == h ? (j + z->img_comp[n].v) / z->img_comp[n].v : (j + 1) / z->img_comp[n].v))
+                    return 0;
             }
             return 1;
         }
@@ -3322,12 +4378,12 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         {
                             for (x = 0; x < z->img_comp[n].h; ++x)
                             {
-                                int x2 = (i * z->img_comp[n].h + x) * 8;
-                                int y2 = (j * z->img_comp[n].v + y) * 8;
+                                int x2 = (i * z->img_comp[n].h + x) * z->img_comp[n].block_size;
+                                int y2 = (j * z->img_comp[n].v + y) * z->img_comp[n].block_size;
                                 int ha = z->img_comp[n].ha;
                                 if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq]))
                                     return 0;
-                                z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * y2 + x2, z->img_comp[n].w2, data);
+                                z->img_comp[n].idct(stbi__jpeg_comp_row(z, n, y2) + x2, z->img_comp[n].w2, data);
                             }
                         }
                     }
@@ -3342,6 +4398,8 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         stbi__jpeg_reset(z);
                     }
                 }
+                if (z->stream && !stbi__jpeg_stream_rows(z, j + 1))
+                    return 0;
             }
             return 1;
         }
@@ -3452,7 +4510,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
                 {
                     short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                     stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * j * 8 + i * 8, z->img_comp[n].w2, data);
+                    z->img_comp[n].idct(z->img_comp[n].data + z->img_comp[n].w2 * j * z->img_comp[n].block_size + i * z->img_comp[n].block_size, z->img_comp[n].w2, data);
                 }
             }
         }
@@ -3664,7 +4722,7 @@ static int stbi__free_jpeg_components(stbi__jpeg *z, int ncomp, int why)
 static int stbi__process_frame_header(stbi__jpeg *z, int scan)
 {
     stbi__context *s = z->s;
-    int Lf, p, i, q, h_max = 1, v_max = 1, c;
+    int Lf, p, i, q, h_max = 1, v_max = 1, c, full_x, full_y;
     Lf = stbi__get16be(s);
     if (Lf < 11)
         return stbi__err("bad SOF len", "Corrupt JPEG"); // JPEG
@@ -3713,10 +4771,20 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
             return stbi__err("bad TQ", "Corrupt JPEG");
     }
 
+    // a scaled decode reports (and produces) the reduced size; block
+    // counts below still come from the full size
+    full_x = s->img_x;
+    full_y = s->img_y;
+    z->scale = stbi__jpeg_scale;
+    s->img_x = (full_x + (1 << z->scale) - 1) >> z->scale;
+    s->img_y = (full_y + (1 << z->scale) - 1) >> z->scale;
+
     if (scan != STBI__SCAN_load)
         return 1;
 
-    if (!stbi__mad3sizes_valid(s->img_x, s->img_y, s->img_n, 0))
+    // a streamed image is never whole in memory; its component buffers are
+    // checked as they're allocated below
+    if (!z->stream && !stbi__mad3sizes_valid(s->img_x, s->img_y, s->img_n, 0))
         return stbi__err("too large", "Image too large to decode");
 
     for (i = 0; i < s->img_n; ++i)
@@ -3740,17 +4808,32 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
     // compute interleaved mcu info
     z->img_h_max = h_max;
     z->img_v_max = v_max;
-    z->img_mcu_w = h_max * 8;
-    z->img_mcu_h = v_max * 8;
     // these sizes can't be more than 17 bits
-    z->img_mcu_x = (s->img_x + z->img_mcu_w - 1) / z->img_mcu_w;
-    z->img_mcu_y = (s->img_y + z->img_mcu_h - 1) / z->img_mcu_h;
+    z->img_mcu_x = (full_x + h_max * 8 - 1) / (h_max * 8);
+    z->img_mcu_y = (full_y + v_max * 8 - 1) / (v_max * 8);
+    z->img_mcu_w = (h_max * 8) >> z->scale;
+    z->img_mcu_h = (v_max * 8) >> z->scale;
 
     for (i = 0; i < s->img_n; ++i)
     {
+        // a scaled subsampled plane keeps more of its blocks (a 2x2 chroma
+        // block at 1/8 scale, say) so it still lands on the output grid and
+        // needs less upsampling; the power-of-two part of the ratio, up to
+        // the scale, is taken back
+        static void (*const reduced[4])(stbi_uc *, int, short *) = {NULL, stbi__idct_block_4x4, stbi__idct_block_2x2, stbi__idct_block_1x1};
+        int hr = h_max / z->img_comp[i].h, vr = v_max / z->img_comp[i].v, cs = z->scale;
+        while (cs > 0 && !(hr & 1) && !(vr & 1))
+        {
+            hr >>= 1;
+            vr >>= 1;
+            --cs;
+        }
+        z->img_comp[i].block_size = 8 >> cs;
+        z->img_comp[i].idct = cs ? reduced[cs] : z->idct_block_kernel;
+
         // number of effective pixels (e.g. for non-interleaved MCU)
-        z->img_comp[i].x = (s->img_x * z->img_comp[i].h + h_max - 1) / h_max;
-        z->img_comp[i].y = (s->img_y * z->img_comp[i].v + v_max - 1) / v_max;
+        z->img_comp[i].x = (full_x * z->img_comp[i].h + h_max - 1) / h_max;
+        z->img_comp[i].y = (full_y * z->img_comp[i].v + v_max - 1) / v_max;
         // to simplify generation, we'll allocate enough memory to decode
         // the bogus oversized data from using interleaved MCUs and their
         // big blocks (e.g. a 16x16 iMCU on an image of width 33); we won't
@@ -3758,22 +4841,27 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
         //
         // img_mcu_x, img_mcu_y: <=17 bits; comp[i].h and .v are <=4 (checked earlier)
         // so these muls can't overflow with 32-bit ints (which we require)
-        z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-        z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+        z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * z->img_comp[i].block_size;
+        z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * z->img_comp[i].block_size;
         z->img_comp[i].coeff = 0;
         z->img_comp[i].raw_coeff = 0;
         z->img_comp[i].linebuf = NULL;
-        z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].h2, 15);
+        // a streamed baseline image only keeps three mcu rows: the one being
+        // converted and its neighbours above and below
+        z->img_comp[i].ring = 0;
+        if (z->stream && !z->progressive && z->img_comp[i].v * z->img_comp[i].block_size * 3 < z->img_comp[i].h2)
+            z->img_comp[i].ring = z->img_comp[i].v * z->img_comp[i].block_size * 3;
+        z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].ring ? z->img_comp[i].ring : z->img_comp[i].h2, 15);
         if (z->img_comp[i].raw_data == NULL)
             return stbi__free_jpeg_components(z, i + 1, stbi__err("outofmem", "Out of memory"));
         // align blocks for idct using mmx/sse
         z->img_comp[i].data = (stbi_uc *)(((size_t)z->img_comp[i].raw_data + 15) & ~15);
         if (z->progressive)
         {
-            // w2, h2 are multiples of 8 (see above)
-            z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
-            z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
-            z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].h2, sizeof(short), 15);
+            // w2, h2 are multiples of the block size (see above)
+            z->img_comp[i].coeff_w = z->img_comp[i].w2 / z->img_comp[i].block_size;
+            z->img_comp[i].coeff_h = z->img_comp[i].h2 / z->img_comp[i].block_size;
+            z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].coeff_w * 64, z->img_comp[i].coeff_h, sizeof(short), 15);
             if (z->img_comp[i].raw_coeff == NULL)
                 return stbi__free_jpeg_components(z, i + 1, stbi__err("outofmem", "Out of memory"));
             z->img_comp[i].coeff = (short *)(((size_t)z->img_comp[i].raw_coeff + 15) & ~15);
@@ -4105,30 +5193,105 @@ static stbi_uc *stbi__resample_row_hv_2_simd(stbi_uc *out, stbi_uc *in_near, stb
 }
 #endif
 
-static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+#ifdef STBI__AVX2
+// same filter as stbi__resample_row_hv_2_simd, 16 pixels at a time
+STBI__AVX2_TARGET static stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
 {
-    // resample with nearest-neighbor
-    int i, j;
-    STBI_NOTUSED(in_far);
-    for (i = 0; i < w; ++i)
-        for (j = 0; j < hs; ++j)
-            out[i * hs + j] = in_near[i];
-    return out;
-}
+    int i = 0, t0, t1;
 
-// this is a reduced-precision calculation of YCbCr-to-RGB introduced
-// to make sure the code produces the same results in both SIMD and scalar
-#define stbi__float2fixed(x) (((int)((x) * 4096.0f + 0.5f)) << 8)
-static void stbi__YCbCr_to_RGB_row(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step)
-{
-    int i;
-    for (i = 0; i < count; ++i)
+    if (w == 1)
     {
-        int y_fixed = (y[i] << 20) + (1 << 19); // rounding
-        int r, g, b;
-        int cr = pcr[i] - 128;
-        int cb = pcb[i] - 128;
-        r = y_fixed + cr * stbi__float2fixed(1.40200f);
+        out[0] = out[1] = stbi__div4(3 * in_near[0] + in_far[0] + 2);
+        return out;
+    }
+
+    t1 = 3 * in_near[0] + in_far[0];
+    // as in the sse2 version, the last pixel in a row is left to the scalar tail
+    for (; i < ((w - 1) & ~15); i += 16)
+    {
+        // vertical pass: 3*x + y = 4*x + (y - x)
+        __m256i farw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)(in_far + i)));
+        __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)(in_near + i)));
+        __m256i diff = _mm256_sub_epi16(farw, nearw);
+        __m256i nears = _mm256_slli_epi16(nearw, 2);
+        __m256i curr = _mm256_add_epi16(nears, diff); // current row
+
+        // "prev"/"next" are curr shifted by one pixel across the whole register;
+        // alignr works per lane, so feed it the neighbouring lane
+        __m256i lo = _mm256_permute2x128_si256(curr, curr, 0x08); // 0, curr.lo
+        __m256i hi = _mm256_permute2x128_si256(curr, curr, 0x81); // curr.hi, 0
+        __m256i prv0 = _mm256_alignr_epi8(curr, lo, 14);
+        __m256i nxt0 = _mm256_alignr_epi8(hi, curr, 2);
+        __m256i prev = _mm256_insert_epi16(prv0, (short)t1, 0);
+        __m256i next = _mm256_insert_epi16(nxt0, (short)(3 * in_near[i + 16] + in_far[i + 16]), 15);
+
+        // horizontal filter, polyphase:
+        // even pixels = cur*4 + (prev - cur), odd pixels = cur*4 + (next - cur)
+        __m256i bias = _mm256_set1_epi16(8);
+        __m256i curs = _mm256_slli_epi16(curr, 2);
+        __m256i prvd = _mm256_sub_epi16(prev, curr);
+        __m256i nxtd = _mm256_sub_epi16(next, curr);
+        __m256i curb = _mm256_add_epi16(curs, bias);
+        __m256i even = _mm256_add_epi16(prvd, curb);
+        __m256i odd = _mm256_add_epi16(nxtd, curb);
+
+        // interleave even and odd pixels, then undo scaling. unpack and pack
+        // both work per lane, so the 32 output bytes come out in order
+        __m256i int0 = _mm256_unpacklo_epi16(even, odd);
+        __m256i int1 = _mm256_unpackhi_epi16(even, odd);
+        __m256i de0 = _mm256_srli_epi16(int0, 4);
+        __m256i de1 = _mm256_srli_epi16(int1, 4);
+
+        __m256i outv = _mm256_packus_epi16(de0, de1);
+        _mm256_storeu_si256((__m256i *)(out + i * 2), outv);
+
+        // "previous" value for next iter
+        t1 = 3 * in_near[i + 15] + in_far[i + 15];
+    }
+
+    t0 = t1;
+    t1 = 3 * in_near[i] + in_far[i];
+    out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+
+    for (++i; i < w; ++i)
+    {
+        t0 = t1;
+        t1 = 3 * in_near[i] + in_far[i];
+        out[i * 2 - 1] = stbi__div16(3 * t0 + t1 + 8);
+        out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+    }
+    out[w * 2 - 1] = stbi__div4(t1 + 2);
+
+    STBI_NOTUSED(hs);
+
+    return out;
+}
+#endif
+
+static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+    // resample with nearest-neighbor
+    int i, j;
+    STBI_NOTUSED(in_far);
+    for (i = 0; i < w; ++i)
+        for (j = 0; j < hs; ++j)
+            out[i * hs + j] = in_near[i];
+    return out;
+}
+
+// this is a reduced-precision calculation of YCbCr-to-RGB introduced
+// to make sure the code produces the same results in both SIMD and scalar
+#define stbi__float2fixed(x) (((int)((x) * 4096.0f + 0.5f)) << 8)
+static void stbi__YCbCr_to_RGB_row(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step)
+{
+    int i;
+    for (i = 0; i < count; ++i)
+    {
+        int y_fixed = (y[i] << 20) + (1 << 19); // rounding
+        int r, g, b;
+        int cr = pcr[i] - 128;
+        int cb = pcb[i] - 128;
+        r = y_fixed + cr * stbi__float2fixed(1.40200f);
         g = y_fixed + (cr * -stbi__float2fixed(0.71414f)) + ((cb * -stbi__float2fixed(0.34414f)) & 0xffff0000);
         b = y_fixed + cb * stbi__float2fixed(1.77200f);
         r >>= 20;
@@ -4321,6 +5484,91 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI__AVX2
+// the sse2 transform on 16 pixels at a time. unlike the sse2 version this
+// also handles step == 3, which is what 3-channel loads use: pixels are
+// built as RGBX and squeezed per 128-bit lane, and the overlapping stores
+// need two pixels of room after each group.
+STBI__AVX2_TARGET static void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+    int i = 0;
+
+    if (step == 3 || step == 4)
+    {
+        __m256i signflip = _mm256_set1_epi16(-0x8000);
+        __m256i cr_const0 = _mm256_set1_epi16((short)(1.40200f * 4096.0f + 0.5f));
+        __m256i cr_const1 = _mm256_set1_epi16(-(short)(0.71414f * 4096.0f + 0.5f));
+        __m256i cb_const0 = _mm256_set1_epi16(-(short)(0.34414f * 4096.0f + 0.5f));
+        __m256i cb_const1 = _mm256_set1_epi16((short)(1.77200f * 4096.0f + 0.5f));
+        __m256i y_bias = _mm256_set1_epi16(128);
+        __m256i xw = _mm256_set1_epi16(255); // alpha channel
+        __m256i rgb_shuf = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        for (; i + 15 + (step == 3 ? 2 : 0) < count; i += 16)
+        {
+            // load and unpack to short, the same layout the sse2 unpacks give:
+            // y is (y << 8) + 128, cr/cb are (c - 128) << 8
+            __m256i yb = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)(y + i)));
+            __m256i crb = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)(pcr + i)));
+            __m256i cbb = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)(pcb + i)));
+            __m256i yw = _mm256_or_si256(_mm256_slli_epi16(yb, 8), y_bias);
+            __m256i crw = _mm256_xor_si256(_mm256_slli_epi16(crb, 8), signflip);
+            __m256i cbw = _mm256_xor_si256(_mm256_slli_epi16(cbb, 8), signflip);
+
+            // color transform
+            __m256i yws = _mm256_srli_epi16(yw, 4);
+            __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+            __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+            __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+            __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+            __m256i rws = _mm256_add_epi16(cr0, yws);
+            __m256i gwt = _mm256_add_epi16(cb0, yws);
+            __m256i bws = _mm256_add_epi16(yws, cb1);
+            __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+            // descale
+            __m256i rw = _mm256_srai_epi16(rws, 4);
+            __m256i bw = _mm256_srai_epi16(bws, 4);
+            __m256i gw = _mm256_srai_epi16(gws, 4);
+
+            // back to byte, set up for transpose
+            __m256i brb = _mm256_packus_epi16(rw, bw);
+            __m256i gxb = _mm256_packus_epi16(gw, xw);
+
+            // transpose to interleave channels; each lane holds 8 pixels, so
+            // o0 is pixels 0-3 | 8-11 and o1 is 4-7 | 12-15
+            __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+            __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+            __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+            __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+            __m256i p0 = _mm256_permute2x128_si256(o0, o1, 0x20); // pixels 0-7
+            __m256i p1 = _mm256_permute2x128_si256(o0, o1, 0x31); // pixels 8-15
+
+            // store
+            if (step == 4)
+            {
+                _mm256_storeu_si256((__m256i *)(out + 0), p0);
+                _mm256_storeu_si256((__m256i *)(out + 32), p1);
+                out += 64;
+            }
+            else
+            {
+                __m256i q0 = _mm256_shuffle_epi8(p0, rgb_shuf);
+                __m256i q1 = _mm256_shuffle_epi8(p1, rgb_shuf);
+                _mm_storeu_si128((__m128i *)(out + 0), _mm256_castsi256_si128(q0));
+                _mm_storeu_si128((__m128i *)(out + 12), _mm256_extracti128_si256(q0, 1));
+                _mm_storeu_si128((__m128i *)(out + 24), _mm256_castsi256_si128(q1));
+                _mm_storeu_si128((__m128i *)(out + 36), _mm256_extracti128_si256(q1, 1));
+                out += 48;
+            }
+        }
+    }
+
+    stbi__YCbCr_to_RGB_simd(out, y + i, pcb + i, pcr + i, count - i, step);
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
@@ -4337,6 +5585,15 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
     }
 #endif
 
+#ifdef STBI__AVX2
+    if (stbi__avx2_available())
+    {
+        j->idct_block_kernel = stbi__idct_avx2;
+        j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+        j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+    }
+#endif
+
 #ifdef STBI_NEON
     j->idct_block_kernel = stbi__idct_simd;
     j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -4367,21 +5624,247 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
     return (stbi_uc)((t + (t >> 8)) >> 8);
 }
 
-static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
+// resample and color-convert rows [j0, j1) of the image into output, which
+// holds row j0 first; linebuf[k] is scratch space for component k. like the
+// rest of the converter this may write one byte past the last row.
+static void stbi__jpeg_convert_rows(stbi__jpeg *z, const stbi__resample *res_comp, stbi_uc **linebuf, stbi_uc *output,
+                                    int n, int decode_n, int is_rgb, unsigned int j0, unsigned int j1)
 {
-    int n, decode_n, is_rgb;
-    z->s->img_n = 0; // make stbi__cleanup_jpeg safe
+    int k;
+    unsigned int i, j;
+    stbi_uc *coutput[4] = {NULL, NULL, NULL, NULL};
+    stbi__resample res[4];
+    int rows_out[4]; // component rows at the output scale
 
-    // validate req_comp
-    if (req_comp < 0 || req_comp > 4)
-        return stbi__errpuc("bad req_comp", "Internal error");
+    // put each resampler where it would be after rows 0..j0-1
+    for (k = 0; k < decode_n; ++k)
+    {
+        stbi__resample *r = &res[k];
+        int rows = rows_out[k] = (z->img_comp[k].y * z->img_comp[k].block_size + 7) >> 3;
+        int t = (res_comp[k].vs >> 1) + (int)j0;
+        *r = res_comp[k];
+        r->ystep = t % r->vs;
+        r->ypos = t / r->vs;
+        r->line1 = stbi__jpeg_comp_row(z, k, r->ypos < rows ? r->ypos : rows - 1);
+        r->line0 = stbi__jpeg_comp_row(z, k, r->ypos == 0 ? 0 : r->ypos - 1 < rows ? r->ypos - 1 : rows - 1);
+    }
 
-    // load a jpeg image from whichever source, but leave in YCbCr format
-    if (!stbi__decode_jpeg_image(z))
+    for (j = j0; j < j1; ++j)
     {
-        stbi__cleanup_jpeg(z);
-        return NULL;
+        stbi_uc *out = output + n * z->s->img_x * (j - j0);
+        for (k = 0; k < decode_n; ++k)
+        {
+            stbi__resample *r = &res[k];
+            int y_bot = r->ystep >= (r->vs >> 1);
+            coutput[k] = r->resample(linebuf[k],
+                                     y_bot ? r->line1 : r->line0,
+                                     y_bot ? r->line0 : r->line1,
+                                     r->w_lores, r->hs);
+            if (++r->ystep >= r->vs)
+            {
+                r->ystep = 0;
+                r->line0 = r->line1;
+                if (++r->ypos < rows_out[k])
+                    r->line1 = stbi__jpeg_comp_row(z, k, r->ypos);
+            }
+        }
+        if (n >= 3)
+        {
+            stbi_uc *y = coutput[0];
+            if (z->s->img_n == 3)
+            {
+                if (is_rgb)
+                {
+                    for (i = 0; i < z->s->img_x; ++i)
+                    {
+                        out[0] = y[i];
+                        out[1] = coutput[1][i];
+                        out[2] = coutput[2][i];
+                        out[3] = 255;
+                        out += n;
+                    }
+                }
+                else
+                {
+                    z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                }
+            }
+            else if (z->s->img_n == 4)
+            {
+                if (z->app14_color_transform == 0)
+                { // CMYK
+                    for (i = 0; i < z->s->img_x; ++i)
+                    {
+                        stbi_uc m = coutput[3][i];
+                        out[0] = stbi__blinn_8x8(coutput[0][i], m);
+                        out[1] = stbi__blinn_8x8(coutput[1][i], m);
+                        out[2] = stbi__blinn_8x8(coutput[2][i], m);
+                        out[3] = 255;
+                        out += n;
+                    }
+                }
+                else if (z->app14_color_transform == 2)
+                { // YCCK
+                    z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                    for (i = 0; i < z->s->img_x; ++i)
+                    {
+                        stbi_uc m = coutput[3][i];
+                        out[0] = stbi__blinn_8x8(255 - out[0], m);
+                        out[1] = stbi__blinn_8x8(255 - out[1], m);
+                        out[2] = stbi__blinn_8x8(255 - out[2], m);
+                        out += n;
+                    }
+                }
+                else
+                { // YCbCr + alpha?  Ignore the fourth channel for now
+                    z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                }
+            }
+            else
+                for (i = 0; i < z->s->img_x; ++i)
+                {
+                    out[0] = out[1] = out[2] = y[i];
+                    out[3] = 255; // not used if n==3
+                    out += n;
+                }
+        }
+        else
+        {
+            if (is_rgb)
+            {
+                if (n == 1)
+                    for (i = 0; i < z->s->img_x; ++i)
+                        *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                else
+                {
+                    for (i = 0; i < z->s->img_x; ++i, out += 2)
+                    {
+                        out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                        out[1] = 255;
+                    }
+                }
+            }
+            else if (z->s->img_n == 4 && z->app14_color_transform == 0)
+            {
+                for (i = 0; i < z->s->img_x; ++i)
+                {
+                    stbi_uc m = coutput[3][i];
+                    stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
+                    stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
+                    stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
+                    out[0] = stbi__compute_y(r, g, b);
+                    out[1] = 255;
+                    out += n;
+                }
+            }
+            else if (z->s->img_n == 4 && z->app14_color_transform == 2)
+            {
+                for (i = 0; i < z->s->img_x; ++i)
+                {
+                    out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+                    out[1] = 255;
+                    out += n;
+                }
+            }
+            else
+            {
+                stbi_uc *y = coutput[0];
+                if (n == 1)
+                    for (i = 0; i < z->s->img_x; ++i)
+                        out[i] = y[i];
+                else
+                    for (i = 0; i < z->s->img_x; ++i)
+                    {
+                        *out++ = y[i];
+                        *out++ = 255;
+                    }
+            }
+        }
+    }
+}
+
+#ifdef STBI_JPEG_THREADS
+typedef struct
+{
+    stbi__jpeg *z;
+    const stbi__resample *res_comp;
+    stbi_uc *output;
+    stbi_uc *linebufs; // line buffers for bands 1..bands-1
+    stbi_uc *lastrows; // last row of bands 0..bands-2
+    int n, decode_n, is_rgb, bands;
+} stbi__jpeg_convert_job;
+
+static void stbi__jpeg_convert_band(void *arg, int index)
+{
+    stbi__jpeg_convert_job *job = (stbi__jpeg_convert_job *)arg;
+    stbi__jpeg *z = job->z;
+    size_t stride = (size_t)job->n * z->s->img_x;
+    unsigned int j0 = z->s->img_y * index / job->bands;
+    unsigned int j1 = z->s->img_y * (index + 1) / job->bands;
+    stbi_uc *linebuf[4];
+    int k;
+    for (k = 0; k < job->decode_n; ++k)
+    {
+        if (index == 0)
+            linebuf[k] = z->img_comp[k].linebuf;
+        else
+            linebuf[k] = job->linebufs + ((index - 1) * job->decode_n + k) * (z->s->img_x + 3);
+    }
+    if (index == job->bands - 1)
+    {
+        stbi__jpeg_convert_rows(z, job->res_comp, linebuf, job->output + stride * j0, job->n, job->decode_n, job->is_rgb, j0, j1);
+        return;
     }
+    // the converter can write a byte past its last row, which belongs to the
+    // next band, so that row goes to a side buffer and is copied in afterwards
+    stbi__jpeg_convert_rows(z, job->res_comp, linebuf, job->output + stride * j0, job->n, job->decode_n, job->is_rgb, j0, j1 - 1);
+    stbi__jpeg_convert_rows(z, job->res_comp, linebuf, job->lastrows + (stride + 1) * index, job->n, job->decode_n, job->is_rgb, j1 - 1, j1);
+}
+
+// split the output rows into bands converted on separate threads; returns 0
+// if the image is too small for that to pay off
+static int stbi__jpeg_convert_parallel(stbi__jpeg *z, const stbi__resample *res_comp, stbi_uc *output, int n, int decode_n, int is_rgb)
+{
+    stbi__jpeg_convert_job job;
+    size_t stride = (size_t)n * z->s->img_x;
+    int min_rows = 65536 / z->s->img_x + 1; // ~64K pixels per band at least
+    int i, bands = stbi__jpeg_thread_count;
+    if (bands > (int)(z->s->img_y / min_rows))
+        bands = (int)(z->s->img_y / min_rows);
+    if (bands < 2)
+        return 0;
+    job.linebufs = (stbi_uc *)stbi__malloc_mad3(bands - 1, decode_n, z->s->img_x + 3, 0);
+    job.lastrows = (stbi_uc *)stbi__malloc_mad3(bands - 1, n, z->s->img_x, bands - 1);
+    if (!job.linebufs || !job.lastrows)
+    {
+        STBI_FREE(job.linebufs);
+        STBI_FREE(job.lastrows);
+        return 0;
+    }
+    job.z = z;
+    job.res_comp = res_comp;
+    job.output = output;
+    job.n = n;
+    job.decode_n = decode_n;
+    job.is_rgb = is_rgb;
+    job.bands = bands;
+    stbi__run_parallel(stbi__jpeg_convert_band, &job, bands);
+    for (i = 0; i < bands - 1; ++i)
+    {
+        unsigned int row = z->s->img_y * (i + 1) / bands - 1;
+        memcpy(output + stride * row, job.lastrows + (stride + 1) * i, stride);
+    }
+    STBI_FREE(job.linebufs);
+    STBI_FREE(job.lastrows);
+    return 1;
+}
+#endif // STBI_JPEG_THREADS
+
+// pick the number of output components and set up the resampler and line
+// buffer of every component that gets decoded
+static int stbi__jpeg_setup_resample(stbi__jpeg *z, int req_comp, stbi__resample *res_comp, int *out_n, int *out_decode_n, int *out_is_rgb)
+{
+    int k, n, decode_n, is_rgb;
 
     // determine actual number of components to generate
     n = req_comp ? req_comp : z->s->img_n >= 3 ? 3
@@ -4397,6 +5880,56 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
     // nothing to do if no components requested; check this now to avoid
     // accessing uninitialized coutput[0] later
     if (decode_n <= 0)
+        return 0;
+
+    for (k = 0; k < decode_n; ++k)
+    {
+        stbi__resample *r = &res_comp[k];
+
+        // allocate line buffer big enough for upsampling off the edges
+        // with upsample factor of 4
+        z->img_comp[k].linebuf = (stbi_uc *)stbi__malloc(z->s->img_x + 3);
+        if (!z->img_comp[k].linebuf)
+            return stbi__err("outofmem", "Out of memory");
+
+        // output pixels per plane sample; only differs from the
+        // subsampling ratio when scaled (see stbi__process_frame_header)
+        r->hs = (z->img_h_max * 8 >> z->scale) / (z->img_comp[k].h * z->img_comp[k].block_size);
+        r->vs = (z->img_v_max * 8 >> z->scale) / (z->img_comp[k].v * z->img_comp[k].block_size);
+        r->ystep = r->vs >> 1;
+        r->w_lores = (z->s->img_x + r->hs - 1) / r->hs;
+        r->ypos = 0;
+        r->line0 = r->line1 = z->img_comp[k].data;
+
+        if (r->hs == 1 && r->vs == 1)
+            r->resample = resample_row_1;
+        else if (r->hs == 1 && r->vs == 2)
+            r->resample = stbi__resample_row_v_2;
+        else if (r->hs == 2 && r->vs == 1)
+            r->resample = stbi__resample_row_h_2;
+        else if (r->hs == 2 && r->vs == 2)
+            r->resample = z->resample_row_hv_2_kernel;
+        else
+            r->resample = stbi__resample_row_generic;
+    }
+
+    *out_n = n;
+    *out_decode_n = decode_n;
+    *out_is_rgb = is_rgb;
+    return 1;
+}
+
+static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
+{
+    int n, decode_n, is_rgb;
+    z->s->img_n = 0; // make stbi__cleanup_jpeg safe
+
+    // validate req_comp
+    if (req_comp < 0 || req_comp > 4)
+        return stbi__errpuc("bad req_comp", "Internal error");
+
+    // load a jpeg image from whichever source, but leave in YCbCr format
+    if (!stbi__decode_jpeg_image(z))
     {
         stbi__cleanup_jpeg(z);
         return NULL;
@@ -4405,42 +5938,13 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
     // resample and color-convert
     {
         int k;
-        unsigned int i, j;
         stbi_uc *output;
-        stbi_uc *coutput[4] = {NULL, NULL, NULL, NULL};
-
         stbi__resample res_comp[4];
 
-        for (k = 0; k < decode_n; ++k)
+        if (!stbi__jpeg_setup_resample(z, req_comp, res_comp, &n, &decode_n, &is_rgb))
         {
-            stbi__resample *r = &res_comp[k];
-
-            // allocate line buffer big enough for upsampling off the edges
-            // with upsample factor of 4
-            z->img_comp[k].linebuf = (stbi_uc *)stbi__malloc(z->s->img_x + 3);
-            if (!z->img_comp[k].linebuf)
-            {
-                stbi__cleanup_jpeg(z);
-                return stbi__errpuc("outofmem", "Out of memory");
-            }
-
-            r->hs = z->img_h_max / z->img_comp[k].h;
-            r->vs = z->img_v_max / z->img_comp[k].v;
-            r->ystep = r->vs >> 1;
-            r->w_lores = (z->s->img_x + r->hs - 1) / r->hs;
-            r->ypos = 0;
-            r->line0 = r->line1 = z->img_comp[k].data;
-
-            if (r->hs == 1 && r->vs == 1)
-                r->resample = resample_row_1;
-            else if (r->hs == 1 && r->vs == 2)
-                r->resample = stbi__resample_row_v_2;
-            else if (r->hs == 2 && r->vs == 1)
-                r->resample = stbi__resample_row_h_2;
-            else if (r->hs == 2 && r->vs == 2)
-                r->resample = z->resample_row_hv_2_kernel;
-            else
-                r->resample = stbi__resample_row_generic;
+            stbi__cleanup_jpeg(z);
+            return NULL;
         }
 
         // can't error after this so, this is safe
@@ -4452,145 +5956,139 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
         }
 
         // now go ahead and resample
-        for (j = 0; j < z->s->img_y; ++j)
+#ifdef STBI_JPEG_THREADS
+        if (!stbi__jpeg_convert_parallel(z, res_comp, output, n, decode_n, is_rgb))
+#endif
         {
-            stbi_uc *out = output + n * z->s->img_x * j;
+            stbi_uc *linebuf[4];
             for (k = 0; k < decode_n; ++k)
-            {
-                stbi__resample *r = &res_comp[k];
-                int y_bot = r->ystep >= (r->vs >> 1);
-                coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                         y_bot ? r->line1 : r->line0,
-                                         y_bot ? r->line0 : r->line1,
-                                         r->w_lores, r->hs);
-                if (++r->ystep >= r->vs)
-                {
-                    r->ystep = 0;
-                    r->line0 = r->line1;
-                    if (++r->ypos < z->img_comp[k].y)
-                        r->line1 += z->img_comp[k].w2;
-                }
-            }
-            if (n >= 3)
-            {
-                stbi_uc *y = coutput[0];
-                if (z->s->img_n == 3)
-                {
-                    if (is_rgb)
-                    {
-                        for (i = 0; i < z->s->img_x; ++i)
-                        {
-                            out[0] = y[i];
-                            out[1] = coutput[1][i];
-                            out[2] = coutput[2][i];
-                            out[3] = 255;
-                            out += n;
-                        }
-                    }
-                    else
-                    {
-                        z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                    }
-                }
-                else if (z->s->img_n == 4)
-                {
-                    if (z->app14_color_transform == 0)
-                    { // CMYK
-                        for (i = 0; i < z->s->img_x; ++i)
-                        {
-                            stbi_uc m = coutput[3][i];
-                            out[0] = stbi__blinn_8x8(coutput[0][i], m);
-                            out[1] = stbi__blinn_8x8(coutput[1][i], m);
-                            out[2] = stbi__blinn_8x8(coutput[2][i], m);
-                            out[3] = 255;
-                            out += n;
-                        }
-                    }
-                    else if (z->app14_color_transform == 2)
-                    { // YCCK
-                        z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                        for (i = 0; i < z->s->img_x; ++i)
-                        {
-                            stbi_uc m = coutput[3][i];
-                            out[0] = stbi__blinn_8x8(255 - out[0], m);
-                            out[1] = stbi__blinn_8x8(255 - out[1], m);
-                            out[2] = stbi__blinn_8x8(255 - out[2], m);
-                            out += n;
-                        }
-                    }
-                    else
-                    { // YCbCr + alpha?  Ignore the fourth channel for now
-                        z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                    }
-                }
-                else
-                    for (i = 0; i < z->s->img_x; ++i)
-                    {
-                        out[0] = out[1] = out[2] = y[i];
-                        out[3] = 255; // not used if n==3
-                        out += n;
-                    }
-            }
-            else
-            {
-                if (is_rgb)
-                {
-                    if (n == 1)
-                        for (i = 0; i < z->s->img_x; ++i)
-                            *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                    else
-                    {
-                        for (i = 0; i < z->s->img_x; ++i, out += 2)
-                        {
-                            out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                            out[1] = 255;
-                        }
-                    }
-                }
-                else if (z->s->img_n == 4 && z->app14_color_transform == 0)
-                {
-                    for (i = 0; i < z->s->img_x; ++i)
-                    {
-                        stbi_uc m = coutput[3][i];
-                        stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
-                        stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
-                        stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
-                        out[0] = stbi__compute_y(r, g, b);
-                        out[1] = 255;
-                        out += n;
-                    }
-                }
-                else if (z->s->img_n == 4 && z->app14_color_transform == 2)
-                {
-                    for (i = 0; i < z->s->img_x; ++i)
-                    {
-                        out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-                        out[1] = 255;
-                        out += n;
-                    }
-                }
-                else
-                {
-                    stbi_uc *y = coutput[0];
-                    if (n == 1)
-                        for (i = 0; i < z->s->img_x; ++i)
-                            out[i] = y[i];
-                    else
-                        for (i = 0; i < z->s->img_x; ++i)
-                        {
-                            *out++ = y[i];
-                            *out++ = 255;
-                        }
-                }
-            }
+                linebuf[k] = z->img_comp[k].linebuf;
+            stbi__jpeg_convert_rows(z, res_comp, linebuf, output, n, decode_n, is_rgb, 0, z->s->img_y);
         }
         stbi__cleanup_jpeg(z);
         *out_x = z->s->img_x;
         *out_y = z->s->img_y;
         if (comp)
-            *comp = z->s->img_n >= 3 ? 3 : 1; // report original components, not output
-        return output;
+            *comp = z->s->img_n >= 3 ? 3 : 1; // report original components, not output
+        return output;
+    }
+}
+
+// row-streaming state: output rows are converted one mcu row at a time, each
+// once the mcu row below it has been decoded into the component rings
+typedef struct stbi__jpeg_stream
+{
+    stbi__row_sink *sink;
+    int req_comp;
+    int ready; // resamplers are set up
+    int whole; // separate scans: nothing is converted until the image is complete
+    int n, decode_n, is_rgb;
+    stbi__resample res_comp[4];
+    stbi_uc *rows; // one mcu row of output
+    unsigned int next_row;
+} stbi__jpeg_stream;
+
+// called with the number of mcu rows decoded so far, or -1 once the image is
+// complete
+static int stbi__jpeg_stream_rows(stbi__jpeg *z, int mcu_rows)
+{
+    stbi__jpeg_stream *st = z->stream;
+    unsigned int end = z->s->img_y;
+    stbi_uc *linebuf[4];
+    int k;
+
+    if (mcu_rows >= 0)
+    {
+        if (st->whole)
+            return 1;
+        // the newest mcu row's top rows are still needed below the one before it
+        unsigned int ready = mcu_rows > 0 ? (unsigned int)(mcu_rows - 1) * z->img_mcu_h : 0;
+        if (ready < end)
+            end = ready;
+    }
+    if (st->next_row >= end)
+        return 1;
+
+    if (!st->ready)
+    {
+        if (!stbi__jpeg_setup_resample(z, st->req_comp, st->res_comp, &st->n, &st->decode_n, &st->is_rgb))
+            return 0;
+        // the converters write one byte past the last row
+        st->rows = (stbi_uc *)stbi__malloc_mad3(st->n, z->s->img_x, z->img_mcu_h, 1);
+        if (!st->rows)
+            return stbi__err("outofmem", "Out of memory");
+        st->sink->row_bytes = st->n * z->s->img_x;
+        st->ready = 1;
+    }
+
+    for (k = 0; k < st->decode_n; ++k)
+        linebuf[k] = z->img_comp[k].linebuf;
+    while (st->next_row < end)
+    {
+        unsigned int j1 = st->next_row + z->img_mcu_h;
+        if (j1 > end)
+            j1 = end;
+        stbi__jpeg_convert_rows(z, st->res_comp, linebuf, st->rows, st->n, st->decode_n, st->is_rgb, st->next_row, j1);
+        if (!stbi__sink_write(st->sink, st->rows, (int)(j1 - st->next_row), j1 == z->s->img_y))
+            return 0;
+        st->next_row = j1;
+    }
+    return 1;
+}
+
+// a baseline image with one scan per component can't be converted until the
+// last scan, so it goes back to whole planes and is converted at the end
+static int stbi__jpeg_stream_fallback(stbi__jpeg *z)
+{
+    int i;
+    if (z->stream->next_row > 0)
+        return stbi__err("bad scan", "Corrupt JPEG");
+    for (i = 0; i < z->s->img_n; ++i)
+    {
+        if (!z->img_comp[i].ring)
+            continue;
+        STBI_FREE(z->img_comp[i].raw_data);
+        z->img_comp[i].ring = 0;
+        z->img_comp[i].data = NULL;
+        z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].h2, 15);
+        if (z->img_comp[i].raw_data == NULL)
+            return stbi__err("outofmem", "Out of memory");
+        z->img_comp[i].data = (stbi_uc *)(((size_t)z->img_comp[i].raw_data + 15) & ~15);
+    }
+    z->stream->whole = 1;
+    return 1;
+}
+
+static int stbi__jpeg_load_rows(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__row_sink *sink)
+{
+    int result;
+    stbi__jpeg_stream st;
+    stbi__jpeg *j = (stbi__jpeg *)stbi__malloc(sizeof(stbi__jpeg));
+    if (!j)
+        return stbi__err("outofmem", "Out of memory");
+    memset(j, 0, sizeof(stbi__jpeg));
+    memset(&st, 0, sizeof(st));
+    st.sink = sink;
+    st.req_comp = req_comp;
+    j->s = s;
+    j->stream = &st;
+    stbi__setup_jpeg(j);
+    s->img_n = 0; // make stbi__cleanup_jpeg safe
+
+    // progressive images get no callbacks while decoding and are converted
+    // from their full planes here; baseline ones just finish their last rows
+    result = stbi__decode_jpeg_image(j) && stbi__jpeg_stream_rows(j, -1) && stbi__sink_flush(sink);
+    if (result)
+    {
+        *x = s->img_x;
+        *y = s->img_y;
+        if (comp)
+            *comp = s->img_n >= 3 ? 3 : 1;
     }
+    stbi__cleanup_jpeg(j);
+    STBI_FREE(st.rows);
+    STBI_FREE(j);
+    return result;
 }
 
 static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
@@ -4608,6 +6106,72 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
     return result;
 }
 
+static int stbi__load_jpeg_planes_main(stbi__context *s, int *x, int *y, int *plane_count, stbi_plane planes[3])
+{
+    int k, n, result;
+    stbi__jpeg *j = (stbi__jpeg *)stbi__malloc(sizeof(stbi__jpeg));
+    if (!j)
+        return stbi__err("outofmem", "Out of memory");
+    memset(j, 0, sizeof(stbi__jpeg));
+    j->s = s;
+    stbi__setup_jpeg(j);
+    s->img_n = 0; // make stbi__cleanup_jpeg safe
+    result = stbi__decode_jpeg_image(j);
+    n = s->img_n;
+    // same test as stbi__jpeg_setup_resample's is_rgb, plus CMYK/YCCK
+    if (result && n != 1 && (n != 3 || j->rgb == 3 || (j->app14_color_transform == 0 && !j->jfif)))
+        result = stbi__err("not YCbCr", "JPEG isn't greyscale or YCbCr");
+    if (result)
+    {
+        for (k = 0; k < n; ++k)
+        {
+            stbi_plane *p = &planes[k];
+            int bs = j->img_comp[k].block_size;
+            p->data = j->img_comp[k].data;
+            p->raw = j->img_comp[k].raw_data;
+            p->w = (j->img_comp[k].x * bs + 7) >> 3;
+            p->h = (j->img_comp[k].y * bs + 7) >> 3;
+            p->stride = j->img_comp[k].w2;
+            p->hs = (j->img_h_max * 8 >> j->scale) / (j->img_comp[k].h * bs);
+            p->vs = (j->img_v_max * 8 >> j->scale) / (j->img_comp[k].v * bs);
+            // handed over; stbi__cleanup_jpeg frees the rest
+            j->img_comp[k].raw_data = NULL;
+            j->img_comp[k].data = NULL;
+        }
+        *x = s->img_x;
+        *y = s->img_y;
+        *plane_count = n;
+    }
+    stbi__cleanup_jpeg(j);
+    STBI_FREE(j);
+    return result;
+}
+
+STBIDEF int stbi_load_jpeg_planes_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *plane_count, stbi_plane planes[3])
+{
+    stbi__context s;
+    stbi__start_mem(&s, buffer, len);
+    return stbi__load_jpeg_planes_main(&s, x, y, plane_count, planes);
+}
+
+STBIDEF int stbi_load_jpeg_planes_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *plane_count, stbi_plane planes[3])
+{
+    stbi__context s;
+    stbi__start_callbacks(&s, (stbi_io_callbacks *)clbk, user);
+    return stbi__load_jpeg_planes_main(&s, x, y, plane_count, planes);
+}
+
+STBIDEF void stbi_jpeg_planes_free(stbi_plane *planes, int plane_count)
+{
+    int k;
+    for (k = 0; k < plane_count; ++k)
+    {
+        STBI_FREE(planes[k].raw);
+        planes[k].raw = NULL;
+        planes[k].data = NULL;
+    }
+}
+
 static int stbi__jpeg_test(stbi__context *s)
 {
     int r;
@@ -4659,6 +6223,11 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 //      - all output is written to a single output buffer (can malloc/realloc)
 //    performance
 //      - fast huffman
+//      - away from the ends of the input and output buffers, huffman blocks
+//        are decoded by a fast loop: 64-bit bit buffer refilled branchlessly,
+//        a literal/length table that resolves up to two literals per lookup,
+//        and 8-byte match copies. near the ends it falls back to the careful
+//        symbol-at-a-time loop, which handles eof and output growth.
 
 #ifndef STBI_NO_ZLIB
 
@@ -4667,6 +6236,20 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #define STBI__ZFAST_MASK ((1 << STBI__ZFAST_BITS) - 1)
 #define STBI__ZNSYMS 288 // number of symbols in literal/length alphabet
 
+// literal/length table for the fast loop; entries are
+//    bits  0-15  symbol, or two literals (first in the low byte)
+//    bits 16-19  length of the first code
+//    bits 20-24  bits consumed by the whole entry
+//    bits 28-29  number of symbols (0 = code longer than STBI__ZLIT_BITS)
+#define STBI__ZLIT_BITS 11
+#define STBI__ZLIT_MASK ((1 << STBI__ZLIT_BITS) - 1)
+
+// the fast loop runs while one iteration can't run off either buffer: it
+// refills by reading 8 bytes, and writes at most a 258-byte match rounded
+// up to 8-byte chunks
+#define STBI__ZFAST_IN_MARGIN 8
+#define STBI__ZFAST_OUT_MARGIN (258 + 16)
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
@@ -4753,9 +6336,9 @@ static int stbi__zbuild_huffman(stbi__zhuffman *z, const stbi_uc *sizelist, int
 //    because PNG allows splitting the zlib stream arbitrarily,
 //    and it's annoying structurally to have PNG call ZLIB call PNG,
 //    we require PNG read all the IDATs and combine them into a single
-//    memory buffer
+//    memory buffer (except when streaming rows, see zrefill)
 
-typedef struct
+typedef struct stbi__zbuf_s
 {
     stbi_uc *zbuffer, *zbuffer_end;
     int num_bits;
@@ -4768,11 +6351,22 @@ typedef struct
     int z_expandable;
 
     stbi__zhuffman z_length, z_distance;
+    stbi__uint32 z_lit[1 << STBI__ZLIT_BITS];
+
+    // streaming (PNG row streaming only): zrefill points zbuffer at the next
+    // piece of input once one runs out; zdrain consumes output from zdrained
+    // on, after which all but the last 32K of what it took can be dropped
+    int (*zrefill)(struct stbi__zbuf_s *z);
+    int (*zdrain)(struct stbi__zbuf_s *z);
+    char *zdrained;
+    void *zuser;
 } stbi__zbuf;
 
 stbi_inline static int stbi__zeof(stbi__zbuf *z)
 {
-    return (z->zbuffer >= z->zbuffer_end);
+    if (z->zbuffer < z->zbuffer_end)
+        return 0;
+    return !z->zrefill || !z->zrefill(z);
 }
 
 stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
@@ -4787,6 +6381,7 @@ static void stbi__fill_bits(stbi__zbuf *z)
         if (z->code_buffer >= (1U << z->num_bits))
         {
             z->zbuffer = z->zbuffer_end; /* treat this as EOF so we fail. */
+            z->zrefill = NULL;
             return;
         }
         z->code_buffer |= (unsigned int)stbi__zget8(z) << z->num_bits;
@@ -4868,8 +6463,30 @@ stbi_inline static int stbi__zhuffman_decode(stbi__zbuf *a, stbi__zhuffman *z)
 static int stbi__zexpand(stbi__zbuf *z, char *zout, int n) // need to make room for n bytes
 {
     char *q;
-    unsigned int cur, limit, old_limit;
+    unsigned int cur, limit, old_limit, drained = 0;
     z->zout = zout;
+    if (z->zdrain)
+    {
+        // hand the consumer what it can take, then slide everything from the
+        // start of the 32K window (or of what it left) back to the front
+        unsigned int keep;
+        if (!z->zdrain(z))
+            return 0;
+        cur = (unsigned int)(z->zout - z->zout_start);
+        keep = cur > 32768 ? cur - 32768 : 0;
+        if (keep > (unsigned int)(z->zdrained - z->zout_start))
+            keep = (unsigned int)(z->zdrained - z->zout_start);
+        if (keep)
+        {
+            memmove(z->zout_start, z->zout_start + keep, cur - keep);
+            z->zout -= keep;
+            z->zdrained -= keep;
+        }
+        if (z->zout + n <= z->zout_end)
+            return 1;
+        // kept as an offset, zdrained isn't read again until it points into the new buffer
+        drained = (unsigned int)(z->zdrained - z->zout_start);
+    }
     if (!z->z_expandable)
         return stbi__err("output buffer limit", "Corrupt PNG");
     cur = (unsigned int)(z->zout - z->zout_start);
@@ -4889,6 +6506,7 @@ static int stbi__zexpand(stbi__zbuf *z, char *zout, int n) // need to make room
     z->zout_start = q;
     z->zout = q + cur;
     z->zout_end = q + limit;
+    z->zdrained = q + drained;
     return 1;
 }
 
@@ -4906,12 +6524,233 @@ static const int stbi__zdist_base[32] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49
 static const int stbi__zdist_extra[32] =
     {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
 
+// build a->z_lit for the literal/length code lengths that a->z_length was
+// just built from: one entry per STBI__ZLIT_BITS-bit index, holding a second
+// literal too when both codes fit in the index
+static void stbi__zbuild_lit_table(stbi__zbuf *a, const stbi_uc *sizelist, int num)
+{
+    int i, j, next_code[16];
+    memset(a->z_lit, 0, sizeof(a->z_lit));
+    for (i = 1; i < 16; ++i)
+        next_code[i] = a->z_length.firstcode[i];
+    for (i = 0; i < num; ++i)
+    {
+        int s = sizelist[i];
+        if (s)
+        {
+            int code = next_code[s]++;
+            if (s <= STBI__ZLIT_BITS)
+            {
+                stbi__uint32 e = (1u << 28) | ((stbi__uint32)s << 20) | ((stbi__uint32)s << 16) | (stbi__uint32)i;
+                for (j = stbi__bit_reverse(code, s); j < (1 << STBI__ZLIT_BITS); j += 1 << s)
+                    a->z_lit[j] = e;
+            }
+        }
+    }
+    // pair up literals. the second code's entry only depends on its own low
+    // bits, and pairing never changes an entry's first symbol, so this can
+    // be done in place
+    for (j = 0; j < (1 << STBI__ZLIT_BITS); ++j)
+    {
+        stbi__uint32 e = a->z_lit[j], e2;
+        int s = (e >> 16) & 15, s2, n2, rest = STBI__ZLIT_BITS - s;
+        if ((e >> 28) != 1 || (e & 0xffff) >= 256 || rest == 0)
+            continue;
+        e2 = a->z_lit[j >> s];
+        s2 = (e2 >> 16) & 15;
+        n2 = e2 >> 28;
+        if (n2 == 0 || s2 > rest || (n2 == 1 && (e2 & 0xffff) >= 256))
+            continue;
+        a->z_lit[j] = (2u << 28) | ((stbi__uint32)(s + s2) << 20) | ((stbi__uint32)s << 16) | ((e2 & 0xff) << 8) | (e & 0xff);
+    }
+}
+
+// decode one symbol of z from the low bits of 'bits' (at least 16 valid);
+// stbi__zhuffman_decode without the bit buffer bookkeeping
+stbi_inline static int stbi__zhuffman_decode_bits(stbi__zhuffman *z, stbi__uint64 bits, int *len)
+{
+    int b, s, k;
+    b = z->fast[bits & STBI__ZFAST_MASK];
+    if (b)
+    {
+        *len = b >> 9;
+        return b & 511;
+    }
+    k = stbi__bit_reverse((int)(bits & 0xffff), 16);
+    for (s = STBI__ZFAST_BITS + 1;; ++s)
+        if (k < z->maxcode[s])
+            break;
+    if (s >= 16)
+        return -1;
+    b = (k >> (16 - s)) - z->firstcode[s] + z->firstsymbol[s];
+    if (b >= STBI__ZNSYMS || z->size[b] != s)
+        return -1;
+    *len = s;
+    return z->value[b];
+}
+
+stbi_inline static stbi__uint64 stbi__zread64(const stbi_uc *p)
+{
+    return (stbi__uint64)p[0] | ((stbi__uint64)p[1] << 8) | ((stbi__uint64)p[2] << 16) | ((stbi__uint64)p[3] << 24) |
+           ((stbi__uint64)p[4] << 32) | ((stbi__uint64)p[5] << 40) | ((stbi__uint64)p[6] << 48) | ((stbi__uint64)p[7] << 56);
+}
+
+// fast loop for the bulk of a huffman block. returns 1 at the end of the
+// block, 0 on error, -1 when too close to the end of a buffer to continue
+static int stbi__parse_huffman_fast(stbi__zbuf *a)
+{
+    const stbi_uc *in = a->zbuffer;
+    const stbi_uc *in_end = a->zbuffer_end - STBI__ZFAST_IN_MARGIN;
+    stbi_uc *out = (stbi_uc *)a->zout;
+    stbi_uc *out_start = (stbi_uc *)a->zout_start;
+    stbi_uc *out_end = (stbi_uc *)a->zout_end - STBI__ZFAST_OUT_MARGIN;
+    stbi__uint64 bits = a->code_buffer;
+    int num_bits = a->num_bits, result = -1, back;
+
+    // every iteration refills to at least 56 bits, enough for a length code,
+    // its extra bits, a distance code and its extra bits (15+5+15+13)
+    while (in < in_end && out < out_end)
+    {
+        stbi__uint32 e;
+        int z, len, dist, n;
+        stbi_uc *p;
+
+        // bits above num_bits may hold the start of the next bytes already;
+        // or-ing them in again is harmless, they're the same bits
+        bits |= stbi__zread64(in) << num_bits;
+        in += (63 - num_bits) >> 3;
+        num_bits |= 56;
+
+        e = a->z_lit[bits & STBI__ZLIT_MASK];
+        if ((e >> 28) == 2)
+        {
+            n = (e >> 20) & 31;
+            out[0] = (stbi_uc)e;
+            out[1] = (stbi_uc)(e >> 8);
+            out += 2;
+            bits >>= n;
+            num_bits -= n;
+            continue;
+        }
+        if (e >> 28)
+        {
+            z = e & 0xffff;
+            n = (e >> 16) & 15;
+        }
+        else
+        {
+            z = stbi__zhuffman_decode_bits(&a->z_length, bits, &n);
+            if (z < 0)
+            {
+                stbi__err("bad huffman code", "Corrupt PNG");
+                result = 0;
+                break;
+            }
+        }
+        bits >>= n;
+        num_bits -= n;
+        if (z < 256)
+        {
+            *out++ = (stbi_uc)z;
+            continue;
+        }
+        if (z == 256)
+        {
+            result = 1;
+            break;
+        }
+        if (z >= 286)
+        {
+            stbi__err("bad huffman code", "Corrupt PNG");
+            result = 0;
+            break;
+        }
+        z -= 257;
+        len = stbi__zlength_base[z];
+        n = stbi__zlength_extra[z];
+        len += (int)(bits & ((1u << n) - 1));
+        bits >>= n;
+        num_bits -= n;
+
+        z = stbi__zhuffman_decode_bits(&a->z_distance, bits, &n);
+        if (z < 0 || z >= 30)
+        {
+            stbi__err("bad huffman code", "Corrupt PNG");
+            result = 0;
+            break;
+        }
+        bits >>= n;
+        num_bits -= n;
+        dist = stbi__zdist_base[z];
+        n = stbi__zdist_extra[z];
+        dist += (int)(bits & ((1u << n) - 1));
+        bits >>= n;
+        num_bits -= n;
+        if (out - out_start < dist)
+        {
+            stbi__err("bad dist", "Corrupt PNG");
+            result = 0;
+            break;
+        }
+
+        p = out - dist;
+        if (dist >= 8)
+        {
+            // chunks never overlap the bytes they read, and the margin
+            // covers the overshoot past len
+            stbi_uc *end = out + len;
+            do
+            {
+                memcpy(out, p, 8);
+                out += 8;
+                p += 8;
+            } while (out < end);
+            out = end;
+        }
+        else if (dist == 1)
+        {
+            memset(out, *p, len);
+            out += len;
+        }
+        else
+        {
+            do
+                *out++ = *p++;
+            while (--len);
+        }
+    }
+
+    // hand back whole bytes still in the bit buffer, so the careful loop and
+    // stored blocks continue from the right place. bits from before this call
+    // may have come from a previous input buffer; those stay in the bit buffer
+    back = num_bits >> 3;
+    if (back > in - a->zbuffer)
+        back = (int)(in - a->zbuffer);
+    in -= back;
+    num_bits -= back * 8;
+    a->zbuffer = (stbi_uc *)in;
+    a->code_buffer = (stbi__uint32)(bits & (((stbi__uint64)1 << num_bits) - 1));
+    a->num_bits = num_bits;
+    a->zout = (char *)out;
+    return result;
+}
+
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
     char *zout = a->zout;
     for (;;)
     {
-        int z = stbi__zhuffman_decode(a, &a->z_length);
+        int z;
+        if (a->zout_end - zout >= STBI__ZFAST_OUT_MARGIN && a->zbuffer_end - a->zbuffer >= STBI__ZFAST_IN_MARGIN && !a->hit_zeof_once)
+        {
+            int r;
+            a->zout = zout;
+            r = stbi__parse_huffman_fast(a);
+            if (r >= 0)
+                return r;
+            zout = a->zout;
+        }
+        z = stbi__zhuffman_decode(a, &a->z_length);
         if (z < 256)
         {
             if (z < 0)
@@ -5049,6 +6888,7 @@ static int stbi__compute_huffman_codes(stbi__zbuf *a)
         return 0;
     if (!stbi__zbuild_huffman(&a->z_distance, lencodes + hlit, hdist))
         return 0;
+    stbi__zbuild_lit_table(a, lencodes, hlit);
     return 1;
 }
 
@@ -5075,14 +6915,25 @@ static int stbi__parse_uncompressed_block(stbi__zbuf *a)
     nlen = header[3] * 256 + header[2];
     if (nlen != (len ^ 0xffff))
         return stbi__err("zlib corrupt", "Corrupt PNG");
-    if (a->zbuffer + len > a->zbuffer_end)
+    if (!a->zrefill && a->zbuffer + len > a->zbuffer_end)
         return stbi__err("read past buffer", "Corrupt PNG");
-    if (a->zout + len > a->zout_end)
-        if (!stbi__zexpand(a, a->zout, len))
-            return 0;
-    memcpy(a->zout, a->zbuffer, len);
-    a->zbuffer += len;
-    a->zout += len;
+    // a streamed block can continue in the next input buffer
+    while (len > 0)
+    {
+        int n;
+        if (stbi__zeof(a))
+            return stbi__err("read past buffer", "Corrupt PNG");
+        n = (int)(a->zbuffer_end - a->zbuffer);
+        if (n > len)
+            n = len;
+        if (a->zout + n > a->zout_end)
+            if (!stbi__zexpand(a, a->zout, n))
+                return 0;
+        memcpy(a->zout, a->zbuffer, n);
+        a->zbuffer += n;
+        a->zout += n;
+        len -= n;
+    }
     return 1;
 }
 
@@ -5162,6 +7013,7 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
                     return 0;
                 if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance, 32))
                     return 0;
+                stbi__zbuild_lit_table(a, stbi__zdefault_length, STBI__ZNSYMS);
             }
             else
             {
@@ -5181,9 +7033,29 @@ static int stbi__do_zlib(stbi__zbuf *a, char *obuf, int olen, int exp, int parse
     a->zout = obuf;
     a->zout_end = obuf + olen;
     a->z_expandable = exp;
+    a->zrefill = NULL;
+    a->zdrain = NULL;
+    a->zdrained = obuf;
+
+    return stbi__parse_zlib(a, parse_header);
+}
+
+#ifndef STBI_NO_PNG
+static int stbi__do_zlib_stream(stbi__zbuf *a, char *obuf, int olen, int parse_header,
+                                int (*refill)(stbi__zbuf *), int (*drain)(stbi__zbuf *), void *user)
+{
+    a->zout_start = obuf;
+    a->zout = obuf;
+    a->zout_end = obuf + olen;
+    a->z_expandable = 1;
+    a->zrefill = refill;
+    a->zdrain = drain;
+    a->zdrained = obuf;
+    a->zuser = user;
 
     return stbi__parse_zlib(a, parse_header);
 }
+#endif
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen)
 {
@@ -5311,11 +7183,25 @@ static int stbi__check_png_header(stbi__context *s)
     return 1;
 }
 
+typedef struct
+{
+    stbi_uc *data;
+    stbi__uint32 len;
+} stbi__png_seg;
+
 typedef struct
 {
     stbi__context *s;
     stbi_uc *idata, *expanded, *out;
     int depth;
+
+    // row streaming: when sink is set, non-interlaced images are inflated a
+    // band at a time. IDATs from memory are left in place and listed in segs;
+    // prior_row carries the last unfiltered row over to the next band
+    stbi__row_sink *sink;
+    stbi__png_seg *segs;
+    int seg_count, seg_cap, seg_next;
+    stbi_uc *prior_row;
 } stbi__png;
 
 enum
@@ -5358,28 +7244,276 @@ static const stbi_uc stbi__depth_scale_table[9] = {0, 0xff, 0x55, 0, 0x11, 0, 0,
 // img_n must be 1 or 3
 static void stbi__create_png_alpha_expand8(stbi_uc *dest, stbi_uc *src, stbi__uint32 x, int img_n)
 {
-    int i;
-    // must process data backwards since we allow dest==src
+    int i;
+    // must process data backwards since we allow dest==src
+    if (img_n == 1)
+    {
+        for (i = x - 1; i >= 0; --i)
+        {
+            dest[i * 2 + 1] = 255;
+            dest[i * 2 + 0] = src[i];
+        }
+    }
+    else
+    {
+        STBI_ASSERT(img_n == 3);
+        for (i = x - 1; i >= 0; --i)
+        {
+            dest[i * 4 + 3] = 255;
+            dest[i * 4 + 2] = src[i * 3 + 2];
+            dest[i * 4 + 1] = src[i * 3 + 1];
+            dest[i * 4 + 0] = src[i * 3 + 0];
+        }
+    }
+}
+
+// converts one row of big-endian 16-bit samples to platform-native, adding
+// an extra all-0xffff alpha channel if out_n == img_n + 1 (img_n 1 or 3)
+static void stbi__png_native16(stbi__uint16 *dest16, stbi_uc const *cur, stbi__uint32 x, int img_n, int out_n)
+{
+    stbi__uint32 i;
+    if (img_n == out_n)
+    {
+        stbi__uint32 nsmp = x * img_n;
+        for (i = 0; i < nsmp; ++i, ++dest16, cur += 2)
+            *dest16 = (cur[0] << 8) | cur[1];
+    }
+    else
+    {
+        STBI_ASSERT(img_n + 1 == out_n);
+        if (img_n == 1)
+        {
+            for (i = 0; i < x; ++i, dest16 += 2, cur += 2)
+            {
+                dest16[0] = (cur[0] << 8) | cur[1];
+                dest16[1] = 0xffff;
+            }
+        }
+        else
+        {
+            STBI_ASSERT(img_n == 3);
+            for (i = 0; i < x; ++i, dest16 += 4, cur += 6)
+            {
+                dest16[0] = (cur[0] << 8) | cur[1];
+                dest16[1] = (cur[2] << 8) | cur[3];
+                dest16[2] = (cur[4] << 8) | cur[5];
+                dest16[3] = 0xffff;
+            }
+        }
+    }
+}
+
+// undo the filter of one scanline of nk bytes; raw is the filtered row,
+// prior the previous unfiltered one
+typedef void (*stbi__unfilter_row_func)(stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int nk, int filter_bytes, int filter);
+
+static void stbi__unfilter_row(stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int nk, int filter_bytes, int filter)
+{
+    int k;
+    switch (filter)
+    {
+    case STBI__F_none:
+        memcpy(cur, raw, nk);
+        break;
+    case STBI__F_sub:
+        memcpy(cur, raw, filter_bytes);
+        for (k = filter_bytes; k < nk; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + cur[k - filter_bytes]);
+        break;
+    case STBI__F_up:
+        for (k = 0; k < nk; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+        break;
+    case STBI__F_avg:
+        for (k = 0; k < filter_bytes; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + (prior[k] >> 1));
+        for (k = filter_bytes; k < nk; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k - filter_bytes]) >> 1));
+        break;
+    case STBI__F_paeth:
+        for (k = 0; k < filter_bytes; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + prior[k]); // prior[k] == stbi__paeth(0,prior[k],0)
+        for (k = filter_bytes; k < nk; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - filter_bytes], prior[k], prior[k - filter_bytes]));
+        break;
+    case STBI__F_avg_first:
+        memcpy(cur, raw, filter_bytes);
+        for (k = filter_bytes; k < nk; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + (cur[k - filter_bytes] >> 1));
+        break;
+    }
+}
+
+#ifdef STBI__AVX2
+// Sub, Avg and Paeth depend on the pixel to the left, so these work one pixel
+// at a time with all of its channels in one register (as libpng does); Up has
+// no such dependency and runs 16 or 32 bytes at a time. bpp is a constant 3
+// or 4 after inlining, so the loads and stores are plain 3/4-byte moves.
+STBI__SSE41_TARGET stbi_inline static __m128i stbi__png_load_px(const stbi_uc *p, int bpp)
+{
+    int v;
+    if (bpp == 4)
+        memcpy(&v, p, 4);
+    else
+        v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return _mm_cvtsi32_si128(v);
+}
+
+STBI__SSE41_TARGET stbi_inline static void stbi__png_store_px(stbi_uc *p, __m128i v, int bpp)
+{
+    int x = _mm_cvtsi128_si32(v);
+    if (bpp == 4)
+        memcpy(p, &x, 4);
+    else
+    {
+        p[0] = (stbi_uc)x;
+        p[1] = (stbi_uc)(x >> 8);
+        p[2] = (stbi_uc)(x >> 16);
+    }
+}
+
+STBI__SSE41_TARGET stbi_inline static void stbi__unfilter_row_sse41_bpp(stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int nk, int filter, int bpp)
+{
+    __m128i a = _mm_setzero_si128(); // left pixel
+    int k = 0;
+    switch (filter)
+    {
+    case STBI__F_sub:
+        for (; k < nk; k += bpp)
+        {
+            a = _mm_add_epi8(a, stbi__png_load_px(raw + k, bpp));
+            stbi__png_store_px(cur + k, a, bpp);
+        }
+        break;
+    case STBI__F_up:
+        for (; k + 16 <= nk; k += 16)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)(raw + k));
+            __m128i b = _mm_loadu_si128((const __m128i *)(prior + k));
+            _mm_storeu_si128((__m128i *)(cur + k), _mm_add_epi8(x, b));
+        }
+        for (; k < nk; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+        break;
+    case STBI__F_avg:
+    {
+        // (a + b) >> 1 is pavgb minus the round-up bit
+        __m128i one = _mm_set1_epi8(1);
+        for (; k < nk; k += bpp)
+        {
+            __m128i b = stbi__png_load_px(prior + k, bpp);
+            __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+            a = _mm_add_epi8(avg, stbi__png_load_px(raw + k, bpp));
+            stbi__png_store_px(cur + k, a, bpp);
+        }
+        break;
+    }
+    case STBI__F_paeth:
+    {
+        // in 16-bit lanes: pa = |b-c|, pb = |a-c|, pc = |a+b-2c|; pick a, b
+        // or c for the smallest, preferring them in that order
+        __m128i c = _mm_setzero_si128();
+        for (; k < nk; k += bpp)
+        {
+            __m128i b = _mm_cvtepu8_epi16(stbi__png_load_px(prior + k, bpp));
+            __m128i pa = _mm_sub_epi16(b, c);
+            __m128i pb = _mm_sub_epi16(a, c);
+            __m128i pc = _mm_abs_epi16(_mm_add_epi16(pa, pb));
+            __m128i smallest, pred;
+            pa = _mm_abs_epi16(pa);
+            pb = _mm_abs_epi16(pb);
+            smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            pred = _mm_blendv_epi8(c, b, _mm_cmpeq_epi16(pb, smallest));
+            pred = _mm_blendv_epi8(pred, a, _mm_cmpeq_epi16(pa, smallest));
+            a = _mm_add_epi8(_mm_packus_epi16(pred, pred), stbi__png_load_px(raw + k, bpp));
+            stbi__png_store_px(cur + k, a, bpp);
+            a = _mm_cvtepu8_epi16(a);
+            c = b;
+        }
+        break;
+    }
+    default:
+        stbi__unfilter_row(cur, prior, raw, nk, bpp, filter);
+        break;
+    }
+}
+
+STBI__SSE41_TARGET static void stbi__unfilter_row_sse41(stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int nk, int filter_bytes, int filter)
+{
+    if (filter_bytes == 4)
+        stbi__unfilter_row_sse41_bpp(cur, prior, raw, nk, filter, 4);
+    else if (filter_bytes == 3)
+        stbi__unfilter_row_sse41_bpp(cur, prior, raw, nk, filter, 3);
+    else
+        stbi__unfilter_row(cur, prior, raw, nk, filter_bytes, filter);
+}
+
+STBI__AVX2_TARGET static void stbi__unfilter_row_avx2(stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int nk, int filter_bytes, int filter)
+{
+    if (filter == STBI__F_up)
+    {
+        int k = 0;
+        for (; k + 32 <= nk; k += 32)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(raw + k));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(prior + k));
+            _mm256_storeu_si256((__m256i *)(cur + k), _mm256_add_epi8(x, b));
+        }
+        for (; k < nk; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+    }
+    else
+        stbi__unfilter_row_sse41(cur, prior, raw, nk, filter_bytes, filter);
+}
+
+// stbi__png_native16 with pshufb doing the byte swap (and making room for
+// alpha); the scalar version finishes each row
+STBI__AVX2_TARGET static void stbi__png_native16_avx2(stbi__uint16 *dest16, stbi_uc const *cur, stbi__uint32 x, int img_n, int out_n)
+{
+    stbi__uint32 i = 0;
+    if (img_n == out_n)
+    {
+        // 16 samples per step
+        stbi__uint32 nsmp = x * img_n;
+        __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        for (; i + 16 <= nsmp; i += 16)
+        {
+            __m256i v = _mm256_loadu_si256((__m256i const *)(cur + i * 2));
+            _mm256_storeu_si256((__m256i *)(dest16 + i), _mm256_shuffle_epi8(v, swap));
+        }
+        stbi__png_native16(dest16 + i, cur + i * 2, nsmp - i, 1, 1);
+        return;
+    }
     if (img_n == 1)
     {
-        for (i = x - 1; i >= 0; --i)
+        // 8 pixels per step: swap, widen each sample to 32 bits and or in the alpha
+        __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        __m256i alpha = _mm256_set1_epi32((int)0xffff0000u);
+        for (; i + 8 <= x; i += 8)
         {
-            dest[i * 2 + 1] = 255;
-            dest[i * 2 + 0] = src[i];
+            __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)(cur + i * 2)), swap);
+            _mm256_storeu_si256((__m256i *)(dest16 + i * 2), _mm256_or_si256(_mm256_cvtepu16_epi32(v), alpha));
         }
     }
     else
     {
+        // 4 pixels per step, two per 128-bit lane; each load reads 4 bytes
+        // past its two pixels, so stop while a pixel is still left
+        __m256i spread = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, -1, -1, 7, 6, 9, 8, 11, 10, -1, -1,
+                                          1, 0, 3, 2, 5, 4, -1, -1, 7, 6, 9, 8, 11, 10, -1, -1);
+        __m256i alpha = _mm256_set1_epi64x((long long)0xffff000000000000ull);
         STBI_ASSERT(img_n == 3);
-        for (i = x - 1; i >= 0; --i)
+        for (; i + 5 <= x; i += 4)
         {
-            dest[i * 4 + 3] = 255;
-            dest[i * 4 + 2] = src[i * 3 + 2];
-            dest[i * 4 + 1] = src[i * 3 + 1];
-            dest[i * 4 + 0] = src[i * 3 + 0];
+            __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((__m128i const *)(cur + i * 6))),
+                                                _mm_loadu_si128((__m128i const *)(cur + i * 6 + 12)), 1);
+            _mm256_storeu_si256((__m256i *)(dest16 + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(v, spread), alpha));
         }
     }
+    stbi__png_native16(dest16 + i * out_n, cur + i * img_n * 2, x - i, img_n, out_n);
 }
+#endif
 
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
@@ -5390,12 +7524,15 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
     stbi__uint32 img_len, img_width_bytes;
     stbi_uc *filter_buf;
     int all_ok = 1;
-    int k;
     int img_n = s->img_n; // copy it into a local for later
 
     int output_bytes = out_n * bytes;
     int filter_bytes = img_n * bytes;
     int width = x;
+    stbi__unfilter_row_func unfilter_row = stbi__unfilter_row;
+#ifdef STBI__AVX2
+    int native16_avx2 = depth == 16 && stbi__avx2_available();
+#endif
 
     STBI_ASSERT(out_n == s->img_n || out_n == s->img_n + 1);
     a->out = (stbi_uc *)stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
@@ -5429,6 +7566,20 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
         width = img_width_bytes;
     }
 
+#ifdef STBI__AVX2
+    if (filter_bytes == 3 || filter_bytes == 4)
+    {
+        if (stbi__avx2_available())
+            unfilter_row = stbi__unfilter_row_avx2;
+        else if (stbi__sse41_available())
+            unfilter_row = stbi__unfilter_row_sse41;
+    }
+#endif
+
+    // a streamed band continues from the previous band's last row
+    if (a->prior_row)
+        memcpy(filter_buf + img_width_bytes, a->prior_row, img_width_bytes);
+
     for (j = 0; j < y; ++j)
     {
         // cur/prior filter buffers alternate
@@ -5446,42 +7597,11 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
         }
 
         // if first row, use special filter that doesn't sample previous row
-        if (j == 0)
+        if (j == 0 && !a->prior_row)
             filter = first_row_filter[filter];
 
         // perform actual filtering
-        switch (filter)
-        {
-        case STBI__F_none:
-            memcpy(cur, raw, nk);
-            break;
-        case STBI__F_sub:
-            memcpy(cur, raw, filter_bytes);
-            for (k = filter_bytes; k < nk; ++k)
-                cur[k] = STBI__BYTECAST(raw[k] + cur[k - filter_bytes]);
-            break;
-        case STBI__F_up:
-            for (k = 0; k < nk; ++k)
-                cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
-            break;
-        case STBI__F_avg:
-            for (k = 0; k < filter_bytes; ++k)
-                cur[k] = STBI__BYTECAST(raw[k] + (prior[k] >> 1));
-            for (k = filter_bytes; k < nk; ++k)
-                cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k - filter_bytes]) >> 1));
-            break;
-        case STBI__F_paeth:
-            for (k = 0; k < filter_bytes; ++k)
-                cur[k] = STBI__BYTECAST(raw[k] + prior[k]); // prior[k] == stbi__paeth(0,prior[k],0)
-            for (k = filter_bytes; k < nk; ++k)
-                cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - filter_bytes], prior[k], prior[k - filter_bytes]));
-            break;
-        case STBI__F_avg_first:
-            memcpy(cur, raw, filter_bytes);
-            for (k = filter_bytes; k < nk; ++k)
-                cur[k] = STBI__BYTECAST(raw[k] + (cur[k - filter_bytes] >> 1));
-            break;
-        }
+        unfilter_row(cur, prior, raw, nk, filter_bytes, filter);
 
         raw += nk;
 
@@ -5541,40 +7661,18 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
         else if (depth == 16)
         {
             // convert the image data from big-endian to platform-native
-            stbi__uint16 *dest16 = (stbi__uint16 *)dest;
-            stbi__uint32 nsmp = x * img_n;
-
-            if (img_n == out_n)
-            {
-                for (i = 0; i < nsmp; ++i, ++dest16, cur += 2)
-                    *dest16 = (cur[0] << 8) | cur[1];
-            }
+#ifdef STBI__AVX2
+            if (native16_avx2)
+                stbi__png_native16_avx2((stbi__uint16 *)dest, cur, x, img_n, out_n);
             else
-            {
-                STBI_ASSERT(img_n + 1 == out_n);
-                if (img_n == 1)
-                {
-                    for (i = 0; i < x; ++i, dest16 += 2, cur += 2)
-                    {
-                        dest16[0] = (cur[0] << 8) | cur[1];
-                        dest16[1] = 0xffff;
-                    }
-                }
-                else
-                {
-                    STBI_ASSERT(img_n == 3);
-                    for (i = 0; i < x; ++i, dest16 += 4, cur += 6)
-                    {
-                        dest16[0] = (cur[0] << 8) | cur[1];
-                        dest16[1] = (cur[2] << 8) | cur[3];
-                        dest16[2] = (cur[4] << 8) | cur[5];
-                        dest16[3] = 0xffff;
-                    }
-                }
-            }
+#endif
+                stbi__png_native16((stbi__uint16 *)dest, cur, x, img_n, out_n);
         }
     }
 
+    if (a->prior_row && all_ok)
+        memcpy(a->prior_row, filter_buf + ((y - 1) & 1) * img_width_bytes, img_width_bytes);
+
     STBI_FREE(filter_buf);
     if (!all_ok)
         return 0;
@@ -5831,6 +7929,151 @@ static void stbi__de_iphone(stbi__png *z)
     }
 }
 
+// state for inflating a non-interlaced PNG straight into a row sink
+typedef struct
+{
+    stbi__png *z;
+    stbi_uc *palette, *tc;
+    stbi__uint16 *tc16;
+    int pal_img_n, has_trans, is_iphone, color, req_comp;
+    stbi__uint32 row_len; // filter byte plus packed row
+    stbi__uint32 rows_done;
+} stbi__png_rows;
+
+// unfilters rows of raw zlib output and runs them through the same per-pixel
+// steps as a whole image, with img_y standing in for the band height
+static int stbi__png_stream_band(stbi__png_rows *r, stbi_uc *raw, int rows)
+{
+    stbi__png *z = r->z;
+    stbi__context *s = z->s;
+    stbi__uint32 img_y = s->img_y, i, count;
+    stbi_uc *out;
+    int n = s->img_out_n, ok = 0;
+
+    s->img_y = rows;
+    if (!stbi__create_png_image_raw(z, raw, r->row_len * rows, n, s->img_x, rows, z->depth, r->color))
+        goto done;
+    if (r->has_trans)
+    {
+        if (z->depth == 16)
+            stbi__compute_transparency16(z, r->tc16, n);
+        else
+            stbi__compute_transparency(z, r->tc, n);
+    }
+    if (r->is_iphone && stbi__de_iphone_flag && n > 2)
+        stbi__de_iphone(z);
+    if (r->pal_img_n)
+    {
+        n = r->req_comp >= 3 ? r->req_comp : r->pal_img_n;
+        if (!stbi__expand_png_palette(z, r->palette, 0, n))
+            goto done;
+    }
+    out = z->out;
+    z->out = NULL;
+    if (r->req_comp && r->req_comp != n)
+    {
+        if (z->depth == 16)
+            out = (stbi_uc *)stbi__convert_format16((stbi__uint16 *)out, n, r->req_comp, s->img_x, rows);
+        else
+            out = stbi__convert_format(out, n, r->req_comp, s->img_x, rows);
+        if (out == NULL)
+            goto done;
+        n = r->req_comp;
+    }
+    if (z->depth == 16)
+    {
+        // sinks take 8-bit rows; narrow in place
+        stbi__uint16 *p16 = (stbi__uint16 *)out;
+        count = s->img_x * rows * n;
+        for (i = 0; i < count; ++i)
+            out[i] = (stbi_uc)(p16[i] >> 8);
+    }
+    r->rows_done += rows;
+    ok = stbi__sink_write(z->sink, out, rows, r->rows_done == img_y);
+    STBI_FREE(out);
+done:
+    s->img_y = img_y;
+    return ok;
+}
+
+// zlib drain hook: hands every whole row inflated so far to the sink
+static int stbi__png_drain(stbi__zbuf *a)
+{
+    stbi__png_rows *r = (stbi__png_rows *)a->zuser;
+    stbi__uint32 rows = (stbi__uint32)(a->zout - a->zdrained) / r->row_len;
+    if (rows > r->z->s->img_y - r->rows_done)
+    {
+        // trailing bytes past the last row are ignored, as in a full load
+        rows = r->z->s->img_y - r->rows_done;
+        a->zdrained = a->zout - rows * r->row_len;
+    }
+    while (rows > 0)
+    {
+        int n = rows < (stbi__uint32)r->z->sink->band_rows ? (int)rows : r->z->sink->band_rows;
+        if (!stbi__png_stream_band(r, (stbi_uc *)a->zdrained, n))
+            return 0;
+        a->zdrained += n * r->row_len;
+        rows -= n;
+    }
+    return 1;
+}
+
+// zlib refill hook: steps through the IDAT payloads left in the source buffer
+static int stbi__png_refill(stbi__zbuf *a)
+{
+    stbi__png *z = ((stbi__png_rows *)a->zuser)->z;
+    while (z->seg_next < z->seg_count)
+    {
+        stbi__png_seg *seg = &z->segs[z->seg_next++];
+        if (seg->len)
+        {
+            a->zbuffer = seg->data;
+            a->zbuffer_end = seg->data + seg->len;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int stbi__png_inflate_rows(stbi__png *z, stbi_uc *idata, stbi__uint32 ioff, stbi__png_rows *r)
+{
+    stbi__context *s = z->s;
+    stbi__zbuf a;
+    int ok, size, band_rows;
+    stbi__uint32 width_bytes = ((s->img_n * s->img_x * z->depth) + 7) >> 3;
+
+    r->z = z;
+    r->row_len = width_bytes + 1;
+    r->rows_done = 0;
+
+    // room for a band of raw rows (or a stored block) after the 32K window
+    band_rows = z->sink->band_rows < (int)s->img_y ? z->sink->band_rows : (int)s->img_y;
+    if (!stbi__mad2sizes_valid((int)r->row_len, band_rows, 32768 + (int)r->row_len + 65536))
+        return stbi__err("too large", "Corrupt PNG");
+    size = (int)r->row_len * band_rows;
+    if (size < 65536)
+        size = 65536;
+    size += 32768 + (int)r->row_len;
+    z->prior_row = (stbi_uc *)stbi__malloc(width_bytes);
+    z->expanded = (stbi_uc *)stbi__malloc(size);
+    if (!z->prior_row || !z->expanded)
+        return stbi__err("outofmem", "Out of memory");
+    memset(z->prior_row, 0, width_bytes);
+
+    // from memory the IDATs are read where they lie, otherwise they were
+    // gathered into idata as for a full load
+    a.zbuffer = idata;
+    a.zbuffer_end = idata ? idata + ioff : idata;
+    ok = stbi__do_zlib_stream(&a, (char *)z->expanded, size, !r->is_iphone,
+                              z->seg_count ? stbi__png_refill : NULL, stbi__png_drain, r);
+    z->expanded = (stbi_uc *)a.zout_start;
+    if (ok)
+        ok = stbi__png_drain(&a);
+    if (ok && r->rows_done < s->img_y)
+        ok = stbi__err("not enough pixels", "Corrupt PNG");
+    return ok;
+}
+
 #define STBI__PNG_TYPE(a, b, c, d) (((unsigned)(a) << 24) + ((unsigned)(b) << 16) + ((unsigned)(c) << 8) + (unsigned)(d))
 
 static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
@@ -5845,6 +8088,9 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
     z->expanded = NULL;
     z->idata = NULL;
     z->out = NULL;
+    z->segs = NULL;
+    z->seg_count = z->seg_cap = z->seg_next = 0;
+    z->prior_row = NULL;
 
     if (!stbi__check_png_header(s))
         return 0;
@@ -5863,7 +8109,7 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             break;
         case STBI__PNG_TYPE('I', 'H', 'D', 'R'):
         {
-            int comp, filter;
+            int comp, filter, whole;
             if (!first)
                 return stbi__err("multiple IHDR", "Corrupt PNG");
             first = 0;
@@ -5898,10 +8144,14 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
                 return stbi__err("bad interlace method", "Corrupt PNG");
             if (!s->img_x || !s->img_y)
                 return stbi__err("0-pixel image", "Corrupt PNG");
+            // only a load that holds the whole image is limited to 1GB; a
+            // streamed one only needs its row buffers to fit (see
+            // stbi__png_inflate_rows), and a header scan allocates nothing
+            whole = scan == STBI__SCAN_load && (!z->sink || interlace);
             if (!pal_img_n)
             {
                 s->img_n = (color & 2 ? 3 : 1) + (color & 4 ? 1 : 0);
-                if ((1 << 30) / s->img_x / s->img_n < s->img_y)
+                if (whole && (1 << 30) / s->img_x / s->img_n < s->img_y)
                     return stbi__err("too large", "Image too large to decode");
             }
             else
@@ -5909,7 +8159,7 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
                 // if paletted, then pal_n is our final components, and
                 // img_n is # components to decompress/filter.
                 s->img_n = 1;
-                if ((1 << 30) / s->img_x / 4 < s->img_y)
+                if (whole && (1 << 30) / s->img_x / 4 < s->img_y)
                     return stbi__err("too large", "Corrupt PNG");
             }
             // even with SCAN_header, have to scan to see if we have a tRNS
@@ -5939,7 +8189,7 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
         {
             if (first)
                 return stbi__err("first not IHDR", "Corrupt PNG");
-            if (z->idata)
+            if (z->idata || z->seg_count)
                 return stbi__err("tRNS after IDAT", "Corrupt PNG");
             if (pal_img_n)
             {
@@ -6000,6 +8250,29 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
                 return stbi__err("IDAT size limit", "IDAT section larger than 2^30 bytes");
             if ((int)(ioff + c.length) < (int)ioff)
                 return 0;
+            if (z->sink && !interlace && !s->read_from_callbacks)
+            {
+                // streaming from memory: inflate straight from the source
+                if (z->seg_count == z->seg_cap)
+                {
+                    int old_cap = z->seg_cap;
+                    stbi__png_seg *p;
+                    z->seg_cap = z->seg_cap ? z->seg_cap * 2 : 8;
+                    STBI_NOTUSED(old_cap);
+                    p = (stbi__png_seg *)STBI_REALLOC_SIZED(z->segs, old_cap * sizeof(*p), z->seg_cap * sizeof(*p));
+                    if (p == NULL)
+                        return stbi__err("outofmem", "Out of memory");
+                    z->segs = p;
+                }
+                if ((stbi__uint32)(s->img_buffer_end - s->img_buffer) < c.length)
+                    return stbi__err("outofdata", "Corrupt PNG");
+                z->segs[z->seg_count].data = s->img_buffer;
+                z->segs[z->seg_count].len = c.length;
+                z->seg_count++;
+                stbi__skip(s, c.length);
+                ioff += c.length;
+                break;
+            }
             if (ioff + c.length > idata_limit)
             {
                 stbi__uint32 idata_limit_old = idata_limit;
@@ -6027,8 +8300,39 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
                 return stbi__err("first not IHDR", "Corrupt PNG");
             if (scan != STBI__SCAN_load)
                 return 1;
-            if (z->idata == NULL)
+            if (z->idata == NULL && z->seg_count == 0)
                 return stbi__err("no IDAT", "Corrupt PNG");
+            if (z->sink && !interlace)
+            {
+                stbi__png_rows r;
+                int final_n;
+                if (has_trans)
+                    s->img_out_n = s->img_n + 1;
+                else
+                    s->img_out_n = s->img_n;
+                if (pal_img_n)
+                    final_n = req_comp >= 3 ? req_comp : pal_img_n;
+                else
+                    final_n = s->img_out_n;
+                z->sink->row_bytes = s->img_x * (req_comp ? req_comp : final_n);
+                r.palette = palette;
+                r.tc = tc;
+                r.tc16 = tc16;
+                r.pal_img_n = pal_img_n;
+                r.has_trans = has_trans;
+                r.is_iphone = is_iphone;
+                r.color = color;
+                r.req_comp = req_comp;
+                if (!stbi__png_inflate_rows(z, z->idata, z->seg_count ? 0 : ioff, &r))
+                    return 0;
+                if (pal_img_n)
+                    s->img_n = pal_img_n;
+                else if (has_trans)
+                    ++s->img_n;
+                s->img_out_n = req_comp ? req_comp : final_n;
+                stbi__get32be(s);
+                return 1;
+            }
             // initial guess for decoded data size to avoid unnecessary reallocs
             bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
             raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
@@ -6140,14 +8444,68 @@ static void *stbi__do_png(stbi__png *p, int *x, int *y, int *n, int req_comp, st
     p->expanded = NULL;
     STBI_FREE(p->idata);
     p->idata = NULL;
+    STBI_FREE(p->segs);
+    p->segs = NULL;
 
     return result;
 }
 
+// streams a PNG into sink. non-interlaced images go a band at a time;
+// interlaced ones are decoded whole and then handed over
+static int stbi__png_load_rows(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__row_sink *sink)
+{
+    stbi__png p;
+    int ok;
+    p.s = s;
+    p.sink = sink;
+    ok = stbi__parse_png_file(&p, STBI__SCAN_load, req_comp);
+    if (ok && p.out)
+    {
+        // whole image, possibly 16-bit, in img_out_n channels
+        stbi_uc *out = p.out;
+        int n = s->img_out_n;
+        p.out = NULL;
+        if (req_comp && req_comp != n)
+        {
+            if (p.depth == 16)
+                out = (stbi_uc *)stbi__convert_format16((stbi__uint16 *)out, n, req_comp, s->img_x, s->img_y);
+            else
+                out = stbi__convert_format(out, n, req_comp, s->img_x, s->img_y);
+            n = req_comp;
+        }
+        if (out && p.depth == 16)
+            out = stbi__convert_16_to_8((stbi__uint16 *)out, s->img_x, s->img_y, n);
+        if (out)
+        {
+            sink->row_bytes = s->img_x * n;
+            ok = stbi__sink_write(sink, out, s->img_y, 1);
+            STBI_FREE(out);
+        }
+        else
+            ok = 0;
+    }
+    if (ok)
+        ok = stbi__sink_flush(sink);
+    if (ok)
+    {
+        *x = s->img_x;
+        *y = s->img_y;
+        if (comp)
+            *comp = s->img_n;
+    }
+    STBI_FREE(p.out);
+    STBI_FREE(p.expanded);
+    STBI_FREE(p.idata);
+    STBI_FREE(p.segs);
+    STBI_FREE(p.prior_row);
+    return ok;
+}
+
 static void *stbi__png_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
 {
     stbi__png p;
     p.s = s;
+    p.sink = NULL;
     return stbi__do_png(&p, x, y, comp, req_comp, ri);
 }
 
@@ -6179,6 +8537,7 @@ static int stbi__png_info(stbi__context *s, int *x, int *y, int *comp)
 {
     stbi__png p;
     p.s = s;
+    p.sink = NULL;
     return stbi__png_info_raw(&p, x, y, comp);
 }
 
@@ -6186,6 +8545,7 @@ static int stbi__png_is16(stbi__context *s)
 {
     stbi__png p;
     p.s = s;
+    p.sink = NULL;
     if (!stbi__png_info_raw(&p, NULL, NULL, NULL))
         return 0;
     if (p.depth != 16)
@@ -8239,7 +10599,7 @@ static void *stbi__load_gif_main(stbi__context *s, int **delays, int *x, int *y,
                 memcpy(out + ((layers - 1) * stride), u, stride);
                 if (layers >= 2)
                 {
-                    two_back = out - 2 * stride;
+                    two_back = out + (layers - 2) * stride;
                 }
 
                 if (delays)
@@ -8304,6 +10664,87 @@ static int stbi__gif_info(stbi__context *s, int *x, int *y, int *comp)
 {
     return stbi__gif_info_raw(s, x, y, comp);
 }
+
+struct stbi_gif_stream
+{
+    stbi__context s;
+    stbi__gif g;
+    stbi_uc *prev[2]; // the last two frames, for disposal method 3
+    int frames;       // frames returned since the start or the last rewind
+};
+
+STBIDEF stbi_gif_stream *stbi_gif_stream_open_from_memory(stbi_uc const *buffer, int len, int *x, int *y)
+{
+    stbi_gif_stream *g = (stbi_gif_stream *)stbi__malloc(sizeof(stbi_gif_stream));
+    int w, h;
+    if (!g)
+        return (stbi_gif_stream *)stbi__errpuc("outofmem", "Out of memory");
+    memset(g, 0, sizeof(*g));
+    stbi__start_mem(&g->s, buffer, len);
+    if (!stbi__gif_test(&g->s) || !stbi__gif_info_raw(&g->s, &w, &h, NULL))
+    {
+        STBI_FREE(g);
+        return (stbi_gif_stream *)stbi__errpuc("not GIF", "Image was not as a gif type.");
+    }
+    if (!stbi__mad3sizes_valid(4, w, h, 0))
+    {
+        STBI_FREE(g);
+        return (stbi_gif_stream *)stbi__errpuc("too large", "GIF image is too large");
+    }
+    g->prev[0] = (stbi_uc *)stbi__malloc_mad3(4, w, h, 0);
+    g->prev[1] = (stbi_uc *)stbi__malloc_mad3(4, w, h, 0);
+    if (!g->prev[0] || !g->prev[1])
+    {
+        stbi_gif_stream_close(g);
+        return (stbi_gif_stream *)stbi__errpuc("outofmem", "Out of memory");
+    }
+    stbi__rewind(&g->s);
+    if (x)
+        *x = w;
+    if (y)
+        *y = h;
+    return g;
+}
+
+STBIDEF int stbi_gif_stream_next(stbi_gif_stream *g, stbi_uc **frame, int *delay_ms)
+{
+    // the frame two back is what disposal method 3 restores
+    stbi_uc *two_back = g->frames >= 2 ? g->prev[g->frames & 1] : NULL;
+    stbi_uc *u = stbi__gif_load_next(&g->s, &g->g, NULL, 4, two_back);
+    if (u == (stbi_uc *)&g->s)
+        return 0; // end of animated gif marker
+    // plenty of GIFs just stop after their last frame; like stbi_load_gif,
+    // treat running out of data once a frame is out as the end
+    if (!u)
+        return g->frames > 0 && stbi__at_eof(&g->s) ? 0 : -1;
+    memcpy(g->prev[g->frames & 1], u, (size_t)4 * g->g.w * g->g.h);
+    g->frames++;
+    if (frame)
+        *frame = u;
+    if (delay_ms)
+        *delay_ms = g->g.delay;
+    return 1;
+}
+
+STBIDEF void stbi_gif_stream_rewind(stbi_gif_stream *g)
+{
+    STBI_FREE(g->g.out);
+    STBI_FREE(g->g.history);
+    STBI_FREE(g->g.background);
+    memset(&g->g, 0, sizeof(g->g));
+    g->frames = 0;
+    stbi__rewind(&g->s);
+}
+
+STBIDEF void stbi_gif_stream_close(stbi_gif_stream *g)
+{
+    if (!g)
+        return;
+    stbi_gif_stream_rewind(g);
+    STBI_FREE(g->prev[0]);
+    STBI_FREE(g->prev[1]);
+    STBI_FREE(g);
+}
 #endif
 
 // *************************************************************************************************
@@ -8395,24 +10836,34 @@ static void stbi__hdr_convert(float *output, stbi_uc *input, int req_comp)
     }
 }
 
-static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
+// stores one decoded pixel, either converted to req_comp floats or as the raw RGBE bytes
+static void stbi__hdr_store(void *output, size_t index, stbi_uc *rgbe, int req_comp, int raw)
+{
+    if (raw)
+        memcpy((stbi_uc *)output + index * 4, rgbe, 4);
+    else
+        stbi__hdr_convert((float *)output + index * req_comp, rgbe, req_comp);
+}
+
+// with raw set, the output is width*height*4 RGBE bytes instead of floats
+static void *stbi__hdr_decode(stbi__context *s, int *x, int *y, int *comp, int req_comp, int raw)
 {
     char buffer[STBI__HDR_BUFLEN];
     char *token;
     int valid = 0;
     int width, height;
-    stbi_uc *scanline;
-    float *hdr_data;
+    stbi_uc *scanline, *row;
+    void *hdr_data;
+    int elem;
     int len;
     unsigned char count, value;
     int i, j, k, c1, c2, z;
     const char *headerToken;
-    STBI_NOTUSED(ri);
 
     // Check identifier
     headerToken = stbi__hdr_gettoken(s, buffer);
     if (strcmp(headerToken, "#?RADIANCE") != 0 && strcmp(headerToken, "#?RGBE") != 0)
-        return stbi__errpf("not HDR", "Corrupt HDR image");
+        return stbi__errpuc("not HDR", "Corrupt HDR image");
 
     // Parse header
     for (;;)
@@ -8425,26 +10876,26 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
     }
 
     if (!valid)
-        return stbi__errpf("unsupported format", "Unsupported HDR format");
+        return stbi__errpuc("unsupported format", "Unsupported HDR format");
 
     // Parse width and height
     // can't use sscanf() if we're not using stdio!
     token = stbi__hdr_gettoken(s, buffer);
     if (strncmp(token, "-Y ", 3))
-        return stbi__errpf("unsupported data layout", "Unsupported HDR format");
+        return stbi__errpuc("unsupported data layout", "Unsupported HDR format");
     token += 3;
     height = (int)strtol(token, &token, 10);
     while (*token == ' ')
         ++token;
     if (strncmp(token, "+X ", 3))
-        return stbi__errpf("unsupported data layout", "Unsupported HDR format");
+        return stbi__errpuc("unsupported data layout", "Unsupported HDR format");
     token += 3;
     width = (int)strtol(token, NULL, 10);
 
     if (height > STBI_MAX_DIMENSIONS)
-        return stbi__errpf("too large", "Very large image (corrupt?)");
+        return stbi__errpuc("too large", "Very large image (corrupt?)");
     if (width > STBI_MAX_DIMENSIONS)
-        return stbi__errpf("too large", "Very large image (corrupt?)");
+        return stbi__errpuc("too large", "Very large image (corrupt?)");
 
     *x = width;
     *y = height;
@@ -8453,14 +10904,17 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
         *comp = 3;
     if (req_comp == 0)
         req_comp = 3;
+    if (raw)
+        req_comp = 4;
+    elem = raw ? 1 : (int)sizeof(float);
 
-    if (!stbi__mad4sizes_valid(width, height, req_comp, sizeof(float), 0))
-        return stbi__errpf("too large", "HDR image is too large");
+    if (!stbi__mad4sizes_valid(width, height, req_comp, elem, 0))
+        return stbi__errpuc("too large", "HDR image is too large");
 
     // Read data
-    hdr_data = (float *)stbi__malloc_mad4(width, height, req_comp, sizeof(float), 0);
+    hdr_data = stbi__malloc_mad4(width, height, req_comp, elem, 0);
     if (!hdr_data)
-        return stbi__errpf("outofmem", "Out of memory");
+        return stbi__errpuc("outofmem", "Out of memory");
 
     // Load image data
     // image data is stored as some number of sca
@@ -8474,7 +10928,7 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
                 stbi_uc rgbe[4];
             main_decode_loop:
                 stbi__getn(s, rgbe, 4);
-                stbi__hdr_convert(hdr_data + j * width * req_comp + i * req_comp, rgbe, req_comp);
+                stbi__hdr_store(hdr_data, (size_t)j * width + i, rgbe, req_comp, raw);
             }
         }
     }
@@ -8497,7 +10951,7 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
                 rgbe[1] = (stbi_uc)c2;
                 rgbe[2] = (stbi_uc)len;
                 rgbe[3] = (stbi_uc)stbi__get8(s);
-                stbi__hdr_convert(hdr_data, rgbe, req_comp);
+                stbi__hdr_store(hdr_data, 0, rgbe, req_comp, raw);
                 i = 1;
                 j = 0;
                 STBI_FREE(scanline);
@@ -8509,17 +10963,19 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
             {
                 STBI_FREE(hdr_data);
                 STBI_FREE(scanline);
-                return stbi__errpf("invalid decoded scanline length", "corrupt HDR");
+                return stbi__errpuc("invalid decoded scanline length", "corrupt HDR");
             }
-            if (scanline == NULL)
+            if (scanline == NULL && !raw)
             {
                 scanline = (stbi_uc *)stbi__malloc_mad2(width, 4, 0);
                 if (!scanline)
                 {
                     STBI_FREE(hdr_data);
-                    return stbi__errpf("outofmem", "Out of memory");
+                    return stbi__errpuc("outofmem", "Out of memory");
                 }
             }
+            // raw RGBE is decoded straight into the output row
+            row = raw ? (stbi_uc *)hdr_data + (size_t)j * width * 4 : scanline;
 
             for (k = 0; k < 4; ++k)
             {
@@ -8537,10 +10993,10 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
                         {
                             STBI_FREE(hdr_data);
                             STBI_FREE(scanline);
-                            return stbi__errpf("corrupt", "bad RLE data in HDR");
+                            return stbi__errpuc("corrupt", "bad RLE data in HDR");
                         }
                         for (z = 0; z < count; ++z)
-                            scanline[i++ * 4 + k] = value;
+                            row[i++ * 4 + k] = value;
                     }
                     else
                     {
@@ -8549,15 +11005,16 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
                         {
                             STBI_FREE(hdr_data);
                             STBI_FREE(scanline);
-                            return stbi__errpf("corrupt", "bad RLE data in HDR");
+                            return stbi__errpuc("corrupt", "bad RLE data in HDR");
                         }
                         for (z = 0; z < count; ++z)
-                            scanline[i++ * 4 + k] = stbi__get8(s);
+                            row[i++ * 4 + k] = stbi__get8(s);
                     }
                 }
             }
-            for (i = 0; i < width; ++i)
-                stbi__hdr_convert(hdr_data + (j * width + i) * req_comp, scanline + i * 4, req_comp);
+            if (!raw)
+                for (i = 0; i < width; ++i)
+                    stbi__hdr_convert((float *)hdr_data + ((size_t)j * width + i) * req_comp, scanline + i * 4, req_comp);
         }
         if (scanline)
             STBI_FREE(scanline);
@@ -8566,6 +11023,117 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
     return hdr_data;
 }
 
+static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
+{
+    STBI_NOTUSED(ri);
+    return (float *)stbi__hdr_decode(s, x, y, comp, req_comp, 0);
+}
+
+static stbi_uc *stbi__load_rgbe_main(stbi__context *s, int *x, int *y)
+{
+    stbi_uc *result;
+    if (!stbi__hdr_test(s))
+        return stbi__errpuc("not HDR", "Image not a Radiance HDR file");
+    result = (stbi_uc *)stbi__hdr_decode(s, x, y, NULL, 4, 1);
+    if (result && stbi__vertically_flip_on_load)
+        stbi__vertical_flip(result, *x, *y, 4);
+    return result;
+}
+
+STBIDEF stbi_uc *stbi_load_rgbe_from_memory(stbi_uc const *buffer, int len, int *x, int *y)
+{
+    stbi__context s;
+    stbi__start_mem(&s, buffer, len);
+    return stbi__load_rgbe_main(&s, x, y);
+}
+
+STBIDEF stbi_uc *stbi_load_rgbe_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y)
+{
+    stbi__context s;
+    stbi__start_callbacks(&s, (stbi_io_callbacks *)clbk, user);
+    return stbi__load_rgbe_main(&s, x, y);
+}
+
+// the RGBE scale 2^(e-136) as float bits; exponents below 10 give values
+// under 2^-119, which are 0 as halves anyway
+static stbi__uint32 stbi__rgbe_scale_bits(int e)
+{
+    return e >= 10 ? (stbi__uint32)(e - 9) << 23 : 0;
+}
+
+// float to IEEE half with round to nearest even, for non-negative finite
+// input (Fabian Giesen's float_to_half_fast3_rtne)
+static stbi_us stbi__float_to_half(float f)
+{
+    union
+    {
+        float f;
+        stbi__uint32 u;
+    } v, magic;
+    v.f = f;
+    if (v.u >= (143u << 23)) // 65536 and up
+        return 0x7c00;
+    if (v.u < (113u << 23))
+    {
+        // subnormal or zero: let the float adder do the rounding
+        magic.u = 126u << 23;
+        v.f += magic.f;
+        return (stbi_us)(v.u - magic.u);
+    }
+    v.u += ((stbi__uint32)(15 - 127) << 23) + 0xfff + ((v.u >> 13) & 1);
+    return (stbi_us)(v.u >> 13);
+}
+
+static void stbi__rgbe_to_half_scalar(stbi_us *output, stbi_uc const *rgbe, int pixel_count)
+{
+    union
+    {
+        float f;
+        stbi__uint32 u;
+    } scale;
+    int i;
+    for (i = 0; i < pixel_count; ++i, rgbe += 4, output += 3)
+    {
+        scale.u = stbi__rgbe_scale_bits(rgbe[3]);
+        output[0] = stbi__float_to_half(rgbe[0] * scale.f);
+        output[1] = stbi__float_to_half(rgbe[1] * scale.f);
+        output[2] = stbi__float_to_half(rgbe[2] * scale.f);
+    }
+}
+
+#ifdef STBI__AVX2
+// two pixels per step: widen R,G,B,E to 32-bit lanes (one pixel per 128-bit
+// half), multiply by the broadcast scale, convert to half with F16C and drop
+// the E lanes. each 16-byte store carries 12 bytes of output and the next
+// store overwrites the rest, so the loop stops while a pixel is still left
+STBI__F16C_TARGET static int stbi__rgbe_to_half_f16c(stbi_us *output, stbi_uc const *rgbe, int pixel_count)
+{
+    __m256i nine = _mm256_set1_epi32(9);
+    __m128i pack = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+    int i;
+    for (i = 0; i + 3 <= pixel_count; i += 2)
+    {
+        __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const *)(rgbe + i * 4)));
+        __m256i e = _mm256_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+        __m256i bits = _mm256_and_si256(_mm256_slli_epi32(_mm256_sub_epi32(e, nine), 23), _mm256_cmpgt_epi32(e, nine));
+        __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_castsi256_ps(bits));
+        __m128i h = _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i *)(output + i * 3), _mm_shuffle_epi8(h, pack));
+    }
+    return i;
+}
+#endif
+
+STBIDEF void stbi_rgbe_to_half(stbi_us *output, stbi_uc const *rgbe, int pixel_count)
+{
+    int done = 0;
+#ifdef STBI__AVX2
+    if (stbi__f16c_available())
+        done = stbi__rgbe_to_half_f16c(output, rgbe, pixel_count);
+#endif
+    stbi__rgbe_to_half_scalar(output + done * 3, rgbe + done * 4, pixel_count - done);
+}
+
 static int stbi__hdr_info(stbi__context *s, int *x, int *y, int *comp)
 {
     char buffer[STBI__HDR_BUFLEN];
@@ -9105,6 +11673,80 @@ STBIDEF int stbi_is_16_bit_from_callbacks(stbi_io_callbacks const *c, void *user
     return stbi__is_16_main(&s);
 }
 
+// decodes the whole image the normal way and hands it to the sink in bands
+static int stbi__load_rows_whole(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__row_sink *sink)
+{
+    stbi__result_info ri;
+    int n, result;
+    stbi_uc *data = (stbi_uc *)stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
+    if (data == NULL)
+        return 0;
+    n = req_comp ? req_comp : *comp;
+    if (ri.bits_per_channel != 8)
+    {
+        STBI_ASSERT(ri.bits_per_channel == 16);
+        data = stbi__convert_16_to_8((stbi__uint16 *)data, *x, *y, n);
+        if (data == NULL)
+            return 0;
+    }
+    sink->row_bytes = *x * n;
+    result = stbi__sink_write(sink, data, *y, 1) && stbi__sink_flush(sink);
+    STBI_FREE(data);
+    return result;
+}
+
+static int stbi__load_rows_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__row_sink *sink)
+{
+    int dummy;
+    if (req_comp < 0 || req_comp > 4)
+        return stbi__err("bad req_comp", "Internal error");
+    if (sink->band_rows < 1)
+        return stbi__err("bad band_rows", "Internal error");
+    if (!comp)
+        comp = &dummy;
+#ifndef STBI_NO_PNG
+    if (stbi__png_test(s))
+        return stbi__png_load_rows(s, x, y, comp, req_comp, sink);
+#endif
+#ifndef STBI_NO_JPEG
+    if (stbi__jpeg_test(s))
+        return stbi__jpeg_load_rows(s, x, y, comp, req_comp, sink);
+#endif
+    return stbi__load_rows_whole(s, x, y, comp, req_comp, sink);
+}
+
+STBIDEF int stbi_load_rows_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels,
+                                       int band_rows, stbi_rows_callback callback, void *callback_user)
+{
+    stbi__context s;
+    stbi__row_sink sink;
+    int result;
+    memset(&sink, 0, sizeof(sink));
+    sink.callback = callback;
+    sink.user = callback_user;
+    sink.band_rows = band_rows;
+    stbi__start_mem(&s, buffer, len);
+    result = stbi__load_rows_main(&s, x, y, channels_in_file, desired_channels, &sink);
+    STBI_FREE(sink.band);
+    return result;
+}
+
+STBIDEF int stbi_load_rows_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *channels_in_file, int desired_channels,
+                                          int band_rows, stbi_rows_callback callback, void *callback_user)
+{
+    stbi__context s;
+    stbi__row_sink sink;
+    int result;
+    memset(&sink, 0, sizeof(sink));
+    sink.callback = callback;
+    sink.user = callback_user;
+    sink.band_rows = band_rows;
+    stbi__start_callbacks(&s, (stbi_io_callbacks *)clbk, user);
+    result = stbi__load_rows_main(&s, x, y, channels_in_file, desired_channels, &sink);
+    STBI_FREE(sink.band);
+    return result;
+}
+
 #endif // STB_IMAGE_IMPLEMENTATION
 
 /*
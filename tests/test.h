@@ -0,0 +1,26 @@
+#ifndef REOPENGL_TEST_H
+#define REOPENGL_TEST_H
+
+#include <stdio.h>
+
+/* checks keep going after a failure so one run reports all of them; main returns TestResult() */
+static int testFailures = 0;
+
+#define CHECK(cond)                                                                    \
+    do                                                                                 \
+    {                                                                                  \
+        if (!(cond))                                                                   \
+        {                                                                              \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            testFailures++;                                                            \
+        }                                                                              \
+    } while (0)
+
+static int TestResult(void)
+{
+    if (testFailures)
+        fprintf(stderr, "%d check(s) failed\n", testFailures);
+    return testFailures ? 1 : 0;
+}
+
+#endif
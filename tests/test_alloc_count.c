@@ -0,0 +1,234 @@
+/*
+    test_alloc_count :
+    texture cache hits and LoadImageInto must not allocate once warm. stb's allocator macros are wrapped to count
+    what lands on the heap instead of the image arena, and the program is linked with --wrap for malloc, calloc,
+    realloc and free, so every heap call made from reopengl.c or stb_img.h is counted as well (calls made inside
+    libc itself, e.g. by realpath, are not). no GL context is needed : the cache entry is registered directly.
+*/
+#include "../reopengl.c"
+
+/* volatile : the compiler assumes malloc doesn't touch our globals */
+static volatile size_t stbHeapAllocations;
+static volatile size_t heapAllocations;
+
+static void *CountedStbiAlloc(size_t size);
+static void *CountedStbiRealloc(void *p, size_t oldSize, size_t newSize);
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_JPEG_THREADS
+#define STBI_MALLOC(sz) CountedStbiAlloc(sz)
+#define STBI_REALLOC_SIZED(p, oldsz, newsz) CountedStbiRealloc(p, oldsz, newsz)
+#define STBI_FREE(p) ImageArenaFree(p)
+#include "../stb_img.h"
+#include "test.h"
+
+static void *CountedStbiAlloc(size_t size)
+{
+    void *p = ImageArenaAlloc(size);
+    if (p && !InArena(p))
+        stbHeapAllocations++;
+    return p;
+}
+
+static void *CountedStbiRealloc(void *p, size_t oldSize, size_t newSize)
+{
+    void *q = ImageArenaRealloc(p, oldSize, newSize);
+    if (q && !InArena(q))
+        stbHeapAllocations++;
+    return q;
+}
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *p, size_t size);
+void __real_free(void *p);
+
+void *__wrap_malloc(size_t size)
+{
+    heapAllocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    heapAllocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+    heapAllocations++;
+    return __real_realloc(p, size);
+}
+
+void __wrap_free(void *p)
+{
+    __real_free(p);
+}
+
+/* 16x8 RGB */
+static const unsigned char smallPng[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x08,
+    0x08, 0x02, 0x00, 0x00, 0x00, 0x7f, 0x14, 0xe8, 0xc0, 0x00, 0x00, 0x01,
+    0x05, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x05, 0xc1, 0xa1, 0x01, 0xc0,
+    0x20, 0x0c, 0x04, 0xc0, 0x97, 0x95, 0x48, 0x64, 0x24, 0x12, 0x89, 0x8c,
+    0xac, 0x44, 0x22, 0x23, 0x2b, 0x91, 0xc8, 0x8c, 0xc0, 0x08, 0x19, 0x81,
+    0x11, 0x32, 0x42, 0x47, 0xc8, 0x08, 0x1d, 0xa1, 0x77, 0x00, 0x90, 0x70,
+    0x11, 0x52, 0x45, 0x66, 0x50, 0x47, 0x11, 0xd4, 0x89, 0xa6, 0xe0, 0x8d,
+    0xdb, 0xd0, 0x0f, 0x86, 0x43, 0x5e, 0x3c, 0x81, 0xf9, 0x61, 0x01, 0x74,
+    0x25, 0x02, 0x51, 0xae, 0x94, 0x98, 0x4a, 0x27, 0x12, 0x6a, 0x93, 0xaa,
+    0xd2, 0xbd, 0x89, 0x8d, 0xc6, 0xa1, 0xee, 0xf4, 0xbc, 0x24, 0x41, 0xeb,
+    0xa3, 0x09, 0x70, 0x4a, 0x9c, 0x89, 0x51, 0xf9, 0x62, 0xae, 0x9d, 0x9b,
+    0x30, 0x4d, 0x2e, 0xca, 0x7d, 0xf3, 0x30, 0xe6, 0xc3, 0xb7, 0xf3, 0x7c,
+    0x79, 0x05, 0xcb, 0xc7, 0x0f, 0x20, 0x39, 0x49, 0x22, 0xb9, 0xaa, 0x80,
+    0xa5, 0x75, 0xa9, 0x22, 0x65, 0x0a, 0xa9, 0x8c, 0x2d, 0xdd, 0xe4, 0x3e,
+    0xc2, 0x2e, 0xeb, 0x95, 0x19, 0xf2, 0x7c, 0x22, 0x80, 0x52, 0xd2, 0x42,
+    0x5a, 0xab, 0x36, 0x56, 0x74, 0xbd, 0x44, 0xd3, 0xd4, 0xac, 0x2a, 0x5b,
+    0x1f, 0xd3, 0x79, 0x74, 0xb9, 0xf2, 0xab, 0x77, 0x68, 0xff, 0x74, 0x00,
+    0x56, 0x92, 0x11, 0x59, 0xab, 0x56, 0xd9, 0xae, 0x6e, 0x10, 0xcb, 0xd3,
+    0x92, 0xda, 0xb3, 0x4d, 0xcc, 0xd6, 0xb1, 0xe9, 0x76, 0xbf, 0xc6, 0x61,
+    0xe3, 0xb3, 0x0e, 0x78, 0x4d, 0xde, 0xc8, 0xa9, 0x7a, 0x61, 0x4f, 0xdd,
+    0xb3, 0x38, 0xa6, 0x5f, 0xea, 0x73, 0xfb, 0x32, 0x97, 0xe3, 0x8f, 0x7b,
+    0x7f, 0x7d, 0x84, 0xf3, 0xe7, 0x37, 0x10, 0x2d, 0x45, 0xa5, 0x28, 0x35,
+    0x88, 0x23, 0xf7, 0x48, 0x12, 0xd7, 0x0c, 0x68, 0xac, 0x1d, 0xd3, 0xe2,
+    0x39, 0x21, 0x1e, 0xe3, 0x8d, 0x1e, 0x71, 0x7f, 0xc1, 0x3f, 0x1a, 0xfb,
+    0x92, 0x01, 0xb8, 0x29, 0x07, 0x41, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45,
+    0x4e, 0x44, 0xae, 0x42, 0x60, 0x82
+};
+
+/* 16x16 RGB, 4:2:0 */
+static const unsigned char smallJpeg[] = {
+    0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46, 0x49, 0x46, 0x00, 0x01,
+    0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43,
+    0x00, 0x10, 0x0b, 0x0c, 0x0e, 0x0c, 0x0a, 0x10, 0x0e, 0x0d, 0x0e, 0x12,
+    0x11, 0x10, 0x13, 0x18, 0x28, 0x1a, 0x18, 0x16, 0x16, 0x18, 0x31, 0x23,
+    0x25, 0x1d, 0x28, 0x3a, 0x33, 0x3d, 0x3c, 0x39, 0x33, 0x38, 0x37, 0x40,
+    0x48, 0x5c, 0x4e, 0x40, 0x44, 0x57, 0x45, 0x37, 0x38, 0x50, 0x6d, 0x51,
+    0x57, 0x5f, 0x62, 0x67, 0x68, 0x67, 0x3e, 0x4d, 0x71, 0x79, 0x70, 0x64,
+    0x78, 0x5c, 0x65, 0x67, 0x63, 0xff, 0xdb, 0x00, 0x43, 0x01, 0x11, 0x12,
+    0x12, 0x18, 0x15, 0x18, 0x2f, 0x1a, 0x1a, 0x2f, 0x63, 0x42, 0x38, 0x42,
+    0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+    0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+    0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+    0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+    0x63, 0x63, 0xff, 0xc0, 0x00, 0x11, 0x08, 0x00, 0x10, 0x00, 0x10, 0x03,
+    0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01, 0xff, 0xc4, 0x00,
+    0x1f, 0x00, 0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+    0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0xff, 0xc4, 0x00, 0xb5, 0x10, 0x00,
+    0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00,
+    0x00, 0x01, 0x7d, 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21,
+    0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81,
+    0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24,
+    0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25,
+    0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a,
+    0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56,
+    0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+    0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86,
+    0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99,
+    0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3,
+    0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6,
+    0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9,
+    0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1,
+    0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xff, 0xc4, 0x00,
+    0x1f, 0x01, 0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+    0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0xff, 0xc4, 0x00, 0xb5, 0x11, 0x00,
+    0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00,
+    0x01, 0x02, 0x77, 0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31,
+    0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08,
+    0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15,
+    0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18,
+    0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39,
+    0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84,
+    0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+    0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa,
+    0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4,
+    0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7,
+    0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+    0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xff, 0xda, 0x00,
+    0x0c, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3f, 0x00, 0xe4,
+    0x6d, 0x97, 0x18, 0xad, 0xab, 0x65, 0xc5, 0x67, 0x5b, 0x2e, 0x08, 0xad,
+    0x2b, 0x65, 0xc6, 0x3d, 0xeb, 0xa2, 0x9a, 0x32, 0xa8, 0x8f, 0xff, 0xd9
+};
+
+static bool WriteFile(const char *path, const unsigned char *data, size_t size)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+static void CheckCacheHits(const char *path)
+{
+    char canonicalPath[CANONICAL_PATH_MAX];
+    unsigned int hash = 0;
+    TextureS tex = {0};
+    CHECK(!AcquireCachedTexture(path, TEXTURE_REPEAT, TEXTURE_ORIGIN_BOTTOM_LEFT, 0, &tex, canonicalPath, &hash));
+
+    /* what LoadTextureEx registers after an upload, with a made-up texture id */
+    tex.id = 7;
+    tex.width = 16;
+    tex.height = 8;
+    tex.channels = 3;
+    tex.setting = TEXTURE_REPEAT;
+    tex.origin = TEXTURE_ORIGIN_BOTTOM_LEFT;
+    RegisterCachedTexture(canonicalPath, hash, 0, &tex);
+
+    size_t before = heapAllocations;
+    for (int i = 0; i < 100; i++)
+    {
+        TextureS hit = LoadTexture(path, TEXTURE_REPEAT);
+        CHECK(hit.id == 7 && hit.width == 16);
+    }
+    CHECK(heapAllocations == before);
+    if (heapAllocations != before)
+        fprintf(stderr, "100 cache hits made %zu heap allocations\n", heapAllocations - before);
+}
+
+static void CheckLoadImageInto(const char *path, int width, int height)
+{
+    unsigned char pixels[16 * 16 * 4];
+    int w = 0, h = 0, c = 0;
+
+    /* the first load sizes the arena block */
+    CHECK(LoadImageInto(path, pixels, sizeof(pixels), &w, &h, &c, 4));
+    CHECK(w == width && h == height && c == 3);
+
+    size_t before = heapAllocations, stbBefore = stbHeapAllocations, arenaBefore = GetImageHeapAllocations();
+    for (int i = 0; i < 20; i++)
+        CHECK(LoadImageInto(path, pixels, sizeof(pixels), &w, &h, &c, 4));
+    CHECK(stbHeapAllocations == stbBefore);
+    CHECK(GetImageHeapAllocations() == arenaBefore);
+    CHECK(heapAllocations == before);
+    if (heapAllocations != before)
+        fprintf(stderr, "20 warm LoadImageInto(%s) made %zu heap allocations\n", path, heapAllocations - before);
+}
+
+int main(void)
+{
+    const char *pngPath = "test_alloc_count.png";
+    const char *jpegPath = "test_alloc_count.jpg";
+    CHECK(WriteFile(pngPath, smallPng, sizeof(smallPng)));
+    CHECK(WriteFile(jpegPath, smallJpeg, sizeof(smallJpeg)));
+
+    CheckCacheHits(pngPath);
+    CheckLoadImageInto(pngPath, 16, 8);
+    CheckLoadImageInto(jpegPath, 16, 16);
+
+    /* the counters themselves work */
+    size_t before = heapAllocations;
+    void *volatile probe = malloc(16);
+    free(probe);
+    CHECK(heapAllocations == before + 1);
+
+    ReleaseImageArena();
+    remove(pngPath);
+    remove(jpegPath);
+    return TestResult();
+}
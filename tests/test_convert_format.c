@@ -0,0 +1,156 @@
+/*
+    test_convert_format :
+    stbi__convert_format and stbi__convert_format16 for every (img_n, req_comp) pair and every width from 1 to
+    127, against a plain per-pixel conversion with the rules of their scalar switch. the SSSE3 shuffle kernel is
+    also run on its own over single rows with guard bytes behind the output, since its 16-byte stores run past
+    the pixels they convert and only the end-of-row margin keeps them inside the row. the input rows are
+    allocated at their exact size, so a sanitizer build also catches reads past them.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "test.h"
+
+#define GUARD 64
+#define MAX_WIDTH 127
+#define ROWS 3
+
+static unsigned int randomState = 1;
+
+static unsigned int Random(void)
+{
+    randomState = randomState * 1103515245u + 12345u;
+    return randomState >> 8;
+}
+
+static unsigned int Get(const stbi_uc *p, int bytes)
+{
+    stbi__uint16 v;
+    if (bytes == 1)
+        return *p;
+    memcpy(&v, p, 2);
+    return v;
+}
+
+static void Put(stbi_uc *p, int bytes, unsigned int v)
+{
+    stbi__uint16 w = (stbi__uint16)v;
+    if (bytes == 1)
+        *p = (stbi_uc)v;
+    else
+        memcpy(p, &w, 2);
+}
+
+/* grey gets replicated, colour dropped to luma, missing alpha made opaque */
+static void ReferenceConvert(stbi_uc *dest, const stbi_uc *src, int img_n, int req_comp, int pixels, int bytes)
+{
+    unsigned int opaque = bytes == 1 ? 0xff : 0xffff;
+    int i, c;
+    for (i = 0; i < pixels; ++i, src += img_n * bytes, dest += req_comp * bytes)
+    {
+        unsigned int px[4], out[4];
+        int srcAlpha = img_n == 2 || img_n == 4;
+        for (c = 0; c < img_n; ++c)
+            px[c] = Get(src + c * bytes, bytes);
+        if (img_n >= 3 && req_comp <= 2)
+            out[0] = ((px[0] * 77) + (px[1] * 150) + (29 * px[2])) >> 8;
+        else
+            out[0] = px[0];
+        if (req_comp >= 3)
+        {
+            out[1] = img_n >= 3 ? px[1] : px[0];
+            out[2] = img_n >= 3 ? px[2] : px[0];
+        }
+        if (req_comp == 2 || req_comp == 4)
+            out[req_comp - 1] = srcAlpha ? px[img_n - 1] : opaque;
+        for (c = 0; c < req_comp; ++c)
+            Put(dest + c * bytes, bytes, out[c]);
+    }
+}
+
+static stbi_uc *RandomImage(int img_n, int x, int y, int bytes)
+{
+    size_t size = (size_t)img_n * x * y * bytes, k;
+    stbi_uc *data = (stbi_uc *)STBI_MALLOC(size);
+    for (k = 0; k < size; ++k)
+        data[k] = (stbi_uc)Random();
+    return data;
+}
+
+static void CheckConvert(int img_n, int req_comp, int bytes)
+{
+    stbi_uc expected[4 * 2 * MAX_WIDTH * ROWS];
+    int x;
+    for (x = 1; x <= MAX_WIDTH; ++x)
+    {
+        size_t outSize = (size_t)req_comp * x * ROWS * bytes;
+        stbi_uc *data = RandomImage(img_n, x, ROWS, bytes), *converted;
+        ReferenceConvert(expected, data, img_n, req_comp, x * ROWS, bytes);
+        if (bytes == 1)
+            converted = stbi__convert_format(data, img_n, req_comp, (unsigned int)x, ROWS);
+        else
+            converted = (stbi_uc *)stbi__convert_format16((stbi__uint16 *)data, img_n, req_comp, (unsigned int)x, ROWS);
+        if (!converted || memcmp(expected, converted, outSize) != 0)
+        {
+            fprintf(stderr, "convert %d -> %d, %d-bit, width %d differs\n", img_n, req_comp, 8 * bytes, x);
+            testFailures++;
+            STBI_FREE(converted);
+            return;
+        }
+        STBI_FREE(converted);
+    }
+}
+
+#ifdef STBI__AVX2
+static void CheckShuffleKernel(int img_n, int req_comp, int bytes)
+{
+    stbi_uc shuf[16], fill[16];
+    stbi_uc expected[4 * 2 * MAX_WIDTH], actual[4 * 2 * MAX_WIDTH + GUARD];
+    int q = stbi__convert_shuffle_setup(img_n, req_comp, bytes, shuf, fill), x, k;
+    if (!q)
+        return;
+    for (x = 1; x <= MAX_WIDTH; ++x)
+    {
+        int in = img_n * bytes, out = req_comp * bytes, done;
+        stbi_uc *row = RandomImage(img_n, x, 1, bytes);
+        ReferenceConvert(expected, row, img_n, req_comp, x, bytes);
+        memset(actual, 0xcd, sizeof(actual));
+        done = stbi__convert_shuffle_ssse3(actual, row, x, in, out, q, shuf, fill);
+        STBI_FREE(row);
+        for (k = x * out; k < x * out + GUARD; ++k)
+        {
+            if (actual[k] != 0xcd)
+                break;
+        }
+        if (done < 0 || done > x || memcmp(expected, actual, (size_t)done * out) != 0 || k < x * out + GUARD)
+        {
+            fprintf(stderr, "shuffle %d -> %d, %d-bit, width %d: %s\n", img_n, req_comp, 8 * bytes, x,
+                    k < x * out + GUARD ? "wrote past the row" : "differs");
+            testFailures++;
+            return;
+        }
+    }
+}
+#endif
+
+int main(void)
+{
+    int img_n, req_comp, bytes;
+    for (bytes = 1; bytes <= 2; ++bytes)
+    {
+        for (img_n = 1; img_n <= 4; ++img_n)
+        {
+            for (req_comp = 1; req_comp <= 4; ++req_comp)
+            {
+                if (img_n == req_comp)
+                    continue;
+                /* the kernel first : an overrun there would corrupt the heap in the full conversion */
+#ifdef STBI__AVX2
+                if (stbi__ssse3_available())
+                    CheckShuffleKernel(img_n, req_comp, bytes);
+#endif
+                CheckConvert(img_n, req_comp, bytes);
+            }
+        }
+    }
+    return TestResult();
+}
@@ -0,0 +1,77 @@
+/*
+    test_gif_stream :
+    stbi_gif_stream_next and _rewind looping an animation, with and without the 0x3B trailer. Many GIFs stop
+    right after their last frame; that has to end the pass like the trailer does, or a looping player stops.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "test.h"
+
+/* 4x2, three frames: red, green then blue with the last pixel white, delays 50, 100 and 150 ms */
+static const unsigned char animatedGif[] = {
+    0x47, 0x49, 0x46, 0x38, 0x39, 0x61, 0x04, 0x00, 0x02, 0x00, 0xf1, 0x00,
+    0x00, 0xff, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff,
+    0xff, 0x21, 0xff, 0x0b, 0x4e, 0x45, 0x54, 0x53, 0x43, 0x41, 0x50, 0x45,
+    0x32, 0x2e, 0x30, 0x03, 0x01, 0x00, 0x00, 0x00, 0x21, 0xf9, 0x04, 0x04,
+    0x05, 0x00, 0x00, 0x00, 0x2c, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x02,
+    0x00, 0x00, 0x02, 0x05, 0x04, 0x08, 0x10, 0x20, 0x56, 0x00, 0x21, 0xf9,
+    0x04, 0x04, 0x0a, 0x00, 0x00, 0x00, 0x2c, 0x00, 0x00, 0x00, 0x00, 0x04,
+    0x00, 0x02, 0x00, 0x00, 0x02, 0x05, 0x4c, 0x98, 0x30, 0x61, 0x56, 0x00,
+    0x21, 0xf9, 0x04, 0x04, 0x0f, 0x00, 0x00, 0x00, 0x2c, 0x00, 0x00, 0x00,
+    0x00, 0x04, 0x00, 0x02, 0x00, 0x00, 0x02, 0x05, 0x94, 0x28, 0x51, 0xa2,
+    0x56, 0x00, 0x3b
+};
+
+static const unsigned char frameColors[3][3] = {{255, 0, 0}, {0, 255, 0}, {0, 0, 255}};
+
+static void CheckPasses(const unsigned char *gif, int length, int passes)
+{
+    int w, h, pass, f;
+    stbi_gif_stream *stream = stbi_gif_stream_open_from_memory(gif, length, &w, &h);
+    CHECK(stream != NULL);
+    if (!stream)
+        return;
+    CHECK(w == 4 && h == 2);
+
+    for (pass = 0; pass < passes; ++pass)
+    {
+        stbi_uc *frame = NULL;
+        int delay = 0;
+        for (f = 0; f < 3; ++f)
+        {
+            CHECK(stbi_gif_stream_next(stream, &frame, &delay) == 1);
+            if (!frame)
+                break;
+            CHECK(memcmp(frame, frameColors[f], 3) == 0);
+            CHECK(frame[7 * 4] == 255 && frame[7 * 4 + 1] == 255 && frame[7 * 4 + 2] == 255);
+            CHECK(delay == 50 * (f + 1));
+        }
+        /* past the last frame, every time it's asked */
+        CHECK(stbi_gif_stream_next(stream, &frame, &delay) == 0);
+        CHECK(stbi_gif_stream_next(stream, &frame, &delay) == 0);
+        stbi_gif_stream_rewind(stream);
+    }
+    stbi_gif_stream_close(stream);
+}
+
+int main(void)
+{
+    int length = (int)sizeof(animatedGif);
+    stbi_gif_stream *stream;
+    stbi_uc *frame;
+    int delay;
+
+    CHECK(animatedGif[length - 1] == 0x3b);
+    CheckPasses(animatedGif, length, 3);
+    CheckPasses(animatedGif, length - 1, 3);
+
+    /* data that ends before the first frame (here inside its graphic control extension) is still an error */
+    stream = stbi_gif_stream_open_from_memory(animatedGif, 50, NULL, NULL);
+    CHECK(stream != NULL);
+    if (stream)
+    {
+        CHECK(stbi_gif_stream_next(stream, &frame, &delay) == -1);
+        stbi_gif_stream_close(stream);
+    }
+    return TestResult();
+}
@@ -0,0 +1,508 @@
+/*
+    test_inflate :
+    the zlib decoder's fast huffman loop and the careful loop it hands back to. a small deflate encoder here
+    writes stored, fixed and dynamic blocks (one dynamic code with 5-bit literals that pair up in the fast
+    table, one with 1- to 15-bit codes), alone and mixed in one stream, for outputs of 0 to 700 bytes and a few
+    large ones, so both loops see the 8-byte input and 274-byte output margins from every side. each stream is
+    inflated through stbi_zlib_decode_* into growing and exact-size buffers, and wrapped in a PNG whose IDAT is
+    cut into chunks of 1 to 40 bytes and more, which stbi_load_rows_from_memory streams through its refill hook.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "test.h"
+
+#define GUARD 64
+
+static unsigned int randomState = 1;
+
+static unsigned int Random(void)
+{
+    randomState = randomState * 1103515245u + 12345u;
+    return randomState >> 8;
+}
+
+/* ---- deflate encoder ---- */
+
+enum
+{
+    BLOCK_STORED,
+    BLOCK_FIXED,
+    BLOCK_FLAT, /* dynamic : 16 literals at 5 bits, everything else 9 or 10 */
+    BLOCK_DEEP, /* dynamic : codes from 1 to 15 bits */
+    BLOCK_TYPES
+};
+
+typedef struct
+{
+    unsigned char *data;
+    int size, capacity;
+    unsigned long long bits;
+    int bitCount;
+} WriterS;
+
+static void PutByte(WriterS *w, unsigned char b)
+{
+    if (w->size == w->capacity)
+    {
+        w->capacity = w->capacity ? 2 * w->capacity : 1024;
+        w->data = (unsigned char *)realloc(w->data, (size_t)w->capacity);
+    }
+    w->data[w->size++] = b;
+}
+
+static void PutBits(WriterS *w, unsigned int value, int count)
+{
+    w->bits |= (unsigned long long)value << w->bitCount;
+    w->bitCount += count;
+    while (w->bitCount >= 8)
+    {
+        PutByte(w, (unsigned char)w->bits);
+        w->bits >>= 8;
+        w->bitCount -= 8;
+    }
+}
+
+static void AlignToByte(WriterS *w)
+{
+    if (w->bitCount)
+        PutBits(w, 0, 8 - w->bitCount);
+}
+
+typedef struct
+{
+    int length[288];
+    unsigned int code[288];
+} CodeS;
+
+/* canonical codes, bit-reversed since deflate sends huffman codes msb first */
+static void BuildCode(CodeS *c, int count)
+{
+    int lengthCount[16] = {0}, next[16], i, k, code = 0;
+    for (i = 0; i < count; ++i)
+        lengthCount[c->length[i]]++;
+    lengthCount[0] = 0;
+    for (i = 1; i < 16; ++i)
+    {
+        code = (code + lengthCount[i - 1]) << 1;
+        next[i] = code;
+    }
+    for (i = 0; i < count; ++i)
+    {
+        unsigned int v = c->length[i] ? (unsigned int)next[c->length[i]]++ : 0, r = 0;
+        for (k = 0; k < c->length[i]; ++k)
+            r |= ((v >> k) & 1) << (c->length[i] - 1 - k);
+        c->code[i] = r;
+    }
+}
+
+static void PutSymbol(WriterS *w, const CodeS *c, int symbol)
+{
+    PutBits(w, c->code[symbol], c->length[symbol]);
+}
+
+/* every code here is complete : the lengths fill the code space exactly */
+static void BlockCodes(int type, CodeS *lit, CodeS *dist)
+{
+    int i, n10 = 0;
+    for (i = 0; i < 288; ++i)
+        lit->length[i] = dist->length[i] = 0;
+    if (type == BLOCK_FIXED)
+    {
+        for (i = 0; i < 288; ++i)
+            lit->length[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+        for (i = 0; i < 30; ++i)
+            dist->length[i] = 5;
+    }
+    else if (type == BLOCK_FLAT)
+    {
+        /* 16 at 5 bits, 242 at 9, 28 at 10 */
+        for (i = 0; i < 286; ++i)
+            lit->length[i] = (i >= 'a' && i <= 'p') ? 5 : i >= 286 - 28 ? 10 : 9;
+        for (i = 0; i < 30; ++i)
+            dist->length[i] = i < 2 ? 4 : 5;
+    }
+    else
+    {
+        /* 'a' at 1, 'b' at 2, 0xf0-0xff at 15, then 243 at 10 and 25 at 11 */
+        for (i = 0; i < 286; ++i)
+        {
+            if (i == 'a')
+                lit->length[i] = 1;
+            else if (i == 'b')
+                lit->length[i] = 2;
+            else if (i >= 0xf0 && i <= 0xff)
+                lit->length[i] = 15;
+            else
+                lit->length[i] = n10++ < 243 ? 10 : 11;
+        }
+        /* distance 1 at 1 bit, 3 at 5, 26 at 6 */
+        for (i = 0; i < 30; ++i)
+            dist->length[i] = i == 0 ? 1 : i < 4 ? 5 : 6;
+    }
+    BuildCode(lit, type == BLOCK_FIXED ? 288 : 286);
+    BuildCode(dist, 30);
+}
+
+/* every length sent as its own code-length symbol, no run codes */
+static void PutDynamicHeader(WriterS *w, const CodeS *lit, const CodeS *dist)
+{
+    static const int order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    CodeS lengths;
+    int i;
+    /* 13 code-length symbols at 4 bits, 6 at 5 */
+    for (i = 0; i < 19; ++i)
+        lengths.length[i] = i < 13 ? 4 : 5;
+    BuildCode(&lengths, 19);
+    PutBits(w, 286 - 257, 5);
+    PutBits(w, 30 - 1, 5);
+    PutBits(w, 19 - 4, 4);
+    for (i = 0; i < 19; ++i)
+        PutBits(w, (unsigned int)lengths.length[order[i]], 3);
+    for (i = 0; i < 286; ++i)
+        PutSymbol(w, &lengths, lit->length[i]);
+    for (i = 0; i < 30; ++i)
+        PutSymbol(w, &lengths, dist->length[i]);
+}
+
+static int LongestMatch(const unsigned char *data, int pos, int end, int *distance)
+{
+    int best = 0, d, tries = 0;
+    int maxLength = end - pos < 258 ? end - pos : 258;
+    /* short distances for overlapping copies, then a few far ones */
+    for (d = 1; d <= pos && d <= 32768 && tries < 40; d += d < 16 ? 1 : 1 + (int)(Random() % 997), ++tries)
+    {
+        int n = 0;
+        while (n < maxLength && data[pos + n] == data[pos - d + n])
+            n++;
+        if (n > best)
+        {
+            best = n;
+            *distance = d;
+        }
+    }
+    return best;
+}
+
+static void PutLengthDistance(WriterS *w, const CodeS *lit, const CodeS *dist, int length, int distance)
+{
+    int z = 28, d = 29;
+    while (stbi__zlength_base[z] > length)
+        z--;
+    PutSymbol(w, lit, 257 + z);
+    PutBits(w, (unsigned int)(length - stbi__zlength_base[z]), stbi__zlength_extra[z]);
+    while (stbi__zdist_base[d] > distance)
+        d--;
+    PutSymbol(w, dist, d);
+    PutBits(w, (unsigned int)(distance - stbi__zdist_base[d]), stbi__zdist_extra[d]);
+}
+
+/* bytes [start, end) of data as one block; matches may reach back before start */
+static void PutBlock(WriterS *w, const unsigned char *data, int start, int end, int type, int final)
+{
+    CodeS lit, dist;
+    int pos = start;
+    if (type == BLOCK_STORED)
+    {
+        int length = end - start;
+        PutBits(w, (unsigned int)final, 1);
+        PutBits(w, 0, 2);
+        AlignToByte(w);
+        PutByte(w, (unsigned char)length);
+        PutByte(w, (unsigned char)(length >> 8));
+        PutByte(w, (unsigned char)~length);
+        PutByte(w, (unsigned char)(~length >> 8));
+        for (; pos < end; ++pos)
+            PutByte(w, data[pos]);
+        return;
+    }
+
+    BlockCodes(type, &lit, &dist);
+    PutBits(w, (unsigned int)final, 1);
+    PutBits(w, type == BLOCK_FIXED ? 1 : 2, 2);
+    if (type != BLOCK_FIXED)
+        PutDynamicHeader(w, &lit, &dist);
+    while (pos < end)
+    {
+        int distance = 0, length = LongestMatch(data, pos, end, &distance);
+        if (length >= 3)
+        {
+            PutLengthDistance(w, &lit, &dist, length, distance);
+            pos += length;
+        }
+        else
+            PutSymbol(w, &lit, data[pos++]);
+    }
+    PutSymbol(w, &lit, 256);
+}
+
+static unsigned int Adler32(const unsigned char *data, int length)
+{
+    unsigned int a = 1, b = 0;
+    int i;
+    for (i = 0; i < length; ++i)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+/* type < 0 mixes block types and sizes; stored blocks are split at 65535 bytes */
+static WriterS Deflate(const unsigned char *data, int length, int type, int zlibHeader)
+{
+    WriterS w = {NULL, 0, 0, 0, 0};
+    int pos = 0;
+    if (zlibHeader)
+    {
+        PutByte(&w, 0x78);
+        PutByte(&w, 0x01);
+    }
+    do
+    {
+        int blockType = type >= 0 ? type : (int)(Random() % BLOCK_TYPES);
+        int size = type >= 0 ? length - pos : 1 + (int)(Random() % 2000);
+        if (blockType == BLOCK_STORED && size > 65535)
+            size = 65535;
+        if (size > length - pos)
+            size = length - pos;
+        PutBlock(&w, data, pos, pos + size, blockType, pos + size == length);
+        pos += size;
+    } while (pos < length);
+    AlignToByte(&w);
+    if (zlibHeader)
+    {
+        unsigned int adler = Adler32(data, length);
+        PutByte(&w, (unsigned char)(adler >> 24));
+        PutByte(&w, (unsigned char)(adler >> 16));
+        PutByte(&w, (unsigned char)(adler >> 8));
+        PutByte(&w, (unsigned char)adler);
+    }
+    return w;
+}
+
+/* text-like runs over 'a'..'p', byte runs, short repeating patterns, copies of earlier bytes and noise */
+static void FillData(unsigned char *data, int length)
+{
+    int pos = 0;
+    while (pos < length)
+    {
+        int run = 1 + (int)(Random() % 300), kind = (int)(Random() % 5), i;
+        int back = 8 + (int)(Random() % 8);
+        if (run > length - pos)
+            run = length - pos;
+        for (i = 0; i < run; ++i)
+        {
+            switch (kind)
+            {
+            case 0:
+                data[pos + i] = (unsigned char)('a' + Random() % 16);
+                break;
+            case 1:
+                data[pos + i] = i ? data[pos] : (unsigned char)Random();
+                break;
+            case 2:
+                data[pos + i] = i >= 5 ? data[pos + i - 5] : (unsigned char)('a' + Random() % 3);
+                break;
+            case 3:
+                data[pos + i] = pos >= back ? data[pos + i - back] : (unsigned char)Random();
+                break;
+            default:
+                data[pos + i] = (unsigned char)Random();
+                break;
+            }
+        }
+        pos += run;
+    }
+}
+
+/* ---- zlib api ---- */
+
+static void CheckZlib(const unsigned char *data, int length, int type)
+{
+    WriterS z = Deflate(data, length, type, 1);
+    WriterS raw = Deflate(data, length, type, 0);
+    char *exact = (char *)malloc((size_t)length + GUARD);
+    int outLength = -1, ok, k;
+
+    /* growing from a 1-byte buffer runs the careful loop's expansion between fast runs */
+    char *out = stbi_zlib_decode_malloc_guesssize((const char *)z.data, z.size, 1, &outLength);
+    ok = out && outLength == length && memcmp(out, data, (size_t)length) == 0;
+    free(out);
+    out = stbi_zlib_decode_malloc((const char *)z.data, z.size, &outLength);
+    ok = ok && out && outLength == length && memcmp(out, data, (size_t)length) == 0;
+    free(out);
+    out = stbi_zlib_decode_noheader_malloc((const char *)raw.data, raw.size, &outLength);
+    ok = ok && out && outLength == length && memcmp(out, data, (size_t)length) == 0;
+    free(out);
+
+    /* exact-size buffers end inside the fast loop's output margin; nothing may land past them */
+    memset(exact, 0xcd, (size_t)length + GUARD);
+    ok = ok && stbi_zlib_decode_buffer(exact, length, (const char *)z.data, z.size) == length && memcmp(exact, data, (size_t)length) == 0;
+    ok = ok && stbi_zlib_decode_noheader_buffer(exact, length, (const char *)raw.data, raw.size) == length && memcmp(exact, data, (size_t)length) == 0;
+    if (length > 0)
+        ok = ok && stbi_zlib_decode_buffer(exact, length - 1, (const char *)z.data, z.size) == -1;
+    for (k = length; k < length + GUARD; ++k)
+        ok = ok && (unsigned char)exact[k] == 0xcd;
+
+    if (!ok)
+    {
+        fprintf(stderr, "zlib : block type %d, %d bytes differs\n", type, length);
+        testFailures++;
+    }
+    free(exact);
+    free(z.data);
+    free(raw.data);
+}
+
+/* ---- streamed png ---- */
+
+static unsigned int Crc32(const unsigned char *data, int length, unsigned int crc)
+{
+    int i, k;
+    for (i = 0; i < length; ++i)
+    {
+        crc ^= data[i];
+        for (k = 0; k < 8; ++k)
+            crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+    }
+    return crc;
+}
+
+static void PutChunk(WriterS *png, const char *type, const unsigned char *data, int length)
+{
+    unsigned int crc;
+    int i;
+    for (i = 24; i >= 0; i -= 8)
+        PutByte(png, (unsigned char)(length >> i));
+    for (i = 0; i < 4; ++i)
+        PutByte(png, (unsigned char)type[i]);
+    for (i = 0; i < length; ++i)
+        PutByte(png, data[i]);
+    crc = ~Crc32(data, length, Crc32((const unsigned char *)type, 4, 0xffffffffu));
+    for (i = 24; i >= 0; i -= 8)
+        PutByte(png, (unsigned char)(crc >> i));
+}
+
+/* 8-bit grey, filter none on every row; the zlib stream is split into IDATs of idatSize bytes */
+static WriterS GreyPng(const unsigned char *pixels, int w, int h, int type, int idatSize)
+{
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    unsigned char header[13] = {0, 0, 0, 0, 0, 0, 0, 0, 8, 0, 0, 0, 0};
+    unsigned char *raw = (unsigned char *)malloc((size_t)(w + 1) * h);
+    WriterS png = {NULL, 0, 0, 0, 0}, z;
+    int y, pos, i;
+    for (y = 0; y < h; ++y)
+    {
+        raw[(size_t)y * (w + 1)] = 0;
+        memcpy(raw + (size_t)y * (w + 1) + 1, pixels + (size_t)y * w, (size_t)w);
+    }
+    z = Deflate(raw, (w + 1) * h, type, 1);
+    for (i = 0; i < 4; ++i)
+    {
+        header[i] = (unsigned char)(w >> (24 - 8 * i));
+        header[4 + i] = (unsigned char)(h >> (24 - 8 * i));
+    }
+    for (i = 0; i < 8; ++i)
+        PutByte(&png, signature[i]);
+    PutChunk(&png, "IHDR", header, 13);
+    for (pos = 0; pos < z.size; pos += idatSize)
+        PutChunk(&png, "IDAT", z.data + pos, z.size - pos < idatSize ? z.size - pos : idatSize);
+    PutChunk(&png, "IEND", NULL, 0);
+    free(raw);
+    free(z.data);
+    return png;
+}
+
+typedef struct
+{
+    const unsigned char *expected;
+    int w, nextRow, mismatches;
+} RowCheckS;
+
+static int CheckRows(void *user, stbi_uc *rows, int firstRow, int rowCount)
+{
+    RowCheckS *check = (RowCheckS *)user;
+    if (firstRow != check->nextRow || memcmp(rows, check->expected + (size_t)firstRow * check->w, (size_t)rowCount * check->w) != 0)
+        check->mismatches++;
+    check->nextRow = firstRow + rowCount;
+    return 1;
+}
+
+static void CheckPng(int w, int h, int type, int idatSize, int bandRows)
+{
+    unsigned char *pixels = (unsigned char *)malloc((size_t)w * h);
+    WriterS png;
+    RowCheckS check;
+    int x, y, channels, ok;
+    unsigned char *whole;
+    FillData(pixels, w * h);
+    png = GreyPng(pixels, w, h, type, idatSize);
+
+    check.expected = pixels;
+    check.w = w;
+    check.nextRow = 0;
+    check.mismatches = 0;
+    ok = stbi_load_rows_from_memory(png.data, png.size, &x, &y, &channels, 1, bandRows, CheckRows, &check);
+    ok = ok && x == w && y == h && check.nextRow == h && check.mismatches == 0;
+    whole = stbi_load_from_memory(png.data, png.size, &x, &y, &channels, 1);
+    ok = ok && whole && memcmp(whole, pixels, (size_t)w * h) == 0;
+    if (!ok)
+    {
+        fprintf(stderr, "png : %dx%d, block type %d, %d-byte IDATs, %d-row bands differs\n", w, h, type, idatSize, bandRows);
+        testFailures++;
+    }
+    stbi_image_free(whole);
+    free(png.data);
+    free(pixels);
+}
+
+int main(void)
+{
+    static const int large[] = {32768, 32768 + 274, 65535, 65536, 100000, 300000};
+    unsigned char *data = (unsigned char *)malloc(300000);
+    int type, length, i, idat;
+
+    for (type = -1; type < BLOCK_TYPES; ++type)
+    {
+        /* a 257- or 258-byte copy at distance 8 or more, ending 1 to 6 bytes before the output does : its
+           8-byte chunks overshoot the match, and only the output margin keeps them inside the buffer */
+        for (length = 257; length <= 258; ++length)
+        {
+            for (i = 1; i <= 6; ++i)
+            {
+                int k, prefix = 400;
+                FillData(data, prefix);
+                for (k = 0; k < length; ++k)
+                    data[prefix + k] = data[prefix + k - 8 - i];
+                FillData(data + prefix + length, i);
+                CheckZlib(data, prefix + length + i, type);
+            }
+        }
+
+        for (length = 0; length <= 700; ++length)
+        {
+            FillData(data, length);
+            CheckZlib(data, length, type);
+        }
+        for (i = 0; i < (int)(sizeof(large) / sizeof(large[0])); ++i)
+        {
+            FillData(data, large[i]);
+            CheckZlib(data, large[i], type);
+        }
+    }
+
+    /* small IDATs keep the fast loop off, larger ones start and stop it at every chunk edge */
+    for (type = -1; type < BLOCK_TYPES; ++type)
+    {
+        for (idat = 1; idat <= 40; ++idat)
+            CheckPng(37, 23, type, idat, 4);
+        CheckPng(37, 23, type, 1 << 20, 1);
+        /* more than the 96K window, so the stream drains and slides */
+        CheckPng(400, 300, type, 300, 7);
+        CheckPng(400, 300, type, 8192, 64);
+        CheckPng(400, 300, type, 1 << 20, 300);
+    }
+
+    free(data);
+    return TestResult();
+}
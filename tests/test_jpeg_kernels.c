@@ -0,0 +1,169 @@
+/*
+    test_jpeg_kernels :
+    the AVX2 IDCT, 2x2 upsampler and YCbCr-to-RGB kernels against the SSE2 and generic C ones. the IDCT gets
+    random blocks (dense, sparse, low-frequency and full-range coefficients), the row kernels every width from
+    1 to 300 with random samples; every kernel has to match byte for byte and write nothing past its output.
+    kernels the CPU can't run are skipped.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "test.h"
+
+#define GUARD 64
+#define MAX_WIDTH 300
+
+static unsigned int randomState = 1;
+
+static unsigned int Random(void)
+{
+    randomState = randomState * 1103515245u + 12345u;
+    return randomState >> 8;
+}
+
+typedef void (*IdctFn)(stbi_uc *out, int out_stride, short data[64]);
+typedef stbi_uc *(*UpsampleFn)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+typedef void (*ColorFn)(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step);
+
+/* random coefficients; kind 3 covers all of short, where the 16-bit SIMD intermediates overflow and only
+   SIMD kernels are compared with each other */
+static void RandomBlock(short block[64], int kind)
+{
+    int k;
+    for (k = 0; k < 64; ++k)
+    {
+        int v;
+        switch (kind)
+        {
+        case 0:
+            v = (int)(Random() % 1025) - 512;
+            break;
+        case 1:
+            v = k < 10 ? (int)(Random() % 4097) - 2048 : 0;
+            break;
+        case 2:
+            v = Random() % 8 == 0 ? (int)(Random() % 601) - 300 : 0;
+            break;
+        default:
+            v = (short)Random();
+            break;
+        }
+        block[k] = (short)v;
+    }
+}
+
+/* the IDCT works on its input in place, so each kernel gets a copy; 8x8 written at a stride of 13 */
+static void RunIdct(IdctFn idct, const short block[64], stbi_uc *out)
+{
+    STBI_SIMD_ALIGN(short, data[64]);
+    memcpy(data, block, sizeof(data));
+    memset(out, 0xcd, 13 * 8 + GUARD);
+    idct(out, 13, data);
+}
+
+static void CheckIdct(const char *name, IdctFn reference, IdctFn kernel, int kinds)
+{
+    STBI_SIMD_ALIGN(short, block[64]);
+    stbi_uc expected[13 * 8 + GUARD], actual[13 * 8 + GUARD];
+    int i, mismatches = 0;
+    for (i = 0; i < 200000; ++i)
+    {
+        RandomBlock(block, i % kinds);
+        RunIdct(reference, block, expected);
+        RunIdct(kernel, block, actual);
+        if (memcmp(expected, actual, sizeof(expected)) != 0)
+            mismatches++;
+    }
+    if (mismatches)
+    {
+        fprintf(stderr, "%s: %d of 200000 blocks differ\n", name, mismatches);
+        testFailures++;
+    }
+}
+
+static void CheckUpsample(const char *name, UpsampleFn reference, UpsampleFn kernel)
+{
+    stbi_uc nearRow[MAX_WIDTH + GUARD], farRow[MAX_WIDTH + GUARD];
+    stbi_uc expected[2 * MAX_WIDTH + GUARD], actual[2 * MAX_WIDTH + GUARD];
+    int w, trial, k;
+    for (w = 1; w <= MAX_WIDTH; ++w)
+    {
+        for (trial = 0; trial < 8; ++trial)
+        {
+            for (k = 0; k < MAX_WIDTH + GUARD; ++k)
+            {
+                nearRow[k] = (stbi_uc)Random();
+                farRow[k] = (stbi_uc)Random();
+            }
+            memset(expected, 0xcd, sizeof(expected));
+            memset(actual, 0xcd, sizeof(actual));
+            reference(expected, nearRow, farRow, w, 2);
+            kernel(actual, nearRow, farRow, w, 2);
+            if (memcmp(expected, actual, sizeof(actual)) != 0)
+            {
+                fprintf(stderr, "%s: width %d differs\n", name, w);
+                testFailures++;
+                return;
+            }
+        }
+    }
+}
+
+static void CheckColor(const char *name, ColorFn reference, ColorFn kernel, int step)
+{
+    stbi_uc y[MAX_WIDTH], cb[MAX_WIDTH], cr[MAX_WIDTH];
+    stbi_uc expected[4 * MAX_WIDTH + GUARD], actual[4 * MAX_WIDTH + GUARD];
+    int w, trial, k;
+    for (w = 1; w <= MAX_WIDTH; ++w)
+    {
+        for (trial = 0; trial < 8; ++trial)
+        {
+            for (k = 0; k < w; ++k)
+            {
+                y[k] = (stbi_uc)Random();
+                cb[k] = (stbi_uc)Random();
+                cr[k] = (stbi_uc)Random();
+            }
+            memset(expected, 0xcd, sizeof(expected));
+            memset(actual, 0xcd, sizeof(actual));
+            reference(expected, y, cb, cr, w, step);
+            kernel(actual, y, cb, cr, w, step);
+            if (memcmp(expected, actual, sizeof(actual)) != 0)
+            {
+                fprintf(stderr, "%s: width %d, step %d differs\n", name, w, step);
+                testFailures++;
+                return;
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    int ran = 0;
+#ifdef STBI_SSE2
+    if (stbi__sse2_available())
+    {
+        CheckIdct("idct sse2 vs C", stbi__idct_block, stbi__idct_simd, 3);
+        CheckUpsample("hv_2 sse2 vs C", stbi__resample_row_hv_2, stbi__resample_row_hv_2_simd);
+        CheckColor("ycbcr sse2 vs C", stbi__YCbCr_to_RGB_row, stbi__YCbCr_to_RGB_simd, 3);
+        CheckColor("ycbcr sse2 vs C", stbi__YCbCr_to_RGB_row, stbi__YCbCr_to_RGB_simd, 4);
+        ran++;
+    }
+#endif
+#ifdef STBI__AVX2
+    if (stbi__avx2_available())
+    {
+        CheckIdct("idct avx2 vs C", stbi__idct_block, stbi__idct_avx2, 3);
+        CheckIdct("idct avx2 vs sse2", stbi__idct_simd, stbi__idct_avx2, 4);
+        CheckUpsample("hv_2 avx2 vs C", stbi__resample_row_hv_2, stbi__resample_row_hv_2_avx2);
+        CheckUpsample("hv_2 avx2 vs sse2", stbi__resample_row_hv_2_simd, stbi__resample_row_hv_2_avx2);
+        CheckColor("ycbcr avx2 vs C", stbi__YCbCr_to_RGB_row, stbi__YCbCr_to_RGB_avx2, 3);
+        CheckColor("ycbcr avx2 vs C", stbi__YCbCr_to_RGB_row, stbi__YCbCr_to_RGB_avx2, 4);
+        CheckColor("ycbcr avx2 vs sse2", stbi__YCbCr_to_RGB_simd, stbi__YCbCr_to_RGB_avx2, 4);
+        ran++;
+    }
+#endif
+    if (!ran)
+        printf("no SIMD kernels on this CPU, nothing to compare\n");
+    return TestResult();
+}
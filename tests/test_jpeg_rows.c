@@ -0,0 +1,122 @@
+/*
+    test_jpeg_rows :
+    stbi_load_rows_from_memory against stbi_load for a single-component baseline JPEG, with the component's
+    sampling factors patched to 1x1 and 2x2. A lone component is always coded block by block, so both files hold
+    the same pixels; with 2x2 an mcu row is two block rows tall.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "test.h"
+
+/* 19x70 grey, quality 75 */
+static const unsigned char greyJpeg[] = {
+    0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46, 0x49, 0x46, 0x00, 0x01, 0x01, 0x00, 0x00, 0x01,
+    0x00, 0x01, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43, 0x00, 0x08, 0x06, 0x06, 0x07, 0x06, 0x05, 0x08,
+    0x07, 0x07, 0x07, 0x09, 0x09, 0x08, 0x0a, 0x0c, 0x14, 0x0d, 0x0c, 0x0b, 0x0b, 0x0c, 0x19, 0x12,
+    0x13, 0x0f, 0x14, 0x1d, 0x1a, 0x1f, 0x1e, 0x1d, 0x1a, 0x1c, 0x1c, 0x20, 0x24, 0x2e, 0x27, 0x20,
+    0x22, 0x2c, 0x23, 0x1c, 0x1c, 0x28, 0x37, 0x29, 0x2c, 0x30, 0x31, 0x34, 0x34, 0x34, 0x1f, 0x27,
+    0x39, 0x3d, 0x38, 0x32, 0x3c, 0x2e, 0x33, 0x34, 0x32, 0xff, 0xc0, 0x00, 0x0b, 0x08, 0x00, 0x46,
+    0x00, 0x13, 0x01, 0x01, 0x11, 0x00, 0xff, 0xc4, 0x00, 0x1f, 0x00, 0x00, 0x01, 0x05, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04,
+    0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0xff, 0xc4, 0x00, 0xb5, 0x10, 0x00, 0x02, 0x01, 0x03,
+    0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7d, 0x01, 0x02, 0x03, 0x00,
+    0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32,
+    0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+    0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35,
+    0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+    0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94,
+    0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2,
+    0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9,
+    0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6,
+    0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xff, 0xda,
+    0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3f, 0x00, 0xf1, 0xcb, 0x58, 0x76, 0x15, 0x1c, 0x7b, 0x81,
+    0xda, 0xba, 0x0b, 0x78, 0xb6, 0x67, 0x8e, 0x71, 0xf9, 0x56, 0xd2, 0xda, 0x2e, 0xd1, 0x9d, 0xdf,
+    0x85, 0x73, 0x96, 0xb1, 0x79, 0x6a, 0x01, 0xef, 0x5a, 0x16, 0xd0, 0x15, 0x3d, 0x79, 0xfa, 0x74,
+    0xae, 0xa8, 0x5b, 0xb6, 0x07, 0xca, 0xc7, 0xf3, 0xae, 0x76, 0xd6, 0x02, 0x87, 0x81, 0x5d, 0x0d,
+    0xbc, 0x45, 0x48, 0xcf, 0x20, 0x8e, 0xc3, 0x81, 0x50, 0x0b, 0x36, 0x61, 0x91, 0xc6, 0x69, 0x2d,
+    0xe0, 0x08, 0x46, 0xe0, 0x0d, 0x5f, 0xb5, 0x8b, 0x60, 0x07, 0x19, 0x27, 0x8a, 0xb8, 0x96, 0x8c,
+    0x50, 0x61, 0xd8, 0x0a, 0xe7, 0x2d, 0x62, 0x0b, 0x8c, 0x67, 0x83, 0xe9, 0x5d, 0x05, 0xac, 0x1b,
+    0x71, 0xc0, 0x6a, 0xda, 0x16, 0xf8, 0x00, 0x6f, 0x0b, 0xed, 0x5c, 0xed, 0xb4, 0x1b, 0x71, 0xd4,
+    0x9f, 0x7a, 0xbd, 0x69, 0x16, 0xd0, 0x7d, 0xfb, 0x7a, 0x57, 0x56, 0xb0, 0xa8, 0x5c, 0x73, 0xf8,
+    0x2d, 0x73, 0xd6, 0xf0, 0x84, 0x00, 0x81, 0xc7, 0x6a, 0xe8, 0x2d, 0xa2, 0x28, 0xbd, 0x3a, 0xfa,
+    0x76, 0xa8, 0x12, 0xd5, 0x8a, 0x0c, 0x00, 0x47, 0xe3, 0x49, 0x6f, 0x10, 0x42, 0x32, 0x0e, 0x3e,
+    0x9d, 0x2a, 0xfd, 0xac, 0x3b, 0x4f, 0x4c, 0xfa, 0xd5, 0xa5, 0xb4, 0x1b, 0x47, 0xdd, 0x1c, 0x77,
+    0xae, 0x7a, 0xd6, 0x05, 0xd8, 0x31, 0xde, 0xb7, 0xad, 0xa3, 0xc1, 0xf9, 0x4f, 0x51, 0x5b, 0x89,
+    0x67, 0xb9, 0x01, 0x0c, 0x06, 0x7d, 0xab, 0xff, 0xd9,
+};
+
+typedef struct
+{
+    unsigned char *pixels;
+    int rowBytes;
+    int nextRow;
+    int rows;
+} RowCollectorS;
+
+static int CollectRows(void *user, stbi_uc *rows, int firstRow, int rowCount)
+{
+    RowCollectorS *collector = (RowCollectorS *)user;
+    CHECK(firstRow == collector->nextRow);
+    CHECK(firstRow + rowCount <= collector->rows);
+    if (firstRow != collector->nextRow || firstRow + rowCount > collector->rows)
+        return 0;
+    memcpy(collector->pixels + (size_t)firstRow * collector->rowBytes, rows, (size_t)rowCount * collector->rowBytes);
+    collector->nextRow += rowCount;
+    return 1;
+}
+
+static void CheckStreamedMatchesWhole(const unsigned char *jpeg, int length, int bandRows)
+{
+    int w, h, channels, sw, sh, schannels;
+    RowCollectorS collector;
+    unsigned char *whole = stbi_load_from_memory(jpeg, length, &w, &h, &channels, 1);
+    CHECK(whole != NULL);
+    if (!whole)
+        return;
+
+    collector.rowBytes = w;
+    collector.rows = h;
+    collector.nextRow = 0;
+    collector.pixels = (unsigned char *)calloc((size_t)w * h, 1);
+    CHECK(stbi_load_rows_from_memory(jpeg, length, &sw, &sh, &schannels, 1, bandRows, CollectRows, &collector));
+    CHECK(sw == w && sh == h && schannels == channels);
+    CHECK(collector.nextRow == h);
+    if (memcmp(collector.pixels, whole, (size_t)w * h) != 0)
+    {
+        fprintf(stderr, "streamed rows differ from stbi_load (band of %d rows)\n", bandRows);
+        testFailures++;
+    }
+    free(collector.pixels);
+    stbi_image_free(whole);
+}
+
+int main(void)
+{
+    static const int bands[] = {1, 3, 8, 16, 70};
+    static const unsigned char samplings[] = {0x11, 0x22};
+    unsigned char jpeg[sizeof(greyJpeg)];
+    int sof = -1, i, s, b;
+
+    for (i = 0; i + 1 < (int)sizeof(greyJpeg); ++i)
+    {
+        if (greyJpeg[i] == 0xff && greyJpeg[i + 1] == 0xc0)
+        {
+            sof = i;
+            break;
+        }
+    }
+    CHECK(sof >= 0);
+    if (sof < 0)
+        return TestResult();
+
+    for (s = 0; s < 2; ++s)
+    {
+        memcpy(jpeg, greyJpeg, sizeof(jpeg));
+        /* marker, length, precision, height, width, component count, component id, then sampling */
+        jpeg[sof + 11] = samplings[s];
+        for (b = 0; b < (int)(sizeof(bands) / sizeof(bands[0])); ++b)
+            CheckStreamedMatchesWhole(jpeg, (int)sizeof(jpeg), bands[b]);
+    }
+    return TestResult();
+}
@@ -0,0 +1,362 @@
+/*
+    test_jpeg_scale :
+    scaled JPEG decoding of baseline YCbCr files with 4:4:4 and 4:2:0 sampling, written here by a small encoder,
+    at denominators 1, 2, 4 and 8. stbi_info and the decode have to report ceil(w/denom) x ceil(h/denom); denom 1
+    has to give exactly the unscaled decode; the smaller decodes have to stay close to a box-filtered full-size
+    decode (the reduced IDCTs average the block's low frequencies, so they differ a little from an average of the
+    full IDCT's pixels).
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "test.h"
+
+#include <math.h>
+
+#define PI 3.14159265358979323846
+
+/* the mean absolute difference allowed against the box filter at 1/2, 1/4 and 1/8 (the smaller IDCTs drop
+   more of what the box filter keeps), and the worst single one */
+static const double meanTolerance[4] = {0.0, 1.0, 1.2, 1.6};
+#define MAX_TOLERANCE 16
+
+static const unsigned char zigzag[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48,
+    41, 34, 27, 20, 13, 6, 7, 14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23,
+    30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+typedef struct
+{
+    unsigned char *data;
+    int size, capacity;
+    unsigned int bits;
+    int bitCount;
+} WriterS;
+
+static void PutByte(WriterS *w, unsigned char b)
+{
+    if (w->size == w->capacity)
+    {
+        w->capacity = w->capacity ? w->capacity * 2 : 4096;
+        w->data = (unsigned char *)realloc(w->data, w->capacity);
+    }
+    w->data[w->size++] = b;
+}
+
+static void PutU16BE(WriterS *w, int v)
+{
+    PutByte(w, (unsigned char)(v >> 8));
+    PutByte(w, (unsigned char)v);
+}
+
+/* entropy-coded bits, msb first, with a zero byte stuffed after every 0xff */
+static void PutBits(WriterS *w, unsigned int value, int count)
+{
+    w->bits = (w->bits << count) | (value & ((1u << count) - 1));
+    w->bitCount += count;
+    while (w->bitCount >= 8)
+    {
+        unsigned char b = (unsigned char)(w->bits >> (w->bitCount - 8));
+        PutByte(w, b);
+        if (b == 0xff)
+            PutByte(w, 0);
+        w->bitCount -= 8;
+    }
+}
+
+/* every code 4 bits long for the 12 DC categories and 8 bits long for the 162 AC symbols, so the code of a
+   symbol is its index in the table */
+static unsigned char acSymbols[162];
+
+static void BuildAcSymbols(void)
+{
+    int run, size, n = 0;
+    acSymbols[n++] = 0x00; /* end of block */
+    acSymbols[n++] = 0xf0; /* 16 zeros */
+    for (run = 0; run < 16; ++run)
+        for (size = 1; size <= 10; ++size)
+            acSymbols[n++] = (unsigned char)(run << 4 | size);
+}
+
+static int AcCode(int symbol)
+{
+    int i;
+    for (i = 0; i < 162; ++i)
+        if (acSymbols[i] == symbol)
+            return i;
+    return -1;
+}
+
+static int Category(int v)
+{
+    int n = 0;
+    v = v < 0 ? -v : v;
+    while (v)
+    {
+        n++;
+        v >>= 1;
+    }
+    return n;
+}
+
+static void PutValue(WriterS *w, int v, int category)
+{
+    if (category)
+        PutBits(w, (unsigned int)(v < 0 ? v - 1 : v), category);
+}
+
+static int Quant(int k)
+{
+    return 1 + (k >> 3) + (k & 7);
+}
+
+/* forward DCT, quantization and huffman coding of one 8x8 block of level-shifted samples */
+static void PutBlock(WriterS *w, const float block[64], int *dcPred)
+{
+    int coefficients[64], u, v, x, y, i, run = 0;
+    for (v = 0; v < 8; ++v)
+    {
+        for (u = 0; u < 8; ++u)
+        {
+            double sum = 0.0;
+            for (y = 0; y < 8; ++y)
+                for (x = 0; x < 8; ++x)
+                    sum += block[y * 8 + x] * cos((2 * x + 1) * u * PI / 16) * cos((2 * y + 1) * v * PI / 16);
+            sum *= 0.25 * (u ? 1.0 : sqrt(0.5)) * (v ? 1.0 : sqrt(0.5));
+            coefficients[v * 8 + u] = (int)floor(sum / Quant(v * 8 + u) + 0.5);
+        }
+    }
+    i = coefficients[0] - *dcPred;
+    *dcPred = coefficients[0];
+    PutBits(w, (unsigned int)Category(i), 4);
+    PutValue(w, i, Category(i));
+    for (i = 1; i < 64; ++i)
+    {
+        int c = coefficients[zigzag[i]];
+        if (c == 0)
+        {
+            run++;
+            continue;
+        }
+        for (; run >= 16; run -= 16)
+            PutBits(w, (unsigned int)AcCode(0xf0), 8);
+        PutBits(w, (unsigned int)AcCode(run << 4 | Category(c)), 8);
+        PutValue(w, c, Category(c));
+        run = 0;
+    }
+    if (run)
+        PutBits(w, (unsigned int)AcCode(0x00), 8);
+}
+
+/* channel c of the rgb image as Y, Cb or Cr, edges repeated past the image */
+static float Sample(const unsigned char *rgb, int w, int h, int x, int y, int c)
+{
+    const unsigned char *p = rgb + ((size_t)(y < h ? y : h - 1) * w + (x < w ? x : w - 1)) * 3;
+    if (c == 0)
+        return 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2];
+    if (c == 1)
+        return -0.168736f * p[0] - 0.331264f * p[1] + 0.5f * p[2] + 128.0f;
+    return 0.5f * p[0] - 0.418688f * p[1] - 0.081312f * p[2] + 128.0f;
+}
+
+/* baseline, one quantization table and one pair of huffman tables for all three components; sub is 1 for
+   4:4:4 and 2 for 4:2:0 (chroma averaged over 2x2 pixels) */
+static WriterS EncodeJpeg(const unsigned char *rgb, int w, int h, int sub)
+{
+    WriterS out = {NULL, 0, 0, 0, 0};
+    int i, c, mx, my, bx, by, x, y, dx, dy, pred[3] = {0, 0, 0}, mcu = 8 * sub;
+    float block[64];
+
+    PutU16BE(&out, 0xffd8);
+    PutU16BE(&out, 0xffdb);
+    PutU16BE(&out, 67);
+    PutByte(&out, 0);
+    for (i = 0; i < 64; ++i)
+        PutByte(&out, (unsigned char)Quant(zigzag[i]));
+    PutU16BE(&out, 0xffc0);
+    PutU16BE(&out, 17);
+    PutByte(&out, 8);
+    PutU16BE(&out, h);
+    PutU16BE(&out, w);
+    PutByte(&out, 3);
+    for (c = 0; c < 3; ++c)
+    {
+        PutByte(&out, (unsigned char)(c + 1));
+        PutByte(&out, (unsigned char)(c ? 0x11 : sub * 0x11));
+        PutByte(&out, 0);
+    }
+    PutU16BE(&out, 0xffc4);
+    PutU16BE(&out, 2 + 17 + 12 + 17 + 162);
+    PutByte(&out, 0x00);
+    for (i = 1; i <= 16; ++i)
+        PutByte(&out, (unsigned char)(i == 4 ? 12 : 0));
+    for (i = 0; i < 12; ++i)
+        PutByte(&out, (unsigned char)i);
+    PutByte(&out, 0x10);
+    for (i = 1; i <= 16; ++i)
+        PutByte(&out, (unsigned char)(i == 8 ? 162 : 0));
+    for (i = 0; i < 162; ++i)
+        PutByte(&out, acSymbols[i]);
+    PutU16BE(&out, 0xffda);
+    PutU16BE(&out, 12);
+    PutByte(&out, 3);
+    for (c = 0; c < 3; ++c)
+    {
+        PutByte(&out, (unsigned char)(c + 1));
+        PutByte(&out, 0x00);
+    }
+    PutByte(&out, 0);
+    PutByte(&out, 63);
+    PutByte(&out, 0);
+
+    for (my = 0; my < h; my += mcu)
+    {
+        for (mx = 0; mx < w; mx += mcu)
+        {
+            for (by = 0; by < sub; ++by)
+            {
+                for (bx = 0; bx < sub; ++bx)
+                {
+                    for (y = 0; y < 8; ++y)
+                        for (x = 0; x < 8; ++x)
+                            block[y * 8 + x] = Sample(rgb, w, h, mx + bx * 8 + x, my + by * 8 + y, 0) - 128.0f;
+                    PutBlock(&out, block, &pred[0]);
+                }
+            }
+            for (c = 1; c < 3; ++c)
+            {
+                for (y = 0; y < 8; ++y)
+                {
+                    for (x = 0; x < 8; ++x)
+                    {
+                        float sum = 0.0f;
+                        for (dy = 0; dy < sub; ++dy)
+                            for (dx = 0; dx < sub; ++dx)
+                                sum += Sample(rgb, w, h, mx + (x * sub) + dx, my + (y * sub) + dy, c);
+                        block[y * 8 + x] = sum / (sub * sub) - 128.0f;
+                    }
+                }
+                PutBlock(&out, block, &pred[c]);
+            }
+        }
+    }
+    PutBits(&out, 0x7f, 7); /* pad the last byte with ones */
+    PutU16BE(&out, 0xffd9);
+    return out;
+}
+
+/* smooth colour gradients with a little detail, so 2x2 to 8x8 averages mean something */
+static unsigned char *TestImage(int w, int h)
+{
+    unsigned char *rgb = (unsigned char *)malloc((size_t)w * h * 3);
+    int x, y;
+    for (y = 0; y < h; ++y)
+    {
+        for (x = 0; x < w; ++x)
+        {
+            unsigned char *p = rgb + ((size_t)y * w + x) * 3;
+            double detail = 30 * sin(x * 0.5 - y * 0.3) + 20 * cos(x * 0.35 + y * 0.45);
+            p[0] = (unsigned char)(128 + 70 * sin(x * 0.13 + y * 0.05) + detail);
+            p[1] = (unsigned char)(128 + 70 * cos(y * 0.11 - x * 0.03) + detail);
+            p[2] = (unsigned char)(64 + (x * 255 / w + y * 255 / h) / 4 + detail);
+        }
+    }
+    return rgb;
+}
+
+static void CheckScaled(int w, int h, int sub)
+{
+    unsigned char *rgb = TestImage(w, h), *full, *one;
+    WriterS jpeg = EncodeJpeg(rgb, w, h, sub);
+    int fw, fh, comp, shift;
+    double total = 0.0;
+    size_t i;
+
+    /* no scale set yet, or set back to 1 by the previous image */
+    full = stbi_load_from_memory(jpeg.data, jpeg.size, &fw, &fh, &comp, 3);
+    CHECK(full && fw == w && fh == h && comp == 3);
+    if (!full)
+    {
+        fprintf(stderr, "%dx%d %s: %s\n", w, h, sub == 2 ? "4:2:0" : "4:4:4", stbi_failure_reason());
+        free(jpeg.data);
+        free(rgb);
+        return;
+    }
+    /* the encoder works: the full decode is the test image, give or take the quantization */
+    for (i = 0; i < (size_t)w * h * 3; ++i)
+        total += abs(full[i] - rgb[i]);
+    if (total / ((double)w * h * 3) > 4.0)
+    {
+        fprintf(stderr, "%dx%d %s: full decode is off from the encoded image by %.2f on average\n", w, h,
+                sub == 2 ? "4:2:0" : "4:4:4", total / ((double)w * h * 3));
+        testFailures++;
+    }
+
+    for (shift = 0; shift <= 3; ++shift)
+    {
+        int denom = 1 << shift;
+        int sw = (w + denom - 1) / denom, sh = (h + denom - 1) / denom, iw, ih, x, y, k, worst = 0;
+        unsigned char *scaled;
+        total = 0.0;
+        stbi_set_jpeg_scale_denom(denom);
+        CHECK(stbi_info_from_memory(jpeg.data, jpeg.size, &iw, &ih, &comp) && iw == sw && ih == sh);
+        scaled = stbi_load_from_memory(jpeg.data, jpeg.size, &iw, &ih, &comp, 3);
+        CHECK(scaled && iw == sw && ih == sh);
+        if (!scaled || iw != sw || ih != sh)
+        {
+            stbi_image_free(scaled);
+            continue;
+        }
+        if (denom == 1)
+            CHECK(memcmp(scaled, full, (size_t)w * h * 3) == 0);
+
+        /* each scaled pixel against the mean of the full-size pixels it covers inside the image */
+        for (y = 0; y < sh; ++y)
+        {
+            for (x = 0; x < sw; ++x)
+            {
+                for (k = 0; k < 3; ++k)
+                {
+                    int sum = 0, count = 0, fx, fy, d;
+                    for (fy = y * denom; fy < (y + 1) * denom && fy < h; ++fy)
+                    {
+                        for (fx = x * denom; fx < (x + 1) * denom && fx < w; ++fx)
+                        {
+                            sum += full[((size_t)fy * w + fx) * 3 + k];
+                            count++;
+                        }
+                    }
+                    d = abs(scaled[((size_t)y * sw + x) * 3 + k] - (sum + count / 2) / count);
+                    total += d;
+                    worst = d > worst ? d : worst;
+                }
+            }
+        }
+        if (total / ((double)sw * sh * 3) > meanTolerance[shift] || worst > MAX_TOLERANCE)
+        {
+            fprintf(stderr, "%dx%d %s at 1/%d: mean difference %.2f, worst %d from the box-filtered full decode\n", w,
+                    h, sub == 2 ? "4:2:0" : "4:4:4", denom, total / ((double)sw * sh * 3), worst);
+            testFailures++;
+        }
+        stbi_image_free(scaled);
+    }
+
+    /* back to unscaled: the same pixels as before any scale was set */
+    stbi_set_jpeg_scale_denom(1);
+    one = stbi_load_from_memory(jpeg.data, jpeg.size, &fw, &fh, &comp, 3);
+    CHECK(one && fw == w && fh == h && memcmp(one, full, (size_t)w * h * 3) == 0);
+    stbi_image_free(one);
+    stbi_image_free(full);
+    free(jpeg.data);
+    free(rgb);
+}
+
+int main(void)
+{
+    BuildAcSymbols();
+    CheckScaled(75, 50, 1);
+    CheckScaled(75, 50, 2);
+    CheckScaled(33, 17, 1);
+    CheckScaled(33, 17, 2);
+    CheckScaled(64, 48, 2);
+    return TestResult();
+}
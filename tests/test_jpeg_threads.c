@@ -0,0 +1,176 @@
+/*
+    test_jpeg_threads :
+    the multi-threaded JPEG decoder from several threads at once, each with its own thread count set through
+    stbi_set_jpeg_thread_count_thread, against a single-threaded decode. the restart intervals are split across
+    the shared pool, so the decodes compete for it.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_JPEG_THREADS
+#include "../stb_img.h"
+#include "test.h"
+
+#define DECODE_THREADS 4
+#define DECODES 50
+
+/* 64x48 RGB, 4:2:0, a restart marker after every MCU */
+static const unsigned char restartJpeg[] = {
+    0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46, 0x49, 0x46, 0x00, 0x01,
+    0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43,
+    0x00, 0x10, 0x0b, 0x0c, 0x0e, 0x0c, 0x0a, 0x10, 0x0e, 0x0d, 0x0e, 0x12,
+    0x11, 0x10, 0x13, 0x18, 0x28, 0x1a, 0x18, 0x16, 0x16, 0x18, 0x31, 0x23,
+    0x25, 0x1d, 0x28, 0x3a, 0x33, 0x3d, 0x3c, 0x39, 0x33, 0x38, 0x37, 0x40,
+    0x48, 0x5c, 0x4e, 0x40, 0x44, 0x57, 0x45, 0x37, 0x38, 0x50, 0x6d, 0x51,
+    0x57, 0x5f, 0x62, 0x67, 0x68, 0x67, 0x3e, 0x4d, 0x71, 0x79, 0x70, 0x64,
+    0x78, 0x5c, 0x65, 0x67, 0x63, 0xff, 0xdb, 0x00, 0x43, 0x01, 0x11, 0x12,
+    0x12, 0x18, 0x15, 0x18, 0x2f, 0x1a, 0x1a, 0x2f, 0x63, 0x42, 0x38, 0x42,
+    0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+    0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+    0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+    0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+    0x63, 0x63, 0xff, 0xc0, 0x00, 0x11, 0x08, 0x00, 0x30, 0x00, 0x40, 0x03,
+    0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01, 0xff, 0xc4, 0x00,
+    0x1f, 0x00, 0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+    0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0xff, 0xc4, 0x00, 0xb5, 0x10, 0x00,
+    0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00,
+    0x00, 0x01, 0x7d, 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21,
+    0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81,
+    0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24,
+    0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25,
+    0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a,
+    0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56,
+    0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+    0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86,
+    0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99,
+    0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3,
+    0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6,
+    0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9,
+    0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1,
+    0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xff, 0xc4, 0x00,
+    0x1f, 0x01, 0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+    0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0xff, 0xc4, 0x00, 0xb5, 0x11, 0x00,
+    0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00,
+    0x01, 0x02, 0x77, 0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31,
+    0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08,
+    0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15,
+    0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18,
+    0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39,
+    0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84,
+    0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+    0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa,
+    0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4,
+    0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7,
+    0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+    0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xff, 0xdd, 0x00,
+    0x04, 0x00, 0x01, 0xff, 0xda, 0x00, 0x0c, 0x03, 0x01, 0x00, 0x02, 0x11,
+    0x03, 0x11, 0x00, 0x3f, 0x00, 0xe4, 0x6d, 0xd7, 0x1c, 0xe2, 0xb6, 0x6d,
+    0x97, 0x15, 0x9f, 0x6c, 0xb8, 0xc5, 0x69, 0x5b, 0x2e, 0x31, 0x5d, 0x14,
+    0xd1, 0x94, 0xd1, 0xff, 0xd0, 0x96, 0xd9, 0x71, 0x8a, 0xb9, 0x02, 0xfc,
+    0xd9, 0xe4, 0x8f, 0x5a, 0x85, 0x53, 0x11, 0x54, 0xf6, 0xcb, 0x8c, 0x60,
+    0x7f, 0xf5, 0xab, 0x9b, 0x34, 0xa9, 0x79, 0x46, 0x9f, 0xcc, 0xe2, 0xe5,
+    0xea, 0x7f, 0xff, 0xd1, 0xda, 0xb6, 0x5c, 0x62, 0xb8, 0xf8, 0x72, 0xce,
+    0x58, 0x81, 0x96, 0x39, 0x38, 0x00, 0x01, 0xf8, 0x0a, 0xe9, 0xf5, 0x78,
+    0x64, 0x7d, 0x2d, 0x95, 0x03, 0x14, 0x19, 0x69, 0x36, 0xe3, 0x38, 0x0a,
+    0x48, 0xeb, 0xdb, 0x70, 0x5e, 0x9c, 0xd7, 0x31, 0x6e, 0xb8, 0x34, 0x65,
+    0x70, 0xb4, 0x5c, 0x8d, 0xf2, 0xea, 0x69, 0x46, 0x52, 0xbe, 0xe7, 0xff,
+    0xd2, 0x68, 0x18, 0x8b, 0x15, 0xa1, 0x6c, 0xb8, 0xc5, 0x54, 0x00, 0x07,
+    0x1d, 0x38, 0xef, 0x57, 0x6d, 0x97, 0x18, 0x15, 0xc7, 0x8e, 0xa9, 0xed,
+    0x31, 0x0f, 0xcb, 0x43, 0xd7, 0x71, 0xb2, 0x3f, 0xff, 0xd3, 0xc4, 0xb6,
+    0x5c, 0x62, 0xb6, 0xad, 0x93, 0x6e, 0x2b, 0x3a, 0xd9, 0x71, 0x8a, 0xd2,
+    0xb6, 0x4c, 0x57, 0x5d, 0x34, 0x4d, 0x44, 0x7f, 0xff, 0xd4, 0x9a, 0x25,
+    0xdb, 0x19, 0x23, 0xd2, 0xae, 0xdb, 0x26, 0xda, 0x83, 0x1b, 0x55, 0x47,
+    0xad, 0x59, 0xb6, 0x4c, 0x62, 0xb8, 0xb3, 0x2a, 0x9c, 0xd5, 0x94, 0x7b,
+    0x23, 0x9f, 0x97, 0x43, 0xff, 0xd5, 0x3c, 0x47, 0x29, 0xfe, 0xd0, 0x8e,
+    0x25, 0x70, 0x55, 0x63, 0x05, 0x80, 0xf5, 0xc9, 0xeb, 0xf8, 0x1e, 0xfe,
+    0xbe, 0xf5, 0x1d, 0xaa, 0xed, 0xc5, 0x41, 0x73, 0x38, 0xbb, 0xbf, 0x92,
+    0x71, 0xbb, 0x0d, 0x81, 0xf3, 0x63, 0x3c, 0x00, 0x32, 0x71, 0xc7, 0x38,
+    0xab, 0x16, 0xe3, 0x68, 0xcd, 0x77, 0xe1, 0x61, 0xec, 0xe9, 0xa4, 0xcf,
+    0x6a, 0x95, 0x2f, 0x67, 0x4a, 0x31, 0x3f, 0xff, 0xd6, 0x68, 0xe0, 0xaa,
+    0xf6, 0xeb, 0x5a, 0x56, 0xe3, 0x68, 0xc8, 0x04, 0x91, 0xd8, 0x55, 0x28,
+    0x86, 0x1c, 0xf1, 0xde, 0xad, 0xab, 0x34, 0x69, 0xf2, 0x60, 0xb7, 0xfb,
+    0x43, 0x81, 0xef, 0x9f, 0xf3, 0xfa, 0xd7, 0x05, 0x6a, 0x8e, 0xb5, 0x79,
+    0x48, 0xf6, 0x6a, 0x5a, 0x11, 0xbb, 0x3f, 0xff, 0xd7, 0xc7, 0xb6, 0x5c,
+    0x11, 0x5b, 0x56, 0xcb, 0x8c, 0x71, 0x59, 0xf6, 0xc8, 0x56, 0xb4, 0x6d,
+    0x97, 0x15, 0xdb, 0x4d, 0x15, 0x51, 0x1f, 0xff, 0xd0, 0xd1, 0x5c, 0x33,
+    0xf1, 0xd0, 0x71, 0xd2, 0xaf, 0x4e, 0xb8, 0xb1, 0x98, 0xf9, 0x49, 0x36,
+    0x17, 0x21, 0x1f, 0x1b, 0x73, 0xef, 0x92, 0x06, 0x3b, 0xd5, 0x7b, 0x65,
+    0xc7, 0x35, 0x6d, 0xe0, 0x69, 0xac, 0xe6, 0x89, 0x30, 0x1a, 0x48, 0xd9,
+    0x41, 0x3d, 0x32, 0x46, 0x2b, 0xc6, 0x55, 0x1d, 0x5a, 0xbe, 0xd2, 0x5d,
+    0x58, 0x24, 0xa3, 0x24, 0x7f, 0xff, 0xd1, 0x9b, 0xc4, 0x93, 0x86, 0xb9,
+    0x86, 0xd8, 0x6d, 0x3e, 0x58, 0xdc, 0xc7, 0x82, 0x41, 0x3d, 0xbd, 0xb8,
+    0x19, 0xfc, 0x45, 0x56, 0x85, 0x76, 0xa1, 0xe3, 0x3c, 0x53, 0x2e, 0xae,
+    0x8d, 0xed, 0xf4, 0x93, 0xe5, 0xf6, 0x13, 0x84, 0x0e, 0x46, 0x54, 0x7a,
+    0x71, 0xfe, 0x7e, 0xbd, 0x6a, 0x44, 0x5d, 0xb1, 0x1f, 0x7a, 0xec, 0xa7,
+    0x1f, 0x65, 0x86, 0x69, 0xf4, 0x4c, 0xf7, 0x68, 0x52, 0xf6, 0x74, 0xe3,
+    0x03, 0xff, 0xd2, 0x8a, 0xe6, 0x52, 0xb1, 0x0d, 0xa0, 0x0d, 0xaf, 0x8c,
+    0x30, 0xe7, 0xbf, 0x3f, 0x4c, 0x7d, 0x73, 0x4f, 0xb6, 0x5c, 0x62, 0xb3,
+    0xe0, 0x53, 0x9c, 0xe0, 0x64, 0x9f, 0x4c, 0x56, 0x95, 0xb2, 0xe2, 0xb2,
+    0xa1, 0x0e, 0x45, 0x63, 0xcc, 0xc6, 0xd7, 0x78, 0x89, 0xf3, 0x33, 0xff,
+    0xd9
+};
+
+static unsigned char *reference;
+static int referenceSize;
+
+typedef struct
+{
+    int threadCount;
+    int mismatches;
+} DecoderArgS;
+
+static void *DecodeLoop(void *param)
+{
+    DecoderArgS *decoder = (DecoderArgS *)param;
+    int i, w, h, c;
+    stbi_set_jpeg_thread_count_thread(decoder->threadCount);
+    for (i = 0; i < DECODES; ++i)
+    {
+        unsigned char *pixels = stbi_load_from_memory(restartJpeg, (int)sizeof(restartJpeg), &w, &h, &c, 3);
+        if (!pixels || w * h * 3 != referenceSize || memcmp(pixels, reference, (size_t)referenceSize) != 0)
+            decoder->mismatches++;
+        stbi_image_free(pixels);
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t threads[DECODE_THREADS];
+    DecoderArgS decoders[DECODE_THREADS];
+    int i, w, h, c;
+
+    reference = stbi_load_from_memory(restartJpeg, (int)sizeof(restartJpeg), &w, &h, &c, 3);
+    CHECK(reference != NULL);
+    if (!reference)
+        return TestResult();
+    referenceSize = w * h * 3;
+    CHECK(stbi__pool.threads == 0);
+
+    for (i = 0; i < DECODE_THREADS; ++i)
+    {
+        decoders[i].threadCount = 2 + 2 * i;
+        decoders[i].mismatches = 0;
+        CHECK(pthread_create(&threads[i], NULL, DecodeLoop, &decoders[i]) == 0);
+    }
+    for (i = 0; i < DECODE_THREADS; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        CHECK(decoders[i].mismatches == 0);
+    }
+
+    /* the pool grew to the largest count asked for, and the other threads' counts stayed theirs */
+    CHECK(stbi__pool.threads == 2 + 2 * (DECODE_THREADS - 1) - 1);
+    CHECK(stbi__jpeg_thread_count == 1);
+
+    /* and the pool is reused rather than grown again */
+    stbi_set_jpeg_thread_count(4);
+    DecodeLoop(&decoders[0]);
+    CHECK(stbi__pool.threads == 2 + 2 * (DECODE_THREADS - 1) - 1);
+    CHECK(decoders[0].mismatches == 0);
+
+    stbi_image_free(reference);
+    return TestResult();
+}
@@ -0,0 +1,245 @@
+/*
+    test_png_native16 :
+    the AVX2 16-bit PNG byte swap against the scalar stbi__png_native16, for every (img_n, out_n) pair the decoder
+    uses and every width from 1 to 129 pixels. input rows are allocated at their exact size and the output has
+    guard words after it; the two have to match word for word. then 16-bit grey, grey+alpha, RGB and RGBA PNGs,
+    plain and Adam7-interlaced, go through stbi_load_16_from_memory and have to come back with the samples they
+    were written with.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "test.h"
+
+#define GUARD 32
+#define MAX_WIDTH 129
+
+static unsigned int randomState = 1;
+
+static unsigned int Random(void)
+{
+    randomState = randomState * 1103515245u + 12345u;
+    return randomState >> 8;
+}
+
+#ifdef STBI__AVX2
+static void CheckNative16(int img_n, int out_n)
+{
+    stbi__uint32 w;
+    int trial, k;
+    for (w = 1; w <= MAX_WIDTH; ++w)
+    {
+        int bytes = (int)w * img_n * 2;
+        /* exactly one row, so a sanitizer catches reads past it */
+        stbi_uc *row = (stbi_uc *)malloc(bytes);
+        stbi__uint16 expected[4 * MAX_WIDTH + GUARD], actual[4 * MAX_WIDTH + GUARD];
+        int failed = 0;
+        for (trial = 0; trial < 8 && !failed; ++trial)
+        {
+            for (k = 0; k < bytes; ++k)
+                row[k] = (stbi_uc)Random();
+            memset(expected, 0xcd, sizeof(expected));
+            memset(actual, 0xcd, sizeof(actual));
+            stbi__png_native16(expected, row, w, img_n, out_n);
+            stbi__png_native16_avx2(actual, row, w, img_n, out_n);
+            failed = memcmp(expected, actual, sizeof(actual)) != 0;
+        }
+        free(row);
+        if (failed)
+        {
+            fprintf(stderr, "native16 avx2 vs C: %d -> %d channels, width %u differs\n", img_n, out_n, (unsigned)w);
+            testFailures++;
+            return;
+        }
+    }
+}
+#endif
+
+typedef struct
+{
+    unsigned char *data;
+    int size, capacity;
+} BufferS;
+
+static void Put(BufferS *b, const void *data, int length)
+{
+    if (length == 0)
+        return;
+    if (b->size + length > b->capacity)
+    {
+        b->capacity = (b->size + length) * 2;
+        b->data = (unsigned char *)realloc(b->data, b->capacity);
+    }
+    memcpy(b->data + b->size, data, length);
+    b->size += length;
+}
+
+static void PutU32BE(BufferS *b, unsigned int v)
+{
+    unsigned char bytes[4] = {(unsigned char)(v >> 24), (unsigned char)(v >> 16), (unsigned char)(v >> 8), (unsigned char)v};
+    Put(b, bytes, 4);
+}
+
+static unsigned int Crc32(const unsigned char *data, int length, unsigned int crc)
+{
+    int i, k;
+    for (i = 0; i < length; ++i)
+    {
+        crc ^= data[i];
+        for (k = 0; k < 8; ++k)
+            crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+    }
+    return crc;
+}
+
+static void PutChunk(BufferS *png, const char *type, const unsigned char *data, int length)
+{
+    PutU32BE(png, (unsigned int)length);
+    Put(png, type, 4);
+    Put(png, data, length);
+    PutU32BE(png, ~Crc32(data, length, Crc32((const unsigned char *)type, 4, 0xffffffffu)));
+}
+
+/* zlib stream of stored blocks; the filter and byte order are what's under test, not inflate */
+static BufferS StoredZlib(const unsigned char *data, int length)
+{
+    static const unsigned char header[2] = {0x78, 0x01};
+    BufferS z = {NULL, 0, 0};
+    unsigned int a = 1, b = 0;
+    int pos = 0, i;
+    Put(&z, header, 2);
+    do
+    {
+        int n = length - pos < 65535 ? length - pos : 65535;
+        unsigned char block[5] = {(unsigned char)(pos + n == length), (unsigned char)n, (unsigned char)(n >> 8),
+                                  (unsigned char)~n, (unsigned char)(~n >> 8)};
+        Put(&z, block, 5);
+        Put(&z, data + pos, n);
+        pos += n;
+    } while (pos < length);
+    for (i = 0; i < length; ++i)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    PutU32BE(&z, (b << 16) | a);
+    return z;
+}
+
+/* 16-bit PNG of native samples, filter none; interlaced images are written as the seven Adam7 passes */
+static BufferS Png16(const stbi__uint16 *samples, int w, int h, int channels, int interlaced)
+{
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    static const unsigned char colorTypes[5] = {0, 0, 4, 2, 6};
+    static const int xorig[7] = {0, 4, 0, 2, 0, 1, 0}, yorig[7] = {0, 0, 4, 0, 2, 0, 1};
+    static const int xspc[7] = {8, 8, 4, 4, 2, 2, 1}, yspc[7] = {8, 8, 8, 4, 4, 2, 2};
+    unsigned char header[13] = {0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0};
+    BufferS raw = {NULL, 0, 0}, png = {NULL, 0, 0}, z;
+    int pass, passes = interlaced ? 7 : 1, x, y, k;
+    for (pass = 0; pass < passes; ++pass)
+    {
+        int x0 = interlaced ? xorig[pass] : 0, y0 = interlaced ? yorig[pass] : 0;
+        int dx = interlaced ? xspc[pass] : 1, dy = interlaced ? yspc[pass] : 1;
+        if (x0 >= w || y0 >= h)
+            continue;
+        for (y = y0; y < h; y += dy)
+        {
+            Put(&raw, "", 1);
+            for (x = x0; x < w; x += dx)
+            {
+                for (k = 0; k < channels; ++k)
+                {
+                    stbi__uint16 s = samples[((size_t)y * w + x) * channels + k];
+                    unsigned char be[2] = {(unsigned char)(s >> 8), (unsigned char)s};
+                    Put(&raw, be, 2);
+                }
+            }
+        }
+    }
+    z = StoredZlib(raw.data, raw.size);
+    for (k = 0; k < 4; ++k)
+    {
+        header[k] = (unsigned char)(w >> (24 - 8 * k));
+        header[4 + k] = (unsigned char)(h >> (24 - 8 * k));
+    }
+    header[9] = colorTypes[channels];
+    header[12] = (unsigned char)interlaced;
+    Put(&png, signature, 8);
+    PutChunk(&png, "IHDR", header, 13);
+    PutChunk(&png, "IDAT", z.data, z.size);
+    PutChunk(&png, "IEND", NULL, 0);
+    free(raw.data);
+    free(z.data);
+    return png;
+}
+
+/* as stored, and with an opaque alpha channel added for grey and RGB */
+static void CheckRoundTrip(int w, int h, int channels, int interlaced)
+{
+    size_t n = (size_t)w * h, i;
+    stbi__uint16 *samples = (stbi__uint16 *)malloc(n * channels * sizeof(stbi__uint16));
+    BufferS png;
+    stbi_us *decoded;
+    int x, y, comp, k;
+    for (i = 0; i < n * channels; ++i)
+        samples[i] = (stbi__uint16)Random();
+    png = Png16(samples, w, h, channels, interlaced);
+
+    decoded = stbi_load_16_from_memory(png.data, png.size, &x, &y, &comp, 0);
+    CHECK(decoded && x == w && y == h && comp == channels);
+    if (decoded && memcmp(decoded, samples, n * channels * sizeof(stbi__uint16)) != 0)
+    {
+        fprintf(stderr, "16-bit png %dx%d, %d channels%s: samples differ\n", w, h, channels, interlaced ? ", interlaced" : "");
+        testFailures++;
+    }
+    stbi_image_free(decoded);
+
+    if (channels == 1 || channels == 3)
+    {
+        int failed = 0;
+        decoded = stbi_load_16_from_memory(png.data, png.size, &x, &y, &comp, channels + 1);
+        CHECK(decoded && x == w && y == h && comp == channels);
+        for (i = 0; decoded && i < n && !failed; ++i)
+        {
+            for (k = 0; k < channels; ++k)
+                failed |= decoded[i * (channels + 1) + k] != samples[i * channels + k];
+            failed |= decoded[i * (channels + 1) + channels] != 0xffff;
+        }
+        if (failed)
+        {
+            fprintf(stderr, "16-bit png %dx%d, %d channels%s: samples with alpha added differ\n", w, h, channels,
+                    interlaced ? ", interlaced" : "");
+            testFailures++;
+        }
+        stbi_image_free(decoded);
+    }
+    free(png.data);
+    free(samples);
+}
+
+int main(void)
+{
+    int channels, interlaced;
+#ifdef STBI__AVX2
+    if (stbi__avx2_available())
+    {
+        CheckNative16(1, 1);
+        CheckNative16(2, 2);
+        CheckNative16(3, 3);
+        CheckNative16(4, 4);
+        CheckNative16(1, 2);
+        CheckNative16(3, 4);
+    }
+    else
+        printf("no AVX2 on this CPU, only the decoder round trip was checked\n");
+#endif
+    for (channels = 1; channels <= 4; ++channels)
+    {
+        for (interlaced = 0; interlaced <= 1; ++interlaced)
+        {
+            CheckRoundTrip(129, 5, channels, interlaced);
+            CheckRoundTrip(37, 23, channels, interlaced);
+            CheckRoundTrip(1, 1, channels, interlaced);
+        }
+    }
+    return TestResult();
+}
@@ -0,0 +1,84 @@
+/*
+    test_png_unfilter :
+    the SSE4.1 and AVX2 PNG unfilter kernels against the scalar stbi__unfilter_row, for every filter type with
+    3- and 4-byte pixels and every width from 1 to 70 pixels. rows are random; the output has to match byte for
+    byte and nothing may be written past the row. kernels the CPU can't run are skipped.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "test.h"
+
+#define GUARD 64
+#define MAX_WIDTH 70
+
+static unsigned int randomState = 1;
+
+static unsigned int Random(void)
+{
+    randomState = randomState * 1103515245u + 12345u;
+    return randomState >> 8;
+}
+
+#ifdef STBI__AVX2
+static const char *filterNames[] = {"none", "sub", "up", "avg", "paeth", "avg_first"};
+
+static void CheckUnfilter(const char *name, stbi__unfilter_row_func kernel)
+{
+    int filter, bpp, w, trial, k;
+    for (filter = STBI__F_none; filter <= STBI__F_avg_first; ++filter)
+    {
+        for (bpp = 3; bpp <= 4; ++bpp)
+        {
+            for (w = 1; w <= MAX_WIDTH; ++w)
+            {
+                int nk = w * bpp;
+                /* exactly nk bytes, so a sanitizer catches reads past the input rows */
+                stbi_uc *raw = (stbi_uc *)malloc(nk), *prior = (stbi_uc *)malloc(nk);
+                stbi_uc expected[4 * MAX_WIDTH + GUARD], actual[4 * MAX_WIDTH + GUARD];
+                int failed = 0;
+                for (trial = 0; trial < 16 && !failed; ++trial)
+                {
+                    for (k = 0; k < nk; ++k)
+                    {
+                        raw[k] = (stbi_uc)Random();
+                        prior[k] = (stbi_uc)Random();
+                    }
+                    memset(expected, 0xcd, sizeof(expected));
+                    memset(actual, 0xcd, sizeof(actual));
+                    stbi__unfilter_row(expected, prior, raw, nk, bpp, filter);
+                    kernel(actual, prior, raw, nk, bpp, filter);
+                    failed = memcmp(expected, actual, sizeof(actual)) != 0;
+                }
+                free(raw);
+                free(prior);
+                if (failed)
+                {
+                    fprintf(stderr, "%s: filter %s, %d bytes/px, width %d differs\n", name, filterNames[filter], bpp, w);
+                    testFailures++;
+                    return;
+                }
+            }
+        }
+    }
+}
+#endif
+
+int main(void)
+{
+    int ran = 0;
+#ifdef STBI__AVX2
+    if (stbi__sse41_available())
+    {
+        CheckUnfilter("unfilter sse4.1 vs C", stbi__unfilter_row_sse41);
+        ran++;
+    }
+    if (stbi__avx2_available())
+    {
+        CheckUnfilter("unfilter avx2 vs C", stbi__unfilter_row_avx2);
+        ran++;
+    }
+#endif
+    if (!ran)
+        printf("no SIMD kernels on this CPU, nothing to compare\n");
+    return TestResult();
+}
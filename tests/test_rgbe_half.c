@@ -0,0 +1,159 @@
+/*
+    test_rgbe_half :
+    stbi_rgbe_to_half for every shared exponent 0-255 (zero below 10, half subnormals, values that round up to
+    infinity). the scalar path has to agree with F16C's _cvtss_sh of the floats stbi_loadf returns for the same
+    Radiance pixels, and the F16C kernel plus the scalar tail has to match the scalar path for every pixel count
+    from 1 to 33 without writing past the output. the F16C checks are skipped on CPUs without it.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_img.h"
+#include "test.h"
+
+#define PIXELS_PER_EXPONENT 8
+#define PIXELS (256 * PIXELS_PER_EXPONENT)
+#define MAX_COUNT 33
+#define GUARD 32
+
+static unsigned int randomState = 1;
+
+static unsigned int Random(void)
+{
+    randomState = randomState * 1103515245u + 12345u;
+    return randomState >> 8;
+}
+
+/* a few fixed mantissas, the rest random, for each exponent */
+static void FillRgbe(stbi_uc *rgbe)
+{
+    static const stbi_uc fixed[3][3] = {{0, 1, 2}, {127, 128, 129}, {255, 254, 253}};
+    int e, p, k;
+    for (e = 0; e < 256; ++e)
+    {
+        for (p = 0; p < PIXELS_PER_EXPONENT; ++p)
+        {
+            stbi_uc *px = rgbe + (e * PIXELS_PER_EXPONENT + p) * 4;
+            for (k = 0; k < 3; ++k)
+                px[k] = p < 3 ? fixed[p][k] : (stbi_uc)Random();
+            px[3] = (stbi_uc)e;
+        }
+    }
+}
+
+/* flat scanlines (width under 8), so the file is just the header and the pixels */
+static stbi_uc *RadianceFile(const stbi_uc *rgbe, int *length)
+{
+    char header[96];
+    int headerLength = sprintf(header, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X 4\n", PIXELS / 4);
+    stbi_uc *file = (stbi_uc *)malloc(headerLength + PIXELS * 4);
+    memcpy(file, header, headerLength);
+    memcpy(file + headerLength, rgbe, PIXELS * 4);
+    *length = headerLength + PIXELS * 4;
+    return file;
+}
+
+#ifdef STBI__AVX2
+STBI__F16C_TARGET static void FloatsToHalf(stbi_us *output, const float *input, int count)
+{
+    int i;
+    for (i = 0; i < count; ++i)
+        output[i] = (stbi_us)_cvtss_sh(input[i], _MM_FROUND_TO_NEAREST_INT);
+}
+
+static void CheckF16cKernel(const stbi_uc *rgbe, const stbi_us *expected)
+{
+    int count, start, k;
+    for (count = 1; count <= MAX_COUNT; ++count)
+    {
+        /* exactly count pixels of input, so a sanitizer catches reads past them */
+        stbi_uc *input = (stbi_uc *)malloc(count * 4);
+        stbi_us output[MAX_COUNT * 3 + GUARD];
+        int failed = 0;
+        for (start = 0; start + count <= PIXELS && !failed; start += count)
+        {
+            int done;
+            memcpy(input, rgbe + start * 4, count * 4);
+            memset(output, 0xcd, sizeof(output));
+            done = stbi__rgbe_to_half_f16c(output, input, count);
+            stbi__rgbe_to_half_scalar(output + done * 3, input + done * 4, count - done);
+            if (done < 0 || done > count || memcmp(output, expected + start * 3, count * 3 * sizeof(stbi_us)) != 0)
+            {
+                fprintf(stderr, "rgbe to half f16c: %d pixels from exponent %d differ (%d by the kernel)\n", count,
+                        rgbe[start * 4 + 3], done);
+                failed = 1;
+            }
+            for (k = count * 3; k < MAX_COUNT * 3 + GUARD && !failed; ++k)
+            {
+                if (output[k] != 0xcdcd)
+                {
+                    fprintf(stderr, "rgbe to half f16c: %d pixels wrote past the output\n", count);
+                    failed = 1;
+                }
+            }
+        }
+        free(input);
+        if (failed)
+        {
+            testFailures++;
+            return;
+        }
+    }
+}
+#endif
+
+int main(void)
+{
+    stbi_uc *rgbe = (stbi_uc *)malloc(PIXELS * 4);
+    stbi_us *expected = (stbi_us *)malloc(PIXELS * 3 * sizeof(stbi_us));
+    stbi_us *actual = (stbi_us *)malloc(PIXELS * 3 * sizeof(stbi_us));
+    int length, x, y, i;
+    stbi_uc *file, *raw;
+    float *floats;
+
+    FillRgbe(rgbe);
+    stbi__rgbe_to_half_scalar(expected, rgbe, PIXELS);
+    for (i = 0; i < PIXELS; ++i)
+    {
+        if (rgbe[i * 4 + 3] < 10)
+            CHECK(expected[i * 3] == 0 && expected[i * 3 + 1] == 0 && expected[i * 3 + 2] == 0);
+        if (rgbe[i * 4 + 3] == 255)
+            CHECK(rgbe[i * 4] == 0 || expected[i * 3] == 0x7c00);
+    }
+
+    file = RadianceFile(rgbe, &length);
+    raw = stbi_load_rgbe_from_memory(file, length, &x, &y);
+    CHECK(raw && x == 4 && y == PIXELS / 4 && memcmp(raw, rgbe, PIXELS * 4) == 0);
+    floats = stbi_loadf_from_memory(file, length, &x, &y, NULL, 3);
+    CHECK(floats != NULL);
+
+    /* whichever path this CPU takes */
+    stbi_rgbe_to_half(actual, rgbe, PIXELS);
+    CHECK(memcmp(actual, expected, PIXELS * 3 * sizeof(stbi_us)) == 0);
+
+#ifdef STBI__AVX2
+    if (stbi__f16c_available() && floats)
+    {
+        FloatsToHalf(actual, floats, PIXELS * 3);
+        for (i = 0; i < PIXELS * 3; ++i)
+        {
+            if (actual[i] != expected[i])
+            {
+                fprintf(stderr, "rgbe to half: exponent %d, mantissa %d gives %04x, _cvtss_sh(stbi_loadf) %04x\n",
+                        rgbe[i / 3 * 4 + 3], rgbe[i / 3 * 4 + i % 3], expected[i], actual[i]);
+                testFailures++;
+                break;
+            }
+        }
+        CheckF16cKernel(rgbe, expected);
+    }
+    else
+        printf("no F16C on this CPU, only the scalar path was checked\n");
+#endif
+
+    stbi_image_free(raw);
+    stbi_image_free(floats);
+    free(file);
+    free(rgbe);
+    free(expected);
+    free(actual);
+    return TestResult();
+}